@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ecc.h"
+#include "uv.h"
+
+/*
+ * P-256 signing throughput: the generic ladder, the fixed-base
+ * table with a nonce generated inline, and the table with every
+ * nonce taken from a pre-filled pool (the pool fill is not timed).
+ */
+
+#define BENCH_SIGS 2000
+
+typedef int (*bench_sign_cb)(
+  const uint8_t private_key[HSK_ECC_BYTES],
+  const uint8_t hash[HSK_ECC_BYTES],
+  uint8_t signature[HSK_ECC_BYTES * 2]
+);
+
+static double
+bench_run(const char *name, bench_sign_cb sign, bool pooled) {
+  uint8_t priv[HSK_ECC_BYTES];
+  uint8_t hash[HSK_ECC_BYTES];
+  uint8_t sig[HSK_ECC_BYTES * 2];
+  uint64_t elapsed = 0;
+  int done = 0;
+
+  for (int i = 0; i < HSK_ECC_BYTES; i++)
+    priv[i] = i + 1;
+
+  while (done < BENCH_SIGS) {
+    int batch = BENCH_SIGS - done;
+
+    if (pooled) {
+      if (batch > HSK_ECC_NONCES)
+        batch = HSK_ECC_NONCES;
+      hsk_ecc_nonces_fill(batch);
+    }
+
+    uint64_t start = uv_hrtime();
+
+    for (int i = 0; i < batch; i++) {
+      memset(hash, done + i, sizeof(hash));
+
+      if (!sign(priv, hash, sig)) {
+        fprintf(stderr, "%s: signing failed\n", name);
+        exit(1);
+      }
+    }
+
+    elapsed += uv_hrtime() - start;
+    done += batch;
+  }
+
+  double rate = (double)done * 1e9 / (double)elapsed;
+
+  printf("%-8s %6d sigs  %8.1f sigs/sec  %7.1f us/sig\n",
+         name, done, rate, (double)elapsed / 1e3 / done);
+
+  return rate;
+}
+
+int
+main() {
+  double generic = bench_run("generic", hsk_ecc_sign_generic, false);
+  double table = bench_run("table", hsk_ecc_sign, false);
+  double pooled = bench_run("pooled", hsk_ecc_sign, true);
+
+  printf("table:  %.1fx generic\n", table / generic);
+  printf("pooled: %.1fx generic\n", pooled / generic);
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+#!/usr/bin/env node
+
+/**
+ * Generate src/tld_hash.h: a minimal perfect hash over
+ * the ICANN TLD names in src/tld.h (hash and displace).
+ *
+ * A name is hashed once with 64 bit FNV-1a over its
+ * lowercased bytes. The top half picks a bucket, whose
+ * displacement scrambles the bottom half into a slot.
+ * Every name gets its own slot, which holds its index
+ * into HSK_TLD_NAMES and HSK_TLD_DATA.
+ *
+ * Must be re-run whenever src/tld.h changes. The hash
+ * and mix functions must match src/icann.c.
+ *
+ * Usage:
+ *   $ node ./scripts/tld-hash.js
+ */
+
+'use strict';
+
+const fs = require('fs');
+const path = require('path');
+
+const ROOT = path.resolve(__dirname, '..');
+const INPUT = path.join(ROOT, 'src', 'tld.h');
+const OUTPUT = path.join(ROOT, 'src', 'tld_hash.h');
+
+// Average names per bucket.
+const LOAD = 4;
+const MAX_DISP = 0xffff;
+
+function readNames(file) {
+  const text = fs.readFileSync(file, 'utf8');
+  const start = text.indexOf('HSK_TLD_NAMES[] = {');
+  const end = text.indexOf('};', start);
+
+  if (start === -1 || end === -1)
+    throw new Error('HSK_TLD_NAMES not found.');
+
+  const names = [];
+  const re = /"([^"]*)"/g;
+  const body = text.slice(start, end);
+
+  let m;
+  while ((m = re.exec(body)))
+    names.push(m[1]);
+
+  const size = /#define HSK_TLD_SIZE (\d+)/.exec(text);
+
+  if (!size || Number(size[1]) !== names.length)
+    throw new Error('HSK_TLD_SIZE does not match HSK_TLD_NAMES.');
+
+  return names;
+}
+
+function hash(name) {
+  let h = 0xcbf29ce484222325n;
+
+  for (const ch of Buffer.from(name.toLowerCase(), 'ascii')) {
+    h ^= BigInt(ch);
+    h = (h * 0x100000001b3n) & 0xffffffffffffffffn;
+  }
+
+  return [Number(h >> 32n), Number(h & 0xffffffffn)];
+}
+
+function mix(lo, disp, size) {
+  let x = (lo ^ Math.imul(disp, 0x9e3779b9)) >>> 0;
+  x = Math.imul(x ^ (x >>> 16), 0x85ebca6b) >>> 0;
+  x = (x ^ (x >>> 13)) >>> 0;
+  return x % size;
+}
+
+function build(names) {
+  const size = names.length;
+  const buckets = Math.ceil(size / LOAD);
+  const lists = [];
+
+  for (let i = 0; i < buckets; i++)
+    lists.push([]);
+
+  names.forEach((name, index) => {
+    const [hi, lo] = hash(name);
+    lists[hi % buckets].push({ index, lo });
+  });
+
+  const order = lists
+    .map((list, bucket) => ({ bucket, list }))
+    .sort((a, b) => b.list.length - a.list.length);
+
+  const disps = new Array(buckets).fill(0);
+  const slots = new Array(size).fill(-1);
+
+  for (const { bucket, list } of order) {
+    if (list.length === 0)
+      continue;
+
+    let disp = 0;
+
+    for (; disp <= MAX_DISP; disp++) {
+      const taken = new Set();
+      let ok = true;
+
+      for (const { lo } of list) {
+        const slot = mix(lo, disp, size);
+
+        if (slots[slot] !== -1 || taken.has(slot)) {
+          ok = false;
+          break;
+        }
+
+        taken.add(slot);
+      }
+
+      if (ok)
+        break;
+    }
+
+    if (disp > MAX_DISP)
+      throw new Error(`No displacement for bucket ${bucket}.`);
+
+    disps[bucket] = disp;
+
+    for (const { index, lo } of list)
+      slots[mix(lo, disp, size)] = index;
+  }
+
+  return { buckets, disps, slots };
+}
+
+function table(values) {
+  const lines = [];
+
+  for (let i = 0; i < values.length; i += 12)
+    lines.push('  ' + values.slice(i, i + 12).join(', '));
+
+  return lines.join(',\n');
+}
+
+function main() {
+  const names = readNames(INPUT);
+  const { buckets, disps, slots } = build(names);
+
+  names.forEach((name, index) => {
+    const [hi, lo] = hash(name);
+    if (slots[mix(lo, disps[hi % buckets], names.length)] !== index)
+      throw new Error(`Bad slot for ${name}.`);
+  });
+
+  const out = [
+    '#ifndef _HSK_TLD_HASH_H',
+    '#define _HSK_TLD_HASH_H',
+    '',
+    '/* Autogenerated by scripts/tld-hash.js, do not edit. */',
+    '',
+    '#include <stdint.h>',
+    '',
+    `#define HSK_TLD_BUCKETS ${buckets}`,
+    '',
+    'static const uint16_t HSK_TLD_DISP[HSK_TLD_BUCKETS] = {',
+    table(disps),
+    '};',
+    '',
+    'static const uint16_t HSK_TLD_SLOTS[HSK_TLD_SIZE] = {',
+    table(slots),
+    '};',
+    '',
+    '#endif',
+    ''
+  ];
+
+  fs.writeFileSync(OUTPUT, out.join('\n'));
+}
+
+main();
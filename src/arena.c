@@ -0,0 +1,169 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/*
+ * Helpers
+ */
+
+static size_t
+hsk_arena_pad(const uint8_t *ptr) {
+  return (HSK_ARENA_ALIGN - ((uintptr_t)ptr & (HSK_ARENA_ALIGN - 1)))
+         & (HSK_ARENA_ALIGN - 1);
+}
+
+// Chain a heap block big enough for `size`
+// and continue carving from it.
+static bool
+hsk_arena_grow(hsk_arena_t *arena, size_t size) {
+  size_t need = sizeof(hsk_arena_block_t) + HSK_ARENA_ALIGN + size;
+
+  if (need < size)
+    return false;
+
+  if (need < HSK_ARENA_BLOCK)
+    need = HSK_ARENA_BLOCK;
+
+  hsk_arena_block_t *block = malloc(need);
+
+  if (!block)
+    return false;
+
+  block->next = arena->blocks;
+  block->size = need;
+
+  arena->blocks = block;
+  arena->buf = (uint8_t *)&block[1];
+  arena->size = need - sizeof(hsk_arena_block_t);
+  arena->pos = 0;
+  arena->grows += 1;
+
+  return true;
+}
+
+/*
+ * Arena
+ */
+
+void
+hsk_arena_init(hsk_arena_t *arena) {
+  assert(arena);
+
+  arena->buf = arena->data;
+  arena->size = sizeof(arena->data);
+  arena->pos = 0;
+  arena->last = NULL;
+  arena->blocks = NULL;
+  arena->allocs = 0;
+  arena->grows = 0;
+}
+
+void
+hsk_arena_uninit(hsk_arena_t *arena) {
+  assert(arena);
+  hsk_arena_reset(arena);
+}
+
+hsk_arena_t *
+hsk_arena_alloc(void) {
+  hsk_arena_t *arena = malloc(sizeof(hsk_arena_t));
+
+  if (!arena)
+    return NULL;
+
+  hsk_arena_init(arena);
+
+  return arena;
+}
+
+void
+hsk_arena_free(hsk_arena_t *arena) {
+  if (arena) {
+    hsk_arena_uninit(arena);
+    free(arena);
+  }
+}
+
+// Release everything at once. Counters are kept.
+void
+hsk_arena_reset(hsk_arena_t *arena) {
+  assert(arena);
+
+  hsk_arena_block_t *block = arena->blocks;
+
+  while (block) {
+    hsk_arena_block_t *next = block->next;
+    free(block);
+    block = next;
+  }
+
+  arena->buf = arena->data;
+  arena->size = sizeof(arena->data);
+  arena->pos = 0;
+  arena->last = NULL;
+  arena->blocks = NULL;
+}
+
+void *
+hsk_arena_malloc(hsk_arena_t *arena, size_t size) {
+  if (!arena)
+    return malloc(size);
+
+  if (size == 0)
+    size = 1;
+
+  size_t pad = hsk_arena_pad(&arena->buf[arena->pos]);
+
+  if (size > arena->size - arena->pos
+      || pad > arena->size - arena->pos - size) {
+    if (!hsk_arena_grow(arena, size))
+      return NULL;
+
+    pad = hsk_arena_pad(&arena->buf[arena->pos]);
+  }
+
+  uint8_t *ptr = &arena->buf[arena->pos + pad];
+
+  arena->pos += pad + size;
+  arena->last = ptr;
+  arena->allocs += 1;
+
+  return ptr;
+}
+
+void *
+hsk_arena_calloc(hsk_arena_t *arena, size_t count, size_t size) {
+  if (!arena)
+    return calloc(count, size);
+
+  if (size != 0 && count > SIZE_MAX / size)
+    return NULL;
+
+  void *ptr = hsk_arena_malloc(arena, count * size);
+
+  if (ptr)
+    memset(ptr, 0, count * size);
+
+  return ptr;
+}
+
+// Heap memory is freed. Arena memory stays put until the
+// arena is reset, unless it is the latest allocation.
+void
+hsk_arena_release(hsk_arena_t *arena, void *ptr) {
+  if (!arena) {
+    free(ptr);
+    return;
+  }
+
+  if (ptr && ptr == arena->last) {
+    arena->pos = arena->last - arena->buf;
+    arena->last = NULL;
+  }
+}
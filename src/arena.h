@@ -0,0 +1,76 @@
+#ifndef _HSK_ARENA_H
+#define _HSK_ARENA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Defs
+ */
+
+// Inline space, enough to build and sign a typical response.
+#define HSK_ARENA_SIZE 16384
+// Heap blocks chained once the inline space runs out.
+#define HSK_ARENA_BLOCK 16384
+#define HSK_ARENA_ALIGN 16
+
+/*
+ * Types
+ */
+
+typedef struct hsk_arena_block_s {
+  struct hsk_arena_block_s *next;
+  size_t size;
+} hsk_arena_block_t;
+
+typedef struct hsk_arena_s {
+  // Block being carved up.
+  uint8_t *buf;
+  size_t size;
+  size_t pos;
+  // Most recent allocation, which may be given back.
+  uint8_t *last;
+  hsk_arena_block_t *blocks;
+  uint64_t allocs;
+  uint64_t grows;
+  uint8_t data[HSK_ARENA_SIZE];
+} hsk_arena_t;
+
+/*
+ * Arena
+ *
+ * Bump allocator for objects which all die together, such as everything
+ * built for one response.  Allocation never frees; the whole arena is
+ * released at once by hsk_arena_reset() or hsk_arena_uninit().
+ *
+ * Every function here also accepts a NULL arena and then behaves like the
+ * plain heap functions, so code taking an allocator works either way.
+ * Objects record the arena they came from and are freed accordingly.
+ */
+
+void
+hsk_arena_init(hsk_arena_t *arena);
+
+void
+hsk_arena_uninit(hsk_arena_t *arena);
+
+hsk_arena_t *
+hsk_arena_alloc(void);
+
+void
+hsk_arena_free(hsk_arena_t *arena);
+
+void
+hsk_arena_reset(hsk_arena_t *arena);
+
+void *
+hsk_arena_malloc(hsk_arena_t *arena, size_t size);
+
+void *
+hsk_arena_calloc(hsk_arena_t *arena, size_t count, size_t size);
+
+void
+hsk_arena_release(hsk_arena_t *arena, void *ptr);
+
+#endif
@@ -7,6 +7,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 
+#include "bio.h"
 #include "cache.h"
 #include "dns.h"
 #include "error.h"
@@ -22,12 +23,46 @@ hsk_cache_init(hsk_cache_t *c) {
     hsk_cache_key_hash,
     hsk_cache_key_equal,
     (hsk_map_free_func)hsk_cache_item_free);
+  hsk_map_init_map(&c->wires,
+    hsk_cache_wire_key_hash,
+    hsk_cache_wire_key_equal,
+    NULL);
+  c->head = NULL;
+  c->tail = NULL;
+  c->heap = NULL;
+  c->heap_size = 0;
+  c->heap_cap = 0;
+  c->size = 0;
+  c->max_size = HSK_CACHE_SIZE;
+  c->max_items = HSK_CACHE_LIMIT;
+  c->min_ttl = HSK_CACHE_MIN_TTL;
+  c->max_ttl = HSK_CACHE_MAX_TTL;
+  c->max_stale = HSK_CACHE_MAX_STALE;
+  c->hits = 0;
+  c->wire_hits = 0;
+  c->stale_hits = 0;
+  c->misses = 0;
+  c->evictions = 0;
+  c->expirations = 0;
 }
 
 void
 hsk_cache_uninit(hsk_cache_t *c) {
   assert(c);
+  // Items own their finalized responses.
+  hsk_map_uninit(&c->wires);
   hsk_map_uninit(&c->map);
+  c->head = NULL;
+  c->tail = NULL;
+
+  if (c->heap) {
+    free(c->heap);
+    c->heap = NULL;
+  }
+
+  c->heap_size = 0;
+  c->heap_cap = 0;
+  c->size = 0;
 }
 
 hsk_cache_t *
@@ -57,65 +92,343 @@ hsk_cache_log(const hsk_cache_t *c, const char *fmt, ...) {
 }
 
 static void
-hsk_cache_prune(hsk_cache_t *c) {
+hsk_cache_unlink(hsk_cache_t *c, hsk_cache_item_t *item) {
+  if (item->prev)
+    item->prev->next = item->next;
+  else
+    c->head = item->next;
+
+  if (item->next)
+    item->next->prev = item->prev;
+  else
+    c->tail = item->prev;
+
+  item->prev = NULL;
+  item->next = NULL;
+}
+
+static void
+hsk_cache_push(hsk_cache_t *c, hsk_cache_item_t *item) {
+  item->prev = NULL;
+  item->next = c->head;
+
+  if (c->head)
+    c->head->prev = item;
+  else
+    c->tail = item;
+
+  c->head = item;
+}
+
+/*
+ * Expiry Heap
+ */
+
+static void
+hsk_cache_heap_set(hsk_cache_t *c, size_t i, hsk_cache_item_t *item) {
+  c->heap[i] = item;
+  item->heap_index = i;
+}
+
+static void
+hsk_cache_heap_up(hsk_cache_t *c, size_t i) {
+  hsk_cache_item_t *item = c->heap[i];
+
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+
+    if (c->heap[parent]->expires <= item->expires)
+      break;
+
+    hsk_cache_heap_set(c, i, c->heap[parent]);
+    i = parent;
+  }
+
+  hsk_cache_heap_set(c, i, item);
+}
+
+static void
+hsk_cache_heap_down(hsk_cache_t *c, size_t i) {
+  hsk_cache_item_t *item = c->heap[i];
+
+  for (;;) {
+    size_t child = i * 2 + 1;
+
+    if (child >= c->heap_size)
+      break;
+
+    if (child + 1 < c->heap_size
+        && c->heap[child + 1]->expires < c->heap[child]->expires) {
+      child += 1;
+    }
+
+    if (item->expires <= c->heap[child]->expires)
+      break;
+
+    hsk_cache_heap_set(c, i, c->heap[child]);
+    i = child;
+  }
+
+  hsk_cache_heap_set(c, i, item);
+}
+
+static bool
+hsk_cache_heap_insert(hsk_cache_t *c, hsk_cache_item_t *item) {
+  if (c->heap_size == c->heap_cap) {
+    size_t cap = c->heap_cap ? c->heap_cap * 2 : 64;
+    hsk_cache_item_t **heap = realloc(c->heap, cap * sizeof(*heap));
+
+    if (!heap)
+      return false;
+
+    c->heap = heap;
+    c->heap_cap = cap;
+  }
+
+  hsk_cache_heap_set(c, c->heap_size, item);
+  c->heap_size += 1;
+  hsk_cache_heap_up(c, item->heap_index);
+
+  return true;
+}
+
+static void
+hsk_cache_heap_remove(hsk_cache_t *c, hsk_cache_item_t *item) {
+  size_t i = item->heap_index;
+
+  assert(i < c->heap_size && c->heap[i] == item);
+
+  c->heap_size -= 1;
+
+  if (i == c->heap_size)
+    return;
+
+  hsk_cache_heap_set(c, i, c->heap[c->heap_size]);
+  hsk_cache_heap_down(c, i);
+  hsk_cache_heap_up(c, i);
+}
+
+static void
+hsk_cache_remove(hsk_cache_t *c, hsk_cache_item_t *item) {
+  hsk_cache_wire_t *cw;
+
+  for (cw = item->wires; cw; cw = cw->next) {
+    hsk_map_del(&c->wires, &cw->key);
+    assert(c->size >= cw->data_len);
+    c->size -= cw->data_len;
+  }
+
+  hsk_cache_heap_remove(c, item);
+  hsk_cache_unlink(c, item);
+  hsk_map_del(&c->map, &item->key);
+  assert(c->size >= item->msg_len);
+  c->size -= item->msg_len;
+  hsk_cache_item_free(item);
+}
+
+// Evict least recently used entries until
+// there is room for `size` more bytes.
+static void
+hsk_cache_prune(hsk_cache_t *c, size_t size) {
   assert(c);
-  hsk_map_clear(&c->map);
+
+  while (c->tail) {
+    if (c->map.size < c->max_items && c->size + size <= c->max_size)
+      break;
+
+    hsk_cache_remove(c, c->tail);
+    c->evictions += 1;
+  }
+}
+
+// Room for a wire copy, which adds bytes but no entry.
+static void
+hsk_cache_prune_size(hsk_cache_t *c, size_t size) {
+  assert(c);
+
+  while (c->tail && c->size + size > c->max_size) {
+    hsk_cache_remove(c, c->tail);
+    c->evictions += 1;
+  }
 }
 
 bool
-hsk_cache_insert_data(
-  hsk_cache_t *c,
-  const char *name,
-  uint16_t type,
-  uint8_t *wire,
-  size_t wire_len
-) {
+hsk_cache_set_limit(hsk_cache_t *c, size_t max_items, size_t max_size) {
   assert(c);
 
-  hsk_cache_key_t ck;
-  hsk_cache_key_init(&ck);
+  if (max_items == 0 || max_size == 0)
+    return false;
 
-  if (!hsk_cache_key_set(&ck, name, type))
+  c->max_items = max_items;
+  c->max_size = max_size;
+
+  hsk_cache_prune(c, 0);
+
+  return true;
+}
+
+bool
+hsk_cache_set_ttl(hsk_cache_t *c, uint32_t min_ttl, uint32_t max_ttl) {
+  assert(c);
+
+  if (min_ttl > max_ttl)
     return false;
 
-  hsk_cache_item_t *cache = hsk_map_get(&c->map, &ck);
+  c->min_ttl = min_ttl;
+  c->max_ttl = max_ttl;
 
-  if (cache) {
-    if (hsk_now() < cache->time + 6 * 60 * 60) {
-      free(wire);
-      return true;
-    }
+  return true;
+}
 
-    hsk_map_del(&c->map, &ck);
-    hsk_cache_item_free(cache);
+void
+hsk_cache_set_stale(hsk_cache_t *c, uint32_t max_stale) {
+  assert(c);
+  c->max_stale = max_stale;
+}
 
-    cache = NULL;
+// Reclaim every entry which has been expired
+// for longer than it may be served stale.
+void
+hsk_cache_expire(hsk_cache_t *c, int64_t now) {
+  assert(c);
+
+  now -= c->max_stale;
+
+  while (c->heap_size > 0 && c->heap[0]->expires <= now) {
+    hsk_cache_remove(c, c->heap[0]);
+    c->expirations += 1;
+  }
+}
+
+// Lowest TTL of the answer and authority sections.
+static uint32_t
+hsk_cache_msg_ttl(const hsk_cache_t *c, const hsk_dns_msg_t *msg) {
+  const hsk_dns_rrs_t *sections[2] = { &msg->an, &msg->ns };
+  bool found = false;
+  uint32_t ttl = 0;
+  int i, j;
+
+  for (i = 0; i < 2; i++) {
+    const hsk_dns_rrs_t *rrs = sections[i];
+
+    for (j = 0; j < rrs->size; j++) {
+      const hsk_dns_rr_t *rr = rrs->items[j];
+
+      if (!found || rr->ttl < ttl)
+        ttl = rr->ttl;
+
+      found = true;
+    }
   }
 
-  if (c->map.size >= HSK_CACHE_LIMIT)
-    hsk_cache_prune(c);
+  if (!found)
+    return c->min_ttl;
+
+  return ttl;
+}
+
+// Link a new entry, taking ownership of
+// `wire` only when returning true.
+static bool
+hsk_cache_add(
+  hsk_cache_t *c,
+  const hsk_cache_key_t *ck,
+  uint8_t *wire,
+  size_t wire_len,
+  int64_t time,
+  int64_t expires
+) {
+  hsk_cache_prune(c, wire_len);
 
   hsk_cache_item_t *item = hsk_cache_item_alloc();
 
   if (!item)
     return false;
 
-  memcpy(&item->key, &ck, sizeof(hsk_cache_key_t));
+  memcpy(&item->key, ck, sizeof(hsk_cache_key_t));
 
   item->msg = wire;
   item->msg_len = wire_len;
-  item->time = hsk_now();
+  item->time = time;
+  item->expires = expires;
+
+  if (!hsk_cache_heap_insert(c, item)) {
+    item->msg = NULL;
+    free(item);
+    return false;
+  }
 
   if (!hsk_map_set(&c->map, &item->key, item)) {
     // hsk_cache_insert will free msg on false
+    hsk_cache_heap_remove(c, item);
     item->msg = NULL;
     free(item);
     return false;
   }
 
+  hsk_cache_push(c, item);
+  c->size += wire_len;
+
   return true;
 }
 
+static bool
+hsk_cache_insert_key(
+  hsk_cache_t *c,
+  const hsk_cache_key_t *ck,
+  uint8_t *wire,
+  size_t wire_len,
+  uint32_t ttl
+) {
+  if (wire_len > c->max_size)
+    return false;
+
+  int64_t now = hsk_now();
+
+  hsk_cache_expire(c, now);
+
+  hsk_cache_item_t *cache = hsk_map_get(&c->map, ck);
+
+  if (cache) {
+    if (now < cache->expires) {
+      free(wire);
+      return true;
+    }
+
+    // Replace the stale entry.
+    hsk_cache_remove(c, cache);
+    cache = NULL;
+  }
+
+  if (ttl < c->min_ttl)
+    ttl = c->min_ttl;
+
+  if (ttl > c->max_ttl)
+    ttl = c->max_ttl;
+
+  return hsk_cache_add(c, ck, wire, wire_len, now, now + ttl);
+}
+
+bool
+hsk_cache_insert_data(
+  hsk_cache_t *c,
+  const char *name,
+  uint16_t type,
+  uint8_t *wire,
+  size_t wire_len,
+  uint32_t ttl
+) {
+  assert(c);
+
+  hsk_cache_key_t ck;
+  hsk_cache_key_init(&ck);
+
+  if (!hsk_cache_key_set(&ck, name, type))
+    return false;
+
+  return hsk_cache_insert_key(c, &ck, wire, wire_len, ttl);
+}
+
 bool
 hsk_cache_insert(
   hsk_cache_t *c,
@@ -130,7 +443,13 @@ hsk_cache_insert(
     return false;
   }
 
-  if (!hsk_cache_insert_data(c, req->name, req->type, wire, wire_len)) {
+  uint32_t ttl = hsk_cache_msg_ttl(c, msg);
+
+  hsk_cache_key_t ck;
+  hsk_cache_key_init(&ck);
+
+  if (!hsk_cache_key_set_req(&ck, req)
+      || !hsk_cache_insert_key(c, &ck, wire, wire_len, ttl)) {
     hsk_cache_log(c, "could not insert cache\n");
     free(wire);
     return false;
@@ -139,6 +458,36 @@ hsk_cache_insert(
   return true;
 }
 
+static bool
+hsk_cache_get_key(
+  hsk_cache_t *c,
+  const hsk_cache_key_t *ck,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  int64_t now = hsk_now();
+
+  hsk_cache_expire(c, now);
+
+  hsk_cache_item_t *cache = hsk_map_get(&c->map, ck);
+
+  if (!cache || now >= cache->expires) {
+    c->misses += 1;
+    return false;
+  }
+
+  // Move to the front of the LRU list.
+  hsk_cache_unlink(c, cache);
+  hsk_cache_push(c, cache);
+
+  c->hits += 1;
+
+  *wire = cache->msg;
+  *wire_len = cache->msg_len;
+
+  return true;
+}
+
 bool
 hsk_cache_get_data(
   hsk_cache_t *c,
@@ -155,21 +504,7 @@ hsk_cache_get_data(
   if (!hsk_cache_key_set(&ck, name, type))
     return false;
 
-  hsk_cache_item_t *cache = hsk_map_get(&c->map, &ck);
-
-  if (!cache)
-    return false;
-
-  if (hsk_now() >= cache->time + 6 * 60 * 60) {
-    hsk_map_del(&c->map, &ck);
-    hsk_cache_item_free(cache);
-    return false;
-  }
-
-  *wire = cache->msg;
-  *wire_len = cache->msg_len;
-
-  return true;
+  return hsk_cache_get_key(c, &ck, wire, wire_len);
 }
 
 hsk_dns_msg_t *
@@ -178,7 +513,13 @@ hsk_cache_get(hsk_cache_t *c, const hsk_dns_req_t *req) {
   size_t data_len;
   hsk_dns_msg_t *msg;
 
-  if (!hsk_cache_get_data(c, req->name, req->type, &data, &data_len))
+  hsk_cache_key_t ck;
+  hsk_cache_key_init(&ck);
+
+  if (!hsk_cache_key_set_req(&ck, req))
+    return NULL;
+
+  if (!hsk_cache_get_key(c, &ck, &data, &data_len))
     return NULL;
 
   hsk_cache_log(c, "cache hit for: %s\n", req->name);
@@ -191,6 +532,355 @@ hsk_cache_get(hsk_cache_t *c, const hsk_dns_req_t *req) {
   return msg;
 }
 
+// Serve an expired entry with its TTLs lowered. Sets `refresh`
+// when the caller should fetch a replacement in the background.
+hsk_dns_msg_t *
+hsk_cache_get_stale(hsk_cache_t *c, const hsk_dns_req_t *req, bool *refresh) {
+  assert(c && req && refresh);
+
+  *refresh = false;
+
+  hsk_cache_key_t ck;
+  hsk_cache_key_init(&ck);
+
+  if (!hsk_cache_key_set_req(&ck, req))
+    return NULL;
+
+  int64_t now = hsk_now();
+
+  hsk_cache_expire(c, now);
+
+  hsk_cache_item_t *cache = hsk_map_get(&c->map, &ck);
+
+  if (!cache || now < cache->expires)
+    return NULL;
+
+  hsk_dns_msg_t *msg;
+
+  if (!hsk_dns_msg_decode(cache->msg, cache->msg_len, &msg)) {
+    hsk_cache_log(c, "could not deserialize stale item\n");
+    return NULL;
+  }
+
+  hsk_dns_rrs_t *sections[3] = { &msg->an, &msg->ns, &msg->ar };
+  int i, j;
+
+  for (i = 0; i < 3; i++) {
+    hsk_dns_rrs_t *rrs = sections[i];
+
+    for (j = 0; j < rrs->size; j++) {
+      hsk_dns_rr_t *rr = rrs->items[j];
+
+      if (rr->ttl > HSK_CACHE_STALE_TTL)
+        rr->ttl = HSK_CACHE_STALE_TTL;
+    }
+  }
+
+  if (now >= cache->refresh_time + HSK_CACHE_REFRESH_INTERVAL) {
+    cache->refresh_time = now;
+    *refresh = true;
+  }
+
+  hsk_cache_unlink(c, cache);
+  hsk_cache_push(c, cache);
+
+  c->hits += 1;
+  c->stale_hits += 1;
+
+  hsk_cache_log(c, "stale cache hit for: %s\n", req->name);
+
+  return msg;
+}
+
+// Length of the uncompressed name at the start of the question section.
+static size_t
+hsk_cache_qname_len(const uint8_t *data, size_t data_len) {
+  size_t off = 12;
+
+  while (off < data_len) {
+    uint8_t len = data[off];
+
+    if (len & 0xc0)
+      return 0;
+
+    off += 1 + len;
+
+    if (len == 0)
+      return off - 12;
+  }
+
+  return 0;
+}
+
+// Store a finalized response alongside the cached
+// message it was built from. Expires with that message.
+bool
+hsk_cache_insert_wire(
+  hsk_cache_t *c,
+  const hsk_dns_req_t *req,
+  const uint8_t *wire,
+  size_t wire_len
+) {
+  assert(c && req && wire);
+
+  hsk_cache_key_t ck;
+  hsk_cache_key_init(&ck);
+
+  if (!hsk_cache_key_set_req(&ck, req))
+    return false;
+
+  hsk_cache_wire_t *cw = malloc(sizeof(hsk_cache_wire_t));
+
+  if (!cw)
+    return false;
+
+  if (!hsk_cache_wire_key_set(&cw->key, req)) {
+    free(cw);
+    return false;
+  }
+
+  if (hsk_map_has(&c->wires, &cw->key)) {
+    free(cw);
+    return true;
+  }
+
+  cw->qname_len = hsk_cache_qname_len(wire, wire_len);
+  cw->data = malloc(wire_len);
+  cw->data_len = wire_len;
+  cw->item = NULL;
+  cw->next = NULL;
+
+  if (cw->qname_len == 0 || !cw->data) {
+    hsk_cache_wire_free(cw);
+    return false;
+  }
+
+  memcpy(cw->data, wire, wire_len);
+
+  int64_t now = hsk_now();
+
+  hsk_cache_expire(c, now);
+
+  hsk_cache_item_t *item = hsk_map_get(&c->map, &ck);
+
+  if (!item || now >= item->expires) {
+    hsk_cache_wire_free(cw);
+    return false;
+  }
+
+  // Keep the parent from being evicted to make room.
+  hsk_cache_unlink(c, item);
+  hsk_cache_push(c, item);
+
+  hsk_cache_prune_size(c, wire_len);
+
+  if (!hsk_map_has(&c->map, &ck)) {
+    hsk_cache_wire_free(cw);
+    return false;
+  }
+
+  if (!hsk_map_set(&c->wires, &cw->key, cw)) {
+    hsk_cache_wire_free(cw);
+    return false;
+  }
+
+  cw->item = item;
+  cw->next = item->wires;
+  item->wires = cw;
+  c->size += wire_len;
+
+  return true;
+}
+
+// Copy out a finalized response, patched with
+// the ID, flags and question case of the query.
+bool
+hsk_cache_get_wire(
+  hsk_cache_t *c,
+  const hsk_dns_req_t *req,
+  const uint8_t *query,
+  size_t query_len,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  assert(c && req && query && wire && wire_len);
+
+  hsk_cache_wire_key_t wk;
+
+  if (!hsk_cache_wire_key_set(&wk, req))
+    return false;
+
+  int64_t now = hsk_now();
+
+  hsk_cache_expire(c, now);
+
+  hsk_cache_wire_t *cw = hsk_map_get(&c->wires, &wk);
+
+  if (!cw || now >= cw->item->expires)
+    return false;
+
+  size_t qname_len = hsk_cache_qname_len(query, query_len);
+
+  if (qname_len != cw->qname_len)
+    return false;
+
+  uint8_t *data = malloc(cw->data_len);
+
+  if (!data)
+    return false;
+
+  memcpy(data, cw->data, cw->data_len);
+
+  // ID.
+  data[0] = req->id >> 8;
+  data[1] = req->id & 0xff;
+
+  // Flags.
+  uint16_t flags = ((uint16_t)data[2] << 8) | data[3];
+
+  flags &= ~(HSK_DNS_RD | HSK_DNS_CD);
+
+  if (req->rd)
+    flags |= HSK_DNS_RD;
+
+  if (req->cd)
+    flags |= HSK_DNS_CD;
+
+  data[2] = flags >> 8;
+  data[3] = flags & 0xff;
+
+  // Question name, preserving the case they sent.
+  memcpy(&data[12], &query[12], qname_len);
+
+  hsk_cache_unlink(c, cw->item);
+  hsk_cache_push(c, cw->item);
+
+  c->hits += 1;
+  c->wire_hits += 1;
+
+  *wire = data;
+  *wire_len = cw->data_len;
+
+  return true;
+}
+
+// Serialize every entry, least recently used
+// first, so reading them back keeps LRU order.
+size_t
+hsk_cache_write(const hsk_cache_t *c, uint8_t **data) {
+  assert(c);
+
+  size_t s = 0;
+  uint32_t count = 0;
+  hsk_cache_item_t *item;
+
+  for (item = c->tail; item; item = item->prev) {
+    if (item->msg_len > UINT32_MAX)
+      continue;
+    count += 1;
+  }
+
+  s += write_u32(data, count);
+
+  for (item = c->tail; item; item = item->prev) {
+    if (item->msg_len > UINT32_MAX)
+      continue;
+
+    s += write_u8(data, (uint8_t)item->key.name_len);
+    s += write_bytes(data, item->key.name, item->key.name_len);
+    s += write_u16(data, item->key.type);
+    s += write_u8(data, item->key.ref ? 1 : 0);
+    s += write_i64(data, item->time);
+    s += write_i64(data, item->expires);
+    s += write_u32(data, (uint32_t)item->msg_len);
+    s += write_bytes(data, item->msg, item->msg_len);
+  }
+
+  return s;
+}
+
+// Restore entries written by hsk_cache_write,
+// skipping those too old to be served stale.
+bool
+hsk_cache_read(hsk_cache_t *c, uint8_t **data, size_t *data_len) {
+  assert(c);
+
+  int64_t now = hsk_now();
+  uint32_t count;
+
+  if (!read_u32(data, data_len, &count))
+    return false;
+
+  for (uint32_t i = 0; i < count; i++) {
+    hsk_cache_key_t ck;
+    uint8_t name_len, ref;
+    int64_t time, expires;
+    uint32_t msg_len;
+
+    hsk_cache_key_init(&ck);
+
+    if (!read_u8(data, data_len, &name_len))
+      return false;
+
+    if (name_len > HSK_DNS_MAX_NAME)
+      return false;
+
+    if (!read_bytes(data, data_len, ck.name, name_len))
+      return false;
+
+    ck.name[name_len] = '\0';
+    ck.name_len = name_len;
+
+    if (!read_u16(data, data_len, &ck.type))
+      return false;
+
+    if (!read_u8(data, data_len, &ref))
+      return false;
+
+    ck.ref = ref != 0;
+
+    if (!read_i64(data, data_len, &time))
+      return false;
+
+    if (!read_i64(data, data_len, &expires))
+      return false;
+
+    if (!read_u32(data, data_len, &msg_len))
+      return false;
+
+    if (*data_len < msg_len)
+      return false;
+
+    const uint8_t *msg = *data;
+
+    *data += msg_len;
+    *data_len -= msg_len;
+
+    if (expires <= now - (int64_t)c->max_stale)
+      continue;
+
+    if (msg_len == 0 || msg_len > c->max_size)
+      continue;
+
+    if (hsk_map_has(&c->map, &ck))
+      continue;
+
+    uint8_t *wire = malloc(msg_len);
+
+    if (!wire)
+      return false;
+
+    memcpy(wire, msg, msg_len);
+
+    if (!hsk_cache_add(c, &ck, wire, msg_len, time, expires)) {
+      free(wire);
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void
 hsk_cache_key_init(hsk_cache_key_t *ck) {
   assert(ck);
@@ -255,6 +945,33 @@ hsk_cache_key_equal(const void *a, const void *b) {
   return true;
 }
 
+// Whether the answer is a referral, shared by
+// every name under the TLD, keyed by the TLD alone.
+static bool
+hsk_cache_key_ref(const char *name, int labels, uint16_t type) {
+  switch (labels) {
+    case 0:
+    case 1:
+      return false;
+    case 2:
+      return !hsk_resource_is_ptr(name);
+    case 3:
+      switch (type) {
+        case HSK_DNS_SRV:
+          return !hsk_dns_label_is_srv(name);
+        case HSK_DNS_TLSA:
+          return !hsk_dns_label_is_tlsa(name);
+        case HSK_DNS_SMIMEA:
+          return !hsk_dns_label_is_smimea(name);
+        case HSK_DNS_OPENPGPKEY:
+          return !hsk_dns_label_is_openpgpkey(name);
+      }
+      return true;
+  }
+
+  return true;
+}
+
 bool
 hsk_cache_key_set(hsk_cache_key_t *ck, const char *name, uint16_t type) {
   assert(ck);
@@ -266,44 +983,7 @@ hsk_cache_key_set(hsk_cache_key_t *ck, const char *name, uint16_t type) {
     return false;
 
   int labels = hsk_dns_label_count(name);
-  bool ref = false;
-
-  switch (labels) {
-    case 0:
-    case 1:
-      ref = false;
-      break;
-    case 2:
-      ref = !hsk_resource_is_ptr(name);
-      break;
-    case 3:
-      switch (type) {
-        case HSK_DNS_SRV: {
-          ref = !hsk_dns_label_is_srv(name);
-          break;
-        }
-        case HSK_DNS_TLSA: {
-          ref = !hsk_dns_label_is_tlsa(name);
-          break;
-        }
-        case HSK_DNS_SMIMEA: {
-          ref = !hsk_dns_label_is_smimea(name);
-          break;
-        }
-        case HSK_DNS_OPENPGPKEY: {
-          ref = !hsk_dns_label_is_openpgpkey(name);
-          break;
-        }
-        default: {
-          ref = true;
-          break;
-        }
-      }
-      break;
-    default:
-      ref = true;
-      break;
-  }
+  bool ref = hsk_cache_key_ref(name, labels, type);
 
   if (ref)
     labels = 1;
@@ -316,6 +996,111 @@ hsk_cache_key_set(hsk_cache_key_t *ck, const char *name, uint16_t type) {
   return true;
 }
 
+// Same key, from what parsing the query already worked out.
+bool
+hsk_cache_key_set_req(hsk_cache_key_t *ck, const hsk_dns_req_t *req) {
+  assert(ck && req);
+
+  // Built by hand rather than parsed.
+  if (req->name_len == 0)
+    return hsk_cache_key_set(ck, req->name, req->type);
+
+  if (req->dirty)
+    return false;
+
+  int labels = (int)req->labels;
+  bool ref = hsk_cache_key_ref(req->name, labels, req->type);
+
+  if (ref)
+    labels = 1;
+
+  // The root is keyed by an empty name.
+  size_t start = labels > 0 ? req->label_offs[req->labels - labels]
+                            : req->name_len;
+  size_t len = req->name_len - start;
+
+  memcpy(ck->name, &req->lower[start], len);
+  ck->name[len] = '\0';
+  ck->name_len = len;
+  ck->ref = ref;
+  ck->type = req->type;
+
+  return true;
+}
+
+uint32_t
+hsk_cache_wire_key_hash(const void *key) {
+  hsk_cache_wire_key_t *wk = (hsk_cache_wire_key_t *)key;
+  assert(wk);
+  return hsk_map_tweak3(wk->name, wk->name_len, 3,
+                        ((uint32_t)wk->max_size << 16) | wk->type);
+}
+
+bool
+hsk_cache_wire_key_equal(const void *a, const void *b) {
+  assert(a && b);
+
+  hsk_cache_wire_key_t *x = (hsk_cache_wire_key_t *)a;
+  hsk_cache_wire_key_t *y = (hsk_cache_wire_key_t *)b;
+
+  if (x->type != y->type
+      || x->class != y->class
+      || x->edns != y->edns
+      || x->dnssec != y->dnssec
+      || x->max_size != y->max_size) {
+    return false;
+  }
+
+  if (x->name_len != y->name_len)
+    return false;
+
+  if (memcmp(x->name, y->name, x->name_len) != 0)
+    return false;
+
+  return true;
+}
+
+bool
+hsk_cache_wire_key_set(hsk_cache_wire_key_t *wk, const hsk_dns_req_t *req) {
+  assert(wk && req);
+
+  size_t len = req->name_len;
+
+  if (len == 0)
+    len = strlen(req->name);
+
+  if (len > HSK_DNS_MAX_NAME)
+    return false;
+
+  memset(wk, 0, sizeof(hsk_cache_wire_key_t));
+
+  if (req->name_len != 0) {
+    memcpy(wk->name, req->lower, len);
+  } else {
+    memcpy(wk->name, req->name, len);
+    hsk_to_lower((char *)wk->name);
+  }
+
+  wk->name_len = len;
+  wk->type = req->type;
+  wk->class = req->class;
+  wk->edns = req->edns;
+  wk->dnssec = req->dnssec;
+  wk->max_size = req->max_size;
+
+  return true;
+}
+
+void
+hsk_cache_wire_free(hsk_cache_wire_t *cw) {
+  assert(cw);
+
+  if (cw->data)
+    free(cw->data);
+
+  free(cw);
+}
+
 void
 hsk_cache_item_init(hsk_cache_item_t *ci) {
   assert(ci);
@@ -323,11 +1108,26 @@ hsk_cache_item_init(hsk_cache_item_t *ci) {
   ci->msg = NULL;
   ci->msg_len = 0;
   ci->time = 0;
+  ci->expires = 0;
+  ci->refresh_time = 0;
+  ci->heap_index = 0;
+  ci->wires = NULL;
+  ci->prev = NULL;
+  ci->next = NULL;
 }
 
 void
 hsk_cache_item_uninit(hsk_cache_item_t *ci) {
   assert(ci);
+
+  hsk_cache_wire_t *cw, *next;
+
+  for (cw = ci->wires; cw; cw = next) {
+    next = cw->next;
+    hsk_cache_wire_free(cw);
+  }
+
+  ci->wires = NULL;
   if (ci->msg) {
     free(ci->msg);
     ci->msg = NULL;
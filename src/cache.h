@@ -10,10 +10,12 @@
 #include "req.h"
 
 #define HSK_CACHE_LIMIT 2000
-
-typedef struct hsk_cache_s {
-  hsk_map_t map;
-} hsk_cache_t;
+#define HSK_CACHE_SIZE (4 * 1024 * 1024)
+#define HSK_CACHE_MIN_TTL 60
+#define HSK_CACHE_MAX_TTL (6 * 60 * 60)
+#define HSK_CACHE_MAX_STALE (24 * 60 * 60)
+#define HSK_CACHE_STALE_TTL 30
+#define HSK_CACHE_REFRESH_INTERVAL 10
 
 typedef struct hsk_cache_key_s {
   uint8_t name[HSK_DNS_MAX_NAME + 1];
@@ -22,13 +24,65 @@ typedef struct hsk_cache_key_s {
   bool ref;
 } hsk_cache_key_t;
 
+// Finalized responses are keyed by everything
+// in the query that changes their wire encoding.
+typedef struct hsk_cache_wire_key_s {
+  uint8_t name[HSK_DNS_MAX_NAME + 1];
+  size_t name_len;
+  uint16_t type;
+  uint16_t class;
+  bool edns;
+  bool dnssec;
+  uint16_t max_size;
+} hsk_cache_wire_key_t;
+
+typedef struct hsk_cache_wire_s {
+  hsk_cache_wire_key_t key;
+  uint8_t *data;
+  size_t data_len;
+  size_t qname_len;
+  struct hsk_cache_item_s *item;
+  struct hsk_cache_wire_s *next;
+} hsk_cache_wire_t;
+
 typedef struct hsk_cache_item_s {
   hsk_cache_key_t key;
   uint8_t *msg;
   size_t msg_len;
   int64_t time;
+  int64_t expires;
+  int64_t refresh_time;
+  size_t heap_index;
+  hsk_cache_wire_t *wires;
+  struct hsk_cache_item_s *prev;
+  struct hsk_cache_item_s *next;
 } hsk_cache_item_t;
 
+typedef struct hsk_cache_s {
+  hsk_map_t map;
+  // Finalized responses, owned by their items.
+  hsk_map_t wires;
+  // LRU list, head is most recently used.
+  hsk_cache_item_t *head;
+  hsk_cache_item_t *tail;
+  // Min-heap ordered by expiry time.
+  hsk_cache_item_t **heap;
+  size_t heap_size;
+  size_t heap_cap;
+  size_t size;
+  size_t max_size;
+  size_t max_items;
+  uint32_t min_ttl;
+  uint32_t max_ttl;
+  uint32_t max_stale;
+  uint64_t hits;
+  uint64_t wire_hits;
+  uint64_t stale_hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t expirations;
+} hsk_cache_t;
+
 void
 hsk_cache_init(hsk_cache_t *c);
 
@@ -41,13 +95,26 @@ hsk_cache_alloc(void);
 void
 hsk_cache_free(hsk_cache_t *c);
 
+bool
+hsk_cache_set_limit(hsk_cache_t *c, size_t max_items, size_t max_size);
+
+bool
+hsk_cache_set_ttl(hsk_cache_t *c, uint32_t min_ttl, uint32_t max_ttl);
+
+void
+hsk_cache_set_stale(hsk_cache_t *c, uint32_t max_stale);
+
+void
+hsk_cache_expire(hsk_cache_t *c, int64_t now);
+
 bool
 hsk_cache_insert_data(
   hsk_cache_t *c,
   const char *name,
   uint16_t type,
   uint8_t *wire,
-  size_t wire_len
+  size_t wire_len,
+  uint32_t ttl
 );
 
 bool
@@ -69,6 +136,33 @@ hsk_cache_get_data(
 hsk_dns_msg_t *
 hsk_cache_get(hsk_cache_t *c, const hsk_dns_req_t *req);
 
+hsk_dns_msg_t *
+hsk_cache_get_stale(hsk_cache_t *c, const hsk_dns_req_t *req, bool *refresh);
+
+bool
+hsk_cache_insert_wire(
+  hsk_cache_t *c,
+  const hsk_dns_req_t *req,
+  const uint8_t *wire,
+  size_t wire_len
+);
+
+bool
+hsk_cache_get_wire(
+  hsk_cache_t *c,
+  const hsk_dns_req_t *req,
+  const uint8_t *query,
+  size_t query_len,
+  uint8_t **wire,
+  size_t *wire_len
+);
+
+size_t
+hsk_cache_write(const hsk_cache_t *c, uint8_t **data);
+
+bool
+hsk_cache_read(hsk_cache_t *c, uint8_t **data, size_t *data_len);
+
 void
 hsk_cache_key_init(hsk_cache_key_t *ck);
 
@@ -90,6 +184,21 @@ hsk_cache_key_equal(const void *a, const void *b);
 bool
 hsk_cache_key_set(hsk_cache_key_t *ck, const char *name, uint16_t type);
 
+bool
+hsk_cache_key_set_req(hsk_cache_key_t *ck, const hsk_dns_req_t *req);
+
+uint32_t
+hsk_cache_wire_key_hash(const void *key);
+
+bool
+hsk_cache_wire_key_equal(const void *a, const void *b);
+
+bool
+hsk_cache_wire_key_set(hsk_cache_wire_key_t *wk, const hsk_dns_req_t *req);
+
+void
+hsk_cache_wire_free(hsk_cache_wire_t *cw);
+
 void
 hsk_cache_item_init(hsk_cache_item_t *ci);
 
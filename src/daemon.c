@@ -16,6 +16,7 @@
 #include "hsk.h"
 #include "pool.h"
 #include "ns.h"
+#include "ns_worker.h"
 #include "rs.h"
 #include "signals.h"
 #include "uv.h"
@@ -24,6 +25,19 @@
 extern char *optarg;
 extern int optind, opterr, optopt;
 
+// Long-only options.
+enum {
+  HSK_OPT_CACHE_SIZE = 256,
+  HSK_OPT_CACHE_LIMIT,
+  HSK_OPT_CACHE_MIN_TTL,
+  HSK_OPT_CACHE_MAX_TTL,
+  HSK_OPT_CACHE_MAX_STALE,
+  HSK_OPT_NS_WORKERS,
+  HSK_OPT_RRL_RATE,
+  HSK_OPT_RRL_PROOF_RATE,
+  HSK_OPT_POOL_MAX_SIZE
+};
+
 typedef struct hsk_options_s {
   char *config;
   struct sockaddr *ns_host;
@@ -37,9 +51,18 @@ typedef struct hsk_options_s {
   uint8_t *identity_key;
   char *seeds;
   int pool_size;
+  int pool_max_size;
   char *user_agent;
   bool checkpoint;
   char *prefix;
+  size_t cache_size;
+  size_t cache_limit;
+  uint32_t cache_min_ttl;
+  uint32_t cache_max_ttl;
+  uint32_t cache_max_stale;
+  int ns_workers;
+  uint32_t rrl_rate;
+  uint32_t rrl_proof_rate;
 } hsk_options_t;
 
 static void
@@ -56,9 +79,18 @@ hsk_options_init(hsk_options_t *opt) {
   opt->identity_key = NULL;
   opt->seeds = NULL;
   opt->pool_size = HSK_POOL_SIZE;
+  opt->pool_max_size = 0;
   opt->user_agent = NULL;
   opt->checkpoint = false;
   opt->prefix = NULL;
+  opt->cache_size = HSK_CACHE_SIZE;
+  opt->cache_limit = HSK_CACHE_LIMIT;
+  opt->cache_min_ttl = HSK_CACHE_MIN_TTL;
+  opt->cache_max_ttl = HSK_CACHE_MAX_TTL;
+  opt->cache_max_stale = HSK_CACHE_MAX_STALE;
+  opt->ns_workers = 0;
+  opt->rrl_rate = HSK_RRL_RATE;
+  opt->rrl_proof_rate = HSK_RRL_PROOF_RATE;
 }
 
 static void
@@ -168,7 +200,10 @@ help(int r) {
     "    Path to unbound config file.\n"
     "\n"
     "  -p, --pool-size <size>\n"
-    "    Size of peer pool.\n"
+    "    Fewest peers to keep connected.\n"
+    "\n"
+    "  --pool-max-size <size>\n"
+    "    Most peers to connect while proof requests are queueing.\n"
     "\n"
     "  -k, --identity-key <hex-string>\n"
     "    Identity key for signing DNS responses as well as P2P messages.\n"
@@ -193,6 +228,31 @@ help(int r) {
     "  -x, --prefix <directory name>\n"
     "    Write/read state to/from disk in given directory.\n"
     "\n"
+    "  --cache-size <bytes>\n"
+    "    Maximum bytes of DNS wire data held in the root nameserver cache.\n"
+    "\n"
+    "  --cache-limit <entries>\n"
+    "    Maximum number of entries in the root nameserver cache.\n"
+    "\n"
+    "  --cache-min-ttl <seconds>\n"
+    "    Shortest time a response is cached, regardless of record TTLs.\n"
+    "\n"
+    "  --cache-max-ttl <seconds>\n"
+    "    Longest time a response is cached, regardless of record TTLs.\n"
+    "\n"
+    "  --cache-max-stale <seconds>\n"
+    "    How long an expired response may be served while it is refreshed.\n"
+    "\n"
+    "  --ns-workers <count>\n"
+    "    Extra threads answering cached root nameserver queries (SO_REUSEPORT).\n"
+    "\n"
+    "  --rrl-rate <queries>\n"
+    "    UDP responses per second to each source network (/24 or /56); 0 disables.\n"
+    "\n"
+    "  --rrl-proof-rate <queries>\n"
+    "    New name proof requests per second for each source network; 0 disables.\n"
+    "    Loopback shares one budget, which covers every recursive resolver client.\n"
+    "\n"
 #ifndef _WIN32
     "  -d, --daemon\n"
     "    Fork and background the process.\n"
@@ -229,6 +289,15 @@ parse_arg(int argc, char **argv, hsk_options_t *opt) {
     { "user-agent", required_argument, NULL, 'a' },
     { "checkpoint", no_argument, NULL, 't' },
     { "prefix", required_argument, NULL, 'x' },
+    { "cache-size", required_argument, NULL, HSK_OPT_CACHE_SIZE },
+    { "cache-limit", required_argument, NULL, HSK_OPT_CACHE_LIMIT },
+    { "cache-min-ttl", required_argument, NULL, HSK_OPT_CACHE_MIN_TTL },
+    { "cache-max-ttl", required_argument, NULL, HSK_OPT_CACHE_MAX_TTL },
+    { "cache-max-stale", required_argument, NULL, HSK_OPT_CACHE_MAX_STALE },
+    { "ns-workers", required_argument, NULL, HSK_OPT_NS_WORKERS },
+    { "rrl-rate", required_argument, NULL, HSK_OPT_RRL_RATE },
+    { "rrl-proof-rate", required_argument, NULL, HSK_OPT_RRL_PROOF_RATE },
+    { "pool-max-size", required_argument, NULL, HSK_OPT_POOL_MAX_SIZE },
 #ifndef _WIN32
     { "daemon", no_argument, NULL, 'd' },
 #endif
@@ -400,6 +469,132 @@ parse_arg(int argc, char **argv, hsk_options_t *opt) {
         break;
       }
 
+      case HSK_OPT_CACHE_SIZE: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        long long size = atoll(optarg);
+
+        if (size <= 0)
+          return help(1);
+
+        opt->cache_size = (size_t)size;
+
+        break;
+      }
+
+      case HSK_OPT_CACHE_LIMIT: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        long long limit = atoll(optarg);
+
+        if (limit <= 0)
+          return help(1);
+
+        opt->cache_limit = (size_t)limit;
+
+        break;
+      }
+
+      case HSK_OPT_CACHE_MIN_TTL: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        long long ttl = atoll(optarg);
+
+        if (ttl < 0 || ttl > UINT32_MAX)
+          return help(1);
+
+        opt->cache_min_ttl = (uint32_t)ttl;
+
+        break;
+      }
+
+      case HSK_OPT_CACHE_MAX_TTL: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        long long ttl = atoll(optarg);
+
+        if (ttl <= 0 || ttl > UINT32_MAX)
+          return help(1);
+
+        opt->cache_max_ttl = (uint32_t)ttl;
+
+        break;
+      }
+
+      case HSK_OPT_CACHE_MAX_STALE: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        long long stale = atoll(optarg);
+
+        if (stale < 0 || stale > UINT32_MAX)
+          return help(1);
+
+        opt->cache_max_stale = (uint32_t)stale;
+
+        break;
+      }
+
+      case HSK_OPT_NS_WORKERS: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        int count = atoi(optarg);
+
+        if (count < 0 || count > HSK_NS_WORKERS_MAX)
+          return help(1);
+
+        opt->ns_workers = count;
+
+        break;
+      }
+
+      case HSK_OPT_RRL_RATE: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        long long rate = atoll(optarg);
+
+        if (rate < 0 || rate > UINT32_MAX)
+          return help(1);
+
+        opt->rrl_rate = (uint32_t)rate;
+
+        break;
+      }
+
+      case HSK_OPT_RRL_PROOF_RATE: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        long long rate = atoll(optarg);
+
+        if (rate < 0 || rate > UINT32_MAX)
+          return help(1);
+
+        opt->rrl_proof_rate = (uint32_t)rate;
+
+        break;
+      }
+
+      case HSK_OPT_POOL_MAX_SIZE: {
+        if (!optarg || strlen(optarg) == 0)
+          return help(1);
+
+        int size = atoi(optarg);
+
+        if (size <= 0 || size > 1000)
+          return help(1);
+
+        opt->pool_max_size = size;
+
+        break;
+      }
+
 #ifndef _WIN32
       case 'd': {
         background = true;
@@ -468,6 +663,9 @@ typedef struct {
   hsk_pool_t *pool;
   hsk_ns_t *ns;
   hsk_rs_t *rs;
+  uv_loop_t *loop;
+  uv_timer_t *timer;
+  char *prefix;
 } hsk_daemon_t;
 
 static void
@@ -483,6 +681,9 @@ hsk_daemon_init(hsk_daemon_t *daemon, uv_loop_t *loop, hsk_options_t *opt) {
   daemon->pool = NULL;
   daemon->ns = NULL;
   daemon->rs = NULL;
+  daemon->loop = loop;
+  daemon->timer = NULL;
+  daemon->prefix = NULL;
 
   int rc = HSK_SUCCESS;
 
@@ -517,6 +718,13 @@ hsk_daemon_init(hsk_daemon_t *daemon, uv_loop_t *loop, hsk_options_t *opt) {
     goto fail;
   }
 
+  if (opt->pool_max_size
+      && !hsk_pool_set_max_size(daemon->pool, opt->pool_max_size)) {
+    fprintf(stderr, "failed setting pool max size (below pool size)\n");
+    rc = HSK_EFAILURE;
+    goto fail;
+  }
+
   if (!hsk_pool_set_seeds(daemon->pool, opt->seeds)) {
     fprintf(stderr, "failed adding seeds\n");
     rc = HSK_EFAILURE;
@@ -551,6 +759,32 @@ hsk_daemon_init(hsk_daemon_t *daemon, uv_loop_t *loop, hsk_options_t *opt) {
     }
   }
 
+  if (!hsk_cache_set_limit(&daemon->ns->cache,
+                           opt->cache_limit,
+                           opt->cache_size)) {
+    fprintf(stderr, "failed setting cache limits\n");
+    rc = HSK_EFAILURE;
+    goto fail;
+  }
+
+  if (!hsk_cache_set_ttl(&daemon->ns->cache,
+                         opt->cache_min_ttl,
+                         opt->cache_max_ttl)) {
+    fprintf(stderr, "failed setting cache ttl bounds\n");
+    rc = HSK_EFAILURE;
+    goto fail;
+  }
+
+  hsk_cache_set_stale(&daemon->ns->cache, opt->cache_max_stale);
+
+  hsk_rrl_set_rate(&daemon->ns->rrl, opt->rrl_rate, opt->rrl_proof_rate);
+
+  if (!hsk_ns_set_workers(daemon->ns, opt->ns_workers)) {
+    fprintf(stderr, "failed setting ns workers\n");
+    rc = HSK_EFAILURE;
+    goto fail;
+  }
+
   daemon->rs = hsk_rs_alloc(loop, opt->ns_host);
 
   if (!daemon->rs) {
@@ -559,6 +793,8 @@ hsk_daemon_init(hsk_daemon_t *daemon, uv_loop_t *loop, hsk_options_t *opt) {
     goto fail;
   }
 
+  hsk_rrl_set_rate(&daemon->rs->rrl, opt->rrl_rate, 0);
+
   if (opt->rs_config) {
     if (!hsk_rs_set_config(daemon->rs, opt->rs_config)) {
       fprintf(stderr, "failed setting rs config\n");
@@ -608,6 +844,68 @@ hsk_daemon_uninit(hsk_daemon_t *daemon) {
   }
 }
 
+/*
+ * Cache Store
+ */
+
+static void
+hsk_daemon_load_cache(hsk_daemon_t *daemon) {
+  uint8_t *map;
+  size_t map_len;
+
+  if (!hsk_store_cache_read(daemon->prefix, &map, &map_len))
+    return;
+
+  uint8_t *data = map + HSK_STORE_CACHE_HEADER_SIZE;
+  size_t data_len = map_len - HSK_STORE_CACHE_HEADER_SIZE;
+
+  // Name results come first: the rest is unreadable without them.
+  if (!hsk_namecache_read(&daemon->pool->namecache, &data, &data_len))
+    fprintf(stderr, "failed reading name cache from file\n");
+  else if (!hsk_cache_read(&daemon->ns->cache, &data, &data_len))
+    fprintf(stderr, "failed reading ns cache from file\n");
+
+  hsk_store_cache_release(map, map_len);
+
+  printf("loaded %u names and %u responses from cache\n",
+         (uint32_t)daemon->pool->namecache.map.size,
+         (uint32_t)daemon->ns->cache.map.size);
+}
+
+static void
+hsk_daemon_save_cache(hsk_daemon_t *daemon) {
+  if (!daemon->prefix || !daemon->pool || !daemon->ns)
+    return;
+
+  hsk_namecache_t *nc = &daemon->pool->namecache;
+  hsk_cache_t *c = &daemon->ns->cache;
+
+  size_t size = hsk_namecache_write(nc, NULL) + hsk_cache_write(c, NULL);
+  uint8_t *data = malloc(size);
+
+  if (!data) {
+    fprintf(stderr, "failed allocating cache store\n");
+    return;
+  }
+
+  uint8_t *buf = data;
+
+  hsk_namecache_write(nc, &buf);
+  hsk_cache_write(c, &buf);
+
+  assert((size_t)(buf - data) == size);
+
+  hsk_store_cache_write(daemon->prefix, data, size);
+
+  free(data);
+}
+
+static void
+after_cache_timer(uv_timer_t *timer) {
+  hsk_daemon_t *daemon = (hsk_daemon_t *)timer->data;
+  hsk_daemon_save_cache(daemon);
+}
+
 int
 hsk_daemon_open(hsk_daemon_t *daemon, hsk_options_t *opt) {
   int rc = HSK_SUCCESS;
@@ -650,6 +948,31 @@ hsk_daemon_open(hsk_daemon_t *daemon, hsk_options_t *opt) {
         return HSK_EBADARGS;
       }
     }
+
+    // Warm the caches from the last run.
+    daemon->prefix = opt->prefix;
+
+    hsk_daemon_load_cache(daemon);
+
+    daemon->timer = malloc(sizeof(uv_timer_t));
+
+    if (!daemon->timer)
+      return HSK_ENOMEM;
+
+    if (uv_timer_init(daemon->loop, daemon->timer) != 0) {
+      free(daemon->timer);
+      daemon->timer = NULL;
+      return HSK_EFAILURE;
+    }
+
+    daemon->timer->data = (void *)daemon;
+
+    uint64_t interval = HSK_STORE_CACHE_INTERVAL * 1000;
+
+    if (uv_timer_start(daemon->timer, after_cache_timer,
+                       interval, interval) != 0) {
+      return HSK_EFAILURE;
+    }
   }
 
   rc = hsk_pool_open(daemon->pool);
@@ -707,6 +1030,14 @@ static void
 hsk_daemon_after_close(void *data) {
   hsk_daemon_t *daemon = (hsk_daemon_t *)data;
 
+  if (daemon->timer) {
+    uv_timer_stop(daemon->timer);
+    hsk_uv_close_free((uv_handle_t *)daemon->timer);
+    daemon->timer = NULL;
+  }
+
+  hsk_daemon_save_cache(daemon);
+
   if (daemon->ns) {
     int rc = hsk_ns_close(daemon->ns);
 
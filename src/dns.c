@@ -8,11 +8,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "arena.h"
 #include "bio.h"
 #include "dns.h"
 #include "ecc.h"
 #include "map.h"
 #include "sha256.h"
+#include "sigcache.h"
 #include "utils.h"
 
 typedef struct hsk_dns_raw_rr_s {
@@ -26,6 +28,12 @@ raw_rr_cmp(const void *a, const void *b);
 static bool
 raw_rr_equal(const hsk_dns_raw_rr_t *a, const hsk_dns_raw_rr_t *b);
 
+static size_t
+hsk_dns_name_lower(uint8_t *data, size_t data_len);
+
+static void
+hsk_dns_raw_rr_canonicalize(hsk_dns_raw_rr_t *raw, uint16_t type, uint32_t ttl);
+
 /*
  * Message
  */
@@ -48,6 +56,7 @@ hsk_dns_msg_init(hsk_dns_msg_t *msg) {
   msg->edns.code = 0;
   msg->edns.rd_len = 0;
   msg->edns.rd = NULL;
+  msg->arena = NULL;
 }
 
 void
@@ -68,17 +77,25 @@ hsk_dns_msg_uninit(hsk_dns_msg_t *msg) {
 
 hsk_dns_msg_t *
 hsk_dns_msg_alloc(void) {
-  hsk_dns_msg_t *msg = malloc(sizeof(hsk_dns_msg_t));
-  if (msg)
+  return hsk_dns_msg_alloc_in(NULL);
+}
+
+hsk_dns_msg_t *
+hsk_dns_msg_alloc_in(hsk_arena_t *arena) {
+  hsk_dns_msg_t *msg = hsk_arena_malloc(arena, sizeof(hsk_dns_msg_t));
+  if (msg) {
     hsk_dns_msg_init(msg);
+    msg->arena = arena;
+  }
   return msg;
 }
 
 void
 hsk_dns_msg_free(hsk_dns_msg_t *msg) {
   assert(msg);
+  hsk_arena_t *arena = msg->arena;
   hsk_dns_msg_uninit(msg);
-  free(msg);
+  hsk_arena_release(arena, msg);
 }
 
 bool
@@ -300,12 +317,11 @@ hsk_dns_msg_truncate(uint8_t *msg, size_t msg_len, size_t max, size_t *len) {
     counts[s] = j;
   }
 
+  // Have the client retry over TCP.
   flags |= HSK_DNS_TC;
 
-  // We would normally set the truncate bit,
-  // but we don't support TCP yet.
-  // msg[2] = (flags >> 8) & 0xff;
-  // msg[3] = flags & 0xff;
+  msg[2] = (flags >> 8) & 0xff;
+  msg[3] = flags & 0xff;
 
   msg[4] = (counts[0] >> 8) & 0xff;
   msg[5] = counts[0] & 0xff;
@@ -447,7 +463,11 @@ fail:
   hsk_dns_rrs_uninit(&msg->an);
   hsk_dns_rrs_uninit(&msg->ns);
   hsk_dns_rrs_uninit(&msg->ar);
+
+  hsk_arena_t *arena = msg->arena;
   hsk_dns_msg_init(msg);
+  msg->arena = arena;
+
   return false;
 }
 
@@ -599,6 +619,7 @@ hsk_dns_qs_init(hsk_dns_qs_t *qs) {
   qs->class = HSK_DNS_IN;
   qs->ttl = 0;
   qs->rd = NULL;
+  qs->arena = NULL;
 }
 
 void
@@ -617,7 +638,7 @@ hsk_dns_qs_alloc(void) {
 void
 hsk_dns_qs_free(hsk_dns_qs_t *qs) {
   assert(qs);
-  free(qs);
+  hsk_arena_release(qs->arena, qs);
 }
 
 void
@@ -670,37 +691,52 @@ hsk_dns_rr_init(hsk_dns_rr_t *rr) {
   rr->class = HSK_DNS_IN;
   rr->ttl = 0;
   rr->rd = NULL;
+  rr->arena = NULL;
 }
 
+// Rdata in an arena, down to its buffers, goes with the arena.
 void
 hsk_dns_rr_uninit(hsk_dns_rr_t *rr) {
   assert(rr);
 
   if (rr->rd) {
-    hsk_dns_rd_free(rr->rd, rr->type);
+    if (!rr->arena)
+      hsk_dns_rd_free(rr->rd, rr->type);
     rr->rd = NULL;
   }
 }
 
 hsk_dns_rr_t *
 hsk_dns_rr_alloc(void) {
-  hsk_dns_rr_t *rr = malloc(sizeof(hsk_dns_rr_t));
-  if (rr)
+  return hsk_dns_rr_alloc_in(NULL);
+}
+
+hsk_dns_rr_t *
+hsk_dns_rr_alloc_in(hsk_arena_t *arena) {
+  hsk_dns_rr_t *rr = hsk_arena_malloc(arena, sizeof(hsk_dns_rr_t));
+  if (rr) {
     hsk_dns_rr_init(rr);
+    rr->arena = arena;
+  }
   return rr;
 }
 
 hsk_dns_rr_t *
 hsk_dns_rr_create(uint16_t type) {
-  hsk_dns_rr_t *rr = hsk_dns_rr_alloc();
+  return hsk_dns_rr_create_in(NULL, type);
+}
+
+hsk_dns_rr_t *
+hsk_dns_rr_create_in(hsk_arena_t *arena, uint16_t type) {
+  hsk_dns_rr_t *rr = hsk_dns_rr_alloc_in(arena);
 
   if (!rr)
     return NULL;
 
-  void *rd = hsk_dns_rd_alloc(type);
+  void *rd = hsk_dns_rd_alloc_in(arena, type);
 
   if (!rd) {
-    free(rr);
+    hsk_arena_release(arena, rr);
     return NULL;
   }
 
@@ -714,8 +750,9 @@ hsk_dns_rr_create(uint16_t type) {
 void
 hsk_dns_rr_free(hsk_dns_rr_t *rr) {
   assert(rr);
+  hsk_arena_t *arena = rr->arena;
   hsk_dns_rr_uninit(rr);
-  free(rr);
+  hsk_arena_release(arena, rr);
 }
 
 bool
@@ -1192,100 +1229,107 @@ hsk_dns_rd_uninit(void *rd, uint16_t type) {
 
 void *
 hsk_dns_rd_alloc(uint16_t type) {
-  void *rd;
+  return hsk_dns_rd_alloc_in(NULL, type);
+}
+
+void *
+hsk_dns_rd_alloc_in(hsk_arena_t *arena, uint16_t type) {
+  size_t size;
 
   switch (type) {
     case HSK_DNS_SOA: {
-      rd = malloc(sizeof(hsk_dns_soa_rd_t));
+      size = sizeof(hsk_dns_soa_rd_t);
       break;
     }
     case HSK_DNS_A: {
-      rd = malloc(sizeof(hsk_dns_a_rd_t));
+      size = sizeof(hsk_dns_a_rd_t);
       break;
     }
     case HSK_DNS_AAAA: {
-      rd = malloc(sizeof(hsk_dns_aaaa_rd_t));
+      size = sizeof(hsk_dns_aaaa_rd_t);
       break;
     }
     case HSK_DNS_LOC: {
-      rd = malloc(sizeof(hsk_dns_loc_rd_t));
+      size = sizeof(hsk_dns_loc_rd_t);
       break;
     }
     case HSK_DNS_CNAME: {
-      rd = malloc(sizeof(hsk_dns_cname_rd_t));
+      size = sizeof(hsk_dns_cname_rd_t);
       break;
     }
     case HSK_DNS_DNAME: {
-      rd = malloc(sizeof(hsk_dns_dname_rd_t));
+      size = sizeof(hsk_dns_dname_rd_t);
       break;
     }
     case HSK_DNS_NS: {
-      rd = malloc(sizeof(hsk_dns_ns_rd_t));
+      size = sizeof(hsk_dns_ns_rd_t);
       break;
     }
     case HSK_DNS_MX: {
-      rd = malloc(sizeof(hsk_dns_mx_rd_t));
+      size = sizeof(hsk_dns_mx_rd_t);
       break;
     }
     case HSK_DNS_PTR: {
-      rd = malloc(sizeof(hsk_dns_ptr_rd_t));
+      size = sizeof(hsk_dns_ptr_rd_t);
       break;
     }
     case HSK_DNS_SRV: {
-      rd = malloc(sizeof(hsk_dns_srv_rd_t));
+      size = sizeof(hsk_dns_srv_rd_t);
       break;
     }
     case HSK_DNS_TXT: {
-      rd = malloc(sizeof(hsk_dns_txt_rd_t));
+      size = sizeof(hsk_dns_txt_rd_t);
       break;
     }
     case HSK_DNS_DS: {
-      rd = malloc(sizeof(hsk_dns_ds_rd_t));
+      size = sizeof(hsk_dns_ds_rd_t);
       break;
     }
     case HSK_DNS_SMIMEA:
     case HSK_DNS_TLSA: {
-      rd = malloc(sizeof(hsk_dns_tlsa_rd_t));
+      size = sizeof(hsk_dns_tlsa_rd_t);
       break;
     }
     case HSK_DNS_SSHFP: {
-      rd = malloc(sizeof(hsk_dns_sshfp_rd_t));
+      size = sizeof(hsk_dns_sshfp_rd_t);
       break;
     }
     case HSK_DNS_OPENPGPKEY: {
-      rd = malloc(sizeof(hsk_dns_openpgpkey_rd_t));
+      size = sizeof(hsk_dns_openpgpkey_rd_t);
       break;
     }
     case HSK_DNS_OPT: {
-      rd = malloc(sizeof(hsk_dns_opt_rd_t));
+      size = sizeof(hsk_dns_opt_rd_t);
       break;
     }
     case HSK_DNS_DNSKEY: {
-      rd = malloc(sizeof(hsk_dns_dnskey_rd_t));
+      size = sizeof(hsk_dns_dnskey_rd_t);
       break;
     }
     case HSK_DNS_RRSIG: {
-      rd = malloc(sizeof(hsk_dns_rrsig_rd_t));
+      size = sizeof(hsk_dns_rrsig_rd_t);
       break;
     }
     case HSK_DNS_URI: {
-      rd = malloc(sizeof(hsk_dns_uri_rd_t));
+      size = sizeof(hsk_dns_uri_rd_t);
       break;
     }
     case HSK_DNS_RP: {
-      rd = malloc(sizeof(hsk_dns_rp_rd_t));
+      size = sizeof(hsk_dns_rp_rd_t);
       break;
     }
     case HSK_DNS_NSEC: {
-      rd = malloc(sizeof(hsk_dns_nsec_rd_t));
+      size = sizeof(hsk_dns_nsec_rd_t);
       break;
     }
     default: {
-      rd = malloc(sizeof(hsk_dns_unknown_rd_t));
+      size = sizeof(hsk_dns_unknown_rd_t);
       break;
     }
   }
 
+  void *rd = hsk_arena_malloc(arena, size);
+
   if (rd)
     hsk_dns_rd_init(rd, type);
 
@@ -2076,7 +2120,12 @@ hsk_dns_txt_uninit(hsk_dns_txt_t *txt) {
 
 hsk_dns_txt_t *
 hsk_dns_txt_alloc(void) {
-  hsk_dns_txt_t *txt = malloc(sizeof(hsk_dns_txt_t));
+  return hsk_dns_txt_alloc_in(NULL);
+}
+
+hsk_dns_txt_t *
+hsk_dns_txt_alloc_in(hsk_arena_t *arena) {
+  hsk_dns_txt_t *txt = hsk_arena_malloc(arena, sizeof(hsk_dns_txt_t));
   if (txt)
     hsk_dns_txt_init(txt);
   return txt;
@@ -2883,17 +2932,16 @@ hsk_dns_label_is_openpgpkey(const char *name) {
 
 long
 hsk_dns_dnskey_keytag(const hsk_dns_dnskey_rd_t *rd) {
-  uint8_t *data;
-  size_t size;
-
-  if (!hsk_dns_rd_encode(rd, HSK_DNS_DNSKEY, &data, &size))
+  if (!rd)
     return -1;
 
-  uint32_t tag = 0;
+  // Summed over the wire rdata, without encoding it.
+  uint32_t tag = (uint32_t)rd->flags
+               + (((uint32_t)rd->protocol << 8) | rd->algorithm);
   size_t i;
 
-  for (i = 0; i < size; i++) {
-    uint32_t ch = (uint32_t)data[i];
+  for (i = 0; i < rd->pubkey_len; i++) {
+    uint32_t ch = (uint32_t)rd->pubkey[i];
 
     if (i & 1)
       tag += ch;
@@ -2904,8 +2952,6 @@ hsk_dns_dnskey_keytag(const hsk_dns_dnskey_rd_t *rd) {
   tag += (tag >> 16) & 0xffff;
   tag &= 0xffff;
 
-  free(data);
-
   return tag;
 }
 
@@ -3029,8 +3075,11 @@ hsk_dns_ds_create(const hsk_dns_rr_t *key) {
   return ds;
 }
 
+// The RRSIG, and any scratch space, is
+// allocated from `arena` (NULL for the heap).
 bool
 hsk_dns_sign_type(
+  hsk_arena_t *arena,
   hsk_dns_rrs_t *rrs,
   uint16_t type,
   const hsk_dns_rr_t *key,
@@ -3039,11 +3088,13 @@ hsk_dns_sign_type(
   if (!rrs || rrs->size >= 255 || !key || !priv)
     return false;
 
-  hsk_dns_rrs_t *rrset = hsk_dns_rrs_alloc();
+  hsk_dns_rrs_t *rrset = hsk_arena_malloc(arena, sizeof(hsk_dns_rrs_t));
 
   if (!rrset)
     return false;
 
+  hsk_dns_rrs_init(rrset);
+
   int i;
   for (i = 0; i < rrs->size; i++) {
     hsk_dns_rr_t *rr = rrs->items[i];
@@ -3051,9 +3102,9 @@ hsk_dns_sign_type(
       assert(hsk_dns_rrs_push(rrset, rr));
   }
 
-  hsk_dns_rr_t *sig = hsk_dns_sign_rrset(rrset, key, priv);
+  hsk_dns_rr_t *sig = hsk_dns_sign_rrset(arena, rrset, key, priv);
 
-  free(rrset);
+  hsk_arena_release(arena, rrset);
 
   if (!sig)
     return false;
@@ -3065,6 +3116,7 @@ hsk_dns_sign_type(
 
 hsk_dns_rr_t *
 hsk_dns_sign_rrset(
+  hsk_arena_t *arena,
   hsk_dns_rrs_t *rrset,
   const hsk_dns_rr_t *key,
   const uint8_t *priv
@@ -3080,7 +3132,7 @@ hsk_dns_sign_rrset(
 
   hsk_dns_dnskey_rd_t *dnskey = (hsk_dns_dnskey_rd_t *)key->rd;
 
-  hsk_dns_rr_t *sig = hsk_dns_rr_create(HSK_DNS_RRSIG);
+  hsk_dns_rr_t *sig = hsk_dns_rr_create_in(arena, HSK_DNS_RRSIG);
 
   if (!sig)
     return NULL;
@@ -3104,8 +3156,15 @@ hsk_dns_sign_rrset(
   strcpy(rrsig->signer_name, key->name);
   hsk_to_lower(rrsig->signer_name);
   rrsig->algorithm = dnskey->algorithm;
-  rrsig->inception = hsk_now() - (14 * 24 * 60 * 60);
-  rrsig->expiration = hsk_now() + (14 * 24 * 60 * 60);
+
+  // Round down to a window, so identical RRsets
+  // hash the same and can share a signature.
+  int64_t now = hsk_now();
+
+  now -= now % HSK_DNS_SIG_WINDOW;
+
+  rrsig->inception = now - HSK_DNS_SIG_VALIDITY;
+  rrsig->expiration = now + HSK_DNS_SIG_VALIDITY;
 
   if (!hsk_dns_sign_rrsig(rrset, sig, priv)) {
     hsk_dns_rr_free(sig);
@@ -3144,15 +3203,22 @@ hsk_dns_sign_rrsig(
   if (!hsk_dns_sighash(rrset, sig, hash))
     return false;
 
-  uint8_t *sigbuf = malloc(64);
+  uint8_t *sigbuf = hsk_arena_malloc(sig->arena, 64);
 
   if (!sigbuf)
     return false;
 
-  // Sign with secp256r1.
-  if (!hsk_ecc_sign(priv, hash, sigbuf)) {
-    free(sigbuf);
-    return false;
+  hsk_sigcache_t *cache = hsk_sigcache_global();
+
+  if (!cache || !hsk_sigcache_get(cache, hash, priv, sigbuf)) {
+    // Sign with secp256r1.
+    if (!hsk_ecc_sign(priv, hash, sigbuf)) {
+      hsk_arena_release(sig->arena, sigbuf);
+      return false;
+    }
+
+    if (cache)
+      hsk_sigcache_put(cache, hash, priv, sigbuf);
   }
 
   rrsig->signature_len = 64;
@@ -3161,6 +3227,8 @@ hsk_dns_sign_rrsig(
   return true;
 }
 
+// Records are hashed in canonical form straight from their
+// wire encoding, in one scratch buffer from the RRSIG's arena.
 bool
 hsk_dns_sighash(hsk_dns_rrs_t *rrset, hsk_dns_rr_t *sig, uint8_t *hash) {
   if (!rrset || rrset->size == 0)
@@ -3174,85 +3242,57 @@ hsk_dns_sighash(hsk_dns_rrs_t *rrset, hsk_dns_rr_t *sig, uint8_t *hash) {
 
   hsk_dns_rrsig_rd_t *rrsig = (hsk_dns_rrsig_rd_t *)sig->rd;
 
-  hsk_dns_raw_rr_t *records =
-    calloc(rrset->size, sizeof(hsk_dns_raw_rr_t));
+  size_t count = rrset->size;
+  size_t total = count * sizeof(hsk_dns_raw_rr_t);
+  size_t i;
 
-  if (!records)
-    return false;
+  for (i = 0; i < count; i++)
+    total += hsk_dns_rr_size(rrset->items[i]);
 
-  int i, j;
-  uint8_t *data;
-  size_t size;
-  bool ret = true;
+  uint8_t *scratch = hsk_arena_malloc(sig->arena, total);
 
-  for (i = 0; i < rrset->size; i++) {
-    hsk_dns_rr_t *item = rrset->items[i];
-    hsk_dns_rr_t *rr = hsk_dns_rr_clone(item);
+  if (!scratch)
+    return false;
 
-    if (!rr)
-      goto fail;
+  hsk_dns_raw_rr_t *records = (hsk_dns_raw_rr_t *)scratch;
+  uint8_t *data = scratch + count * sizeof(hsk_dns_raw_rr_t);
 
-    hsk_to_lower(rr->name);
+  for (i = 0; i < count; i++) {
+    hsk_dns_raw_rr_t *raw = &records[i];
+    uint8_t *start = data;
 
-    rr->ttl = rrsig->orig_ttl;
+    hsk_dns_rr_write(rrset->items[i], &data, NULL);
 
-    switch (rr->type) {
-      case HSK_DNS_NS:
-        hsk_to_lower(((hsk_dns_ns_rd_t *)rr->rd)->ns);
-        break;
-      case HSK_DNS_CNAME:
-        hsk_to_lower(((hsk_dns_cname_rd_t *)rr->rd)->target);
-        break;
-      case HSK_DNS_SOA:
-        hsk_to_lower(((hsk_dns_soa_rd_t *)rr->rd)->ns);
-        hsk_to_lower(((hsk_dns_soa_rd_t *)rr->rd)->mbox);
-        break;
-      case HSK_DNS_PTR:
-        hsk_to_lower(((hsk_dns_ptr_rd_t *)rr->rd)->ptr);
-        break;
-      case HSK_DNS_MX:
-        hsk_to_lower(((hsk_dns_mx_rd_t *)rr->rd)->mx);
-        break;
-      case HSK_DNS_SIG:
-      case HSK_DNS_RRSIG:
-        hsk_to_lower(((hsk_dns_rrsig_rd_t *)rr->rd)->signer_name);
-        break;
-      case HSK_DNS_SRV:
-        hsk_to_lower(((hsk_dns_srv_rd_t *)rr->rd)->target);
-        break;
-      case HSK_DNS_DNAME:
-        hsk_to_lower(((hsk_dns_dname_rd_t *)rr->rd)->target);
-        break;
-    }
+    raw->data = start;
+    raw->size = data - start;
 
-    if (!hsk_dns_rr_encode(rr, &data, &size)) {
-      hsk_dns_rr_free(rr);
-      goto fail;
-    }
+    hsk_dns_raw_rr_canonicalize(raw, rrset->items[i]->type, rrsig->orig_ttl);
+  }
 
-    hsk_dns_rr_free(rr);
+  qsort((void *)records, count, sizeof(hsk_dns_raw_rr_t), raw_rr_cmp);
 
-    hsk_dns_raw_rr_t *raw = &records[i];
+  // RRSIG rdata without the signature.
+  uint8_t tbs[18 + HSK_DNS_MAX_NAME + 1];
+  uint8_t *tbs_data = tbs;
+  hsk_dns_rrsig_rd_t tmp = *rrsig;
 
-    raw->size = size;
-    raw->data = data;
-  }
+  tmp.signature = NULL;
+  tmp.signature_len = 0;
 
-  qsort((void *)records, rrset->size, sizeof(hsk_dns_raw_rr_t), raw_rr_cmp);
+  size_t tbs_len = hsk_dns_rd_write(&tmp, HSK_DNS_RRSIG, &tbs_data, NULL);
 
-  if (!hsk_dns_rrsig_tbs(rrsig, &data, &size))
-    goto fail;
+  assert(tbs_len >= 18 && tbs_len <= sizeof(tbs));
+
+  hsk_dns_name_lower(&tbs[18], tbs_len - 18);
 
   hsk_sha256_ctx ctx;
   hsk_sha256_init(&ctx);
-  hsk_sha256_update(&ctx, data, size);
-
-  free(data);
+  hsk_sha256_update(&ctx, tbs, tbs_len);
 
   hsk_dns_raw_rr_t *last = NULL;
 
-  for (j = 0; j < rrset->size; j++) {
-    hsk_dns_raw_rr_t *raw = &records[j];
+  for (i = 0; i < count; i++) {
+    hsk_dns_raw_rr_t *raw = &records[i];
 
     if (last && raw_rr_equal(raw, last))
       continue;
@@ -3264,22 +3304,9 @@ hsk_dns_sighash(hsk_dns_rrs_t *rrset, hsk_dns_rr_t *sig, uint8_t *hash) {
 
   hsk_sha256_final(&ctx, hash);
 
-  goto done;
+  hsk_arena_release(sig->arena, scratch);
 
-fail:
-  ret = false;
-
-done:
-  for (j = 0; j < i; j++) {
-    hsk_dns_raw_rr_t *raw = &records[j];
-
-    if (raw->data)
-      free(raw->data);
-  }
-
-  free(records);
-
-  return ret;
+  return true;
 }
 
 bool
@@ -3304,15 +3331,14 @@ hsk_dns_rrs_clean(hsk_dns_rrs_t *rrs, uint16_t type) {
   if (!rrs)
     return false;
 
-  hsk_dns_rrs_t *tmp = hsk_dns_rrs_alloc();
-
-  if (!tmp)
-    return false;
-
   int i;
+  size_t size = 0;
+
   for (i = 0; i < rrs->size; i++) {
     hsk_dns_rr_t *rr = rrs->items[i];
 
+    rrs->items[i] = NULL;
+
     switch (rr->type) {
       case HSK_DNS_DS:
       case HSK_DNS_DLV:
@@ -3324,24 +3350,16 @@ hsk_dns_rrs_clean(hsk_dns_rrs_t *rrs, uint16_t type) {
       case HSK_DNS_NSEC3PARAM:
         if (type != rr->type) {
           hsk_dns_rr_free(rr);
-          rrs->items[i] = NULL;
           break;
         }
         // fall through
       default:
-        assert(hsk_dns_rrs_push(tmp, rr));
+        rrs->items[size++] = rr;
         break;
     }
   }
 
-  hsk_dns_rrs_init(rrs);
-
-  for (i = 0; i < tmp->size; i++) {
-    hsk_dns_rr_t *rr = tmp->items[i];
-    assert(hsk_dns_rrs_push(rrs, rr));
-  }
-
-  free(tmp);
+  rrs->size = size;
 
   return true;
 }
@@ -3419,3 +3437,66 @@ raw_rr_equal(const hsk_dns_raw_rr_t *a, const hsk_dns_raw_rr_t *b) {
 
   return memcmp(a->data, b->data, a->size) == 0;
 }
+
+// Lowercase an uncompressed wire name in place. Length octets
+// are never letters. Returns the size of the name.
+static size_t
+hsk_dns_name_lower(uint8_t *data, size_t data_len) {
+  size_t off = 0;
+
+  while (off < data_len) {
+    size_t len = data[off++];
+
+    if (len == 0)
+      break;
+
+    for (; len > 0 && off < data_len; len--, off++) {
+      if (data[off] >= 'A' && data[off] <= 'Z')
+        data[off] += ' ';
+    }
+  }
+
+  return off;
+}
+
+// Canonical form (RFC 4034, section 6.2) of an uncompressed record:
+// owner and embedded names lowercased, TTL set to the original one.
+static void
+hsk_dns_raw_rr_canonicalize(hsk_dns_raw_rr_t *raw, uint16_t type, uint32_t ttl) {
+  uint8_t *data = raw->data;
+  size_t off = hsk_dns_name_lower(data, raw->size);
+
+  assert(raw->size >= off + 10);
+
+  set_u32be(&data[off + 4], ttl);
+
+  uint8_t *rd = &data[off + 10];
+  size_t rd_len = raw->size - off - 10;
+
+  switch (type) {
+    case HSK_DNS_NS:
+    case HSK_DNS_CNAME:
+    case HSK_DNS_PTR:
+    case HSK_DNS_DNAME:
+      hsk_dns_name_lower(rd, rd_len);
+      break;
+    case HSK_DNS_SOA: {
+      size_t len = hsk_dns_name_lower(rd, rd_len);
+      hsk_dns_name_lower(&rd[len], rd_len - len);
+      break;
+    }
+    case HSK_DNS_MX:
+      if (rd_len > 2)
+        hsk_dns_name_lower(&rd[2], rd_len - 2);
+      break;
+    case HSK_DNS_SRV:
+      if (rd_len > 6)
+        hsk_dns_name_lower(&rd[6], rd_len - 6);
+      break;
+    case HSK_DNS_SIG:
+    case HSK_DNS_RRSIG:
+      if (rd_len > 18)
+        hsk_dns_name_lower(&rd[18], rd_len - 18);
+      break;
+  }
+}
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include "arena.h"
 #include "map.h"
 
 typedef struct hsk_dns_rr_s {
@@ -12,6 +13,8 @@ typedef struct hsk_dns_rr_s {
   uint16_t class;
   uint32_t ttl;
   void *rd;
+  // Where the record and its rdata live (NULL for the heap).
+  hsk_arena_t *arena;
 } hsk_dns_rr_t;
 
 typedef hsk_dns_rr_t hsk_dns_qs_t;
@@ -39,6 +42,9 @@ typedef struct hsk_dns_msg_s {
     size_t rd_len;
     uint8_t *rd;
   } edns;
+  // Where the message lives (NULL for the heap). Records
+  // track their own, and EDNS data is always on the heap.
+  hsk_arena_t *arena;
 } hsk_dns_msg_t;
 
 typedef struct hsk_dns_txt_s {
@@ -210,6 +216,11 @@ typedef struct {
 #define HSK_DNS_MAX_EDNS 4096
 #define HSK_DNS_MAX_TCP 65535
 
+// RRSIGs are valid this long either side of signing,
+#define HSK_DNS_SIG_VALIDITY (14 * 24 * 60 * 60)
+// measured from the start of the current window.
+#define HSK_DNS_SIG_WINDOW (60 * 60)
+
 // Opcodes
 #define HSK_DNS_QUERY 0
 #define HSK_DNS_IQUERY 1
@@ -380,6 +391,9 @@ hsk_dns_msg_uninit(hsk_dns_msg_t *msg);
 hsk_dns_msg_t *
 hsk_dns_msg_alloc(void);
 
+hsk_dns_msg_t *
+hsk_dns_msg_alloc_in(hsk_arena_t *arena);
+
 void
 hsk_dns_msg_free(hsk_dns_msg_t *msg);
 
@@ -466,9 +480,15 @@ hsk_dns_rr_uninit(hsk_dns_rr_t *rr);
 hsk_dns_rr_t *
 hsk_dns_rr_alloc(void);
 
+hsk_dns_rr_t *
+hsk_dns_rr_alloc_in(hsk_arena_t *arena);
+
 hsk_dns_rr_t *
 hsk_dns_rr_create(uint16_t type);
 
+hsk_dns_rr_t *
+hsk_dns_rr_create_in(hsk_arena_t *arena, uint16_t type);
+
 void
 hsk_dns_rr_free(hsk_dns_rr_t *rr);
 
@@ -504,6 +524,9 @@ hsk_dns_rd_init(void *rd, uint16_t type);
 void *
 hsk_dns_rd_alloc(uint16_t type);
 
+void *
+hsk_dns_rd_alloc_in(hsk_arena_t *arena, uint16_t type);
+
 void
 hsk_dns_rd_uninit(void *rd, uint16_t type);
 
@@ -585,6 +608,9 @@ hsk_dns_txt_uninit(hsk_dns_txt_t *txt);
 hsk_dns_txt_t *
 hsk_dns_txt_alloc(void);
 
+hsk_dns_txt_t *
+hsk_dns_txt_alloc_in(hsk_arena_t *arena);
+
 void
 hsk_dns_txt_free(hsk_dns_txt_t *txt);
 
@@ -755,6 +781,7 @@ hsk_dns_ds_create(const hsk_dns_rr_t *key);
 
 bool
 hsk_dns_sign_type(
+  hsk_arena_t *arena,
   hsk_dns_rrs_t *rrs,
   uint16_t type,
   const hsk_dns_rr_t *key,
@@ -763,6 +790,7 @@ hsk_dns_sign_type(
 
 hsk_dns_rr_t *
 hsk_dns_sign_rrset(
+  hsk_arena_t *arena,
   hsk_dns_rrs_t *rrset,
   const hsk_dns_rr_t *key,
   const uint8_t *priv
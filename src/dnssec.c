@@ -4,60 +4,57 @@
 
 #include "dns.h"
 #include "dnssec.h"
+#include "uv.h"
 
 static hsk_dns_rr_t *ksk_key = NULL;
 static hsk_dns_rr_t *zsk_key = NULL;
 static hsk_dns_rr_t *ksk_ds = NULL;
+static uv_once_t keys_once = UV_ONCE_INIT;
 
-const hsk_dns_rr_t *
-hsk_dnssec_get_ksk(void) {
-  if (ksk_key)
-    return (const hsk_dns_rr_t *)ksk_key;
+// Responses may be signed off the loop,
+// so the keys are created exactly once.
+static void
+hsk_dnssec_init_keys(void) {
+  ksk_key = hsk_dns_dnskey_create(".", &hsk_dnssec_ksk[0], true);
+  assert(ksk_key);
 
-  const uint8_t *ksk = &hsk_dnssec_ksk[0];
+  zsk_key = hsk_dns_dnskey_create(".", &hsk_dnssec_zsk[0], false);
+  assert(zsk_key);
 
-  ksk_key = hsk_dns_dnskey_create(".", ksk, true);
-  assert(ksk_key);
+  ksk_ds = hsk_dns_ds_create(ksk_key);
+  assert(ksk_ds);
+}
 
+const hsk_dns_rr_t *
+hsk_dnssec_get_ksk(void) {
+  uv_once(&keys_once, hsk_dnssec_init_keys);
   return (const hsk_dns_rr_t *)ksk_key;
 }
 
 const hsk_dns_rr_t *
 hsk_dnssec_get_zsk(void) {
-  if (zsk_key)
-    return (const hsk_dns_rr_t *)zsk_key;
-
-  const uint8_t *zsk = &hsk_dnssec_zsk[0];
-
-  zsk_key = hsk_dns_dnskey_create(".", zsk, false);
-  assert(zsk_key);
-
+  uv_once(&keys_once, hsk_dnssec_init_keys);
   return (const hsk_dns_rr_t *)zsk_key;
 }
 
 const hsk_dns_rr_t *
 hsk_dnssec_get_ds(void) {
-  if (ksk_ds)
-    return (const hsk_dns_rr_t *)ksk_ds;
-
-  ksk_ds = hsk_dns_ds_create(hsk_dnssec_get_ksk());
-  assert(ksk_ds);
-
+  uv_once(&keys_once, hsk_dnssec_init_keys);
   return (const hsk_dns_rr_t *)ksk_ds;
 }
 
 bool
-hsk_dnssec_sign_ksk(hsk_dns_rrs_t *rrs, uint16_t type) {
+hsk_dnssec_sign_ksk(hsk_arena_t *arena, hsk_dns_rrs_t *rrs, uint16_t type) {
   const uint8_t *priv = &hsk_dnssec_ksk[0];
   const hsk_dns_rr_t *key = hsk_dnssec_get_ksk();
 
-  return hsk_dns_sign_type(rrs, type, key, priv);
+  return hsk_dns_sign_type(arena, rrs, type, key, priv);
 }
 
 bool
-hsk_dnssec_sign_zsk(hsk_dns_rrs_t *rrs, uint16_t type) {
+hsk_dnssec_sign_zsk(hsk_arena_t *arena, hsk_dns_rrs_t *rrs, uint16_t type) {
   const uint8_t *priv = &hsk_dnssec_zsk[0];
   const hsk_dns_rr_t *key = hsk_dnssec_get_zsk();
 
-  return hsk_dns_sign_type(rrs, type, key, priv);
+  return hsk_dns_sign_type(arena, rrs, type, key, priv);
 }
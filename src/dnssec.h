@@ -26,9 +26,9 @@ const hsk_dns_rr_t *
 hsk_dnssec_get_ds(void);
 
 bool
-hsk_dnssec_sign_ksk(hsk_dns_rrs_t *rrs, uint16_t type);
+hsk_dnssec_sign_ksk(hsk_arena_t *arena, hsk_dns_rrs_t *rrs, uint16_t type);
 
 bool
-hsk_dnssec_sign_zsk(hsk_dns_rrs_t *rrs, uint16_t type);
+hsk_dnssec_sign_zsk(hsk_arena_t *arena, hsk_dns_rrs_t *rrs, uint16_t type);
 
 #endif
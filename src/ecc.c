@@ -29,13 +29,20 @@
 #include "config.h"
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "ecc.h"
+#include "uv.h"
 
 #define NUM_ECC_DIGITS (HSK_ECC_BYTES / 8)
 #define MAX_TRIES 16
 
+// Fixed-base table: one row per 4 bit window of the
+// scalar, holding the odd multiples 1, 3, ..., 15.
+#define COMB_WINDOWS (HSK_ECC_BYTES * 2)
+#define COMB_POINTS 8
+
 typedef unsigned int uint;
 
 #if defined(__SIZEOF_INT128__) \
@@ -1116,6 +1123,236 @@ ecc_point_mult(
   vli_set(result->y, Ry[0]);
 }
 
+// ------ Fixed-base multiplication ------
+
+// comb_table[i][j] = (2j + 1) * 16^i * G, and
+// comb_top = 16^64 * G, where every sum starts.
+static ecc_point_t comb_table[COMB_WINDOWS][COMB_POINTS];
+static ecc_point_t comb_top;
+static uv_once_t comb_once = UV_ONCE_INIT;
+
+// dest = mask ? src : dest, for a mask of all ones or zeroes.
+static void
+vli_cmov(uint64_t *dest, uint64_t *src, uint64_t mask) {
+  uint i;
+  for (i = 0; i < NUM_ECC_DIGITS; i++)
+    dest[i] ^= (dest[i] ^ src[i]) & mask;
+}
+
+// Affine R = P + Q, for building the table.
+static void
+ecc_point_add_affine(ecc_point_t *result, ecc_point_t *P, ecc_point_t *Q) {
+  uint64_t l[NUM_ECC_DIGITS];
+  uint64_t t[NUM_ECC_DIGITS];
+  uint64_t x3[NUM_ECC_DIGITS];
+  uint64_t y3[NUM_ECC_DIGITS];
+
+  if (ecc_point_is_zero(P)) {
+    *result = *Q;
+    return;
+  }
+
+  if (ecc_point_is_zero(Q)) {
+    *result = *P;
+    return;
+  }
+
+  if (vli_cmp(P->x, Q->x) == 0) {
+    if (vli_cmp(P->y, Q->y) != 0 || vli_is_zero(P->y)) {
+      // P = -Q
+      vli_clear(result->x);
+      vli_clear(result->y);
+      return;
+    }
+
+    // l = 3 * (x^2 - 1) / 2y, with a = -3
+    uint64_t one[NUM_ECC_DIGITS] = {1};
+
+    vli_mod_sqr_fast(l, P->x);
+    vli_mod_sub(l, l, one, curve_p);
+    vli_mod_add(t, l, l, curve_p);
+    vli_mod_add(l, t, l, curve_p);
+    vli_mod_add(t, P->y, P->y, curve_p);
+  } else {
+    // l = (y2 - y1) / (x2 - x1)
+    vli_mod_sub(l, Q->y, P->y, curve_p);
+    vli_mod_sub(t, Q->x, P->x, curve_p);
+  }
+
+  vli_mod_inv(t, t, curve_p);
+  vli_mod_mult_fast(l, l, t);
+
+  vli_mod_sqr_fast(x3, l); // l^2
+  vli_mod_sub(x3, x3, P->x, curve_p);
+  vli_mod_sub(x3, x3, Q->x, curve_p); // x3 = l^2 - x1 - x2
+  vli_mod_sub(t, P->x, x3, curve_p);
+  vli_mod_mult_fast(y3, l, t);
+  vli_mod_sub(y3, y3, P->y, curve_p); // y3 = l * (x1 - x3) - y1
+
+  vli_set(result->x, x3);
+  vli_set(result->y, y3);
+}
+
+static void
+comb_init(void) {
+  ecc_point_t base = curve_g;
+  ecc_point_t twice;
+  int i, j;
+
+  for (i = 0; i < COMB_WINDOWS; i++) {
+    ecc_point_add_affine(&twice, &base, &base);
+
+    comb_table[i][0] = base;
+
+    for (j = 1; j < COMB_POINTS; j++)
+      ecc_point_add_affine(&comb_table[i][j], &comb_table[i][j - 1], &twice);
+
+    // Next row starts at 16 * base.
+    ecc_point_add_affine(&base, &comb_table[i][COMB_POINTS - 1], &base);
+  }
+
+  comb_top = base;
+}
+
+// Mixed Jacobian + affine addition, in place.
+// The point at infinity is Z = 0.
+static void
+ecc_point_add_mixed(
+  uint64_t *X1,
+  uint64_t *Y1,
+  uint64_t *Z1,
+  ecc_point_t *Q
+) {
+  uint64_t zz[NUM_ECC_DIGITS];
+  uint64_t h[NUM_ECC_DIGITS];
+  uint64_t r[NUM_ECC_DIGITS];
+  uint64_t hh[NUM_ECC_DIGITS];
+  uint64_t hhh[NUM_ECC_DIGITS];
+  uint64_t v[NUM_ECC_DIGITS];
+
+  if (vli_is_zero(Z1)) {
+    vli_set(X1, Q->x);
+    vli_set(Y1, Q->y);
+    vli_clear(Z1);
+    Z1[0] = 1;
+    return;
+  }
+
+  vli_mod_sqr_fast(zz, Z1); // Z1^2
+  vli_mod_mult_fast(h, Q->x, zz); // U2 = x2 * Z1^2
+  vli_mod_mult_fast(r, Q->y, zz);
+  vli_mod_mult_fast(r, r, Z1); // S2 = y2 * Z1^3
+  vli_mod_sub(h, h, X1, curve_p); // H = U2 - X1
+  vli_mod_sub(r, r, Y1, curve_p); // R = S2 - Y1
+
+  if (vli_is_zero(h)) {
+    if (vli_is_zero(r))
+      ecc_point_double_jacobian(X1, Y1, Z1);
+    else
+      vli_clear(Z1);
+    return;
+  }
+
+  vli_mod_sqr_fast(hh, h); // H^2
+  vli_mod_mult_fast(hhh, hh, h); // H^3
+  vli_mod_mult_fast(v, X1, hh); // V = X1 * H^2
+
+  vli_mod_sqr_fast(X1, r);
+  vli_mod_sub(X1, X1, hhh, curve_p);
+  vli_mod_sub(X1, X1, v, curve_p);
+  vli_mod_sub(X1, X1, v, curve_p); // X3 = R^2 - H^3 - 2V
+
+  vli_mod_sub(v, v, X1, curve_p);
+  vli_mod_mult_fast(v, v, r); // R * (V - X3)
+  vli_mod_mult_fast(Y1, Y1, hhh); // Y1 * H^3
+  vli_mod_sub(Y1, v, Y1, curve_p); // Y3 = R * (V - X3) - Y1 * H^3
+
+  vli_mod_mult_fast(Z1, Z1, h); // Z3 = Z1 * H
+}
+
+// result = scalar * G, for 0 < scalar < n.
+//
+// An odd k is recoded into 64 signed digits, each odd and
+// in [-15, 15] (never zero), with k = sum(d[i] * 16^i) + 16^64:
+// d[i] is the 5 bit window at bit 4i with its low bit set,
+// less 16. An even k is replaced by n - k and the result
+// negated. The sum starts at 16^64 * G rather than infinity,
+// and every window adds one point, picked by scanning its
+// whole row and negated with a mask, so neither the control
+// flow nor the memory access depends on the scalar. (Partial
+// sums only meet a table point for a negligible share of
+// scalars; the addition stays correct then, just not uniform.)
+static void
+ecc_point_mult_base(ecc_point_t *result, uint64_t *scalar) {
+  uint64_t k[NUM_ECC_DIGITS];
+  uint64_t X[NUM_ECC_DIGITS];
+  uint64_t Y[NUM_ECC_DIGITS];
+  uint64_t Z[NUM_ECC_DIGITS];
+  uint64_t t[NUM_ECC_DIGITS];
+  ecc_point_t q;
+  int i, j;
+
+  uv_once(&comb_once, comb_init);
+
+  uint64_t even = (scalar[0] & 1) - 1;
+
+  vli_set(k, scalar);
+  vli_sub(t, curve_n, scalar);
+  vli_cmov(k, t, even);
+
+  vli_set(X, comb_top.x);
+  vli_set(Y, comb_top.y);
+  vli_clear(Z);
+  Z[0] = 1;
+
+  for (i = 0; i < COMB_WINDOWS; i++) {
+    uint bit = i * 4;
+    uint word = bit / 64;
+    uint shift = bit % 64;
+    uint64_t window = k[word] >> shift;
+
+    if (shift > 59 && word + 1 < NUM_ECC_DIGITS)
+      window |= k[word + 1] << (64 - shift);
+
+    // d = (window | 1) - 16, as a sign and an index.
+    uint32_t digit = (uint32_t)(window & 0x1f) | 1;
+    uint32_t neg = ((digit - 16) >> 31) & 1;
+    uint32_t index = ((digit ^ (0 - neg)) & 0x0f) >> 1;
+
+    vli_clear(q.x);
+    vli_clear(q.y);
+
+    for (j = 0; j < COMB_POINTS; j++) {
+      uint64_t mask = 0 - (uint64_t)((((uint32_t)j ^ index) - 1) >> 31);
+
+      vli_cmov(q.x, comb_table[i][j].x, mask);
+      vli_cmov(q.y, comb_table[i][j].y, mask);
+    }
+
+    vli_sub(t, curve_p, q.y);
+    vli_cmov(q.y, t, 0 - (uint64_t)neg);
+
+    ecc_point_add_mixed(X, Y, Z, &q);
+  }
+
+  vli_sub(t, curve_p, Y);
+  vli_cmov(Y, t, even);
+
+  memset(k, 0, sizeof(k));
+
+  if (vli_is_zero(Z)) {
+    vli_clear(result->x);
+    vli_clear(result->y);
+    return;
+  }
+
+  vli_mod_inv(Z, Z, curve_p); // 1 / Z
+  vli_mod_sqr_fast(q.x, Z); // 1 / Z^2
+  vli_mod_mult_fast(q.y, q.x, Z); // 1 / Z^3
+  vli_mod_mult_fast(result->x, X, q.x);
+  vli_mod_mult_fast(result->y, Y, q.y);
+}
+
 static void
 ecc_bytes2native(
   uint64_t native[NUM_ECC_DIGITS],
@@ -1396,11 +1633,169 @@ umax(uint a, uint b) {
   return (a > b ? a : b);
 }
 
+// ------ Nonces ------
+
+// A signing nonce: r = x(k * G) mod n, and 1 / k.
+typedef struct ecc_nonce_s {
+  uint64_t r[NUM_ECC_DIGITS];
+  uint64_t kinv[NUM_ECC_DIGITS];
+} ecc_nonce_t;
+
+static struct {
+  uv_mutex_t mutex;
+  ecc_nonce_t items[HSK_ECC_NONCES];
+  size_t size;
+} nonce_pool;
+
+static uv_once_t nonce_once = UV_ONCE_INIT;
+
+static void
+nonce_pool_init(void) {
+  if (uv_mutex_init(&nonce_pool.mutex) != 0)
+    abort();
+
+  nonce_pool.size = 0;
+}
+
+static int
+ecc_nonce_make(ecc_nonce_t *nonce) {
+  uint64_t k[NUM_ECC_DIGITS];
+  uint64_t t[NUM_ECC_DIGITS];
+  ecc_point_t p;
+  unsigned tries = 0;
+
+  do {
+    if (!get_rand_num(k) || (tries++ >= MAX_TRIES))
+      return 0;
+
+    if (vli_is_zero(k))
+      continue;
+
+    // k = k - n when k >= n, without a branch on k.
+    uint64_t borrow = vli_sub(t, k, curve_n);
+    vli_cmov(k, t, borrow - 1);
+
+    // p = k * G
+    ecc_point_mult_base(&p, k);
+
+    // r = x1 (mod n)
+    if (vli_cmp(curve_n, p.x) != 1)
+      vli_sub(p.x, p.x, curve_n);
+  } while (vli_is_zero(p.x));
+
+  vli_set(nonce->r, p.x);
+  vli_mod_inv(nonce->kinv, k, curve_n);
+
+  memset(k, 0, sizeof(k));
+  memset(t, 0, sizeof(t));
+
+  return 1;
+}
+
+static int
+ecc_nonce_pop(ecc_nonce_t *nonce) {
+  int found = 0;
+
+  uv_once(&nonce_once, nonce_pool_init);
+
+  uv_mutex_lock(&nonce_pool.mutex);
+
+  if (nonce_pool.size > 0) {
+    ecc_nonce_t *item = &nonce_pool.items[--nonce_pool.size];
+    *nonce = *item;
+    memset(item, 0, sizeof(*item));
+    found = 1;
+  }
+
+  uv_mutex_unlock(&nonce_pool.mutex);
+
+  return found;
+}
+
+size_t
+hsk_ecc_nonces(void) {
+  size_t size;
+
+  uv_once(&nonce_once, nonce_pool_init);
+
+  uv_mutex_lock(&nonce_pool.mutex);
+  size = nonce_pool.size;
+  uv_mutex_unlock(&nonce_pool.mutex);
+
+  return size;
+}
+
+// Top the pool up by at most `max` nonces. The point
+// multiplications run without holding the lock.
+size_t
+hsk_ecc_nonces_fill(size_t max) {
+  size_t added = 0;
+  ecc_nonce_t nonce;
+
+  while (added < max) {
+    if (hsk_ecc_nonces() >= HSK_ECC_NONCES)
+      break;
+
+    if (!ecc_nonce_make(&nonce))
+      break;
+
+    uv_mutex_lock(&nonce_pool.mutex);
+
+    int full = nonce_pool.size >= HSK_ECC_NONCES;
+
+    if (!full)
+      nonce_pool.items[nonce_pool.size++] = nonce;
+
+    uv_mutex_unlock(&nonce_pool.mutex);
+
+    if (full)
+      break;
+
+    added += 1;
+  }
+
+  memset(&nonce, 0, sizeof(nonce));
+
+  return added;
+}
+
+// ------ Signing ------
+
 int
 hsk_ecc_sign(
   const uint8_t private_key[HSK_ECC_BYTES],
   const uint8_t hash[HSK_ECC_BYTES],
   uint8_t signature[HSK_ECC_BYTES * 2]
+) {
+  uint64_t tmp[NUM_ECC_DIGITS];
+  uint64_t s[NUM_ECC_DIGITS];
+  ecc_nonce_t nonce;
+
+  if (!ecc_nonce_pop(&nonce) && !ecc_nonce_make(&nonce))
+    return 0;
+
+  ecc_native2bytes(signature, nonce.r);
+
+  ecc_bytes2native(tmp, private_key);
+  vli_mod_mult(s, nonce.r, tmp, curve_n); // s = r*d
+  ecc_bytes2native(tmp, hash);
+  vli_mod_add(s, tmp, s, curve_n); // s = e + r*d
+  vli_mod_mult(s, s, nonce.kinv, curve_n); // s = (e + r*d) / k
+  ecc_native2bytes(signature + HSK_ECC_BYTES, s);
+
+  memset(&nonce, 0, sizeof(nonce));
+  memset(tmp, 0, sizeof(tmp));
+
+  return 1;
+}
+
+// Signs with a fresh nonce and the generic
+// ladder, bypassing the table and the pool.
+int
+hsk_ecc_sign_generic(
+  const uint8_t private_key[HSK_ECC_BYTES],
+  const uint8_t hash[HSK_ECC_BYTES],
+  uint8_t signature[HSK_ECC_BYTES * 2]
 ) {
   uint64_t k[NUM_ECC_DIGITS];
   uint64_t tmp[NUM_ECC_DIGITS];
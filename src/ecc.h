@@ -29,6 +29,7 @@
 #ifndef _HSK_ECC_H
 #define _HSK_ECC_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define HSK_SECP128R1 16
@@ -49,6 +50,9 @@
 
 #define HSK_ECC_BYTES HSK_ECC_CURVE
 
+// Signing nonces kept ready by hsk_ecc_nonces_fill().
+#define HSK_ECC_NONCES 256
+
 int
 hsk_ecc_make_key(
   uint8_t public_key[HSK_ECC_BYTES + 1],
@@ -81,6 +85,19 @@ hsk_ecc_sign(
   uint8_t signature[HSK_ECC_BYTES * 2]
 );
 
+int
+hsk_ecc_sign_generic(
+  const uint8_t private_key[HSK_ECC_BYTES],
+  const uint8_t hash[HSK_ECC_BYTES],
+  uint8_t signature[HSK_ECC_BYTES * 2]
+);
+
+size_t
+hsk_ecc_nonces(void);
+
+size_t
+hsk_ecc_nonces_fill(size_t max);
+
 int
 hsk_ecc_verify(
   const uint8_t public_key[HSK_ECC_BYTES + 1],
@@ -4,9 +4,12 @@
 
 #include "chain.h"
 #include "dns.h"
+#include "ecc.h"
 #include "ns.h"
 #include "pool.h"
 #include "req.h"
+#include "sigcache.h"
+#include "work.h"
 
 static bool
 hsk_hesiod_txt_push(char *name, char *text, hsk_dns_rrs_t *an) {
@@ -56,6 +59,36 @@ hsk_hesiod_txt_push_float(char *name, float f, hsk_dns_rrs_t *an) {
   return hsk_hesiod_txt_push(name, value, an);
 }
 
+static bool
+hsk_hesiod_txt_push_work(
+  const char *qname,
+  const char *group,
+  const hsk_work_t *work,
+  hsk_dns_rrs_t *an
+) {
+  const char *names[5] = { "pending", "queued", "inline", "wait", "maxwait" };
+  uint64_t values[5] = {
+    work->pending,
+    work->queued,
+    work->inlined,
+    hsk_work_wait_avg(work),
+    work->wait_max
+  };
+  char label[65];
+
+  for (int i = 0; i < 5; i++) {
+    sprintf(label, "%s.%s", names[i], group);
+
+    if (!hsk_dns_is_subdomain(qname, label))
+      continue;
+
+    if (!hsk_hesiod_txt_push_u64(label, values[i], an))
+      return false;
+  }
+
+  return true;
+}
+
 static bool
 hsk_hesiod_txt_push_peer(hsk_peer_t *peer, hsk_dns_rrs_t *an, uint16_t count) {
   char label[65];
@@ -78,6 +111,22 @@ hsk_hesiod_txt_push_peer(hsk_peer_t *peer, hsk_dns_rrs_t *an, uint16_t count) {
   if (!hsk_hesiod_txt_push_u64(label, peer->proofs, an))
     return false;
 
+  sprintf(label, "rtt.%s", sublabel);
+  if (!hsk_hesiod_txt_push_u64(label, peer->proof_rtt, an))
+    return false;
+
+  sprintf(label, "inflight.%s", sublabel);
+  if (!hsk_hesiod_txt_push_u64(label, peer->names.size, an))
+    return false;
+
+  sprintf(label, "window.%s", sublabel);
+  if (!hsk_hesiod_txt_push_u64(label, peer->window, an))
+    return false;
+
+  sprintf(label, "timeouts.%s", sublabel);
+  if (!hsk_hesiod_txt_push_u64(label, peer->timeouts, an))
+    return false;
+
   char state[32];
   switch (peer->state) {
     case HSK_STATE_DISCONNECTED:
@@ -173,6 +222,80 @@ hsk_hesiod_resolve(hsk_dns_req_t *req, hsk_ns_t *ns) {
       goto fail;
   }
 
+  //  TARGET
+  if (hsk_dns_is_subdomain(req->name, "target.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("target.pool.hnsd.",
+                                 ns->pool->target,
+                                 an))
+      goto fail;
+  }
+
+  //  PROOF REQUEST DEADLINES
+  if (hsk_dns_is_subdomain(req->name, "timeouts.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("timeouts.pool.hnsd.",
+                                 ns->pool->timeouts,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "retries.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("retries.pool.hnsd.",
+                                 ns->pool->retries,
+                                 an))
+      goto fail;
+  }
+
+  //  QUEUED PROOF REQUESTS
+  if (hsk_dns_is_subdomain(req->name, "live.queue.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("live.queue.pool.hnsd.",
+                                 ns->pool->pending.count,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "background.queue.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("background.queue.pool.hnsd.",
+                                 ns->pool->background.count,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "expired.queue.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("expired.queue.pool.hnsd.",
+                                 ns->pool->queue_expired,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "rejected.queue.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("rejected.queue.pool.hnsd.",
+                                 ns->pool->queue_rejected,
+                                 an))
+      goto fail;
+  }
+
+  //  HEDGED PROOF REQUESTS
+  if (hsk_dns_is_subdomain(req->name, "sent.hedge.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("sent.hedge.pool.hnsd.",
+                                 ns->pool->hedges,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "wins.hedge.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("wins.hedge.pool.hnsd.",
+                                 ns->pool->hedge_wins,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "delay.hedge.pool.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("delay.hedge.pool.hnsd.",
+                                 ns->pool->hedge_delay,
+                                 an))
+      goto fail;
+  }
+
   //  PEERS
   if (hsk_dns_is_subdomain(req->name, "peers.pool.hnsd.")) {
     hsk_peer_t *peerIter, *next;
@@ -185,6 +308,263 @@ hsk_hesiod_resolve(hsk_dns_req_t *req, hsk_ns_t *ns) {
     }
   }
 
+  // CACHE
+  if (hsk_dns_is_subdomain(req->name, "entries.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("entries.cache.hnsd.",
+                                 ns->cache.map.size,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "size.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("size.cache.hnsd.",
+                                 ns->cache.size,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "hits.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("hits.cache.hnsd.",
+                                 ns->cache.hits,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "wire_hits.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("wire_hits.cache.hnsd.",
+                                 ns->cache.wire_hits,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "stale_hits.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("stale_hits.cache.hnsd.",
+                                 ns->cache.stale_hits,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "misses.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("misses.cache.hnsd.",
+                                 ns->cache.misses,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "evictions.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("evictions.cache.hnsd.",
+                                 ns->cache.evictions,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "expirations.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("expirations.cache.hnsd.",
+                                 ns->cache.expirations,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "inflight.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("inflight.cache.hnsd.",
+                                 ns->inflight.size,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "coalesced.cache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("coalesced.cache.hnsd.",
+                                 ns->coalesced,
+                                 an))
+      goto fail;
+  }
+
+  // ROOT ZONE
+  if (hsk_dns_is_subdomain(req->name, "signed.zone.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("signed.zone.hnsd.",
+                                 ns->zone.signed_time,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "hits.zone.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("hits.zone.hnsd.",
+                                 ns->zone.hits,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "misses.zone.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("misses.zone.hnsd.",
+                                 ns->zone.misses,
+                                 an))
+      goto fail;
+  }
+
+  // SIGNATURE CACHE
+  hsk_sigcache_t *sigcache = hsk_sigcache_global();
+
+  if (sigcache && hsk_dns_is_subdomain(req->name, "hits.sigcache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("hits.sigcache.hnsd.",
+                                 sigcache->hits,
+                                 an))
+      goto fail;
+  }
+
+  if (sigcache && hsk_dns_is_subdomain(req->name, "misses.sigcache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("misses.sigcache.hnsd.",
+                                 sigcache->misses,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "nonces.sigcache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("nonces.sigcache.hnsd.",
+                                 hsk_ecc_nonces(),
+                                 an))
+      goto fail;
+  }
+
+  // OFFLOADED WORK
+  if (ns->sign) {
+    if (!hsk_hesiod_txt_push_work(req->name, "sign.hnsd.", ns->sign, an))
+      goto fail;
+  }
+
+  if (ns->pool->verify) {
+    if (!hsk_hesiod_txt_push_work(req->name, "verify.hnsd.",
+                                  ns->pool->verify, an))
+      goto fail;
+  }
+
+  // NAME CACHE
+  if (hsk_dns_is_subdomain(req->name, "entries.namecache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("entries.namecache.hnsd.",
+                                 ns->pool->namecache.map.size,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "hits.namecache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("hits.namecache.hnsd.",
+                                 ns->pool->namecache.hits,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "misses.namecache.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("misses.namecache.hnsd.",
+                                 ns->pool->namecache.misses,
+                                 an))
+      goto fail;
+  }
+
+  // UDP BATCHING
+  hsk_udp_batch_t *b = ns->batch;
+  uint64_t recv_calls = b ? b->recv_calls : 0;
+  uint64_t recv_msgs = b ? b->recv_msgs : 0;
+  uint64_t send_calls = b ? b->send_calls : 0;
+  uint64_t send_msgs = b ? b->send_msgs : 0;
+
+  if (hsk_dns_is_subdomain(req->name, "recv_msgs.udp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("recv_msgs.udp.hnsd.",
+                                 recv_msgs,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "recv_batch.udp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_float("recv_batch.udp.hnsd.",
+                             recv_calls ? (float)recv_msgs / recv_calls : 0,
+                             an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "send_msgs.udp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("send_msgs.udp.hnsd.",
+                                 send_msgs,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "send_batch.udp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_float("send_batch.udp.hnsd.",
+                             send_calls ? (float)send_msgs / send_calls : 0,
+                             an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "send_allocs.udp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("send_allocs.udp.hnsd.",
+                                 ns->sends ? ns->sends->allocs : 0,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "send_drops.udp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("send_drops.udp.hnsd.",
+                                 b ? b->send_drops : 0,
+                                 an))
+      goto fail;
+  }
+
+  // TCP
+  if (hsk_dns_is_subdomain(req->name, "conns.tcp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("conns.tcp.hnsd.",
+                                 ns->tcp ? ns->tcp->conns.size : 0,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "queries.tcp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("queries.tcp.hnsd.",
+                                 ns->tcp ? ns->tcp->queries : 0,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "rejected.tcp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("rejected.tcp.hnsd.",
+                                 ns->tcp ? ns->tcp->rejected : 0,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "timeouts.tcp.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("timeouts.tcp.hnsd.",
+                                 ns->tcp ? ns->tcp->timeouts : 0,
+                                 an))
+      goto fail;
+  }
+
+  // RATE LIMITING
+  if (hsk_dns_is_subdomain(req->name, "passed.rrl.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("passed.rrl.hnsd.",
+                                 ns->rrl.passed,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "dropped.rrl.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("dropped.rrl.hnsd.",
+                                 ns->rrl.dropped,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "truncated.rrl.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("truncated.rrl.hnsd.",
+                                 ns->rrl.truncated,
+                                 an))
+      goto fail;
+  }
+
+  if (hsk_dns_is_subdomain(req->name, "proofs.rrl.hnsd.")) {
+    if (!hsk_hesiod_txt_push_u64("proofs.rrl.hnsd.",
+                                 ns->rrl.proofs_limited,
+                                 an))
+      goto fail;
+  }
 
   return msg;
 
@@ -0,0 +1,99 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "icann.h"
+#include "resource.h"
+#include "tld.h"
+#include "tld_hash.h"
+#include "uv.h"
+
+static const hsk_resource_t *hsk_icann_resources[HSK_TLD_SIZE];
+static uv_once_t hsk_icann_once = UV_ONCE_INIT;
+
+/*
+ * Helpers
+ */
+
+// FNV-1a over the lowercased name.
+static uint64_t
+hsk_icann_hash(const char *name) {
+  uint64_t h = 0xcbf29ce484222325ull;
+
+  for (const char *s = name; *s; s++) {
+    uint8_t ch = (uint8_t)*s;
+
+    if (ch >= 'A' && ch <= 'Z')
+      ch += ' ';
+
+    h ^= ch;
+    h *= 0x100000001b3ull;
+  }
+
+  return h;
+}
+
+static uint32_t
+hsk_icann_mix(uint32_t lo, uint16_t disp) {
+  uint32_t x = lo ^ ((uint32_t)disp * 0x9e3779b9u);
+  x = (x ^ (x >> 16)) * 0x85ebca6bu;
+  x ^= x >> 13;
+  return x % HSK_TLD_SIZE;
+}
+
+static void
+hsk_icann_decode(void) {
+  for (int i = 0; i < HSK_TLD_SIZE; i++) {
+    const uint8_t *item = (const uint8_t *)HSK_TLD_DATA[i];
+    const uint8_t *raw = &item[2];
+    size_t raw_len = (((size_t)item[1]) << 8) | ((size_t)item[0]);
+    hsk_resource_t *res;
+
+    // Left empty: the name is treated as not existing.
+    if (!hsk_resource_decode(raw, raw_len, &res))
+      res = NULL;
+
+    hsk_icann_resources[i] = res;
+  }
+}
+
+/*
+ * ICANN Fallback
+ */
+
+// Decode everything ahead of serving.
+void
+hsk_icann_init(void) {
+  uv_once(&hsk_icann_once, hsk_icann_decode);
+}
+
+int
+hsk_icann_index(const char *name) {
+  assert(name);
+
+  uint64_t h = hsk_icann_hash(name);
+  uint16_t disp = HSK_TLD_DISP[(uint32_t)(h >> 32) % HSK_TLD_BUCKETS];
+  int index = HSK_TLD_SLOTS[hsk_icann_mix((uint32_t)h, disp)];
+
+  // Every string hashes somewhere.
+  if (strcasecmp(HSK_TLD_NAMES[index], name) != 0)
+    return -1;
+
+  return index;
+}
+
+const hsk_resource_t *
+hsk_icann_resource(const char *name) {
+  int index = hsk_icann_index(name);
+
+  if (index == -1)
+    return NULL;
+
+  hsk_icann_init();
+
+  return hsk_icann_resources[index];
+}
@@ -0,0 +1,29 @@
+#ifndef _HSK_ICANN_H
+#define _HSK_ICANN_H
+
+#include <stdint.h>
+
+#include "resource.h"
+
+/*
+ * ICANN Fallback
+ *
+ * Resources for the ICANN root zone TLDs, served for names which do not
+ * exist on Handshake.  Names are found with the minimal perfect hash in
+ * tld_hash.h (see scripts/tld-hash.js), and every resource is decoded once
+ * up front, so a fallback is one hash and one table read.
+ *
+ * The decoded resources are shared and read-only, and live for the whole
+ * process; they may be read from any thread.
+ */
+
+void
+hsk_icann_init(void);
+
+int
+hsk_icann_index(const char *name);
+
+const hsk_resource_t *
+hsk_icann_resource(const char *name);
+
+#endif
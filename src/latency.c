@@ -0,0 +1,85 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency.h"
+
+/*
+ * Latency
+ */
+
+void
+hsk_latency_init(hsk_latency_t *lat) {
+  assert(lat);
+  memset(lat->samples, 0, sizeof(lat->samples));
+  lat->count = 0;
+  lat->next = 0;
+  lat->total = 0;
+}
+
+// Overwrites the oldest sample once the window is full.
+void
+hsk_latency_add(hsk_latency_t *lat, int64_t ms) {
+  assert(lat);
+
+  if (ms < 0)
+    ms = 0;
+
+  if (ms > UINT32_MAX)
+    ms = UINT32_MAX;
+
+  lat->samples[lat->next] = (uint32_t)ms;
+  lat->next = (lat->next + 1) % HSK_LATENCY_SAMPLES;
+
+  if (lat->count < HSK_LATENCY_SAMPLES)
+    lat->count += 1;
+
+  lat->total += 1;
+}
+
+// Nearest-rank quantile of the window, or -1 without samples.
+int64_t
+hsk_latency_quantile(const hsk_latency_t *lat, double q) {
+  assert(lat);
+
+  if (lat->count == 0)
+    return -1;
+
+  if (q < 0)
+    q = 0;
+
+  if (q > 1)
+    q = 1;
+
+  uint32_t sorted[HSK_LATENCY_SAMPLES];
+  size_t n = lat->count;
+
+  memcpy(sorted, lat->samples, n * sizeof(uint32_t));
+
+  // Small enough for an insertion sort.
+  for (size_t i = 1; i < n; i++) {
+    uint32_t x = sorted[i];
+    size_t j = i;
+
+    while (j > 0 && sorted[j - 1] > x) {
+      sorted[j] = sorted[j - 1];
+      j -= 1;
+    }
+
+    sorted[j] = x;
+  }
+
+  size_t rank = (size_t)(q * n + 0.999999);
+
+  if (rank == 0)
+    rank = 1;
+
+  if (rank > n)
+    rank = n;
+
+  return sorted[rank - 1];
+}
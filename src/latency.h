@@ -0,0 +1,39 @@
+#ifndef _HSK_LATENCY_H
+#define _HSK_LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Defs
+ */
+
+#define HSK_LATENCY_SAMPLES 64
+
+/*
+ * Types
+ */
+
+// The most recent round trips, in milliseconds.
+typedef struct hsk_latency_s {
+  uint32_t samples[HSK_LATENCY_SAMPLES];
+  size_t count;
+  size_t next;
+  uint64_t total;
+} hsk_latency_t;
+
+/*
+ * Latency
+ */
+
+void
+hsk_latency_init(hsk_latency_t *lat);
+
+void
+hsk_latency_add(hsk_latency_t *lat, int64_t ms);
+
+int64_t
+hsk_latency_quantile(const hsk_latency_t *lat, double q);
+
+#endif
@@ -0,0 +1,425 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bio.h"
+#include "map.h"
+#include "namecache.h"
+#include "utils.h"
+
+/*
+ * Name Cache
+ */
+
+void
+hsk_namecache_init(hsk_namecache_t *nc) {
+  assert(nc);
+  hsk_map_init_hash_map(&nc->map, (hsk_map_free_func)hsk_namecache_item_free);
+  nc->head = NULL;
+  nc->tail = NULL;
+  nc->max_items = HSK_NAMECACHE_LIMIT;
+  nc->hits = 0;
+  nc->misses = 0;
+}
+
+void
+hsk_namecache_uninit(hsk_namecache_t *nc) {
+  assert(nc);
+  hsk_map_uninit(&nc->map);
+  nc->head = NULL;
+  nc->tail = NULL;
+}
+
+hsk_namecache_t *
+hsk_namecache_alloc(void) {
+  hsk_namecache_t *nc = malloc(sizeof(hsk_namecache_t));
+  if (nc)
+    hsk_namecache_init(nc);
+  return nc;
+}
+
+void
+hsk_namecache_free(hsk_namecache_t *nc) {
+  assert(nc);
+  hsk_namecache_uninit(nc);
+  free(nc);
+}
+
+static void
+hsk_namecache_unlink(hsk_namecache_t *nc, hsk_namecache_item_t *item) {
+  if (item->prev)
+    item->prev->next = item->next;
+  else
+    nc->head = item->next;
+
+  if (item->next)
+    item->next->prev = item->prev;
+  else
+    nc->tail = item->prev;
+
+  item->prev = NULL;
+  item->next = NULL;
+}
+
+static void
+hsk_namecache_push(hsk_namecache_t *nc, hsk_namecache_item_t *item) {
+  item->prev = NULL;
+  item->next = nc->head;
+
+  if (nc->head)
+    nc->head->prev = item;
+  else
+    nc->tail = item;
+
+  nc->head = item;
+}
+
+static void
+hsk_namecache_remove(hsk_namecache_t *nc, hsk_namecache_item_t *item) {
+  hsk_namecache_unlink(nc, item);
+  hsk_map_del(&nc->map, item->hash);
+  hsk_namecache_item_free(item);
+}
+
+static void
+hsk_namecache_prune(hsk_namecache_t *nc) {
+  while (nc->tail && nc->map.size >= nc->max_items)
+    hsk_namecache_remove(nc, nc->tail);
+}
+
+bool
+hsk_namecache_set_limit(hsk_namecache_t *nc, size_t max_items) {
+  assert(nc);
+
+  if (max_items == 0)
+    return false;
+
+  nc->max_items = max_items;
+
+  while (nc->tail && nc->map.size > nc->max_items)
+    hsk_namecache_remove(nc, nc->tail);
+
+  return true;
+}
+
+bool
+hsk_namecache_insert(
+  hsk_namecache_t *nc,
+  const char *name,
+  const uint8_t *hash,
+  const uint8_t *root,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len
+) {
+  assert(nc && name && hash && root);
+
+  if (strlen(name) > 255)
+    return false;
+
+  uint8_t *copy = NULL;
+
+  if (data_len > 0) {
+    copy = malloc(data_len);
+
+    if (!copy)
+      return false;
+
+    memcpy(copy, data, data_len);
+  }
+
+  // Replaces any result against an older root,
+  // keeping the popularity of the name.
+  hsk_namecache_item_t *item = hsk_map_get(&nc->map, hash);
+
+  if (item) {
+    free(item->data);
+    item->data = copy;
+    memcpy(item->root, root, 32);
+    item->exists = exists;
+    item->data_len = data_len;
+    item->time = hsk_now();
+    hsk_namecache_unlink(nc, item);
+    hsk_namecache_push(nc, item);
+    return true;
+  }
+
+  hsk_namecache_prune(nc);
+
+  item = hsk_namecache_item_alloc();
+
+  if (!item) {
+    free(copy);
+    return false;
+  }
+
+  item->data = copy;
+
+  strcpy(item->name, name);
+  memcpy(item->hash, hash, 32);
+  memcpy(item->root, root, 32);
+  item->exists = exists;
+  item->data_len = data_len;
+  item->time = hsk_now();
+  item->score = 1;
+
+  if (!hsk_map_set(&nc->map, item->hash, item)) {
+    hsk_namecache_item_free(item);
+    return false;
+  }
+
+  hsk_namecache_push(nc, item);
+
+  return true;
+}
+
+const hsk_namecache_item_t *
+hsk_namecache_get(
+  hsk_namecache_t *nc,
+  const uint8_t *hash,
+  const uint8_t *root
+) {
+  assert(nc && hash && root);
+
+  hsk_namecache_item_t *item = hsk_map_get(&nc->map, hash);
+
+  if (item && item->score < UINT32_MAX)
+    item->score += 1;
+
+  if (!item || memcmp(item->root, root, 32) != 0) {
+    nc->misses += 1;
+    return NULL;
+  }
+
+  hsk_namecache_unlink(nc, item);
+  hsk_namecache_push(nc, item);
+
+  nc->hits += 1;
+
+  return item;
+}
+
+// Age every popularity score by half.
+void
+hsk_namecache_decay(hsk_namecache_t *nc) {
+  assert(nc);
+
+  hsk_namecache_item_t *item;
+
+  for (item = nc->head; item; item = item->next)
+    item->score >>= 1;
+}
+
+static int
+hsk_namecache_cmp(const void *a, const void *b) {
+  const hsk_namecache_item_t *x = *(const hsk_namecache_item_t **)a;
+  const hsk_namecache_item_t *y = *(const hsk_namecache_item_t **)b;
+
+  if (x->score > y->score)
+    return -1;
+
+  if (x->score < y->score)
+    return 1;
+
+  return 0;
+}
+
+// Collect the most popular names which
+// have not been proven against `root` yet.
+size_t
+hsk_namecache_hottest(
+  hsk_namecache_t *nc,
+  const uint8_t *root,
+  hsk_namecache_item_t **items,
+  size_t max
+) {
+  assert(nc && root && items);
+
+  if (max == 0 || nc->map.size == 0)
+    return 0;
+
+  hsk_namecache_item_t **all = malloc(nc->map.size * sizeof(*all));
+
+  if (!all)
+    return 0;
+
+  size_t total = 0;
+  hsk_namecache_item_t *item;
+
+  for (item = nc->head; item; item = item->next) {
+    if (item->score == 0)
+      continue;
+
+    if (memcmp(item->root, root, 32) == 0)
+      continue;
+
+    all[total++] = item;
+  }
+
+  qsort(all, total, sizeof(*all), hsk_namecache_cmp);
+
+  if (total > max)
+    total = max;
+
+  memcpy(items, all, total * sizeof(*all));
+
+  free(all);
+
+  return total;
+}
+
+// Serialize every result, least recently used first.
+size_t
+hsk_namecache_write(const hsk_namecache_t *nc, uint8_t **data) {
+  assert(nc);
+
+  size_t s = 0;
+  uint32_t count = 0;
+  hsk_namecache_item_t *item;
+
+  for (item = nc->tail; item; item = item->prev) {
+    if (item->data_len <= 0xffff)
+      count += 1;
+  }
+
+  s += write_u32(data, count);
+
+  for (item = nc->tail; item; item = item->prev) {
+    if (item->data_len > 0xffff)
+      continue;
+
+    size_t name_len = strlen(item->name);
+
+    s += write_u8(data, (uint8_t)name_len);
+    s += write_bytes(data, (uint8_t *)item->name, name_len);
+    s += write_bytes(data, item->hash, 32);
+    s += write_bytes(data, item->root, 32);
+    s += write_u8(data, item->exists ? 1 : 0);
+    s += write_i64(data, item->time);
+    s += write_u32(data, item->score);
+    s += write_u16(data, (uint16_t)item->data_len);
+    s += write_bytes(data, item->data, item->data_len);
+  }
+
+  return s;
+}
+
+// Restore results written by hsk_namecache_write.
+// Each keeps the root it was proven against, so
+// only lookups at that same root will use it.
+bool
+hsk_namecache_read(hsk_namecache_t *nc, uint8_t **data, size_t *data_len) {
+  assert(nc);
+
+  uint32_t count;
+
+  if (!read_u32(data, data_len, &count))
+    return false;
+
+  for (uint32_t i = 0; i < count; i++) {
+    char name[256];
+    uint8_t name_len;
+    uint8_t hash[32];
+    uint8_t root[32];
+    uint8_t exists;
+    int64_t time;
+    uint32_t score;
+    uint16_t len;
+
+    if (!read_u8(data, data_len, &name_len))
+      return false;
+
+    if (!read_bytes(data, data_len, (uint8_t *)name, name_len))
+      return false;
+
+    name[name_len] = '\0';
+
+    if (!read_bytes(data, data_len, hash, 32))
+      return false;
+
+    if (!read_bytes(data, data_len, root, 32))
+      return false;
+
+    if (!read_u8(data, data_len, &exists))
+      return false;
+
+    if (!read_i64(data, data_len, &time))
+      return false;
+
+    if (!read_u32(data, data_len, &score))
+      return false;
+
+    if (!read_u16(data, data_len, &len))
+      return false;
+
+    if (*data_len < len)
+      return false;
+
+    const uint8_t *res = *data;
+
+    *data += len;
+    *data_len -= len;
+
+    if (hsk_map_has(&nc->map, hash))
+      continue;
+
+    if (!hsk_namecache_insert(nc, name, hash, root, exists != 0, res, len))
+      return false;
+
+    hsk_namecache_item_t *item = hsk_map_get(&nc->map, hash);
+    assert(item);
+
+    item->time = time;
+    item->score = score;
+  }
+
+  return true;
+}
+
+/*
+ * Name Cache Item
+ */
+
+void
+hsk_namecache_item_init(hsk_namecache_item_t *item) {
+  assert(item);
+  memset(item->name, 0, sizeof(item->name));
+  memset(item->hash, 0, sizeof(item->hash));
+  memset(item->root, 0, sizeof(item->root));
+  item->exists = false;
+  item->data = NULL;
+  item->data_len = 0;
+  item->time = 0;
+  item->score = 0;
+  item->prev = NULL;
+  item->next = NULL;
+}
+
+void
+hsk_namecache_item_uninit(hsk_namecache_item_t *item) {
+  assert(item);
+  if (item->data) {
+    free(item->data);
+    item->data = NULL;
+    item->data_len = 0;
+  }
+}
+
+hsk_namecache_item_t *
+hsk_namecache_item_alloc(void) {
+  hsk_namecache_item_t *item = malloc(sizeof(hsk_namecache_item_t));
+  if (item)
+    hsk_namecache_item_init(item);
+  return item;
+}
+
+void
+hsk_namecache_item_free(hsk_namecache_item_t *item) {
+  assert(item);
+  hsk_namecache_item_uninit(item);
+  free(item);
+}
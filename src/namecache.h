@@ -0,0 +1,112 @@
+#ifndef _HSK_NAMECACHE_H
+#define _HSK_NAMECACHE_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "map.h"
+
+#define HSK_NAMECACHE_LIMIT 5000
+#define HSK_NAMECACHE_PREFETCH 100
+
+/*
+ * Types
+ */
+
+// Verified proof result for a name against a tree root.
+typedef struct hsk_namecache_item_s {
+  char name[256];
+  uint8_t hash[32];
+  uint8_t root[32];
+  bool exists;
+  uint8_t *data;
+  size_t data_len;
+  int64_t time;
+  // Lookups seen, halved on every new tree root.
+  uint32_t score;
+  struct hsk_namecache_item_s *prev;
+  struct hsk_namecache_item_s *next;
+} hsk_namecache_item_t;
+
+typedef struct hsk_namecache_s {
+  hsk_map_t map;
+  // LRU list, head is most recently used.
+  hsk_namecache_item_t *head;
+  hsk_namecache_item_t *tail;
+  size_t max_items;
+  uint64_t hits;
+  uint64_t misses;
+} hsk_namecache_t;
+
+/*
+ * Name Cache
+ */
+
+void
+hsk_namecache_init(hsk_namecache_t *nc);
+
+void
+hsk_namecache_uninit(hsk_namecache_t *nc);
+
+hsk_namecache_t *
+hsk_namecache_alloc(void);
+
+void
+hsk_namecache_free(hsk_namecache_t *nc);
+
+bool
+hsk_namecache_set_limit(hsk_namecache_t *nc, size_t max_items);
+
+bool
+hsk_namecache_insert(
+  hsk_namecache_t *nc,
+  const char *name,
+  const uint8_t *hash,
+  const uint8_t *root,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len
+);
+
+const hsk_namecache_item_t *
+hsk_namecache_get(
+  hsk_namecache_t *nc,
+  const uint8_t *hash,
+  const uint8_t *root
+);
+
+void
+hsk_namecache_decay(hsk_namecache_t *nc);
+
+size_t
+hsk_namecache_hottest(
+  hsk_namecache_t *nc,
+  const uint8_t *root,
+  hsk_namecache_item_t **items,
+  size_t max
+);
+
+size_t
+hsk_namecache_write(const hsk_namecache_t *nc, uint8_t **data);
+
+bool
+hsk_namecache_read(hsk_namecache_t *nc, uint8_t **data, size_t *data_len);
+
+/*
+ * Name Cache Item
+ */
+
+void
+hsk_namecache_item_init(hsk_namecache_item_t *item);
+
+void
+hsk_namecache_item_uninit(hsk_namecache_item_t *item);
+
+hsk_namecache_item_t *
+hsk_namecache_item_alloc(void);
+
+void
+hsk_namecache_item_free(hsk_namecache_item_t *item);
+#endif
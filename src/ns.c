@@ -10,21 +10,28 @@
 #include <time.h>
 
 #include "addr.h"
+#include "arena.h"
 #include "cache.h"
 #include "constants.h"
 #include "dns.h"
 #include "ec.h"
+#include "ecc.h"
 #include "error.h"
 #include "resource.h"
+#include "sendpool.h"
+#include "tcp.h"
 #include "ns.h"
+#include "ns_worker.h"
 #include "pool.h"
 #include "req.h"
-#include "tld.h"
+#include "udp_batch.h"
+#include "zone.h"
 #include "platform-net.h"
 #include "utils.h"
 #include "uv.h"
 #include "dnssec.h"
 #include "hesiod.h"
+#include "icann.h"
 
 // A RRSIG NSEC
 static const uint8_t hsk_type_map_a[] = {
@@ -40,11 +47,30 @@ static const uint8_t hsk_type_map_aaaa[] = {
  * Types
  */
 
-typedef struct {
+// Queries for the same name and type waiting
+// on a single resolution.
+typedef struct hsk_ns_waiters_s {
   hsk_ns_t *ns;
-  void *data;
-  bool should_free;
-} hsk_send_data_t;
+  hsk_cache_key_t key;
+  bool keyed;
+  hsk_dns_req_t **reqs;
+  size_t size;
+  size_t cap;
+} hsk_ns_waiters_t;
+
+// A response being built and signed off the loop, for
+// either a set of waiters or a cache refresh.
+typedef struct hsk_ns_build_s {
+  hsk_ns_t *ns;
+  hsk_ns_waiters_t *waiters;
+  hsk_dns_req_t *req;
+  const hsk_resource_t *res;
+  hsk_resource_t *owned;
+  char name[HSK_DNS_MAX_NAME + 1];
+  uint16_t type;
+  hsk_dns_msg_t *msg;
+  hsk_arena_t arena;
+} hsk_ns_build_t;
 
 /*
  * Prototypes
@@ -63,6 +89,24 @@ after_resolve(
   const void *arg
 );
 
+static void
+after_refresh(
+  const char *name,
+  int status,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len,
+  const void *arg
+);
+
+static void
+hsk_ns_reply(
+  hsk_ns_t *ns,
+  const hsk_dns_req_t *req,
+  uint8_t *wire,
+  size_t wire_len
+);
+
 int
 hsk_ns_send(
   hsk_ns_t *ns,
@@ -75,9 +119,6 @@ hsk_ns_send(
 static void
 alloc_buffer(uv_handle_t *handle, size_t size, uv_buf_t *buf);
 
-static void
-after_send(uv_udp_send_t *req, int status);
-
 static void
 after_recv(
   uv_udp_t *socket,
@@ -90,11 +131,42 @@ after_recv(
 static void
 after_close(uv_handle_t *handle);
 
-static int
-hsk_tld_index(const char *name);
+static void
+after_resign(uv_timer_t *timer);
+
+static void
+hsk_ns_deliver(
+  hsk_ns_t *ns,
+  const hsk_ns_waiters_t *waiters,
+  hsk_dns_msg_t *msg,
+  bool nx
+);
+
+static void
+on_build(void *arg);
+
+static void
+after_build(void *arg, bool cancelled);
+
+static void
+after_loop(uv_check_t *check);
 
-static const uint8_t *
-hsk_icann_lookup(const char *name);
+static void
+after_batch_recv(
+  void *data,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+);
+
+static void
+after_tcp_recv(
+  void *data,
+  int conn,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+);
 
 /*
  * Root Nameserver
@@ -110,18 +182,38 @@ hsk_ns_init(hsk_ns_t *ns, const uv_loop_t *loop, const hsk_pool_t *pool) {
   if (!ec)
     return HSK_ENOMEM;
 
+  hsk_work_t *sign = hsk_work_alloc(loop);
+
+  if (!sign) {
+    hsk_ec_free(ec);
+    return HSK_ENOMEM;
+  }
+
   ns->loop = (uv_loop_t *)loop;
   ns->pool = (hsk_pool_t *)pool;
   hsk_addr_init(&ns->ip_);
   ns->ip = NULL;
   ns->socket = NULL;
+  ns->batch = NULL;
+  ns->sends = NULL;
+  ns->tcp = NULL;
   ns->ec = ec;
   hsk_cache_init(&ns->cache);
+  hsk_map_init_map(&ns->inflight, hsk_cache_key_hash, hsk_cache_key_equal,
+                   NULL);
+  ns->coalesced = 0;
+  hsk_rrl_init(&ns->rrl);
+  hsk_zone_init(&ns->zone);
+  ns->resign = NULL;
+  ns->refill = NULL;
+  ns->sign = sign;
   memset(ns->key_, 0x00, sizeof(ns->key_));
   ns->key = NULL;
   memset(ns->pubkey, 0x00, sizeof(ns->pubkey));
   memset(ns->read_buffer, 0x00, sizeof(ns->read_buffer));
   ns->receiving = false;
+  ns->worker_count = 0;
+  ns->workers = NULL;
 
   return HSK_SUCCESS;
 }
@@ -136,6 +228,23 @@ hsk_ns_uninit(hsk_ns_t *ns) {
     ns->ec = NULL;
   }
 
+  if (ns->workers) {
+    hsk_ns_workers_free(ns->workers);
+    ns->workers = NULL;
+  }
+
+  if (ns->sign) {
+    hsk_work_release(ns->sign);
+    ns->sign = NULL;
+  }
+
+  // Waiters are owned by their pending resolutions.
+  hsk_map_uninit(&ns->inflight);
+
+  hsk_zone_uninit(&ns->zone);
+
+  hsk_rrl_uninit(&ns->rrl);
+
   hsk_cache_uninit(&ns->cache);
 }
 
@@ -157,6 +266,10 @@ hsk_ns_set_ip(hsk_ns_t *ns, const struct sockaddr *addr) {
 
   ns->ip = &ns->ip_;
 
+  // Already serving: the apex glue has changed.
+  if (ns->zone.ready && !hsk_zone_sign(&ns->zone, ns->ip))
+    return false;
+
   return true;
 }
 
@@ -180,44 +293,138 @@ hsk_ns_set_key(hsk_ns_t *ns, const uint8_t *key) {
   return true;
 }
 
+bool
+hsk_ns_set_workers(hsk_ns_t *ns, int count) {
+  assert(ns);
+
+  if (count < 0 || count > HSK_NS_WORKERS_MAX)
+    return false;
+
+  ns->worker_count = count;
+
+  return true;
+}
+
 int
 hsk_ns_open(hsk_ns_t *ns, const struct sockaddr *addr) {
   if (!ns || !addr)
     return HSK_EBADARGS;
 
-  ns->socket = malloc(sizeof(uv_udp_t));
-  if (!ns->socket)
+  if (hsk_udp_batch_supported()) {
+    ns->batch = hsk_udp_batch_alloc(ns->loop, after_batch_recv, (void *)ns);
+
+    if (!ns->batch)
+      return HSK_ENOMEM;
+
+    bool reuseport = ns->worker_count > 0;
+
+    if (hsk_udp_batch_open(ns->batch, addr, reuseport) != HSK_SUCCESS)
+      return HSK_EFAILURE;
+  } else {
+    ns->socket = malloc(sizeof(uv_udp_t));
+    if (!ns->socket)
+      return HSK_ENOMEM;
+
+    if (uv_udp_init(ns->loop, ns->socket) != 0)
+      return HSK_EFAILURE;
+
+    ns->socket->data = (void *)ns;
+
+    ns->sends = hsk_sendpool_alloc();
+
+    if (!ns->sends)
+      return HSK_ENOMEM;
+
+    if (hsk_ns_bind(ns->socket, addr, ns->worker_count > 0) != HSK_SUCCESS)
+      return HSK_EFAILURE;
+
+    int value = sizeof(ns->read_buffer);
+
+    if (uv_send_buffer_size((uv_handle_t *)ns->socket, &value) != 0)
+      return HSK_EFAILURE;
+
+    if (uv_recv_buffer_size((uv_handle_t *)ns->socket, &value) != 0)
+      return HSK_EFAILURE;
+
+    if (uv_udp_recv_start(ns->socket, alloc_buffer, after_recv) != 0)
+      return HSK_EFAILURE;
+  }
+
+  ns->receiving = true;
+
+  // Truncated answers point clients here.
+  ns->tcp = hsk_tcp_alloc(ns->loop, after_tcp_recv, (void *)ns);
+
+  if (!ns->tcp)
     return HSK_ENOMEM;
 
-  if (uv_udp_init(ns->loop, ns->socket) != 0)
-    return HSK_EFAILURE;
+  if (hsk_tcp_open(ns->tcp, addr) != HSK_SUCCESS) {
+    hsk_ns_log(ns, "failed opening tcp listener\n");
+    hsk_tcp_free(ns->tcp);
+    ns->tcp = NULL;
+  }
+
+  if (!ns->ip)
+    hsk_ns_set_ip(ns, addr);
 
-  ns->socket->data = (void *)ns;
+  // Fallback answers are decoded once, up front.
+  hsk_icann_init();
 
-  if (uv_udp_bind(ns->socket, addr, 0) != 0)
+  if (!hsk_zone_sign(&ns->zone, ns->ip)) {
+    hsk_ns_log(ns, "could not sign root zone\n");
     return HSK_EFAILURE;
+  }
 
-  int value = sizeof(ns->read_buffer);
+  ns->resign = malloc(sizeof(uv_timer_t));
 
-  if (uv_send_buffer_size((uv_handle_t *)ns->socket, &value) != 0)
-    return HSK_EFAILURE;
+  if (!ns->resign)
+    return HSK_ENOMEM;
+
+  ns->resign->data = (void *)ns;
 
-  if (uv_recv_buffer_size((uv_handle_t *)ns->socket, &value) != 0)
+  if (uv_timer_init(ns->loop, ns->resign) != 0)
     return HSK_EFAILURE;
 
-  if (uv_udp_recv_start(ns->socket, alloc_buffer, after_recv) != 0)
+  if (uv_timer_start(ns->resign, after_resign, HSK_ZONE_RESIGN_INTERVAL,
+                     HSK_ZONE_RESIGN_INTERVAL) != 0) {
     return HSK_EFAILURE;
+  }
 
-  ns->receiving = true;
+  // Signing nonces are generated off the request path.
+  ns->refill = malloc(sizeof(uv_check_t));
 
-  if (!ns->ip)
-    hsk_ns_set_ip(ns, addr);
+  if (!ns->refill)
+    return HSK_ENOMEM;
+
+  ns->refill->data = (void *)ns;
+
+  if (uv_check_init(ns->loop, ns->refill) != 0)
+    return HSK_EFAILURE;
+
+  if (uv_check_start(ns->refill, after_loop) != 0)
+    return HSK_EFAILURE;
 
   char host[HSK_MAX_HOST];
   assert(hsk_sa_to_string(addr, host, HSK_MAX_HOST, HSK_NS_PORT));
 
   hsk_ns_log(ns, "root nameserver listening on: %s\n", host);
 
+  if (ns->worker_count > 0) {
+    ns->workers = hsk_ns_workers_alloc(ns, ns->worker_count);
+
+    if (!ns->workers)
+      return HSK_ENOMEM;
+
+    int rc = hsk_ns_workers_open(ns->workers, addr);
+
+    if (rc != HSK_SUCCESS) {
+      hsk_ns_log(ns, "failed starting workers: %s\n", hsk_strerror(rc));
+      return rc;
+    }
+
+    hsk_ns_log(ns, "started %d worker threads\n", ns->worker_count);
+  }
+
   return HSK_SUCCESS;
 }
 
@@ -226,6 +433,40 @@ hsk_ns_close(hsk_ns_t *ns) {
   if (!ns)
     return HSK_EBADARGS;
 
+  if (ns->workers)
+    hsk_ns_workers_close(ns->workers);
+
+  if (ns->resign) {
+    uv_timer_stop(ns->resign);
+    hsk_uv_close_free((uv_handle_t *)ns->resign);
+    ns->resign = NULL;
+  }
+
+  if (ns->refill) {
+    uv_check_stop(ns->refill);
+    hsk_uv_close_free((uv_handle_t *)ns->refill);
+    ns->refill = NULL;
+  }
+
+  // Responses still being signed are dropped when they return.
+  if (ns->sign) {
+    hsk_work_release(ns->sign);
+    ns->sign = NULL;
+  }
+
+  if (ns->tcp) {
+    hsk_tcp_close(ns->tcp);
+    hsk_tcp_free(ns->tcp);
+    ns->tcp = NULL;
+  }
+
+  if (ns->batch) {
+    hsk_udp_batch_close(ns->batch);
+    hsk_udp_batch_free(ns->batch);
+    ns->batch = NULL;
+    ns->receiving = false;
+  }
+
   if (ns->receiving) {
     if (uv_udp_recv_stop(ns->socket) != 0)
       return HSK_EFAILURE;
@@ -238,6 +479,12 @@ hsk_ns_close(hsk_ns_t *ns) {
     ns->socket = NULL;
   }
 
+  // Outstanding sends are cancelled by the close and free it.
+  if (ns->sends) {
+    hsk_sendpool_release(ns->sends);
+    ns->sends = NULL;
+  }
+
   return HSK_SUCCESS;
 }
 
@@ -290,55 +537,399 @@ hsk_ns_log(hsk_ns_t *ns, const char *fmt, ...) {
   va_end(args);
 }
 
+// Finalize a reply, remembering the unsigned
+// wire so later hits can skip straight to sending.
+static bool
+hsk_ns_seal(
+  hsk_cache_t *cache,
+  const hsk_ec_t *ec,
+  const uint8_t *key,
+  hsk_dns_msg_t **msg,
+  const hsk_dns_req_t *req,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  uint8_t *data = NULL;
+  size_t data_len = 0;
+
+  *wire = NULL;
+  *wire_len = 0;
+
+  if (!hsk_dns_msg_finalize_raw(msg, req, key != NULL, &data, &data_len))
+    return false;
+
+  hsk_cache_insert_wire(cache, req, data, data_len);
+
+  if (!key) {
+    *wire = data;
+    *wire_len = data_len;
+    return true;
+  }
+
+  return hsk_dns_msg_sign(ec, key, data, data_len, wire, wire_len);
+}
+
+static bool
+hsk_ns_finalize(
+  hsk_ns_t *ns,
+  hsk_dns_msg_t **msg,
+  const hsk_dns_req_t *req,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  return hsk_ns_seal(&ns->cache, ns->ec, ns->key, msg, req, wire, wire_len);
+}
+
+// Reply with one of the pre-signed root zone responses.
+static bool
+hsk_ns_zone_reply(hsk_ns_t *ns, const hsk_dns_req_t *req, int slot) {
+  uint8_t *wire = NULL;
+  size_t wire_len = 0;
+
+  if (!hsk_zone_wire(&ns->zone, slot, req, ns->key != NULL,
+                     &wire, &wire_len)) {
+    hsk_dns_msg_t *msg = hsk_zone_msg(&ns->zone, slot);
+
+    if (!msg)
+      return false;
+
+    if (!hsk_dns_msg_finalize(&msg, req, ns->ec, ns->key, &wire, &wire_len))
+      return false;
+  } else if (ns->key) {
+    uint8_t *raw = wire;
+    size_t raw_len = wire_len;
+
+    if (!hsk_dns_msg_sign(ns->ec, ns->key, raw, raw_len, &wire, &wire_len))
+      return false;
+  }
+
+  hsk_ns_reply(ns, req, wire, wire_len);
+
+  return true;
+}
+
+// Empty reply telling a rate limited client to retry
+// over TCP. Left unsigned to cost little more than a drop.
+// Shared with the worker threads.
+bool
+hsk_ns_truncated(
+  const hsk_dns_req_t *req,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  hsk_dns_msg_t *msg = hsk_resource_to_truncated();
+
+  if (!msg)
+    return false;
+
+  return hsk_dns_msg_finalize_raw(&msg, req, false, wire, wire_len);
+}
+
+static void
+hsk_ns_servfail(hsk_ns_t *ns, const hsk_dns_req_t *req) {
+  if (!hsk_ns_zone_reply(ns, req, HSK_ZONE_SERVFAIL)) {
+    hsk_ns_log(ns, "could not create servfail (%u)\n", req->id);
+    return;
+  }
+
+  hsk_ns_log(ns, "sending servfail (%u)\n", req->id);
+}
+
+// Answer from the finalized response cache or the
+// message cache. Shared with the worker threads,
+// which each pass their own cache and ec context.
+bool
+hsk_ns_cached(
+  hsk_cache_t *cache,
+  const hsk_ec_t *ec,
+  const uint8_t *key,
+  const hsk_dns_req_t *req,
+  const uint8_t *query,
+  size_t query_len,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  if (hsk_cache_get_wire(cache, req, query, query_len, wire, wire_len)) {
+    if (!key)
+      return true;
+
+    uint8_t *raw = *wire;
+    size_t raw_len = *wire_len;
+
+    return hsk_dns_msg_sign(ec, key, raw, raw_len, wire, wire_len);
+  }
+
+  hsk_dns_msg_t *msg = hsk_cache_get(cache, req);
+
+  if (!msg)
+    return false;
+
+  return hsk_ns_seal(cache, ec, key, &msg, req, wire, wire_len);
+}
+
+// Store a response in the cache, and in the
+// cache of the worker which forwarded the query.
+static void
+hsk_ns_cache_insert(
+  hsk_ns_t *ns,
+  const hsk_dns_req_t *req,
+  const hsk_dns_msg_t *msg
+) {
+  hsk_cache_insert(&ns->cache, req, msg);
+
+  if (req->worker)
+    hsk_ns_worker_post((hsk_ns_worker_t *)req->worker, req, msg);
+}
+
+// Fetch a replacement for a stale cache entry
+// without anybody waiting on the answer.
+static void
+hsk_ns_refresh(hsk_ns_t *ns, const hsk_dns_req_t *req) {
+  hsk_dns_req_t *copy = hsk_dns_req_clone(req);
+
+  if (!copy)
+    return;
+
+  copy->ns = (void *)ns;
+
+  int rc = hsk_pool_resolve_background(ns->pool,
+                                       copy->tld,
+                                       after_refresh,
+                                       (void *)copy);
+
+  if (rc != HSK_SUCCESS) {
+    hsk_ns_log(ns, "could not refresh %s: %s\n", copy->name, hsk_strerror(rc));
+    hsk_dns_req_free(copy);
+  }
+}
+
+static hsk_ns_waiters_t *
+hsk_ns_waiters_alloc(hsk_ns_t *ns) {
+  hsk_ns_waiters_t *waiters = malloc(sizeof(hsk_ns_waiters_t));
+
+  if (!waiters)
+    return NULL;
+
+  waiters->ns = ns;
+  hsk_cache_key_init(&waiters->key);
+  waiters->keyed = false;
+  waiters->reqs = NULL;
+  waiters->size = 0;
+  waiters->cap = 0;
+
+  return waiters;
+}
+
+static void
+hsk_ns_waiters_free(hsk_ns_waiters_t *waiters) {
+  if (!waiters)
+    return;
+
+  for (size_t i = 0; i < waiters->size; i++)
+    hsk_dns_req_free(waiters->reqs[i]);
+
+  if (waiters->reqs)
+    free(waiters->reqs);
+
+  free(waiters);
+}
+
+static bool
+hsk_ns_waiters_push(hsk_ns_waiters_t *waiters, hsk_dns_req_t *req) {
+  if (waiters->size == waiters->cap) {
+    size_t cap = waiters->cap == 0 ? 4 : waiters->cap * 2;
+    hsk_dns_req_t **reqs = realloc(waiters->reqs, cap * sizeof(*reqs));
+
+    if (!reqs)
+      return false;
+
+    waiters->reqs = reqs;
+    waiters->cap = cap;
+  }
+
+  waiters->reqs[waiters->size++] = req;
+
+  return true;
+}
+
+// Resolve a cache miss, joining any identical query which is
+// already waiting on a proof. Takes ownership of `req` on success.
+static int
+hsk_ns_resolve(hsk_ns_t *ns, hsk_dns_req_t *req) {
+  hsk_cache_key_t ck;
+  bool keyed = hsk_cache_key_set_req(&ck, req);
+
+  if (keyed) {
+    hsk_ns_waiters_t *waiters = hsk_map_get(&ns->inflight, &ck);
+
+    if (waiters) {
+      if (!hsk_ns_waiters_push(waiters, req))
+        return HSK_ENOMEM;
+
+      ns->coalesced += 1;
+
+      return HSK_SUCCESS;
+    }
+  }
+
+  // Only queries which start a proof request are charged,
+  // so clients asking after the same name share one.
+  if (!hsk_rrl_proof(&ns->rrl, req->addr, uv_now(ns->loop))) {
+    hsk_ns_log(ns, "proof budget exceeded (%u)\n", req->id);
+    hsk_ns_servfail(ns, req);
+    hsk_dns_req_free(req);
+    return HSK_SUCCESS;
+  }
+
+  hsk_ns_waiters_t *waiters = hsk_ns_waiters_alloc(ns);
+
+  if (!waiters)
+    return HSK_ENOMEM;
+
+  if (!hsk_ns_waiters_push(waiters, req)) {
+    hsk_ns_waiters_free(waiters);
+    return HSK_ENOMEM;
+  }
+
+  if (keyed) {
+    memcpy(&waiters->key, &ck, sizeof(hsk_cache_key_t));
+
+    if (!hsk_map_set(&ns->inflight, &waiters->key, (void *)waiters)) {
+      waiters->size = 0;
+      hsk_ns_waiters_free(waiters);
+      return HSK_ENOMEM;
+    }
+
+    waiters->keyed = true;
+  }
+
+  // A cached proof may call back before this returns.
+  int rc = hsk_pool_resolve(
+    ns->pool,
+    req->tld,
+    after_resolve,
+    (void *)waiters
+  );
+
+  if (rc != HSK_SUCCESS) {
+    if (waiters->keyed)
+      hsk_map_del(&ns->inflight, &waiters->key);
+
+    // The caller still owns the request.
+    waiters->size = 0;
+    hsk_ns_waiters_free(waiters);
+  }
+
+  return rc;
+}
+
 static void
 hsk_ns_onrecv(
   hsk_ns_t *ns,
   const uint8_t *data,
   size_t data_len,
   const struct sockaddr *addr,
-  uint32_t flags
+  void *worker,
+  int tcp
 ) {
-  hsk_dns_req_t *req = hsk_dns_req_create(data, data_len, addr);
+  // Parsed on the stack: only queries
+  // waiting on a proof need a copy.
+  hsk_dns_req_t query;
+  hsk_dns_req_t *req = &query;
 
-  if (!req) {
+  if (!hsk_dns_req_parse(req, data, data_len, addr)) {
     hsk_ns_log(ns, "failed processing dns request\n");
     return;
   }
 
+  req->worker = worker;
+  req->tcp = tcp;
+
+  // No size limit beyond the length prefix.
+  if (tcp)
+    req->max_size = HSK_DNS_MAX_TCP;
+
   hsk_dns_req_print(req, "ns: ");
 
   uint8_t *wire = NULL;
   size_t wire_len = 0;
   hsk_dns_msg_t *msg = NULL;
 
-  // Hit cache first.
-  msg = hsk_cache_get(&ns->cache, req);
+  // Workers limit their own sockets, and TCP
+  // sources can't be spoofed to reflect off us.
+  if (!worker && !tcp) {
+    switch (hsk_rrl_check(&ns->rrl, addr, uv_now(ns->loop))) {
+      case HSK_RRL_DROP:
+        return;
+      case HSK_RRL_TRUNCATE:
+        if (hsk_ns_truncated(req, &wire, &wire_len))
+          hsk_ns_reply(ns, req, wire, wire_len);
+        return;
+    }
+  }
+
+  // A worker missed: answer from the message cache
+  // and hand the entry back so its next lookup hits.
+  if (worker) {
+    msg = hsk_cache_get(&ns->cache, req);
+
+    if (msg) {
+      hsk_ns_worker_post((hsk_ns_worker_t *)worker, req, msg);
+
+      if (!hsk_ns_finalize(ns, &msg, req, &wire, &wire_len)) {
+        hsk_ns_log(ns, "could not reply\n");
+        goto fail;
+      }
+
+      hsk_ns_log(ns, "sending cached msg (%u): %u\n", req->id, wire_len);
+
+      hsk_ns_reply(ns, req, wire, wire_len);
+
+      return;
+    }
+  }
+
+  // Otherwise hit the response caches first.
+  if (hsk_ns_cached(&ns->cache, ns->ec, ns->key, req,
+                    data, data_len, &wire, &wire_len)) {
+    hsk_ns_log(ns, "sending cached msg (%u): %u\n", req->id, wire_len);
+
+    hsk_ns_reply(ns, req, wire, wire_len);
+
+    return;
+  }
+
+  // Serve expired entries while a refresh is in flight,
+  // or while the pool is unable to provide proofs.
+  bool refresh = false;
+
+  msg = hsk_cache_get_stale(&ns->cache, req, &refresh);
 
   if (msg) {
+    if (refresh)
+      hsk_ns_refresh(ns, req);
+
     if (!hsk_dns_msg_finalize(&msg, req, ns->ec, ns->key, &wire, &wire_len)) {
       hsk_ns_log(ns, "could not reply\n");
       goto fail;
     }
 
-    hsk_ns_log(ns, "sending cached msg (%u): %u\n", req->id, wire_len);
+    hsk_ns_log(ns, "sending stale msg (%u): %u\n", req->id, wire_len);
 
-    hsk_ns_send(ns, wire, wire_len, addr, true);
+    hsk_ns_reply(ns, req, wire, wire_len);
 
-    goto done;
+    return;
   }
 
-  bool should_cache = true;
   // Hesiod class is used for local text queries of internal metadata
   if (req->class == HSK_DNS_HS
     && req->type == HSK_DNS_TXT
   ) {
-    should_cache = false;
-
     hsk_addr_t address;
     hsk_addr_from_sa(&address, req->addr);
     if (!hsk_addr_is_local(&address)) {
       hsk_ns_log(ns, "ignoring non-local HS class request\n");
-      goto done;
+      return;
     }
 
     msg = hsk_hesiod_resolve(req, ns);
@@ -352,9 +943,9 @@ hsk_ns_onrecv(
       goto fail;
     }
 
-    hsk_ns_send(ns, wire, wire_len, addr, true);
+    hsk_ns_reply(ns, req, wire, wire_len);
 
-    goto done;
+    return;
   }
 
   // Handle reverse pointers.
@@ -365,7 +956,6 @@ hsk_ns_onrecv(
   // by decoding the name itself (it does not have to be looked up).
   if (strcmp(req->tld, "_synth") == 0 && req->labels <= 2) {
     msg = hsk_dns_msg_alloc();
-    should_cache = false;
 
     if (!msg)
       goto fail;
@@ -377,10 +967,10 @@ hsk_ns_onrecv(
     // TLD '._synth' is being queried on its own, send SOA
     // so recursive asks again with complete synth record.
     if (req->labels == 1) {
-      hsk_resource_to_empty(req->tld, NULL, 0, rrns);
-      hsk_dnssec_sign_zsk(rrns, HSK_DNS_NSEC);
-      hsk_resource_root_to_soa(rrns);
-      hsk_dnssec_sign_zsk(rrns, HSK_DNS_SOA);
+      hsk_resource_to_empty(NULL, req->tld, NULL, 0, rrns);
+      hsk_dnssec_sign_zsk(NULL, rrns, HSK_DNS_NSEC);
+      hsk_resource_root_to_soa(NULL, rrns);
+      hsk_dnssec_sign_zsk(NULL, rrns, HSK_DNS_SOA);
 
       goto finalize;
     }
@@ -413,6 +1003,7 @@ hsk_ns_onrecv(
         // Empty proof:
         if (family == HSK_DNS_A) {
           hsk_resource_to_empty(
+            NULL,
             req->name,
             hsk_type_map_a,
             sizeof(hsk_type_map_a),
@@ -420,15 +1011,16 @@ hsk_ns_onrecv(
           );
         } else {
           hsk_resource_to_empty(
+            NULL,
             req->name,
             hsk_type_map_aaaa,
             sizeof(hsk_type_map_aaaa),
             rrns
           );
         }
-        hsk_dnssec_sign_zsk(rrns, HSK_DNS_NSEC);
-        hsk_resource_root_to_soa(rrns);
-        hsk_dnssec_sign_zsk(rrns, HSK_DNS_SOA);
+        hsk_dnssec_sign_zsk(NULL, rrns, HSK_DNS_NSEC);
+        hsk_resource_root_to_soa(NULL, rrns);
+        hsk_dnssec_sign_zsk(NULL, rrns, HSK_DNS_SOA);
       } else {
         uint16_t rrtype = family;
 
@@ -454,7 +1046,7 @@ hsk_ns_onrecv(
 
         hsk_dns_rrs_push(an, rr);
 
-        hsk_dnssec_sign_zsk(ar, rrtype);
+        hsk_dnssec_sign_zsk(NULL, ar, rrtype);
       }
     }
 
@@ -467,12 +1059,14 @@ finalize:
 
     hsk_ns_log(ns, "sending synthesized msg (%u): %u\n", req->id, wire_len);
 
-    hsk_ns_send(ns, wire, wire_len, addr, true);
+    hsk_ns_reply(ns, req, wire, wire_len);
 
-    goto done;
+    return;
   }
 
   // Requesting a lookup.
+  int slot;
+
   if (req->labels > 0) {
     // Check blacklist.
     if (strcmp(req->tld, "bit") == 0 // Namecoin
@@ -483,19 +1077,20 @@ finalize:
         || strcmp(req->tld, "onion") == 0 // Tor
         || strcmp(req->tld, "tor") == 0 // OnioNS
         || strcmp(req->tld, "zkey") == 0) { // GNS
-      msg = hsk_resource_to_nx();
+      slot = HSK_ZONE_NX;
     } else {
       req->ns = (void *)ns;
 
-      int rc = hsk_pool_resolve(
-        ns->pool,
-        req->tld,
-        after_resolve,
-        (void *)req
-      );
+      hsk_dns_req_t *copy = hsk_dns_req_clone(req);
+
+      if (!copy)
+        goto fail;
+
+      int rc = hsk_ns_resolve(ns, copy);
 
       if (rc != HSK_SUCCESS) {
         hsk_ns_log(ns, "pool resolve error: %s\n", hsk_strerror(rc));
+        hsk_dns_req_free(copy);
         goto fail;
       }
 
@@ -503,60 +1098,37 @@ finalize:
     }
   } else {
     // Querying the root zone.
-    msg = hsk_resource_root(req->type, ns->ip);
+    slot = hsk_zone_root_slot(req->type);
   }
 
-  if (!msg) {
-    hsk_ns_log(ns, "could not create root soa\n");
-    goto fail;
-  }
-
-  if (should_cache)
-    hsk_cache_insert(&ns->cache, req, msg);
-
-  if (!hsk_dns_msg_finalize(&msg, req, ns->ec, ns->key, &wire, &wire_len)) {
+  if (!hsk_ns_zone_reply(ns, req, slot)) {
     hsk_ns_log(ns, "could not reply\n");
     goto fail;
   }
 
-  hsk_ns_send(ns, wire, wire_len, addr, true);
+  hsk_ns_log(ns, "sending root zone msg (%u)\n", req->id);
 
-  goto done;
+  return;
 
 fail:
   assert(!msg);
 
-  msg = hsk_resource_to_servfail();
-
-  if (!msg) {
-    hsk_ns_log(ns, "failed creating servfail\n");
-    goto done;
-  }
-
-  if (!hsk_dns_msg_finalize(&msg, req, ns->ec, ns->key, &wire, &wire_len)) {
-    hsk_ns_log(ns, "could not reply\n");
-    goto done;
-  }
-
-  hsk_ns_log(ns, "sending servfail (%u): %u\n", req->id, wire_len);
-
-  hsk_ns_send(ns, wire, wire_len, addr, true);
-
-done:
-  if (req)
-    hsk_dns_req_free(req);
+  hsk_ns_servfail(ns, req);
 }
 
 static void
 hsk_ns_respond(
   hsk_ns_t *ns,
-  const hsk_dns_req_t *req,
+  const hsk_ns_waiters_t *waiters,
   int status,
   const hsk_resource_t *res
 ) {
+  const hsk_dns_req_t *req = waiters->reqs[0];
   hsk_dns_msg_t *msg = NULL;
-  uint8_t *wire = NULL;
-  size_t wire_len = 0;
+  bool nx = false;
+  hsk_arena_t arena;
+
+  hsk_arena_init(&arena);
 
   if (status != HSK_SUCCESS) {
     // Pool resolve error.
@@ -576,51 +1148,132 @@ hsk_ns_respond(
     //
     // Instead, we give a phony proof, which
     // makes the root zone look empty.
-    msg = hsk_resource_to_nx();
+    msg = hsk_zone_msg(&ns->zone, HSK_ZONE_NX);
+    nx = true;
 
     if (!msg)
       hsk_ns_log(ns, "could not create nx response (%u)\n", req->id);
-    else
-      hsk_ns_log(ns, "sending nxdomain (%u)\n", req->id);
   } else {
     // Exists!
-    msg = hsk_resource_to_dns(res, req->name, req->type);
+    msg = hsk_resource_to_dns(&arena, res, req->name, req->type);
 
     if (!msg)
       hsk_ns_log(ns, "could not create dns response (%u)\n", req->id);
-    else
-      hsk_ns_log(ns, "sending msg (%u)\n", req->id);
   }
 
+  hsk_ns_deliver(ns, waiters, msg, nx);
+
+  // Everything built for the reply goes at once.
+  hsk_arena_uninit(&arena);
+}
+
+// Cache the response and answer every waiter, with
+// SERVFAIL if there is none. Takes ownership of `msg`.
+static void
+hsk_ns_deliver(
+  hsk_ns_t *ns,
+  const hsk_ns_waiters_t *waiters,
+  hsk_dns_msg_t *msg,
+  bool nx
+) {
+  const hsk_dns_req_t *req = waiters->reqs[0];
+  uint8_t *raw = NULL;
+  size_t raw_len = 0;
+
   if (msg) {
     hsk_cache_insert(&ns->cache, req, msg);
 
-    if (!hsk_dns_msg_finalize(&msg, req, ns->ec, ns->key, &wire, &wire_len)) {
-      assert(!msg && !wire);
-      hsk_ns_log(ns, "could not finalize\n");
+    // Every waiter gets its own copy to finalize, since
+    // the ID, question and EDNS options are theirs.
+    if (!nx && waiters->size > 1
+        && !hsk_dns_msg_encode(msg, &raw, &raw_len)) {
+      hsk_ns_log(ns, "could not encode response (%u)\n", req->id);
+      hsk_dns_msg_free(msg);
+      msg = NULL;
     }
   }
 
-  if (!wire) {
-    // Send SERVFAIL in case of error.
-    assert(!msg);
+  for (size_t i = 0; i < waiters->size; i++) {
+    const hsk_dns_req_t *waiter = waiters->reqs[i];
+    hsk_dns_msg_t *copy = NULL;
+    uint8_t *wire = NULL;
+    size_t wire_len = 0;
 
-    msg = hsk_resource_to_servfail();
+    // Hand the entry to each worker which forwarded one.
+    if (msg && waiter->worker) {
+      bool posted = false;
 
-    if (!msg) {
-      hsk_ns_log(ns, "could not create servfail response\n");
-      return;
+      for (size_t j = 0; j < i; j++) {
+        if (waiters->reqs[j]->worker == waiter->worker) {
+          posted = true;
+          break;
+        }
+      }
+
+      if (!posted)
+        hsk_ns_worker_post((hsk_ns_worker_t *)waiter->worker, waiter, msg);
     }
 
-    if (!hsk_dns_msg_finalize(&msg, req, ns->ec, ns->key, &wire, &wire_len)) {
-      hsk_ns_log(ns, "could not create servfail\n");
-      return;
+    // Same for every name, straight from the template.
+    if (msg && nx) {
+      if (hsk_ns_zone_reply(ns, waiter, HSK_ZONE_NX)) {
+        hsk_ns_log(ns, "sending nxdomain (%u)\n", waiter->id);
+        continue;
+      }
+    } else if (msg) {
+      if (i == waiters->size - 1) {
+        copy = msg;
+        msg = NULL;
+      } else if (!hsk_dns_msg_decode(raw, raw_len, &copy)) {
+        copy = NULL;
+      }
+    }
+
+    if (copy) {
+      if (!hsk_ns_finalize(ns, &copy, waiter, &wire, &wire_len)) {
+        assert(!copy && !wire);
+        hsk_ns_log(ns, "could not finalize\n");
+      } else {
+        hsk_ns_log(ns, "sending msg (%u)\n", waiter->id);
+      }
     }
 
-    hsk_ns_log(ns, "sending servfail (%u): %u\n", req->id, wire_len);
+    // Send SERVFAIL in case of error.
+    if (!wire) {
+      hsk_ns_servfail(ns, waiter);
+      continue;
+    }
+
+    hsk_ns_reply(ns, waiter, wire, wire_len);
+  }
+
+  if (msg)
+    hsk_dns_msg_free(msg);
+
+  if (raw)
+    free(raw);
+}
+
+// Answer a query on whichever transport it arrived on.
+static void
+hsk_ns_reply(
+  hsk_ns_t *ns,
+  const hsk_dns_req_t *req,
+  uint8_t *wire,
+  size_t wire_len
+) {
+  if (!req->tcp) {
+    hsk_ns_send(ns, wire, wire_len, req->addr, true);
+    return;
+  }
+
+  if (!ns->tcp) {
+    free(wire);
+    return;
   }
 
-  hsk_ns_send(ns, wire, wire_len, req->addr, true);
+  if (hsk_tcp_send(ns->tcp, req->tcp, wire, wire_len) != HSK_SUCCESS)
+    hsk_ns_log(ns, "tcp connection gone for reply (%u)\n", req->id);
 }
 
 int
@@ -631,58 +1284,20 @@ hsk_ns_send(
   const struct sockaddr *addr,
   bool should_free
 ) {
-  int rc = HSK_SUCCESS;
-  hsk_send_data_t *sd = NULL;
-  uv_udp_send_t *req = NULL;
+  if (ns->batch)
+    return hsk_udp_batch_send(ns->batch, data, data_len, addr, should_free);
 
-  if (!ns->socket) {
-    rc = HSK_EFAILURE;
-    goto fail;
-  }
-
-  sd = (hsk_send_data_t *)malloc(sizeof(hsk_send_data_t));
-
-  if (!sd) {
-    rc = HSK_ENOMEM;
-    goto fail;
-  }
-
-  req = (uv_udp_send_t *)malloc(sizeof(uv_udp_send_t));
-
-  if (!req) {
-    rc = HSK_ENOMEM;
-    goto fail;
-  }
-
-  sd->ns = ns;
-  sd->data = (void *)data;
-  sd->should_free = should_free;
-
-  req->data = (void *)sd;
-
-  uv_buf_t bufs[] = {
-    { .base = (char *)data, .len = data_len }
-  };
-
-  int status = uv_udp_send(req, ns->socket, bufs, 1, addr, after_send);
-
-  if (status != 0) {
-    hsk_ns_log(ns, "failed sending: %s\n", uv_strerror(status));
-    rc = HSK_EFAILURE;
-    goto fail;
+  if (!ns->socket || !ns->sends) {
+    if (data && should_free)
+      free(data);
+    return HSK_EFAILURE;
   }
 
-  return rc;
-
-fail:
-  if (sd)
-    free(sd);
-
-  if (req)
-    free(req);
+  int rc = hsk_sendpool_send(ns->sends, ns->socket, data, data_len, addr,
+                             should_free);
 
-  if (data && should_free)
-    free(data);
+  if (rc != HSK_SUCCESS)
+    hsk_ns_log(ns, "failed sending: %s\n", hsk_strerror(rc));
 
   return rc;
 }
@@ -705,26 +1320,6 @@ alloc_buffer(uv_handle_t *handle, size_t size, uv_buf_t *buf) {
   buf->len = sizeof(ns->read_buffer);
 }
 
-static void
-after_send(uv_udp_send_t *req, int status) {
-  hsk_send_data_t *sd = (hsk_send_data_t *)req->data;
-  hsk_ns_t *ns = sd->ns;
-
-  if (sd->data && sd->should_free)
-    free(sd->data);
-
-  free(sd);
-  free(req);
-
-  if (!ns)
-    return;
-
-  if (status != 0) {
-    hsk_ns_log(ns, "send error: %s\n", uv_strerror(status));
-    return;
-  }
-}
-
 static void
 after_recv(
   uv_udp_t *socket,
@@ -757,10 +1352,126 @@ after_recv(
     (uint8_t *)buf->base,
     (size_t)nread,
     (struct sockaddr *)addr,
-    (uint32_t)flags
+    NULL,
+    0
   );
 }
 
+static void
+after_batch_recv(
+  void *data,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+) {
+  hsk_ns_onrecv((hsk_ns_t *)data, buf, len, addr, NULL, 0);
+}
+
+static void
+after_tcp_recv(
+  void *data,
+  int conn,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+) {
+  hsk_ns_onrecv((hsk_ns_t *)data, buf, len, addr, NULL, conn);
+}
+
+// Handle a query a worker thread could not answer from its cache.
+void
+hsk_ns_forward(
+  hsk_ns_t *ns,
+  const uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr,
+  void *worker
+) {
+  hsk_ns_onrecv(ns, data, data_len, addr, worker, 0);
+}
+
+// Sign the response on the threadpool once the nonce pool
+// runs low and every signature means a point multiplication.
+// On success the job owns the waiters (or request) and `owned`.
+static bool
+hsk_ns_build(
+  hsk_ns_t *ns,
+  hsk_ns_waiters_t *waiters,
+  hsk_dns_req_t *req,
+  const hsk_resource_t *res,
+  hsk_resource_t *owned
+) {
+  if (!ns->sign)
+    return false;
+
+  if (hsk_ecc_nonces() >= HSK_NS_SIGN_INLINE) {
+    ns->sign->inlined += 1;
+    return false;
+  }
+
+  const hsk_dns_req_t *first = waiters ? waiters->reqs[0] : req;
+  hsk_ns_build_t *build = malloc(sizeof(hsk_ns_build_t));
+
+  if (!build)
+    return false;
+
+  build->ns = ns;
+  build->waiters = waiters;
+  build->req = req;
+  build->res = res;
+  build->owned = owned;
+  strcpy(build->name, first->name);
+  build->type = first->type;
+  build->msg = NULL;
+
+  hsk_arena_init(&build->arena);
+
+  if (!hsk_work_queue(ns->sign, on_build, after_build, build)) {
+    ns->sign->inlined += 1;
+    free(build);
+    return false;
+  }
+
+  return true;
+}
+
+// Decode a proven resource, falling back
+// to the ICANN root zone for unclaimed names.
+// Only a decoded proof is `owned` by the caller;
+// ICANN resources are shared.
+static int
+hsk_ns_decode(
+  hsk_ns_t *ns,
+  const char *name,
+  int status,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len,
+  const hsk_resource_t **res,
+  hsk_resource_t **owned
+) {
+  *res = NULL;
+  *owned = NULL;
+
+  if (status != HSK_SUCCESS)
+    return status;
+
+  if (!exists || data_len == 0) {
+    *res = hsk_icann_resource(name);
+    return HSK_SUCCESS;
+  }
+
+  if (!hsk_resource_decode(data, data_len, owned)) {
+    hsk_ns_log(ns, "could not decode resource for: %s\n", name);
+    *owned = NULL;
+    return HSK_EFAILURE;
+  }
+
+  *res = *owned;
+
+  return HSK_SUCCESS;
+}
+
 static void
 after_resolve(
   const char *name,
@@ -769,69 +1480,169 @@ after_resolve(
   const uint8_t *data,
   size_t data_len,
   const void *arg
+) {
+  hsk_ns_waiters_t *waiters = (hsk_ns_waiters_t *)arg;
+  hsk_ns_t *ns = waiters->ns;
+  const hsk_resource_t *res;
+  hsk_resource_t *owned;
+
+  if (waiters->keyed) {
+    hsk_map_del(&ns->inflight, &waiters->key);
+    waiters->keyed = false;
+  }
+
+  status = hsk_ns_decode(ns, name, status, exists, data, data_len,
+                         &res, &owned);
+
+  if (res && hsk_ns_build(ns, waiters, NULL, res, owned))
+    return;
+
+  hsk_ns_respond(ns, waiters, status, res);
+
+  if (owned)
+    hsk_resource_free(owned);
+
+  hsk_ns_waiters_free(waiters);
+}
+
+static void
+after_refresh(
+  const char *name,
+  int status,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len,
+  const void *arg
 ) {
   hsk_dns_req_t *req = (hsk_dns_req_t *)arg;
   hsk_ns_t *ns = (hsk_ns_t *)req->ns;
-  hsk_resource_t *res = NULL;
+  const hsk_resource_t *res;
+  hsk_resource_t *owned;
+  hsk_dns_msg_t *msg = NULL;
+  hsk_arena_t arena;
 
-  if (status == HSK_SUCCESS) {
-    if (!exists || data_len == 0) {
-      const uint8_t *item = hsk_icann_lookup(name);
+  hsk_arena_init(&arena);
 
-      if (item) {
-        const uint8_t *raw = &item[2];
-        size_t raw_len = (((size_t)item[1]) << 8) | ((size_t)item[0]);
+  status = hsk_ns_decode(ns, name, status, exists, data, data_len,
+                         &res, &owned);
 
-        if (!hsk_resource_decode(raw, raw_len, &res)) {
-          hsk_ns_log(ns, "could not decode root resource for: %s\n", name);
-          status = HSK_EFAILURE;
-          res = NULL;
-        }
-      }
-    } else {
-      if (!hsk_resource_decode(data, data_len, &res)) {
-        hsk_ns_log(ns, "could not decode resource for: %s\n", name);
-        status = HSK_EFAILURE;
-        res = NULL;
-      }
-    }
+  if (status != HSK_SUCCESS) {
+    hsk_ns_log(ns, "refresh error for %s: %s\n", req->name,
+               hsk_strerror(status));
+    goto done;
   }
 
-  hsk_ns_respond(ns, req, status, res);
+  if (res && hsk_ns_build(ns, NULL, req, res, owned))
+    return;
 
   if (res)
-    hsk_resource_free(res);
+    msg = hsk_resource_to_dns(&arena, res, req->name, req->type);
+  else
+    msg = hsk_zone_msg(&ns->zone, HSK_ZONE_NX);
+
+  if (!msg) {
+    hsk_ns_log(ns, "could not create refreshed response for: %s\n",
+               req->name);
+    goto done;
+  }
+
+  hsk_ns_cache_insert(ns, req, msg);
+  hsk_dns_msg_free(msg);
+
+done:
+  hsk_arena_uninit(&arena);
+
+  if (owned)
+    hsk_resource_free(owned);
 
   hsk_dns_req_free(req);
 }
 
-static int
-hsk_tld_index(const char *name) {
-  int start = 0;
-  int end = HSK_TLD_SIZE - 1;
-
-  while (start <= end) {
-    int pos = (start + end) >> 1;
-    int cmp = strcasecmp(HSK_TLD_NAMES[pos], name);
+static void
+on_build(void *arg) {
+  hsk_ns_build_t *build = (hsk_ns_build_t *)arg;
+  build->msg = hsk_resource_to_dns(&build->arena, build->res,
+                                   build->name, build->type);
+}
 
-    if (cmp == 0)
-      return pos;
+static void
+after_build(void *arg, bool cancelled) {
+  hsk_ns_build_t *build = (hsk_ns_build_t *)arg;
+  hsk_ns_t *ns = build->ns;
+  hsk_dns_msg_t *msg = build->msg;
+
+  if (cancelled) {
+    if (msg)
+      hsk_dns_msg_free(msg);
+  } else if (build->waiters) {
+    if (!msg)
+      hsk_ns_log(ns, "could not create dns response (%u)\n",
+                 build->waiters->reqs[0]->id);
 
-    if (cmp < 0)
-      start = pos + 1;
-    else
-      end = pos - 1;
+    hsk_ns_deliver(ns, build->waiters, msg, false);
+  } else if (msg) {
+    hsk_ns_cache_insert(ns, build->req, msg);
+    hsk_dns_msg_free(msg);
+  } else {
+    hsk_ns_log(ns, "could not create refreshed response for: %s\n",
+               build->name);
   }
 
-  return -1;
+  if (build->waiters)
+    hsk_ns_waiters_free(build->waiters);
+
+  if (build->req)
+    hsk_dns_req_free(build->req);
+
+  if (build->owned)
+    hsk_resource_free(build->owned);
+
+  hsk_arena_uninit(&build->arena);
+
+  free(build);
 }
 
-static const uint8_t *
-hsk_icann_lookup(const char *name) {
-  int index = hsk_tld_index(name);
+static void
+after_resign(uv_timer_t *timer) {
+  hsk_ns_t *ns = (hsk_ns_t *)timer->data;
 
-  if (index == -1)
-    return NULL;
+  if (!hsk_zone_sign(&ns->zone, ns->ip))
+    hsk_ns_log(ns, "could not re-sign root zone\n");
+}
+
+// The nonce pool is shared by the whole process, and so is
+// its refill: at most one is queued at a time, and it holds
+// no reference to the server.
+static bool hsk_ns_refilling = false;
+
+static void
+refill_work(uv_work_t *req) {
+  hsk_ecc_nonces_fill(HSK_ECC_NONCES);
+}
+
+static void
+after_refill(uv_work_t *req, int status) {
+  hsk_ns_refilling = false;
+  free(req);
+}
+
+static void
+after_loop(uv_check_t *check) {
+  if (hsk_ns_refilling)
+    return;
+
+  if (hsk_ecc_nonces() > HSK_ECC_NONCES / 2)
+    return;
+
+  uv_work_t *req = malloc(sizeof(uv_work_t));
+
+  if (!req)
+    return;
+
+  if (uv_queue_work(check->loop, req, refill_work, after_refill) != 0) {
+    free(req);
+    return;
+  }
 
-  return (const uint8_t *)HSK_TLD_DATA[index];
+  hsk_ns_refilling = true;
 }
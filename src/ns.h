@@ -8,31 +8,55 @@
 
 #include "cache.h"
 #include "ec.h"
+#include "map.h"
 #include "pool.h"
+#include "rrl.h"
+#include "sendpool.h"
+#include "tcp.h"
+#include "udp_batch.h"
+#include "work.h"
+#include "zone.h"
 
 /*
  * Defs
  */
 
 #define HSK_UDP_BUFFER 4096
+// Responses are signed on the loop while this many nonces are ready.
+#define HSK_NS_SIGN_INLINE 4
 
 /*
  * Types
  */
 
+struct hsk_ns_workers_s;
+
 typedef struct {
   uv_loop_t *loop;
   hsk_pool_t *pool;
   hsk_addr_t ip_;
   hsk_addr_t *ip;
   uv_udp_t *socket;
+  hsk_udp_batch_t *batch;
+  hsk_sendpool_t *sends;
+  hsk_tcp_t *tcp;
   hsk_ec_t *ec;
   hsk_cache_t cache;
+  // Resolutions in flight, keyed like the cache.
+  hsk_map_t inflight;
+  uint64_t coalesced;
+  hsk_rrl_t rrl;
+  hsk_zone_t zone;
+  uv_timer_t *resign;
+  uv_check_t *refill;
+  hsk_work_t *sign;
   uint8_t key_[32];
   uint8_t *key;
   uint8_t pubkey[33];
   uint8_t read_buffer[HSK_UDP_BUFFER];
   bool receiving;
+  int worker_count;
+  struct hsk_ns_workers_s *workers;
 } hsk_ns_t;
 
 /*
@@ -51,6 +75,9 @@ hsk_ns_set_ip(hsk_ns_t *ns, const struct sockaddr *addr);
 bool
 hsk_ns_set_key(hsk_ns_t *ns, const uint8_t *key);
 
+bool
+hsk_ns_set_workers(hsk_ns_t *ns, int count);
+
 int
 hsk_ns_open(hsk_ns_t *ns, const struct sockaddr *addr);
 
@@ -65,4 +92,32 @@ hsk_ns_free(hsk_ns_t *ns);
 
 int
 hsk_ns_destroy(hsk_ns_t *ns);
+
+bool
+hsk_ns_cached(
+  hsk_cache_t *cache,
+  const hsk_ec_t *ec,
+  const uint8_t *key,
+  const hsk_dns_req_t *req,
+  const uint8_t *query,
+  size_t query_len,
+  uint8_t **wire,
+  size_t *wire_len
+);
+
+bool
+hsk_ns_truncated(
+  const hsk_dns_req_t *req,
+  uint8_t **wire,
+  size_t *wire_len
+);
+
+void
+hsk_ns_forward(
+  hsk_ns_t *ns,
+  const uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr,
+  void *worker
+);
 #endif
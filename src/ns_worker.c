@@ -0,0 +1,693 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "cache.h"
+#include "dns.h"
+#include "ec.h"
+#include "error.h"
+#include "ns.h"
+#include "ns_worker.h"
+#include "platform-net.h"
+#include "req.h"
+#include "rrl.h"
+#include "sendpool.h"
+#include "udp_batch.h"
+#include "utils.h"
+#include "uv.h"
+
+/*
+ * Prototypes
+ */
+
+static void
+hsk_ns_worker_log(hsk_ns_worker_t *worker, const char *fmt, ...);
+
+static void
+run_ns_worker(void *arg);
+
+static void
+after_forward_async(uv_async_t *async);
+
+static void
+after_worker_async(uv_async_t *async);
+
+static void
+alloc_worker_buffer(uv_handle_t *handle, size_t size, uv_buf_t *buf);
+
+static void
+after_worker_recv(
+  uv_udp_t *socket,
+  ssize_t nread,
+  const uv_buf_t *buf,
+  const struct sockaddr *addr,
+  unsigned flags
+);
+
+static void
+after_worker_batch_recv(
+  void *data,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+);
+
+/*
+ * Job Queue
+ */
+
+static int
+hsk_ns_queue_init(hsk_ns_queue_t *queue) {
+  if (uv_mutex_init(&queue->mutex))
+    return HSK_EFAILURE;
+  queue->head = NULL;
+  queue->tail = NULL;
+  queue->closed = false;
+  return HSK_SUCCESS;
+}
+
+static void
+hsk_ns_job_free(hsk_ns_job_t *job) {
+  if (job->data)
+    free(job->data);
+
+  if (job->req)
+    hsk_dns_req_free(job->req);
+
+  free(job);
+}
+
+static void
+hsk_ns_queue_uninit(hsk_ns_queue_t *queue) {
+  hsk_ns_job_t *job, *next;
+
+  for (job = queue->head; job; job = next) {
+    next = job->next;
+    hsk_ns_job_free(job);
+  }
+
+  queue->head = NULL;
+  queue->tail = NULL;
+
+  uv_mutex_destroy(&queue->mutex);
+}
+
+// Enqueue a job - thread-safe.  Fails once the queue is closed, in which case
+// the caller still owns the job.
+static bool
+hsk_ns_queue_push(hsk_ns_queue_t *queue, hsk_ns_job_t *job) {
+  uv_mutex_lock(&queue->mutex);
+
+  if (queue->closed) {
+    uv_mutex_unlock(&queue->mutex);
+    return false;
+  }
+
+  job->next = NULL;
+
+  if (!queue->tail) {
+    queue->head = job;
+    queue->tail = job;
+  } else {
+    queue->tail->next = job;
+    queue->tail = job;
+  }
+
+  uv_mutex_unlock(&queue->mutex);
+
+  return true;
+}
+
+// Take every queued job at once - thread-safe.
+static hsk_ns_job_t *
+hsk_ns_queue_take(hsk_ns_queue_t *queue, bool *closed) {
+  uv_mutex_lock(&queue->mutex);
+
+  hsk_ns_job_t *head = queue->head;
+
+  queue->head = NULL;
+  queue->tail = NULL;
+
+  if (closed)
+    *closed = queue->closed;
+
+  uv_mutex_unlock(&queue->mutex);
+
+  return head;
+}
+
+static void
+hsk_ns_queue_close(hsk_ns_queue_t *queue) {
+  uv_mutex_lock(&queue->mutex);
+  queue->closed = true;
+  uv_mutex_unlock(&queue->mutex);
+}
+
+/*
+ * Sockets
+ */
+
+// Bind a UDP handle, optionally sharing the address
+// with other sockets so the kernel spreads queries.
+int
+hsk_ns_bind(uv_udp_t *handle, const struct sockaddr *addr, bool reuseport) {
+  if (!reuseport) {
+    if (uv_udp_bind(handle, addr, 0) != 0)
+      return HSK_EFAILURE;
+    return HSK_SUCCESS;
+  }
+
+#if !defined(_WIN32) && defined(SO_REUSEPORT)
+  int fd = socket(addr->sa_family, SOCK_DGRAM, 0);
+
+  if (fd == -1)
+    return HSK_EFAILURE;
+
+  int on = 1;
+
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0) {
+    close(fd);
+    return HSK_EFAILURE;
+  }
+
+  socklen_t len = addr->sa_family == AF_INET6
+    ? sizeof(struct sockaddr_in6)
+    : sizeof(struct sockaddr_in);
+
+  if (bind(fd, addr, len) != 0) {
+    close(fd);
+    return HSK_EFAILURE;
+  }
+
+  if (uv_udp_open(handle, fd) != 0) {
+    close(fd);
+    return HSK_EFAILURE;
+  }
+
+  return HSK_SUCCESS;
+#else
+  return HSK_EFAILURE;
+#endif
+}
+
+/*
+ * Worker Threads
+ */
+
+int
+hsk_ns_workers_init(hsk_ns_workers_t *ws, hsk_ns_t *ns, int count) {
+  if (!ws || !ns || count <= 0 || count > HSK_NS_WORKERS_MAX)
+    return HSK_EBADARGS;
+
+  ws->ns = ns;
+  ws->async = NULL;
+  ws->workers = NULL;
+  ws->count = 0;
+
+  if (hsk_ns_queue_init(&ws->queue) != HSK_SUCCESS)
+    return HSK_EFAILURE;
+
+  ws->workers = calloc(count, sizeof(hsk_ns_worker_t));
+
+  if (!ws->workers) {
+    hsk_ns_queue_uninit(&ws->queue);
+    return HSK_ENOMEM;
+  }
+
+  for (int i = 0; i < count; i++) {
+    hsk_ns_worker_t *w = &ws->workers[i];
+
+    w->workers = ws;
+    w->ec = hsk_ec_alloc();
+    w->sends = NULL;
+    w->batch = NULL;
+    w->running = false;
+
+    if (!w->ec || hsk_ns_queue_init(&w->inbox) != HSK_SUCCESS) {
+      if (w->ec)
+        hsk_ec_free(w->ec);
+      hsk_ns_workers_uninit(ws);
+      return HSK_ENOMEM;
+    }
+
+    hsk_cache_init(&w->cache);
+    hsk_rrl_init(&w->rrl);
+
+    ws->count += 1;
+  }
+
+  return HSK_SUCCESS;
+}
+
+void
+hsk_ns_workers_uninit(hsk_ns_workers_t *ws) {
+  if (!ws)
+    return;
+
+  for (int i = 0; i < ws->count; i++) {
+    hsk_ns_worker_t *w = &ws->workers[i];
+
+    // Can't destroy while the thread is still running.
+    assert(!w->running);
+
+    if (w->batch)
+      hsk_udp_batch_free(w->batch);
+
+    hsk_rrl_uninit(&w->rrl);
+    hsk_cache_uninit(&w->cache);
+    hsk_ns_queue_uninit(&w->inbox);
+    hsk_ec_free(w->ec);
+  }
+
+  if (ws->workers) {
+    free(ws->workers);
+    ws->workers = NULL;
+  }
+
+  ws->count = 0;
+
+  hsk_ns_queue_uninit(&ws->queue);
+}
+
+hsk_ns_workers_t *
+hsk_ns_workers_alloc(hsk_ns_t *ns, int count) {
+  hsk_ns_workers_t *ws = malloc(sizeof(hsk_ns_workers_t));
+
+  if (!ws)
+    return NULL;
+
+  if (hsk_ns_workers_init(ws, ns, count) != HSK_SUCCESS) {
+    free(ws);
+    return NULL;
+  }
+
+  return ws;
+}
+
+void
+hsk_ns_workers_free(hsk_ns_workers_t *ws) {
+  if (ws) {
+    hsk_ns_workers_uninit(ws);
+    free(ws);
+  }
+}
+
+static void
+close_walk_cb(uv_handle_t *handle, void *arg) {
+  if (!uv_is_closing(handle))
+    uv_close(handle, NULL);
+}
+
+// Tear down a worker loop which is not (or no longer) running on its thread.
+static void
+hsk_ns_worker_close_loop(hsk_ns_worker_t *w) {
+  hsk_udp_batch_close(w->batch);
+  uv_walk(&w->loop, close_walk_cb, NULL);
+  uv_run(&w->loop, UV_RUN_DEFAULT);
+  uv_loop_close(&w->loop);
+
+  // Cancelled sends have all come back by now.
+  hsk_sendpool_release(w->sends);
+  w->sends = NULL;
+}
+
+static int
+hsk_ns_worker_open(hsk_ns_worker_t *w, const struct sockaddr *addr) {
+  hsk_ns_t *ns = w->workers->ns;
+
+  // Same limits as the main cache, each.
+  hsk_cache_set_limit(&w->cache, ns->cache.max_items, ns->cache.max_size);
+  hsk_cache_set_ttl(&w->cache, ns->cache.min_ttl, ns->cache.max_ttl);
+  hsk_cache_set_stale(&w->cache, ns->cache.max_stale);
+
+  // Proofs are only requested by the main loop, which charges them.
+  hsk_rrl_set_rate(&w->rrl, ns->rrl.rate, 0);
+
+  if (uv_loop_init(&w->loop) != 0)
+    return HSK_EFAILURE;
+
+  if (uv_async_init(&w->loop, &w->async, after_worker_async) != 0) {
+    uv_loop_close(&w->loop);
+    return HSK_EFAILURE;
+  }
+
+  w->async.data = (void *)w;
+
+  if (hsk_udp_batch_supported()) {
+    w->batch = hsk_udp_batch_alloc(&w->loop, after_worker_batch_recv,
+                                   (void *)w);
+
+    if (!w->batch
+        || hsk_udp_batch_open(w->batch, addr, true) != HSK_SUCCESS) {
+      hsk_ns_worker_log(w, "failed binding worker socket\n");
+      hsk_ns_worker_close_loop(w);
+      return HSK_EFAILURE;
+    }
+  } else {
+    if (uv_udp_init(&w->loop, &w->socket) != 0) {
+      hsk_ns_worker_close_loop(w);
+      return HSK_EFAILURE;
+    }
+
+    w->socket.data = (void *)w;
+    w->sends = hsk_sendpool_alloc();
+
+    if (!w->sends || hsk_ns_bind(&w->socket, addr, true) != HSK_SUCCESS) {
+      hsk_ns_worker_log(w, "failed binding worker socket\n");
+      hsk_ns_worker_close_loop(w);
+      return HSK_EFAILURE;
+    }
+
+    int value = sizeof(w->read_buffer);
+
+    if (uv_send_buffer_size((uv_handle_t *)&w->socket, &value) != 0
+        || uv_recv_buffer_size((uv_handle_t *)&w->socket, &value) != 0
+        || uv_udp_recv_start(&w->socket, alloc_worker_buffer,
+                             after_worker_recv) != 0) {
+      hsk_ns_worker_close_loop(w);
+      return HSK_EFAILURE;
+    }
+  }
+
+  // The loop belongs to the worker thread from here on.
+  w->running = true;
+
+  if (uv_thread_create(&w->thread, run_ns_worker, (void *)w) != 0) {
+    hsk_ns_worker_log(w, "failed to create worker thread\n");
+    w->running = false;
+    hsk_ns_worker_close_loop(w);
+    return HSK_EFAILURE;
+  }
+
+  return HSK_SUCCESS;
+}
+
+int
+hsk_ns_workers_open(hsk_ns_workers_t *ws, const struct sockaddr *addr) {
+  hsk_ns_t *ns = ws->ns;
+
+  ws->async = malloc(sizeof(uv_async_t));
+
+  if (!ws->async)
+    return HSK_ENOMEM;
+
+  if (uv_async_init(ns->loop, ws->async, after_forward_async) != 0) {
+    free(ws->async);
+    ws->async = NULL;
+    return HSK_EFAILURE;
+  }
+
+  ws->async->data = (void *)ws;
+
+  for (int i = 0; i < ws->count; i++) {
+    int rc = hsk_ns_worker_open(&ws->workers[i], addr);
+
+    if (rc != HSK_SUCCESS)
+      return rc;
+  }
+
+  return HSK_SUCCESS;
+}
+
+void
+hsk_ns_workers_close(hsk_ns_workers_t *ws) {
+  for (int i = 0; i < ws->count; i++) {
+    hsk_ns_worker_t *w = &ws->workers[i];
+
+    hsk_ns_queue_close(&w->inbox);
+
+    if (!w->running)
+      continue;
+
+    uv_async_send(&w->async);
+    uv_thread_join(&w->thread);
+    w->running = false;
+
+    hsk_ns_worker_close_loop(w);
+  }
+
+  hsk_ns_queue_close(&ws->queue);
+
+  if (ws->async) {
+    ws->async->data = NULL;
+    hsk_uv_close_free((uv_handle_t *)ws->async);
+    ws->async = NULL;
+  }
+}
+
+// Hand a response cached by the main loop to the
+// worker which forwarded the query - main loop only.
+void
+hsk_ns_worker_post(
+  hsk_ns_worker_t *worker,
+  const hsk_dns_req_t *req,
+  const hsk_dns_msg_t *msg
+) {
+  hsk_ns_job_t *job = calloc(1, sizeof(hsk_ns_job_t));
+
+  if (!job)
+    return;
+
+  job->worker = worker;
+  job->req = hsk_dns_req_alloc();
+
+  if (!job->req || !hsk_dns_msg_encode(msg, &job->data, &job->data_len)) {
+    hsk_ns_job_free(job);
+    return;
+  }
+
+  memcpy(job->req, req, sizeof(hsk_dns_req_t));
+  job->req->addr = (struct sockaddr *)&job->req->ss;
+  job->req->ns = NULL;
+  job->req->worker = NULL;
+
+  if (!hsk_ns_queue_push(&worker->inbox, job)) {
+    hsk_ns_job_free(job);
+    return;
+  }
+
+  uv_async_send(&worker->async);
+}
+
+/*
+ * Worker Thread
+ */
+
+static void
+hsk_ns_worker_log(hsk_ns_worker_t *worker, const char *fmt, ...) {
+  printf("ns worker: ");
+
+  va_list args;
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+}
+
+static void
+run_ns_worker(void *arg) {
+  hsk_ns_worker_t *w = (hsk_ns_worker_t *)arg;
+  uv_run(&w->loop, UV_RUN_DEFAULT);
+}
+
+static void
+hsk_ns_worker_send(
+  hsk_ns_worker_t *w,
+  uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr
+) {
+  if (w->batch) {
+    hsk_udp_batch_send(w->batch, data, data_len, addr, true);
+    return;
+  }
+
+  int rc = hsk_sendpool_send(w->sends, &w->socket, data, data_len, addr,
+                             true);
+
+  if (rc != HSK_SUCCESS)
+    hsk_ns_worker_log(w, "failed sending: %s\n", hsk_strerror(rc));
+}
+
+static void
+hsk_ns_worker_forward(
+  hsk_ns_worker_t *w,
+  const uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr
+) {
+  hsk_ns_workers_t *ws = w->workers;
+  hsk_ns_job_t *job = calloc(1, sizeof(hsk_ns_job_t));
+
+  if (!job)
+    return;
+
+  job->worker = w;
+  job->data = malloc(data_len);
+
+  if (!job->data) {
+    free(job);
+    return;
+  }
+
+  memcpy(job->data, data, data_len);
+  job->data_len = data_len;
+
+  if (addr->sa_family == AF_INET6)
+    memcpy(&job->ss, addr, sizeof(struct sockaddr_in6));
+  else
+    memcpy(&job->ss, addr, sizeof(struct sockaddr_in));
+
+  if (!hsk_ns_queue_push(&ws->queue, job)) {
+    hsk_ns_job_free(job);
+    return;
+  }
+
+  uv_async_send(ws->async);
+}
+
+static void
+hsk_ns_worker_onrecv(
+  hsk_ns_worker_t *w,
+  const uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr
+) {
+  hsk_ns_t *ns = w->workers->ns;
+  hsk_dns_req_t req;
+
+  if (!hsk_dns_req_parse(&req, data, data_len, addr)) {
+    hsk_ns_worker_log(w, "failed processing dns request\n");
+    return;
+  }
+
+  uint8_t *wire = NULL;
+  size_t wire_len = 0;
+
+  switch (hsk_rrl_check(&w->rrl, addr, uv_now(&w->loop))) {
+    case HSK_RRL_DROP:
+      return;
+    case HSK_RRL_TRUNCATE:
+      if (hsk_ns_truncated(&req, &wire, &wire_len))
+        hsk_ns_worker_send(w, wire, wire_len, addr);
+      return;
+  }
+
+  if (hsk_ns_cached(&w->cache, w->ec, ns->key, &req,
+                    data, data_len, &wire, &wire_len)) {
+    hsk_ns_worker_send(w, wire, wire_len, addr);
+    return;
+  }
+
+  hsk_ns_worker_forward(w, data, data_len, addr);
+}
+
+/*
+ * UV behavior
+ */
+
+static void
+after_forward_async(uv_async_t *async) {
+  hsk_ns_workers_t *ws = (hsk_ns_workers_t *)async->data;
+
+  if (!ws)
+    return;
+
+  hsk_ns_job_t *job = hsk_ns_queue_take(&ws->queue, NULL);
+  hsk_ns_job_t *next;
+
+  for (; job; job = next) {
+    next = job->next;
+
+    hsk_ns_forward(ws->ns,
+                   job->data,
+                   job->data_len,
+                   (struct sockaddr *)&job->ss,
+                   (void *)job->worker);
+
+    hsk_ns_job_free(job);
+  }
+}
+
+static void
+after_worker_async(uv_async_t *async) {
+  hsk_ns_worker_t *w = (hsk_ns_worker_t *)async->data;
+  bool closed = false;
+
+  hsk_ns_job_t *job = hsk_ns_queue_take(&w->inbox, &closed);
+  hsk_ns_job_t *next;
+
+  for (; job; job = next) {
+    next = job->next;
+
+    hsk_dns_msg_t *msg = NULL;
+
+    if (hsk_dns_msg_decode(job->data, job->data_len, &msg)) {
+      hsk_cache_insert(&w->cache, job->req, msg);
+      hsk_dns_msg_free(msg);
+    }
+
+    hsk_ns_job_free(job);
+  }
+
+  if (closed) {
+    // Closing every handle lets uv_run() return on the worker thread.
+    if (w->batch) {
+      hsk_udp_batch_close(w->batch);
+    } else {
+      uv_udp_recv_stop(&w->socket);
+      uv_close((uv_handle_t *)&w->socket, NULL);
+    }
+
+    uv_close((uv_handle_t *)&w->async, NULL);
+  }
+}
+
+static void
+alloc_worker_buffer(uv_handle_t *handle, size_t size, uv_buf_t *buf) {
+  hsk_ns_worker_t *w = (hsk_ns_worker_t *)handle->data;
+
+  buf->base = (char *)w->read_buffer;
+  buf->len = sizeof(w->read_buffer);
+}
+
+static void
+after_worker_recv(
+  uv_udp_t *socket,
+  ssize_t nread,
+  const uv_buf_t *buf,
+  const struct sockaddr *addr,
+  unsigned flags
+) {
+  hsk_ns_worker_t *w = (hsk_ns_worker_t *)socket->data;
+
+  if (nread < 0) {
+    hsk_ns_worker_log(w, "udp read error: %s\n", uv_strerror(nread));
+    return;
+  }
+
+  if (nread == 0 || addr == NULL)
+    return;
+
+  hsk_ns_worker_onrecv(w, (uint8_t *)buf->base, (size_t)nread, addr);
+}
+
+static void
+after_worker_batch_recv(
+  void *data,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+) {
+  hsk_ns_worker_onrecv((hsk_ns_worker_t *)data, buf, len, addr);
+}
@@ -0,0 +1,117 @@
+#ifndef _HSK_NS_WORKER_
+#define _HSK_NS_WORKER_
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uv.h"
+
+#include "cache.h"
+#include "dns.h"
+#include "ec.h"
+#include "ns.h"
+#include "req.h"
+#include "rrl.h"
+#include "sendpool.h"
+#include "udp_batch.h"
+
+/*
+ * Defs
+ */
+
+#define HSK_NS_WORKERS_MAX 64
+
+/*
+ * Types
+ */
+
+struct hsk_ns_worker_s;
+
+// A query forwarded to the main loop, or a
+// response posted back to a worker's cache.
+typedef struct hsk_ns_job_s {
+  struct hsk_ns_worker_s *worker;
+  struct sockaddr_storage ss;
+  uint8_t *data;
+  size_t data_len;
+  hsk_dns_req_t *req;
+  struct hsk_ns_job_s *next;
+} hsk_ns_job_t;
+
+// Thread-safe job queue - synchronized with a mutex.
+typedef struct {
+  uv_mutex_t mutex;
+  hsk_ns_job_t *head;
+  hsk_ns_job_t *tail;
+  bool closed;
+} hsk_ns_queue_t;
+
+// Serving thread with its own loop, socket and cache.  Answers cache hits on
+// its own and forwards everything else to the main loop.
+typedef struct hsk_ns_worker_s {
+  struct hsk_ns_workers_s *workers;
+  uv_loop_t loop;
+  uv_thread_t thread;
+  uv_udp_t socket;
+  hsk_sendpool_t *sends;
+  hsk_udp_batch_t *batch;
+  // Async used to signal cache results (and shutdown) to the worker.
+  uv_async_t async;
+  hsk_ns_queue_t inbox;
+  hsk_ec_t *ec;
+  hsk_cache_t cache;
+  // Response limits for this socket's share of the traffic.
+  hsk_rrl_t rrl;
+  uint8_t read_buffer[HSK_UDP_BUFFER];
+  bool running;
+} hsk_ns_worker_t;
+
+typedef struct hsk_ns_workers_s {
+  hsk_ns_t *ns;
+  // Async used to signal forwarded queries to the main loop.
+  uv_async_t *async;
+  hsk_ns_queue_t queue;
+  hsk_ns_worker_t *workers;
+  int count;
+} hsk_ns_workers_t;
+
+/*
+ * Worker Threads
+ *
+ * Queries are spread over the main socket and one socket per worker by the
+ * kernel (SO_REUSEPORT).  Workers answer from their own response cache.
+ * Misses go through the main loop's queue, since only the main loop may
+ * touch the pool.  Responses the main loop caches are posted back to the
+ * worker that forwarded the query.
+ */
+
+int
+hsk_ns_workers_init(hsk_ns_workers_t *ws, hsk_ns_t *ns, int count);
+
+void
+hsk_ns_workers_uninit(hsk_ns_workers_t *ws);
+
+hsk_ns_workers_t *
+hsk_ns_workers_alloc(hsk_ns_t *ns, int count);
+
+void
+hsk_ns_workers_free(hsk_ns_workers_t *ws);
+
+int
+hsk_ns_workers_open(hsk_ns_workers_t *ws, const struct sockaddr *addr);
+
+void
+hsk_ns_workers_close(hsk_ns_workers_t *ws);
+
+void
+hsk_ns_worker_post(
+  hsk_ns_worker_t *worker,
+  const hsk_dns_req_t *req,
+  const hsk_dns_msg_t *msg
+);
+
+int
+hsk_ns_bind(uv_udp_t *socket, const struct sockaddr *addr, bool reuseport);
+
+#endif
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -23,12 +24,14 @@
 #include "header.h"
 #include "map.h"
 #include "msg.h"
+#include "namecache.h"
 #include "proof.h"
 #include "resource.h"
 #include "timedata.h"
 #include "pool.h"
 #include "utils.h"
 #include "uv.h"
+#include "work.h"
 
 #ifdef HSK_DEBUG_LOG
 #define hsk_pool_debug hsk_pool_log
@@ -48,6 +51,21 @@ typedef struct hsk_write_data_s {
   bool should_free;
 } hsk_write_data_t;
 
+// A proof being verified off the loop. The name requests
+// stay with the peer, which may be gone by the time the
+// result comes back.
+typedef struct hsk_verify_s {
+  hsk_pool_t *pool;
+  uint64_t peer_id;
+  uint8_t root[32];
+  uint8_t key[32];
+  hsk_proof_t proof;
+  int rc;
+  bool exists;
+  uint8_t *data;
+  size_t data_len;
+} hsk_verify_t;
+
 /*
  * Prototypes
  */
@@ -64,6 +82,21 @@ hsk_pool_log(hsk_pool_t *pool, const char *fmt, ...);
 static int
 hsk_pool_refill(hsk_pool_t *pool);
 
+static void
+hsk_pool_scale(hsk_pool_t *pool, bool shrink);
+
+static void
+hsk_pool_hedge(hsk_pool_t *pool, hsk_name_req_t *head);
+
+static void
+hsk_pool_timeout(hsk_pool_t *pool, hsk_name_req_t *head);
+
+static void
+hsk_name_queue_init(hsk_name_queue_t *queue);
+
+static void
+hsk_name_queue_clear(hsk_name_queue_t *queue);
+
 static void
 hsk_peer_push(hsk_peer_t *peer);
 
@@ -101,6 +134,22 @@ hsk_peer_send_getproof(
   const uint8_t *root
 );
 
+static void
+after_hedge(
+  const char *name,
+  int status,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len,
+  const void *arg
+);
+
+static void
+on_verify(void *arg);
+
+static void
+after_verify(void *arg, bool cancelled);
+
 static void
 on_connect(uv_connect_t *conn, int status);
 
@@ -119,6 +168,9 @@ after_close(uv_handle_t *handle);
 static void
 after_timer(uv_timer_t *timer);
 
+static void
+after_wheel_timer(uv_timer_t *timer);
+
 void
 hsk_chain_get_locator(hsk_chain_t *chain, hsk_getheaders_msg_t *msg);
 
@@ -156,6 +208,13 @@ hsk_pool_init(hsk_pool_t *pool, const uv_loop_t *loop) {
   if (!hsk_ec_create_pubkey(ec, pool->key_, pool->pubkey))
     return HSK_EFAILURE;
 
+  hsk_work_t *verify = hsk_work_alloc(loop);
+
+  if (!verify) {
+    hsk_ec_free(ec);
+    return HSK_ENOMEM;
+  }
+
   pool->loop = (uv_loop_t *)loop;
   pool->ec = ec;
   pool->key = &pool->key_[0];
@@ -168,9 +227,27 @@ hsk_pool_init(hsk_pool_t *pool, const uv_loop_t *loop) {
   pool->head = NULL;
   pool->tail = NULL;
   pool->size = 0;
-  pool->max_size = HSK_POOL_SIZE;
-  pool->pending = NULL;
-  pool->pending_count = 0;
+  pool->min_size = HSK_POOL_SIZE;
+  pool->max_size = HSK_POOL_MAX_SIZE;
+  pool->target = HSK_POOL_SIZE;
+  hsk_name_queue_init(&pool->pending);
+  hsk_name_queue_init(&pool->background);
+  pool->queue_expired = 0;
+  pool->queue_rejected = 0;
+  hsk_namecache_init(&pool->namecache);
+  pool->verify = verify;
+  hsk_latency_init(&pool->latency);
+  pool->wheel_timer = NULL;
+  hsk_wheel_init(&pool->deadlines, uv_now(pool->loop) / HSK_POOL_TICK);
+  hsk_wheel_init(&pool->hedging, uv_now(pool->loop) / HSK_POOL_TICK);
+  pool->timeouts = 0;
+  pool->retries = 0;
+  pool->hedge_delay = HSK_POOL_HEDGE_DEFAULT;
+  pool->hedges = 0;
+  pool->hedge_wins = 0;
+  pool->prefetch = NULL;
+  pool->prefetch_count = 0;
+  memset(pool->prefetch_root, 0, 32);
   pool->block_time = 0;
   pool->getheaders_time = 0;
   pool->user_agent = (char *)malloc(256);
@@ -195,15 +272,25 @@ hsk_pool_uninit(hsk_pool_t *pool) {
     hsk_peer_destroy(peer);
   }
 
+  hsk_name_queue_clear(&pool->pending);
+  hsk_name_queue_clear(&pool->background);
+
   hsk_name_req_t *req, *n;
-  for (req = pool->pending; req; req = n) {
+  for (req = pool->prefetch; req; req = n) {
     n = req->next;
     free(req);
   }
 
-  pool->pending = NULL;
-  pool->pending_count = 0;
+  pool->prefetch = NULL;
+  pool->prefetch_count = 0;
+
+  // Verifications still running are dropped when they return.
+  if (pool->verify) {
+    hsk_work_release(pool->verify);
+    pool->verify = NULL;
+  }
 
+  hsk_namecache_uninit(&pool->namecache);
   hsk_map_uninit(&pool->peers);
   hsk_chain_uninit(&pool->chain);
   hsk_addrman_uninit(&pool->am);
@@ -236,10 +323,26 @@ hsk_pool_set_key(hsk_pool_t *pool, const uint8_t *key) {
 }
 
 bool
-hsk_pool_set_size(hsk_pool_t *pool, int max_size) {
+hsk_pool_set_size(hsk_pool_t *pool, int min_size) {
+  assert(pool);
+
+  if (min_size <= 0 || min_size > 1000)
+    return false;
+
+  pool->min_size = min_size;
+  pool->target = min_size;
+
+  if (pool->max_size < min_size)
+    pool->max_size = min_size;
+
+  return true;
+}
+
+bool
+hsk_pool_set_max_size(hsk_pool_t *pool, int max_size) {
   assert(pool);
 
-  if (max_size <= 0 || max_size > 1000)
+  if (max_size < pool->min_size || max_size > 1000)
     return false;
 
   pool->max_size = max_size;
@@ -360,7 +463,18 @@ hsk_pool_open(hsk_pool_t *pool) {
   if (uv_timer_start(pool->timer, after_timer, 3000, 3000) != 0)
     return HSK_EFAILURE;
 
-  hsk_pool_log(pool, "pool opened (size=%u)\n", pool->max_size);
+  // Runs while proof requests are in flight.
+  pool->wheel_timer = malloc(sizeof(uv_timer_t));
+  if (!pool->wheel_timer)
+    return HSK_ENOMEM;
+
+  pool->wheel_timer->data = (void *)pool;
+
+  if (uv_timer_init(pool->loop, pool->wheel_timer) != 0)
+    return HSK_EFAILURE;
+
+  hsk_pool_log(pool, "pool opened (size=%u-%u)\n",
+               pool->min_size, pool->max_size);
 
   hsk_pool_refill(pool);
 
@@ -378,6 +492,12 @@ hsk_pool_close(hsk_pool_t *pool) {
   hsk_uv_close_free((uv_handle_t*)pool->timer);
   pool->timer = NULL;
 
+  if (pool->wheel_timer) {
+    uv_timer_stop(pool->wheel_timer);
+    hsk_uv_close_free((uv_handle_t*)pool->wheel_timer);
+    pool->wheel_timer = NULL;
+  }
+
   return HSK_SUCCESS;
 }
 
@@ -412,9 +532,13 @@ hsk_pool_getaddr(hsk_pool_t *pool, hsk_addr_t *addr) {
   return hsk_addrman_pick_addr(&pool->am, &pool->peers, addr);
 }
 
+// Open connections towards the target, a few at a time.
 static int
 hsk_pool_refill(hsk_pool_t *pool) {
-  if (pool->size < pool->max_size) {
+  for (int i = 0; i < HSK_POOL_REFILL_BURST; i++) {
+    if (pool->size >= pool->target)
+      break;
+
     hsk_addr_t addr;
 
     if (!hsk_pool_getaddr(pool, &addr)) {
@@ -424,7 +548,7 @@ hsk_pool_refill(hsk_pool_t *pool) {
 
     if (hsk_addr_has_key(&addr) && !hsk_ec_verify_pubkey(pool->ec, addr.key)) {
       hsk_addrman_remove_addr(&pool->am, &addr);
-      return HSK_SUCCESS;
+      continue;
     }
 
     hsk_peer_t *peer = hsk_peer_alloc(pool, hsk_addr_has_key(&addr));
@@ -449,186 +573,984 @@ hsk_pool_refill(hsk_pool_t *pool) {
   return HSK_SUCCESS;
 }
 
-static hsk_peer_t *
-hsk_pool_pick_prover(hsk_pool_t *pool, const uint8_t *name_hash) {
-  hsk_peer_t *first_best = pool->head;
-  hsk_peer_t *second_best = NULL;
-  hsk_peer_t *deterministic = NULL;
-  hsk_peer_t *random = NULL;
+// Proof round trip expected from a peer, falling
+// back to its ping time before any proof arrives.
+static int64_t
+hsk_peer_rtt(const hsk_peer_t *peer) {
+  if (peer->proof_rtt)
+    return peer->proof_rtt + peer->proof_rttvar;
 
-  int total = 0;
+  if (peer->min_ping)
+    return peer->min_ping;
 
-  hsk_peer_t *peer;
-  for (peer = pool->head; peer; peer = peer->next) {
-    if (peer->state != HSK_STATE_HANDSHAKE)
-      continue;
+  return HSK_POOL_RTT_DEFAULT;
+}
 
-    if (peer->proofs > first_best->proofs
-        && peer->names.size <= first_best->names.size) {
-      second_best = first_best;
-      first_best = peer;
-    }
+// Expected time for a new request to complete,
+// behind everything already in flight.
+static int64_t
+hsk_peer_cost(const hsk_peer_t *peer) {
+  return hsk_peer_rtt(peer) * (int64_t)(peer->names.size + 1);
+}
+
+// Fold a proof round trip into the smoothed
+// estimate, the same way TCP does (RFC 6298).
+static void
+hsk_peer_add_rtt(hsk_peer_t *peer, int64_t ms) {
+  if (ms < 1)
+    ms = 1;
+
+  if (!peer->proof_rtt) {
+    peer->proof_rtt = ms;
+    peer->proof_rttvar = ms / 2;
+    return;
+  }
+
+  int64_t err = ms - peer->proof_rtt;
+
+  peer->proof_rttvar += ((err < 0 ? -err : err) - peer->proof_rttvar) / 4;
+  peer->proof_rtt += err / 8;
+
+  if (peer->proof_rtt < 1)
+    peer->proof_rtt = 1;
+}
+
+// Additive increase while proofs are on time,
+// multiplicative decrease when one is late.
+static void
+hsk_peer_shrink_window(hsk_peer_t *peer) {
+  peer->window /= 2;
+
+  if (peer->window < HSK_POOL_WINDOW_MIN)
+    peer->window = HSK_POOL_WINDOW_MIN;
+
+  peer->window_acc = 0;
+}
+
+static void
+hsk_peer_update_window(hsk_peer_t *peer, int64_t ms) {
+  int64_t late = peer->proof_rtt + 4 * peer->proof_rttvar;
+
+  if (peer->proof_rtt && ms > late) {
+    hsk_peer_shrink_window(peer);
+    return;
+  }
+
+  peer->window_acc += 1;
+
+  if (peer->window_acc >= peer->window) {
+    peer->window_acc = 0;
+
+    if (peer->window < HSK_POOL_WINDOW_MAX)
+      peer->window += 1;
+  }
+}
+
+static bool
+hsk_peer_has_room(const hsk_peer_t *peer) {
+  return peer->state == HSK_STATE_HANDSHAKE
+         && (int)peer->names.size < peer->window;
+}
+
+// Count a proof request against a peer's record,
+// dropping the peer once most of them time out.
+static void
+hsk_peer_record(hsk_peer_t *peer, bool timeout) {
+  int sample = timeout ? 1000 : 0;
+
+  peer->timeout_rate += (sample - peer->timeout_rate) / 4;
+
+  if (timeout) {
+    peer->timeouts += 1;
+    hsk_peer_shrink_window(peer);
+  }
+}
+
+static bool
+hsk_peer_is_failing(const hsk_peer_t *peer) {
+  return peer->timeouts >= HSK_POOL_PENALTY_MIN
+         && peer->timeout_rate >= HSK_POOL_PENALTY_RATE;
+}
+
+// Power of two choices: of two random peers
+// with room, the one expected to answer sooner.
+static hsk_peer_t *
+hsk_pool_pick_prover(hsk_pool_t *pool, const hsk_peer_t *exclude) {
+  hsk_peer_t *peer;
+  int total = 0;
 
-    total += 1;
+  for (peer = pool->head; peer; peer = peer->next) {
+    if (peer != exclude && hsk_peer_has_room(peer))
+      total += 1;
   }
 
   if (total == 0)
     return NULL;
 
-  int i = name_hash[0] % total;
-  int r = hsk_random() % total;
+  int a = hsk_random() % total;
+  int b = total > 1 ? hsk_random() % (total - 1) : a;
+
+  if (b >= a && total > 1)
+    b += 1;
+
+  hsk_peer_t *first = NULL;
+  hsk_peer_t *second = NULL;
 
   for (peer = pool->head; peer; peer = peer->next) {
-    if (peer->state != HSK_STATE_HANDSHAKE)
+    if (peer == exclude || !hsk_peer_has_room(peer))
       continue;
 
-    if (i == 0)
-      deterministic = peer;
+    if (a == 0)
+      first = peer;
 
-    if (r == 0)
-      random = peer;
+    if (b == 0)
+      second = peer;
 
-    i -= 1;
-    r -= 1;
+    a -= 1;
+    b -= 1;
   }
 
-  if (random && (hsk_random() % 5) == 0)
-    return random;
-
-  if (second_best && (hsk_random() % 10) == 0)
-    return second_best;
+  assert(first && second);
 
-  if (first_best && (hsk_random() % 10) == 0)
-    return first_best;
+  if (hsk_peer_cost(second) < hsk_peer_cost(first))
+    return second;
 
-  return deterministic;
+  return first;
 }
 
-int
-hsk_pool_resolve(
+// Find a peer which already has a request
+// in flight for this name at this root.
+static hsk_peer_t *
+hsk_pool_find_prover(
   hsk_pool_t *pool,
-  const char *name,
-  hsk_resolve_cb callback,
-  const void *arg
+  const uint8_t *name_hash,
+  const uint8_t *root
 ) {
-  hsk_pool_log(pool, "sending proof request for: %s.\n", name);
+  hsk_peer_t *peer;
 
-  if (!hsk_chain_synced(&pool->chain)) {
-    hsk_pool_log(pool, "cannot send proof request: chain not synced.\n");
-    return HSK_ETIMEOUT;
+  for (peer = pool->head; peer; peer = peer->next) {
+    if (peer->state != HSK_STATE_HANDSHAKE)
+      continue;
+
+    hsk_name_req_t *head = hsk_map_get(&peer->names, name_hash);
+
+    if (head && memcmp(head->root, root, 32) == 0)
+      return peer;
   }
 
-  const uint8_t *root = hsk_chain_safe_root(&pool->chain);
+  return NULL;
+}
+
+/*
+ * Name Requests
+ */
+
+static hsk_name_req_t *
+hsk_name_req_alloc(
+  const char *name,
+  const uint8_t *hash,
+  const uint8_t *root,
+  hsk_resolve_cb callback,
+  const void *arg,
+  bool background
+) {
   hsk_name_req_t *req = malloc(sizeof(hsk_name_req_t));
 
   if (!req)
-    return HSK_ENOMEM;
+    return NULL;
 
   strcpy(req->name, name);
-
-  hsk_hash_name(name, req->hash);
-
+  memcpy(req->hash, hash, 32);
   memcpy(req->root, root, 32);
-
   req->callback = callback;
   req->arg = (void *)arg;
   req->time = hsk_now();
+  req->sent = 0;
+  req->hedged = false;
+  req->background = background;
+  req->retries = 0;
+  req->peer = NULL;
+  hsk_wheel_entry_init(&req->deadline);
+  hsk_wheel_entry_init(&req->hedge_due);
   req->next = NULL;
 
-  hsk_peer_t *peer = hsk_pool_pick_prover(pool, req->hash);
+  return req;
+}
 
-  // Insert into a "pending" list.
-  if (!peer) {
-    hsk_pool_log(pool, "cannot send proof request: no peer.\n");
-    req->next = pool->pending;
-    pool->pending = req;
-    pool->pending_count += 1;
-    return HSK_SUCCESS;
+// Whether anyone is waiting on the answer, as
+// opposed to refreshes, prefetches and hedges.
+static bool
+hsk_name_req_is_live(const hsk_name_req_t *req) {
+  for (; req; req = req->next) {
+    if (!req->background)
+      return true;
   }
 
-  hsk_name_req_t *head = hsk_map_get(&peer->names, req->hash);
+  return false;
+}
 
-  if (!hsk_map_set(&peer->names, req->hash, (void *)req)) {
-    free(req);
-    return HSK_ENOMEM;
-  }
+static uint64_t
+hsk_pool_tick_at(uint64_t ms) {
+  return (ms + HSK_POOL_TICK - 1) / HSK_POOL_TICK;
+}
 
-  if (head) {
-    hsk_peer_log(peer, "already requesting proof for: %s.\n", name);
-    req->next = head;
-    req->time = head->time;
-    return HSK_SUCCESS;
+// The head of a chain in flight carries its deadline,
+// and the time to hedge it if anyone is waiting.
+static void
+hsk_pool_schedule(hsk_pool_t *pool, hsk_name_req_t *head) {
+  uint64_t now = uv_now(pool->loop) / HSK_POOL_TICK;
+
+  // Stopped while idle; nothing to tick through.
+  hsk_wheel_catch_up(&pool->deadlines, now);
+  hsk_wheel_catch_up(&pool->hedging, now);
+
+  hsk_wheel_add(&pool->deadlines,
+                &head->deadline,
+                hsk_pool_tick_at(head->sent + HSK_POOL_PROOF_TIMEOUT));
+
+  if (!head->hedged && hsk_name_req_is_live(head)) {
+    hsk_wheel_add(&pool->hedging,
+                  &head->hedge_due,
+                  hsk_pool_tick_at(head->sent + pool->hedge_delay));
   }
 
-  hsk_peer_log(peer, "sending proof request for: %s.\n", name);
+  if (pool->wheel_timer && !uv_is_active((uv_handle_t *)pool->wheel_timer))
+    uv_timer_start(pool->wheel_timer, after_wheel_timer,
+                   HSK_POOL_TICK, HSK_POOL_TICK);
+}
 
-  return hsk_peer_send_getproof(peer, req->hash, root);
+static void
+hsk_pool_unschedule(hsk_pool_t *pool, hsk_name_req_t *req) {
+  hsk_wheel_remove(&pool->deadlines, &req->deadline);
+  hsk_wheel_remove(&pool->hedging, &req->hedge_due);
 }
 
 static void
-hsk_pool_resend(hsk_pool_t *pool) {
-  if (!hsk_chain_synced(&pool->chain))
-    return;
+hsk_name_req_free(hsk_pool_t *pool, hsk_name_req_t *req) {
+  hsk_pool_unschedule(pool, req);
+  free(req);
+}
 
-  uint8_t *root = pool->chain.tip->name_root;
-  hsk_name_req_t *req = pool->pending;
+/*
+ * Queues
+ */
 
-  if (!req)
-    return;
+static void
+hsk_name_queue_init(hsk_name_queue_t *queue) {
+  queue->head = NULL;
+  queue->tail = NULL;
+  queue->count = 0;
+}
+
+static void
+hsk_name_queue_push(hsk_name_queue_t *queue, hsk_name_req_t *req) {
+  req->next = NULL;
 
-  hsk_peer_t *peer = hsk_pool_pick_prover(pool, req->hash);
+  if (queue->tail)
+    queue->tail->next = req;
+  else
+    queue->head = req;
 
-  if (!peer)
-    return;
+  queue->tail = req;
+  queue->count += 1;
+}
 
-  hsk_name_req_t *next;
+static void
+hsk_name_queue_unshift(hsk_name_queue_t *queue, hsk_name_req_t *req) {
+  req->next = queue->head;
+  queue->head = req;
 
-  pool->pending = NULL;
-  pool->pending_count = 0;
+  if (!queue->tail)
+    queue->tail = req;
 
-  int64_t now = hsk_now();
+  queue->count += 1;
+}
 
-  for (; req; req = next) {
-    next = req->next;
+static hsk_name_req_t *
+hsk_name_queue_shift(hsk_name_queue_t *queue) {
+  hsk_name_req_t *req = queue->head;
 
-    hsk_peer_t *peer = hsk_pool_pick_prover(pool, req->hash);
-    assert(peer);
+  if (!req)
+    return NULL;
 
-    req->next = NULL;
-    req->time = now;
+  queue->head = req->next;
 
-    hsk_name_req_t *head = hsk_map_get(&peer->names, req->hash);
+  if (!queue->head)
+    queue->tail = NULL;
 
-    if (!hsk_map_set(&peer->names, req->hash, (void *)req)) {
-      free(req);
-      continue;
-    }
+  queue->count -= 1;
+
+  req->next = NULL;
 
-    if (head) {
-      req->next = head;
+  return req;
+}
+
+// Remove every request for a name at a root,
+// returning them chained together.
+static hsk_name_req_t *
+hsk_name_queue_take(
+  hsk_name_queue_t *queue,
+  const uint8_t *hash,
+  const uint8_t *root
+) {
+  hsk_name_req_t *taken = NULL;
+  hsk_name_req_t *prev = NULL;
+  hsk_name_req_t *req, *next;
+
+  for (req = queue->head; req; req = next) {
+    next = req->next;
+
+    if (memcmp(req->hash, hash, 32) != 0
+        || memcmp(req->root, root, 32) != 0) {
+      prev = req;
       continue;
     }
 
-    hsk_peer_send_getproof(peer, req->hash, root);
+    if (prev)
+      prev->next = next;
+    else
+      queue->head = next;
+
+    if (queue->tail == req)
+      queue->tail = prev;
+
+    queue->count -= 1;
+
+    req->next = taken;
+    taken = req;
+  }
+
+  return taken;
+}
+
+static void
+hsk_name_queue_clear(hsk_name_queue_t *queue) {
+  hsk_name_req_t *req, *next;
+
+  for (req = queue->head; req; req = next) {
+    next = req->next;
+    free(req);
   }
+
+  hsk_name_queue_init(queue);
+}
+
+// Join a request already in flight for the same
+// name, which costs no room in any window.
+static bool
+hsk_pool_join(hsk_pool_t *pool, hsk_name_req_t *req) {
+  hsk_peer_t *peer = hsk_pool_find_prover(pool, req->hash, req->root);
+
+  if (!peer)
+    return false;
+
+  hsk_name_req_t *head = hsk_map_get(&peer->names, req->hash);
+
+  if (!hsk_map_set(&peer->names, req->hash, (void *)req))
+    return false;
+
+  hsk_peer_log(peer, "already requesting proof for: %s.\n", req->name);
+
+  hsk_pool_unschedule(pool, head);
+
+  req->next = head;
+  req->time = head->time;
+  req->sent = head->sent;
+  req->hedged = head->hedged;
+  req->peer = peer;
+
+  // May have been a prefetch until now.
+  hsk_pool_schedule(pool, req);
+
+  return true;
+}
+
+// Send a request to a peer with room in its window.
+static bool
+hsk_pool_send(hsk_pool_t *pool, hsk_name_req_t *req, const hsk_peer_t *exclude) {
+  hsk_peer_t *peer = hsk_pool_pick_prover(pool, exclude);
+
+  if (!peer)
+    return false;
+
+  if (!hsk_map_set(&peer->names, req->hash, (void *)req))
+    return false;
+
+  hsk_peer_log(peer, "sending proof request for: %s.\n", req->name);
+
+  req->next = NULL;
+  req->time = hsk_now();
+  req->sent = uv_now(pool->loop);
+  req->hedged = false;
+  req->peer = peer;
+
+  hsk_pool_schedule(pool, req);
+
+  hsk_peer_send_getproof(peer, req->hash, req->root);
+
+  return true;
 }
 
-static void
-hsk_pool_send_getheaders(hsk_pool_t *pool) {
-  hsk_peer_t *peer;
+static int
+hsk_pool_request(hsk_pool_t *pool, hsk_name_req_t *req) {
+  if (hsk_pool_join(pool, req))
+    return HSK_SUCCESS;
+
+  hsk_name_queue_t *queue = &pool->pending;
+  int limit = HSK_POOL_QUEUE_LIVE;
+
+  if (req->background) {
+    queue = &pool->background;
+    limit = HSK_POOL_QUEUE_BACKGROUND;
+  }
+
+  // Nothing jumps ahead of a client lookup.
+  bool behind = pool->pending.count > 0 || queue->count > 0;
+
+  if (!behind && hsk_pool_send(pool, req, NULL))
+    return HSK_SUCCESS;
+
+  if (queue->count >= limit) {
+    hsk_pool_debug(pool, "proof queue is full, dropping: %s.\n", req->name);
+    pool->queue_rejected += 1;
+    free(req);
+    return HSK_ETIMEOUT;
+  }
+
+  hsk_pool_debug(pool, "queueing proof request for: %s.\n", req->name);
+
+  req->time = hsk_now();
+
+  hsk_name_queue_push(queue, req);
+
+  // Connect more peers now rather than on the next tick.
+  hsk_pool_scale(pool, false);
+  hsk_pool_refill(pool);
+
+  return HSK_SUCCESS;
+}
+
+static int
+hsk_pool_lookup(
+  hsk_pool_t *pool,
+  const char *name,
+  hsk_resolve_cb callback,
+  const void *arg,
+  bool background
+) {
+  const uint8_t *root = hsk_chain_safe_root(&pool->chain);
+  uint8_t hash[32];
+
+  hsk_hash_name(name, hash);
+
+  // Every qtype for a name shares one proof per root.
+  // Results restored from disk can be used while the
+  // chain is still syncing, as long as the root matches.
+  const hsk_namecache_item_t *item =
+    hsk_namecache_get(&pool->namecache, hash, root);
+
+  if (item) {
+    hsk_pool_debug(pool, "using cached proof for: %s.\n", name);
+    callback(name, HSK_SUCCESS, item->exists, item->data, item->data_len, arg);
+    return HSK_SUCCESS;
+  }
+
+  if (!hsk_chain_synced(&pool->chain)) {
+    hsk_pool_log(pool, "cannot send proof request: chain not synced.\n");
+    return HSK_ETIMEOUT;
+  }
+
+  hsk_pool_log(pool, "sending proof request for: %s.\n", name);
+
+  hsk_name_req_t *req =
+    hsk_name_req_alloc(name, hash, root, callback, arg, background);
+
+  if (!req)
+    return HSK_ENOMEM;
+
+  return hsk_pool_request(pool, req);
+}
+
+int
+hsk_pool_resolve(
+  hsk_pool_t *pool,
+  const char *name,
+  hsk_resolve_cb callback,
+  const void *arg
+) {
+  return hsk_pool_lookup(pool, name, callback, arg, false);
+}
+
+// Same, for answers nobody is waiting on yet, such as
+// cache refreshes. Sent only once client lookups are.
+int
+hsk_pool_resolve_background(
+  hsk_pool_t *pool,
+  const char *name,
+  hsk_resolve_cb callback,
+  const void *arg
+) {
+  return hsk_pool_lookup(pool, name, callback, arg, true);
+}
+
+// Send queued requests while peers have room,
+// client lookups before everything else.
+static void
+hsk_pool_drain(hsk_pool_t *pool) {
+  hsk_name_queue_t *queues[2] = { &pool->pending, &pool->background };
+
+  for (int i = 0; i < 2; i++) {
+    hsk_name_queue_t *queue = queues[i];
+    hsk_name_req_t *req;
+
+    while ((req = hsk_name_queue_shift(queue))) {
+      if (hsk_pool_join(pool, req))
+        continue;
+
+      if (!hsk_pool_send(pool, req, NULL)) {
+        hsk_name_queue_unshift(queue, req);
+        return;
+      }
+    }
+  }
+}
+
+// Time out requests which have waited
+// too long for room in any window.
+static void
+hsk_pool_expire(hsk_pool_t *pool) {
+  hsk_name_queue_t *queues[2] = { &pool->pending, &pool->background };
+  int64_t now = hsk_now();
+
+  for (int i = 0; i < 2; i++) {
+    hsk_name_queue_t *queue = queues[i];
+
+    while (queue->head
+           && now > queue->head->time + HSK_POOL_QUEUE_TIMEOUT) {
+      hsk_name_req_t *req = hsk_name_queue_shift(queue);
+
+      pool->queue_expired += 1;
+
+      req->callback(
+        req->name,
+        HSK_ETIMEOUT,
+        false,
+        NULL,
+        0,
+        req->arg
+      );
+
+      free(req);
+    }
+  }
+}
+
+static void
+after_prefetch(
+  const char *name,
+  int status,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len,
+  const void *arg
+) {
+  // The proof has already landed in the name cache.
+  return;
+}
+
+// Queue the most popular names for re-proving
+// whenever the safe tree root moves forward.
+static void
+hsk_pool_prefetch_queue(hsk_pool_t *pool) {
+  if (!hsk_chain_synced(&pool->chain))
+    return;
+
+  const uint8_t *root = hsk_chain_safe_root(&pool->chain);
+
+  if (memcmp(pool->prefetch_root, root, 32) == 0)
+    return;
+
+  memcpy(pool->prefetch_root, root, 32);
+
+  hsk_namecache_decay(&pool->namecache);
+
+  hsk_namecache_item_t *items[HSK_NAMECACHE_PREFETCH];
+  size_t count = hsk_namecache_hottest(&pool->namecache,
+                                       root,
+                                       items,
+                                       HSK_NAMECACHE_PREFETCH);
+
+  if (count == 0)
+    return;
+
+  hsk_pool_log(pool, "prefetching %u names for new root.\n", (uint32_t)count);
+
+  hsk_name_req_t *req, *next;
+
+  // Drop anything left over from the previous root.
+  for (req = pool->prefetch; req; req = next) {
+    next = req->next;
+    free(req);
+  }
+
+  pool->prefetch = NULL;
+  pool->prefetch_count = 0;
+
+  size_t i = count;
+
+  while (i--) {
+    req = hsk_name_req_alloc(items[i]->name,
+                             items[i]->hash,
+                             root,
+                             after_prefetch,
+                             NULL,
+                             true);
+
+    if (!req)
+      break;
+
+    req->next = pool->prefetch;
+
+    pool->prefetch = req;
+    pool->prefetch_count += 1;
+  }
+}
+
+// Send queued prefetches, a few per peer per tick,
+// so live lookups are never stuck behind them.
+static void
+hsk_pool_prefetch_send(hsk_pool_t *pool) {
+  if (!pool->prefetch)
+    return;
+
+  if (!hsk_chain_synced(&pool->chain))
+    return;
+
+  const uint8_t *root = hsk_chain_safe_root(&pool->chain);
+  hsk_peer_t *peer;
+  int budget = 0;
+
+  for (peer = pool->head; peer; peer = peer->next) {
+    if (peer->state == HSK_STATE_HANDSHAKE)
+      budget += HSK_POOL_PREFETCH_RATE;
+  }
+
+  // Only into windows left empty by everything else.
+  while (pool->prefetch && budget > 0) {
+    if (pool->pending.count > 0 || pool->background.count > 0)
+      break;
+
+    hsk_name_req_t *req = pool->prefetch;
+
+    pool->prefetch = req->next;
+    pool->prefetch_count -= 1;
+
+    req->next = NULL;
+
+    const hsk_namecache_item_t *item =
+      hsk_map_get(&pool->namecache.map, req->hash);
+
+    // Stale queue, or a client already asked.
+    if (memcmp(req->root, root, 32) != 0
+        || (item && memcmp(item->root, root, 32) == 0)) {
+      free(req);
+      continue;
+    }
+
+    req->time = hsk_now();
+
+    hsk_pool_debug(pool, "prefetching proof for: %s.\n", req->name);
+
+    hsk_pool_request(pool, req);
+
+    budget -= 1;
+  }
+}
+
+static void
+hsk_pool_send_getheaders(hsk_pool_t *pool) {
+  hsk_peer_t *peer;
+
+  for (peer = pool->head; peer; peer = peer->next) {
+    if (peer->state != HSK_STATE_HANDSHAKE)
+      continue;
+
+    hsk_peer_send_getheaders(peer, NULL);
+  }
+
+  pool->getheaders_time = hsk_now();
+}
+
+static void
+after_hedge(
+  const char *name,
+  int status,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len,
+  const void *arg
+) {
+  // Stands in for the waiters on the other peer.
+  return;
+}
+
+// Track the p90 of recent proof latency.
+static void
+hsk_pool_hedge_update(hsk_pool_t *pool) {
+  if (pool->latency.count < HSK_POOL_HEDGE_SAMPLES)
+    return;
+
+  int64_t delay = hsk_latency_quantile(&pool->latency,
+                                       HSK_POOL_HEDGE_QUANTILE);
+
+  if (delay < HSK_POOL_HEDGE_MIN)
+    delay = HSK_POOL_HEDGE_MIN;
+
+  if (delay > HSK_POOL_HEDGE_MAX)
+    delay = HSK_POOL_HEDGE_MAX;
+
+  pool->hedge_delay = delay;
+}
+
+// The quickest peer not already asked for this name.
+static hsk_peer_t *
+hsk_pool_pick_hedger(
+  hsk_pool_t *pool,
+  const hsk_peer_t *prover,
+  const uint8_t *name_hash
+) {
+  hsk_peer_t *best = NULL;
+  hsk_peer_t *peer;
+
+  for (peer = pool->head; peer; peer = peer->next) {
+    if (peer == prover || !hsk_peer_has_room(peer))
+      continue;
+
+    if (hsk_map_has(&peer->names, name_hash))
+      continue;
+
+    if (!best || hsk_peer_cost(peer) < hsk_peer_cost(best))
+      best = peer;
+  }
+
+  return best;
+}
+
+static bool
+hsk_pool_send_hedge(
+  hsk_pool_t *pool,
+  hsk_peer_t *prover,
+  const hsk_name_req_t *head
+) {
+  hsk_peer_t *peer = hsk_pool_pick_hedger(pool, prover, head->hash);
+
+  if (!peer)
+    return false;
+
+  hsk_name_req_t *req = hsk_name_req_alloc(head->name,
+                                           head->hash,
+                                           head->root,
+                                           after_hedge,
+                                           NULL,
+                                           true);
+
+  if (!req)
+    return false;
+
+  if (!hsk_map_set(&peer->names, req->hash, (void *)req)) {
+    free(req);
+    return false;
+  }
+
+  hsk_peer_log(peer, "hedging proof request for: %s.\n", req->name);
+
+  req->sent = uv_now(pool->loop);
+  req->hedged = true;
+  req->retries = HSK_POOL_PROOF_RETRIES;
+  req->peer = peer;
+
+  hsk_pool_schedule(pool, req);
+
+  hsk_peer_send_getproof(peer, req->hash, req->root);
+
+  pool->hedges += 1;
+
+  return true;
+}
+
+// Send a second copy of a live request which has waited
+// longer than the hedge delay. Without a second peer the
+// request waits out its deadline.
+static void
+hsk_pool_hedge(hsk_pool_t *pool, hsk_name_req_t *head) {
+  if (head->hedged)
+    return;
+
+  head->hedged = true;
+
+  hsk_pool_send_hedge(pool, head->peer, head);
+}
+
+// Move the waiters of a failed request over to the
+// other half of their hedge, if it is still in flight.
+static bool
+hsk_pool_adopt_reqs(hsk_pool_t *pool, hsk_peer_t *from, hsk_name_req_t *reqs) {
+  hsk_name_req_t *head = NULL;
+  hsk_peer_t *peer;
+
+  for (peer = pool->head; peer; peer = peer->next) {
+    if (peer == from)
+      continue;
+
+    head = hsk_map_get(&peer->names, reqs->hash);
+
+    if (head && memcmp(head->root, reqs->root, 32) == 0)
+      break;
+
+    head = NULL;
+  }
+
+  if (!head)
+    return false;
+
+  hsk_name_req_t *tail = head;
+
+  while (tail->next)
+    tail = tail->next;
+
+  hsk_name_req_t *req, *next;
+
+  for (req = reqs; req; req = next) {
+    next = req->next;
+
+    if (req->callback == after_hedge) {
+      hsk_name_req_free(pool, req);
+      continue;
+    }
+
+    hsk_pool_unschedule(pool, req);
+
+    req->time = head->time;
+    req->sent = head->sent;
+    req->hedged = true;
+    req->peer = NULL;
+    req->next = NULL;
+
+    tail->next = req;
+    tail = req;
+  }
+
+  return true;
+}
+
+// Give every waiter of a failed request another peer,
+// once, and time out those which have had theirs.
+static void
+hsk_pool_retry(hsk_pool_t *pool, hsk_peer_t *from, hsk_name_req_t *reqs) {
+  if (reqs->hedged && hsk_pool_adopt_reqs(pool, from, reqs))
+    return;
+
+  hsk_name_req_t *req, *next;
+
+  for (req = reqs; req; req = next) {
+    next = req->next;
+
+    hsk_pool_unschedule(pool, req);
+
+    req->next = NULL;
+    req->peer = NULL;
+    req->hedged = false;
+
+    if (req->callback == after_hedge) {
+      free(req);
+      continue;
+    }
+
+    if (req->retries >= HSK_POOL_PROOF_RETRIES) {
+      req->callback(
+        req->name,
+        HSK_ETIMEOUT,
+        false,
+        NULL,
+        0,
+        req->arg
+      );
+
+      free(req);
+      continue;
+    }
+
+    req->retries += 1;
+    pool->retries += 1;
+
+    if (hsk_pool_join(pool, req) || hsk_pool_send(pool, req, from))
+      continue;
+
+    // Waited long enough already; first in line.
+    req->time = hsk_now();
+
+    if (req->background)
+      hsk_name_queue_unshift(&pool->background, req);
+    else
+      hsk_name_queue_unshift(&pool->pending, req);
+  }
+}
+
+static void
+hsk_peer_add_late(hsk_peer_t *peer, const uint8_t *hash, const uint8_t *root) {
+  memcpy(peer->late_hash[peer->late_next], hash, 32);
+  memcpy(peer->late_root[peer->late_next], root, 32);
+
+  peer->late_next = (peer->late_next + 1) % HSK_POOL_LATE;
+
+  if (peer->late_size < HSK_POOL_LATE)
+    peer->late_size += 1;
+}
+
+static bool
+hsk_peer_is_late(
+  const hsk_peer_t *peer,
+  const uint8_t *hash,
+  const uint8_t *root
+) {
+  for (int i = 0; i < peer->late_size; i++) {
+    if (memcmp(peer->late_hash[i], hash, 32) == 0
+        && memcmp(peer->late_root[i], root, 32) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+// A proof request ran out of time on one peer. Only that
+// request is retried; the peer goes once most do this.
+static void
+hsk_pool_timeout(hsk_pool_t *pool, hsk_name_req_t *head) {
+  hsk_peer_t *peer = head->peer;
+
+  assert(peer);
+  assert(hsk_map_get(&peer->names, head->hash) == head);
+
+  hsk_peer_log(peer, "proof request timed out: %s\n", head->name);
+
+  hsk_map_del(&peer->names, head->hash);
+  hsk_peer_add_late(peer, head->hash, head->root);
 
-  for (peer = pool->head; peer; peer = peer->next) {
-    if (peer->state != HSK_STATE_HANDSHAKE)
-      continue;
+  pool->timeouts += 1;
 
-    hsk_peer_send_getheaders(peer, NULL);
-  }
+  hsk_peer_record(peer, true);
+  hsk_pool_retry(pool, peer, head);
 
-  pool->getheaders_time = hsk_now();
+  if (hsk_peer_is_failing(peer)) {
+    hsk_peer_log(peer, "peer is stalling (timeouts)\n");
+    hsk_peer_destroy(peer);
+  }
 }
 
 static void
-hsk_pool_merge_reqs(hsk_pool_t *pool, hsk_map_t *map) {
+hsk_peer_timeout_reqs(hsk_peer_t *peer) {
+  hsk_pool_t *pool = (hsk_pool_t *)peer->pool;
+  hsk_map_t *map = &peer->names;
   hsk_map_iter_t i;
 
   for (i = hsk_map_begin(map); i != hsk_map_end(map); i++) {
@@ -638,100 +1560,115 @@ hsk_pool_merge_reqs(hsk_pool_t *pool, hsk_map_t *map) {
     hsk_name_req_t *req = (hsk_name_req_t *)hsk_map_value(map, i);
     assert(req);
 
-    hsk_name_req_t *tail;
-    int count = 0;
-
-    for (tail = req; tail; tail = tail->next) {
-      count += 1;
-      if (!tail->next)
-        break;
-    }
+    hsk_map_delete(map, i);
 
-    if (tail) {
-      tail->next = pool->pending;
-      pool->pending = req;
-      pool->pending_count += count;
-    }
+    hsk_pool_retry(pool, peer, req);
   }
 
   hsk_map_reset(map);
+}
 
-  if (pool->pending_count > 100) {
-    hsk_name_req_t *req, *next;
+// Expire deadlines and send hedges which are due.
+static void
+hsk_pool_tick(hsk_pool_t *pool) {
+  uint64_t now = uv_now(pool->loop) / HSK_POOL_TICK;
+  hsk_wheel_entry_t *entry;
 
-    for (req = pool->pending; req; req = next) {
-      next = req->next;
+  while ((entry = hsk_wheel_expire(&pool->hedging, now))) {
+    hsk_name_req_t *head = (hsk_name_req_t *)
+      ((uint8_t *)entry - offsetof(hsk_name_req_t, hedge_due));
 
-      req->callback(
-        req->name,
-        HSK_ETIMEOUT,
-        false,
-        NULL,
-        0,
-        req->arg
-      );
+    hsk_pool_hedge(pool, head);
+  }
 
-      free(req);
-    }
+  while ((entry = hsk_wheel_expire(&pool->deadlines, now))) {
+    hsk_name_req_t *head = (hsk_name_req_t *)
+      ((uint8_t *)entry - offsetof(hsk_name_req_t, deadline));
 
-    pool->pending_count = 0;
+    hsk_pool_timeout(pool, head);
   }
+
+  if (pool->deadlines.size == 0 && pool->hedging.size == 0)
+    uv_timer_stop(pool->wheel_timer);
 }
 
-static void
-hsk_peer_timeout_reqs(hsk_peer_t *peer) {
-  hsk_map_t *map = &peer->names;
-  hsk_map_iter_t i;
+// Close the slowest idle peer, if any.
+static bool
+hsk_pool_shed(hsk_pool_t *pool) {
+  hsk_peer_t *worst = NULL;
 
-  for (i = hsk_map_begin(map); i != hsk_map_end(map); i++) {
-    if (!hsk_map_exists(map, i))
+  for (hsk_peer_t *peer = pool->head; peer; peer = peer->next) {
+    if (peer->state != HSK_STATE_HANDSHAKE || peer->names.size > 0)
       continue;
 
-    hsk_name_req_t *req = (hsk_name_req_t *)hsk_map_value(map, i);
-    hsk_name_req_t *next;
-
-    assert(req);
+    if (!worst || hsk_peer_cost(peer) > hsk_peer_cost(worst))
+      worst = peer;
+  }
 
-    hsk_map_delete(map, i);
+  if (!worst)
+    return false;
 
-    for (; req; req = next) {
-      next = req->next;
+  hsk_peer_log(worst, "shedding idle peer\n");
+  hsk_peer_destroy(worst);
 
-      req->callback(
-        req->name,
-        HSK_ETIMEOUT,
-        false,
-        NULL,
-        0,
-        req->arg
-      );
+  return true;
+}
 
-      free(req);
+// Move the target size between the minimum and maximum
+// with demand: grow by enough fresh windows to take the
+// queued requests, shrink by one peer a tick when idle.
+static void
+hsk_pool_scale(hsk_pool_t *pool, bool shrink) {
+  int queued = pool->pending.count + pool->background.count;
+  int connecting = 0;
+  int used = 0;
+  int room = 0;
+
+  for (hsk_peer_t *peer = pool->head; peer; peer = peer->next) {
+    if (peer->state != HSK_STATE_HANDSHAKE) {
+      connecting += 1;
+      continue;
     }
+
+    used += peer->names.size;
+    room += peer->window;
   }
 
-  hsk_map_reset(map);
-}
+  int target = pool->target;
 
-static bool
-hsk_peer_is_overdue(hsk_peer_t *peer) {
-  int64_t now = hsk_now();
+  if (queued > 0 || used * 100 > room * HSK_POOL_BUSY) {
+    // Peers still connecting will take some of it.
+    int need = (queued + HSK_POOL_WINDOW_INIT - 1) / HSK_POOL_WINDOW_INIT;
 
-  hsk_map_t *map = &peer->names;
-  hsk_map_iter_t i;
+    if (need < 1)
+      need = 1;
 
-  for (i = hsk_map_begin(map); i != hsk_map_end(map); i++) {
-    if (!hsk_map_exists(map, i))
-      continue;
+    need -= connecting;
 
-    hsk_name_req_t *req = (hsk_name_req_t *)hsk_map_value(map, i);
-    assert(req);
+    if (need > 0 && pool->size + need > target)
+      target = pool->size + need;
+  } else if (shrink && used * 100 < room * HSK_POOL_IDLE) {
+    target -= 1;
+  }
 
-    if (now > req->time + 5)
-      return true;
+  if (target > pool->max_size)
+    target = pool->max_size;
+
+  if (target < pool->min_size)
+    target = pool->min_size;
+
+  if (target != pool->target) {
+    hsk_pool_debug(pool, "pool target %d -> %d (queued=%d used=%d/%d)\n",
+                   pool->target, target, queued, used, room);
+    pool->target = target;
   }
 
-  return false;
+  if (shrink) {
+    while (pool->size > pool->target) {
+      if (!hsk_pool_shed(pool))
+        break;
+    }
+  }
 }
 
 static void
@@ -779,6 +1716,7 @@ hsk_pool_timer(hsk_pool_t *pool) {
         hsk_peer_debug(peer, "pinging...\n");
         peer->challenge = hsk_nonce();
         peer->last_ping = now;
+        peer->ping_sent = uv_now(pool->loop);
         hsk_peer_send_ping(peer, peer->challenge);
       }
     }
@@ -797,11 +1735,6 @@ hsk_pool_timer(hsk_pool_t *pool) {
       continue;
     }
 
-    if (hsk_peer_is_overdue(peer)) {
-      hsk_peer_log(peer, "peer is stalling (overdue)\n");
-      hsk_peer_destroy(peer);
-      continue;
-    }
   }
 
   if (pool->block_time && now > pool->block_time + 10 * 60) {
@@ -811,6 +1744,11 @@ hsk_pool_timer(hsk_pool_t *pool) {
     }
   }
 
+  hsk_pool_expire(pool);
+  hsk_pool_drain(pool);
+  hsk_pool_prefetch_send(pool);
+
+  hsk_pool_scale(pool, true);
   hsk_pool_refill(pool);
 }
 
@@ -860,7 +1798,16 @@ hsk_peer_init(hsk_peer_t *peer, hsk_pool_t *pool, bool encrypted) {
   peer->version_time = 0;
   peer->last_ping = 0;
   peer->last_pong = 0;
+  peer->ping_sent = 0;
   peer->min_ping = 0;
+  peer->proof_rtt = 0;
+  peer->proof_rttvar = 0;
+  peer->window = HSK_POOL_WINDOW_INIT;
+  peer->window_acc = 0;
+  peer->timeouts = 0;
+  peer->timeout_rate = 0;
+  peer->late_size = 0;
+  peer->late_next = 0;
   peer->ping_timer = 0;
   peer->challenge = 0;
   peer->conn_time = 0;
@@ -1013,7 +1960,6 @@ hsk_peer_close(hsk_peer_t *peer) {
   }
 
   peer->state = HSK_STATE_DISCONNECTING;
-  // hsk_pool_merge_reqs(peer->pool, &peer->names);
   hsk_peer_timeout_reqs(peer);
   hsk_peer_remove(peer);
 
@@ -1353,6 +2299,9 @@ hsk_peer_handle_verack(hsk_peer_t *peer, const hsk_verack_msg_t *msg) {
 
   peer->version_time = 0;
 
+  // Another window to fill.
+  hsk_pool_drain((hsk_pool_t *)peer->pool);
+
   // VERACK is boring, no need to respond.
   return HSK_SUCCESS;
 }
@@ -1382,9 +2331,10 @@ hsk_peer_handle_pong(hsk_peer_t *peer, const hsk_pong_msg_t *msg) {
   hsk_peer_debug(peer, "received pong\n");
 
   int64_t now = hsk_now();
+  uint64_t ms = uv_now(peer->loop);
 
-  if (now >= peer->last_ping) {
-    int64_t min = now - peer->last_ping;
+  if (now >= peer->last_ping && ms >= peer->ping_sent) {
+    int64_t min = ms - peer->ping_sent;
     peer->last_pong = now;
     if (!peer->min_ping)
       peer->min_ping = min;
@@ -1516,6 +2466,8 @@ hsk_peer_handle_headers(hsk_peer_t *peer, const hsk_headers_msg_t *msg) {
   pool->block_time = hsk_now();
   peer->getheaders_time = 0;
 
+  hsk_pool_prefetch_queue(pool);
+
   if (msg->header_count == 2000) {
     hsk_peer_log(peer, "requesting more headers\n");
     return hsk_peer_send_getheaders(peer, NULL);
@@ -1524,70 +2476,297 @@ hsk_peer_handle_headers(hsk_peer_t *peer, const hsk_headers_msg_t *msg) {
   return HSK_SUCCESS;
 }
 
-static int
-hsk_peer_handle_proof(hsk_peer_t *peer, const hsk_proof_msg_t *msg) {
-  hsk_peer_log(peer, "received proof: %s\n", hsk_hex_encode32(msg->key));
+// Answer a chain of requests, returning whether
+// it was the second copy of a hedged request.
+static bool
+hsk_pool_deliver(
+  hsk_pool_t *pool,
+  hsk_name_req_t *reqs,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len
+) {
+  hsk_name_req_t *req, *next;
+  bool hedge = false;
 
-  hsk_name_req_t *reqs = hsk_map_get(&peer->names, msg->key);
+  for (req = reqs; req; req = next) {
+    next = req->next;
 
-  if (!reqs) {
-    hsk_peer_log(peer,
-      "received unsolicited proof: %s\n",
-      hsk_hex_encode32(msg->key));
-    return HSK_EBADARGS;
+    if (req->callback == after_hedge)
+      hedge = true;
+
+    req->callback(
+      req->name,
+      HSK_SUCCESS,
+      exists,
+      data,
+      data_len,
+      req->arg
+    );
+
+    hsk_name_req_free(pool, req);
   }
 
-  hsk_peer_log(peer, "received proof for: %s\n", reqs->name);
+  return hedge;
+}
+
+// A verified proof whose request timed out and was
+// retried answers the retry just as well, wherever it
+// is: in flight on other peers or back in a queue.
+// Takes ownership of `data`.
+static void
+hsk_pool_finish_late(
+  hsk_pool_t *pool,
+  const uint8_t *root,
+  const uint8_t *key,
+  bool exists,
+  uint8_t *data,
+  size_t data_len
+) {
+  const hsk_namecache_item_t *item = hsk_map_get(&pool->namecache.map, key);
 
-  if (memcmp(msg->root, reqs->root, 32) != 0) {
-    hsk_peer_log(peer, "proof hash mismatch (why?)\n");
-    return HSK_EHASHMISMATCH;
+  // Already answered.
+  if (item && memcmp(item->root, root, 32) == 0) {
+    if (data)
+      free(data);
+    return;
   }
 
-  bool exists;
-  uint8_t *data;
-  size_t data_len;
+  hsk_name_req_t *queued[2] = {
+    hsk_name_queue_take(&pool->pending, key, root),
+    hsk_name_queue_take(&pool->background, key, root)
+  };
 
-  int rc = hsk_proof_verify(
-    msg->root,
-    msg->key,
-    &msg->proof,
-    &exists,
-    &data,
-    &data_len
-  );
+  hsk_peer_t *other = hsk_pool_find_prover(pool, key, root);
+  const char *name = NULL;
 
+  if (other)
+    name = ((hsk_name_req_t *)hsk_map_get(&other->names, key))->name;
+  else if (queued[0])
+    name = queued[0]->name;
+  else if (queued[1])
+    name = queued[1]->name;
+
+  // Nobody waiting any more.
+  if (!name) {
+    if (data)
+      free(data);
+    return;
+  }
+
+  hsk_pool_debug(pool, "late proof answers retry for: %s.\n", name);
+
+  if (!hsk_namecache_insert(&pool->namecache,
+                            name,
+                            key,
+                            root,
+                            exists,
+                            data,
+                            data_len)) {
+    hsk_pool_log(pool, "could not cache proof for: %s\n", name);
+  }
+
+  // Including both halves of a hedge. The peers'
+  // own proofs are still taken when they turn up.
+  while ((other = hsk_pool_find_prover(pool, key, root))) {
+    hsk_name_req_t *rest = hsk_map_get(&other->names, key);
+    hsk_peer_add_late(other, key, root);
+    hsk_map_del(&other->names, key);
+    hsk_pool_deliver(pool, rest, exists, data, data_len);
+  }
+
+  hsk_pool_deliver(pool, queued[0], exists, data, data_len);
+  hsk_pool_deliver(pool, queued[1], exists, data, data_len);
+
+  free(data);
+
+  hsk_pool_drain(pool);
+}
+
+// Deliver a verified proof to everyone waiting on it.
+// Takes ownership of `data`.
+static int
+hsk_peer_finish_proof(
+  hsk_peer_t *peer,
+  const uint8_t *root,
+  const uint8_t *key,
+  int rc,
+  bool exists,
+  uint8_t *data,
+  size_t data_len
+) {
   if (rc != HSK_SUCCESS) {
     hsk_peer_log(peer, "invalid proof: %s\n", hsk_strerror(rc));
+    if (data)
+      free(data);
     return rc;
   }
 
-  hsk_map_del(&peer->names, msg->key);
+  hsk_pool_t *pool = (hsk_pool_t *)peer->pool;
+  hsk_name_req_t *reqs = hsk_map_get(&peer->names, key);
 
-  hsk_name_req_t *req, *next;
+  // Timed out here and retried, or answered by a duplicate.
+  if (!reqs) {
+    hsk_pool_finish_late(pool, root, key, exists, data, data_len);
+    return HSK_SUCCESS;
+  }
 
-  for (req = reqs; req; req = next) {
-    next = req->next;
+  if (memcmp(root, reqs->root, 32) != 0) {
+    if (data)
+      free(data);
+    return HSK_SUCCESS;
+  }
 
-    req->callback(
-      req->name,
-      HSK_SUCCESS,
-      exists,
-      data,
-      data_len,
-      req->arg
-    );
+  hsk_map_del(&peer->names, key);
 
-    free(req);
+  int64_t rtt = (int64_t)(uv_now(pool->loop) - reqs->sent);
+
+  hsk_peer_record(peer, false);
+  hsk_peer_update_window(peer, rtt);
+  hsk_peer_add_rtt(peer, rtt);
+  hsk_latency_add(&pool->latency, rtt);
+  hsk_pool_hedge_update(pool);
+
+  if (!hsk_namecache_insert(&pool->namecache,
+                            reqs->name,
+                            key,
+                            root,
+                            exists,
+                            data,
+                            data_len)) {
+    hsk_peer_log(peer, "could not cache proof for: %s\n", reqs->name);
+  }
+
+  bool hedged = reqs->hedged;
+
+  if (hsk_pool_deliver(pool, reqs, exists, data, data_len))
+    pool->hedge_wins += 1;
+
+  // First answer serves both halves of a hedge. The
+  // slower peer's proof is still expected, so it is
+  // remembered as late rather than treated as unsolicited.
+  if (hedged) {
+    hsk_peer_t *other;
+
+    for (other = pool->head; other; other = other->next) {
+      if (other == peer)
+        continue;
+
+      hsk_name_req_t *rest = hsk_map_get(&other->names, key);
+
+      if (!rest || memcmp(root, rest->root, 32) != 0)
+        continue;
+
+      hsk_peer_add_late(other, key, root);
+      hsk_map_del(&other->names, key);
+      hsk_pool_deliver(pool, rest, exists, data, data_len);
+    }
   }
 
   free(data);
 
   peer->proofs += 1;
 
+  // Room opened up in a window.
+  hsk_pool_drain(pool);
+
   return HSK_SUCCESS;
 }
 
+static bool
+hsk_peer_queue_verify(hsk_peer_t *peer, hsk_proof_msg_t *msg) {
+  hsk_pool_t *pool = (hsk_pool_t *)peer->pool;
+  hsk_verify_t *verify = malloc(sizeof(hsk_verify_t));
+
+  if (!verify)
+    return false;
+
+  verify->pool = pool;
+  verify->peer_id = peer->id;
+  memcpy(verify->root, msg->root, 32);
+  memcpy(verify->key, msg->key, 32);
+  verify->proof = msg->proof;
+  verify->rc = HSK_EFAILURE;
+  verify->exists = false;
+  verify->data = NULL;
+  verify->data_len = 0;
+
+  if (!hsk_work_queue(pool->verify, on_verify, after_verify, verify)) {
+    free(verify);
+    return false;
+  }
+
+  // The job owns the proof now.
+  hsk_proof_init(&msg->proof);
+
+  return true;
+}
+
+static int
+hsk_peer_handle_proof(hsk_peer_t *peer, hsk_proof_msg_t *msg) {
+  hsk_peer_log(peer, "received proof: %s\n", hsk_hex_encode32(msg->key));
+
+  hsk_pool_t *pool = (hsk_pool_t *)peer->pool;
+  hsk_name_req_t *reqs = hsk_map_get(&peer->names, msg->key);
+
+  if (!reqs) {
+    const hsk_namecache_item_t *item =
+      hsk_map_get(&pool->namecache.map, msg->key);
+
+    // Lost a hedge, or answered after a retry.
+    if (item && memcmp(item->root, msg->root, 32) == 0) {
+      hsk_peer_debug(peer,
+        "received late proof: %s\n",
+        hsk_hex_encode32(msg->key));
+      return HSK_SUCCESS;
+    }
+
+    if (!hsk_peer_is_late(peer, msg->key, msg->root)) {
+      hsk_peer_log(peer,
+        "received unsolicited proof: %s\n",
+        hsk_hex_encode32(msg->key));
+      return HSK_EBADARGS;
+    }
+
+    // Timed out here, or lost a hedge the
+    // answer has since been evicted for.
+    hsk_peer_log(peer,
+      "received overdue proof: %s\n",
+      hsk_hex_encode32(msg->key));
+  } else {
+    hsk_peer_log(peer, "received proof for: %s\n", reqs->name);
+
+    if (memcmp(msg->root, reqs->root, 32) != 0) {
+      hsk_peer_log(peer, "proof hash mismatch (why?)\n");
+      return HSK_EHASHMISMATCH;
+    }
+  }
+
+  // Deep proofs are hashed on the threadpool.
+  if (msg->proof.node_count > HSK_POOL_VERIFY_INLINE
+      && hsk_peer_queue_verify(peer, msg)) {
+    return HSK_SUCCESS;
+  }
+
+  pool->verify->inlined += 1;
+
+  bool exists = false;
+  uint8_t *data = NULL;
+  size_t data_len = 0;
+
+  int rc = hsk_proof_verify(
+    msg->root,
+    msg->key,
+    &msg->proof,
+    &exists,
+    &data,
+    &data_len
+  );
+
+  return hsk_peer_finish_proof(peer, msg->root, msg->key,
+                               rc, exists, data, data_len);
+}
+
 static int
 hsk_peer_handle_msg(hsk_peer_t *peer, const hsk_msg_t *msg) {
   hsk_peer_debug(peer, "handling msg: %s\n", hsk_msg_str(msg->cmd));
@@ -1894,6 +3073,80 @@ after_timer(uv_timer_t *timer) {
   hsk_pool_timer(pool);
 }
 
+static void
+after_wheel_timer(uv_timer_t *timer) {
+  hsk_pool_t *pool = (hsk_pool_t *)timer->data;
+  assert(pool);
+  hsk_pool_tick(pool);
+}
+
+static void
+on_verify(void *arg) {
+  hsk_verify_t *verify = (hsk_verify_t *)arg;
+
+  verify->rc = hsk_proof_verify(
+    verify->root,
+    verify->key,
+    &verify->proof,
+    &verify->exists,
+    &verify->data,
+    &verify->data_len
+  );
+}
+
+static void
+after_verify(void *arg, bool cancelled) {
+  hsk_verify_t *verify = (hsk_verify_t *)arg;
+
+  if (!cancelled) {
+    hsk_pool_t *pool = verify->pool;
+    hsk_peer_t *peer;
+
+    for (peer = pool->head; peer; peer = peer->next) {
+      if (peer->id == verify->peer_id)
+        break;
+    }
+
+    // Closed peers have handed their requests to
+    // others, which the proof can still answer.
+    if (!peer && verify->rc == HSK_SUCCESS) {
+      hsk_pool_finish_late(
+        pool,
+        verify->root,
+        verify->key,
+        verify->exists,
+        verify->data,
+        verify->data_len
+      );
+
+      verify->data = NULL;
+    }
+
+    if (peer) {
+      int rc = hsk_peer_finish_proof(
+        peer,
+        verify->root,
+        verify->key,
+        verify->rc,
+        verify->exists,
+        verify->data,
+        verify->data_len
+      );
+
+      verify->data = NULL;
+
+      if (rc != HSK_SUCCESS)
+        hsk_peer_destroy(peer);
+    }
+  }
+
+  if (verify->data)
+    free(verify->data);
+
+  hsk_proof_uninit(&verify->proof);
+  free(verify);
+}
+
 static void
 after_brontide_connect(const void *arg) {
   hsk_peer_t *peer = (hsk_peer_t *)arg;
@@ -12,15 +12,29 @@
 #include "chain.h"
 #include "ec.h"
 #include "header.h"
+#include "latency.h"
 #include "map.h"
+#include "namecache.h"
 #include "timedata.h"
+#include "wheel.h"
+#include "work.h"
 
 /*
  * Defs
  */
 
 #define HSK_BUFFER_SIZE 32768
+// Peers kept connected, and the most the pool grows to
+// while proof requests are queueing or windows are busy.
 #define HSK_POOL_SIZE 8
+#define HSK_POOL_MAX_SIZE 32
+// Connections opened at once while short of the target.
+#define HSK_POOL_REFILL_BURST 4
+// Share of window room in use (percent) above which the
+// pool grows, and below which it sheds idle peers.
+#define HSK_POOL_BUSY 75
+#define HSK_POOL_IDLE 25
+#define HSK_POOL_PREFETCH_RATE 2
 #define HSK_STATE_DISCONNECTED 0
 #define HSK_STATE_CONNECTING 2
 #define HSK_STATE_CONNECTED 3
@@ -28,6 +42,42 @@
 #define HSK_STATE_HANDSHAKE 5
 #define HSK_STATE_DISCONNECTING 6
 #define HSK_MAX_AGENT 255
+// Proofs with at most this many nodes are verified on the loop.
+#define HSK_POOL_VERIFY_INLINE 16
+// A proof request still unanswered after the p90 of recent
+// proof latency is also sent to a second peer (milliseconds).
+#define HSK_POOL_HEDGE_QUANTILE 0.9
+#define HSK_POOL_HEDGE_SAMPLES 8
+#define HSK_POOL_HEDGE_DEFAULT 1000
+#define HSK_POOL_HEDGE_MIN 100
+#define HSK_POOL_HEDGE_MAX 3000
+// Proof round trip assumed for a peer with no proofs
+// or pongs yet (milliseconds).
+#define HSK_POOL_RTT_DEFAULT 500
+// Distinct proof requests one peer may have in flight. The
+// window grows while proofs come back on time and halves
+// when one is late.
+#define HSK_POOL_WINDOW_INIT 8
+#define HSK_POOL_WINDOW_MIN 2
+#define HSK_POOL_WINDOW_MAX 64
+// Requests waiting for room in a peer's window. Client
+// lookups go first; refreshes and prefetches wait for them.
+#define HSK_POOL_QUEUE_LIVE 1000
+#define HSK_POOL_QUEUE_BACKGROUND 200
+#define HSK_POOL_QUEUE_TIMEOUT 5
+// Each proof request gets this long on one peer (milliseconds)
+// before its waiters are handed to another, at most this often.
+#define HSK_POOL_PROOF_TIMEOUT 4000
+#define HSK_POOL_PROOF_RETRIES 1
+// Peers are dropped once this many requests have timed out and
+// the recent share of timeouts reaches this, in thousandths.
+#define HSK_POOL_PENALTY_MIN 3
+#define HSK_POOL_PENALTY_RATE 500
+// Timed out requests remembered per peer, so their
+// answers are still taken when they turn up late.
+#define HSK_POOL_LATE 16
+// Resolution of proof request deadlines (milliseconds).
+#define HSK_POOL_TICK 25
 
 /*
  * Types
@@ -42,6 +92,8 @@ typedef void (*hsk_resolve_cb)(
   const void *arg
 );
 
+struct hsk_peer_s;
+
 typedef struct hsk_name_req_s {
   char name[256];
   uint8_t hash[32];
@@ -49,9 +101,26 @@ typedef struct hsk_name_req_s {
   hsk_resolve_cb callback;
   void *arg;
   int64_t time;
+  // Loop time the request went out, in milliseconds.
+  uint64_t sent;
+  // Also requested from another peer.
+  bool hedged;
+  // Nobody is waiting on the answer right now.
+  bool background;
+  int retries;
+  // Set on the head of a chain in flight.
+  struct hsk_peer_s *peer;
+  hsk_wheel_entry_t deadline;
+  hsk_wheel_entry_t hedge_due;
   struct hsk_name_req_s *next;
 } hsk_name_req_t;
 
+typedef struct hsk_name_queue_s {
+  hsk_name_req_t *head;
+  hsk_name_req_t *tail;
+  int count;
+} hsk_name_queue_t;
+
 typedef struct hsk_peer_s {
   void *pool;
   hsk_chain_t *chain;
@@ -72,7 +141,27 @@ typedef struct hsk_peer_s {
   int64_t version_time;
   int64_t last_ping;
   int64_t last_pong;
+  // Loop time of the last ping, in milliseconds.
+  uint64_t ping_sent;
+  // Fastest pong, in milliseconds.
   int64_t min_ping;
+  // Smoothed proof round trip and its mean
+  // deviation, in milliseconds. Zero until known.
+  int64_t proof_rtt;
+  int64_t proof_rttvar;
+  // Proof request window, and on-time proofs
+  // counted towards growing it.
+  int window;
+  int window_acc;
+  // Proof requests timed out, and their recent
+  // share of all requests, in thousandths.
+  int timeouts;
+  int timeout_rate;
+  // Most recent of those (name hash, root).
+  uint8_t late_hash[HSK_POOL_LATE][32];
+  uint8_t late_root[HSK_POOL_LATE][32];
+  int late_size;
+  int late_next;
   int64_t ping_timer;
   uint64_t challenge;
   int64_t conn_time;
@@ -101,9 +190,28 @@ typedef struct hsk_pool_s {
   hsk_peer_t *head;
   hsk_peer_t *tail;
   int size;
+  int min_size;
   int max_size;
-  hsk_name_req_t *pending;
-  int pending_count;
+  int target;
+  hsk_name_queue_t pending;
+  hsk_name_queue_t background;
+  uint64_t queue_expired;
+  uint64_t queue_rejected;
+  hsk_namecache_t namecache;
+  hsk_work_t *verify;
+  hsk_latency_t latency;
+  // Ticks while any deadline is pending.
+  uv_timer_t *wheel_timer;
+  hsk_wheel_t deadlines;
+  hsk_wheel_t hedging;
+  uint64_t timeouts;
+  uint64_t retries;
+  int64_t hedge_delay;
+  uint64_t hedges;
+  uint64_t hedge_wins;
+  hsk_name_req_t *prefetch;
+  int prefetch_count;
+  uint8_t prefetch_root[32];
   int64_t block_time;
   int64_t getheaders_time;
   char *user_agent;
@@ -123,7 +231,10 @@ bool
 hsk_pool_set_key(hsk_pool_t *pool, const uint8_t *key);
 
 bool
-hsk_pool_set_size(hsk_pool_t *pool, int max_size);
+hsk_pool_set_size(hsk_pool_t *pool, int min_size);
+
+bool
+hsk_pool_set_max_size(hsk_pool_t *pool, int max_size);
 
 bool
 hsk_pool_set_seeds(hsk_pool_t *pool, const char *seeds);
@@ -153,4 +264,12 @@ hsk_pool_resolve(
   hsk_resolve_cb callback,
   const void *arg
 );
+
+int
+hsk_pool_resolve_background(
+  hsk_pool_t *pool,
+  const char *name,
+  hsk_resolve_cb callback,
+  const void *arg
+);
 #endif
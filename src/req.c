@@ -8,6 +8,7 @@
 #include <stdio.h>
 
 #include "addr.h"
+#include "bio.h"
 #include "constants.h"
 #include "dns.h"
 #include "ec.h"
@@ -20,6 +21,8 @@ void
 hsk_dns_req_init(hsk_dns_req_t *req) {
   assert(req);
   req->ns = NULL;
+  req->worker = NULL;
+  req->tcp = 0;
   req->id = 0;
   req->labels = 0;
   memset(req->name, 0x00, sizeof(req->name));
@@ -30,6 +33,9 @@ hsk_dns_req_init(hsk_dns_req_t *req) {
   req->ad = false;
   req->edns = false;
   req->dnssec = false;
+  memset(req->lower, 0x00, sizeof(req->lower));
+  req->name_len = 0;
+  req->dirty = false;
   memset(req->tld, 0x00, sizeof(req->tld));
   memset(&req->ss, 0x00, sizeof(struct sockaddr_storage));
   req->addr = (struct sockaddr *)&req->ss;
@@ -56,21 +62,249 @@ hsk_dns_req_free(hsk_dns_req_t *req) {
 }
 
 hsk_dns_req_t *
-hsk_dns_req_create(
-  const uint8_t *data,
-  size_t data_len,
-  const struct sockaddr *addr
-) {
-  hsk_dns_req_t *req = NULL;
-  hsk_dns_msg_t *msg = NULL;
+hsk_dns_req_clone(const hsk_dns_req_t *req) {
+  assert(req);
 
-  req = hsk_dns_req_alloc();
+  hsk_dns_req_t *copy = malloc(sizeof(hsk_dns_req_t));
 
-  if (!req)
-    goto fail;
+  if (!copy)
+    return NULL;
+
+  memcpy(copy, req, sizeof(hsk_dns_req_t));
+  copy->addr = (struct sockaddr *)&copy->ss;
+
+  return copy;
+}
+
+// Same test as hsk_dns_name_dirty(), one byte at a time.
+static inline bool
+hsk_dns_req_dirty(uint8_t c) {
+  switch (c) {
+    case 0x28 /*(*/:
+    case 0x29 /*)*/:
+    case 0x3b /*;*/:
+    case 0x20 /* */:
+    case 0x40 /*@*/:
+    case 0x22 /*"*/:
+    case 0x5c /*\\*/:
+      return true;
+  }
+
+  return c < 0x20 || c > 0x7e;
+}
+
+// Index a name filled in by a full decode.
+static bool
+hsk_dns_req_index(hsk_dns_req_t *req) {
+  size_t len = strlen(req->name);
+  bool dot = true;
+
+  req->labels = 0;
+  req->dirty = false;
+
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = (uint8_t)req->name[i];
+
+    if (c >= 'A' && c <= 'Z')
+      c |= 0x20;
+
+    req->lower[i] = (char)c;
+
+    if (c == '.') {
+      dot = true;
+      continue;
+    }
+
+    if (hsk_dns_req_dirty(c))
+      req->dirty = true;
+
+    if (dot) {
+      if (req->labels == HSK_DNS_MAX_LABELS)
+        return false;
+      req->label_offs[req->labels++] = (uint8_t)i;
+      dot = false;
+    }
+  }
+
+  req->lower[len] = '\0';
+  req->name_len = len;
+
+  return true;
+}
+
+// Single pass over a plain query: the header, one uncompressed
+// question and at most an OPT record, read in place. Fills in the
+// name, its lowercased copy, label offsets and TLD as it goes.
+// Returns 1 when parsed, 0 when a full decode should decide,
+// and -1 when the full decode would reject the query too.
+static int
+hsk_dns_req_read(hsk_dns_req_t *req, const uint8_t *data, size_t data_len) {
+  if (data_len < 12)
+    return -1;
+
+  uint16_t flags = get_u16be(&data[2]);
+  uint16_t qdcount = get_u16be(&data[4]);
+  uint16_t ancount = get_u16be(&data[6]);
+  uint16_t nscount = get_u16be(&data[8]);
+  uint16_t arcount = get_u16be(&data[10]);
+
+  if (((flags >> 11) & 0x0f) != HSK_DNS_QUERY
+      || (flags & 0x0f) != HSK_DNS_NOERROR) {
+    return -1;
+  }
+
+  if (qdcount != 1 || ancount != 0 || nscount != 0 || arcount > 1)
+    return 0;
+
+  size_t off = 12;
+  size_t noff = 0;
+  size_t tld = 0;
+  bool tld_dirty = false;
+
+  req->labels = 0;
+  req->dirty = false;
+
+  for (;;) {
+    if (off >= data_len)
+      return -1;
+
+    uint8_t c = data[off];
+
+    off += 1;
+
+    if (c == 0x00)
+      break;
+
+    // Leave pointers to the full decoder.
+    if (c & 0xc0)
+      return (c & 0xc0) == 0xc0 ? 0 : -1;
+
+    if (off + c > data_len)
+      return -1;
+
+    if (noff + c + 1 > HSK_DNS_MAX_NAME)
+      return -1;
+
+    assert(req->labels < HSK_DNS_MAX_LABELS);
+
+    req->label_offs[req->labels++] = (uint8_t)noff;
+    tld = noff;
+    tld_dirty = false;
+
+    for (size_t j = 0; j < c; j++) {
+      uint8_t b = data[off + j];
+
+      // As hsk_dns_name_parse() does.
+      if (b == 0x00)
+        b = 0xff;
+
+      if (b == 0x2e)
+        b = 0xfe;
+
+      if (hsk_dns_req_dirty(b))
+        tld_dirty = true;
+
+      req->name[noff] = (char)b;
+
+      if (b >= 'A' && b <= 'Z')
+        b |= 0x20;
+
+      req->lower[noff] = (char)b;
+
+      noff += 1;
+    }
+
+    if (tld_dirty)
+      req->dirty = true;
+
+    req->name[noff] = '.';
+    req->lower[noff] = '.';
+    noff += 1;
+    off += c;
+  }
+
+  if (noff == 0) {
+    req->name[noff] = '.';
+    req->lower[noff] = '.';
+    noff += 1;
+  }
+
+  req->name[noff] = '\0';
+  req->lower[noff] = '\0';
+  req->name_len = noff;
+
+  // Don't allow dirty TLDs.
+  if (tld_dirty)
+    return -1;
+
+  if (req->labels > 0) {
+    size_t tld_len = noff - 1 - tld;
+    memcpy(req->tld, &req->lower[tld], tld_len);
+    req->tld[tld_len] = '\0';
+  } else {
+    req->tld[0] = '\0';
+  }
+
+  if (off + 4 > data_len)
+    return -1;
+
+  req->type = get_u16be(&data[off]);
+  req->class = get_u16be(&data[off + 2]);
+  off += 4;
+
+  req->edns = false;
+  req->dnssec = false;
+  req->max_size = HSK_DNS_MAX_UDP;
+
+  if (arcount == 1 && off < data_len) {
+    // OPT is owned by the root.
+    if (data[off] != 0x00)
+      return 0;
+
+    if (off + 11 > data_len)
+      return -1;
+
+    uint16_t type = get_u16be(&data[off + 1]);
+    uint16_t size = get_u16be(&data[off + 3]);
+    uint32_t ttl = get_u32be(&data[off + 5]);
+    uint16_t rd_len = get_u16be(&data[off + 9]);
+
+    if (type != HSK_DNS_OPT)
+      return 0;
+
+    if (off + 11 + rd_len > data_len)
+      return -1;
+
+    // Extended RCODE.
+    if ((ttl >> 24) != 0)
+      return -1;
+
+    req->edns = true;
+
+    if (size >= HSK_DNS_MAX_UDP) {
+      req->max_size = size;
+      if (req->max_size > HSK_DNS_MAX_EDNS)
+        req->max_size = HSK_DNS_MAX_EDNS;
+    }
+
+    req->dnssec = (ttl & HSK_DNS_DO) != 0;
+  }
+
+  req->id = get_u16be(&data[0]);
+  req->rd = (flags & HSK_DNS_RD) != 0;
+  req->cd = (flags & HSK_DNS_CD) != 0;
+  req->ad = (flags & HSK_DNS_AD) != 0;
+
+  return 1;
+}
+
+// Anything the single pass won't take.
+static bool
+hsk_dns_req_decode(hsk_dns_req_t *req, const uint8_t *data, size_t data_len) {
+  hsk_dns_msg_t *msg = NULL;
 
   if (!hsk_dns_msg_decode(data, data_len, &msg))
-    goto fail;
+    return false;
 
   if (msg->opcode != HSK_DNS_QUERY
       || msg->code != HSK_DNS_NOERROR
@@ -102,12 +336,8 @@ hsk_dns_req_create(
   // Lowercase.
   hsk_to_lower(req->tld);
 
-  // Reference.
-  req->ns = NULL;
-
   // DNS stuff.
   req->id = msg->id;
-  req->labels = hsk_dns_label_count(qs->name);
   strcpy(req->name, qs->name);
   req->type = qs->type;
   req->class = qs->class;
@@ -123,22 +353,65 @@ hsk_dns_req_create(
   }
   req->dnssec = (msg->edns.flags & HSK_DNS_DO) != 0;
 
-  // Sender address.
-  hsk_sa_copy(req->addr, addr);
+  if (!hsk_dns_req_index(req))
+    goto fail;
 
   // Free stuff up.
   hsk_dns_msg_free(msg);
 
-  return req;
+  return true;
 
 fail:
-  if (req)
-    free(req);
+  hsk_dns_msg_free(msg);
+  return false;
+}
 
-  if (msg)
-    hsk_dns_msg_free(msg);
+// Parse a query into caller-provided storage.
+bool
+hsk_dns_req_parse(
+  hsk_dns_req_t *req,
+  const uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr
+) {
+  assert(req && data);
+
+  hsk_dns_req_init(req);
+
+  switch (hsk_dns_req_read(req, data, data_len)) {
+    case -1:
+      return false;
+    case 0:
+      hsk_dns_req_init(req);
+      if (!hsk_dns_req_decode(req, data, data_len))
+        return false;
+      break;
+  }
+
+  // Sender address.
+  if (addr)
+    hsk_sa_copy(req->addr, addr);
 
-  return NULL;
+  return true;
+}
+
+hsk_dns_req_t *
+hsk_dns_req_create(
+  const uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr
+) {
+  hsk_dns_req_t *req = malloc(sizeof(hsk_dns_req_t));
+
+  if (!req)
+    return NULL;
+
+  if (!hsk_dns_req_parse(req, data, data_len, addr)) {
+    free(req);
+    return NULL;
+  }
+
+  return req;
 }
 
 void
@@ -161,16 +434,17 @@ hsk_dns_req_print(const hsk_dns_req_t *req, const char *prefix) {
   printf("%s  addr=%s\n", prefix, addr);
 }
 
+// Build the reply for `req` without signing it. When `sig0`
+// is set, room is left for a SIG(0) record to be appended.
 bool
-hsk_dns_msg_finalize(
+hsk_dns_msg_finalize_raw(
   hsk_dns_msg_t **res,
   const hsk_dns_req_t *req,
-  const hsk_ec_t *ec,
-  const uint8_t *key,
+  bool sig0,
   uint8_t **wire,
   size_t *wire_len
 ) {
-  assert(res && req && ec && wire && wire_len);
+  assert(res && req && wire && wire_len);
 
   hsk_dns_msg_t *msg = *res;
 
@@ -211,7 +485,7 @@ hsk_dns_msg_finalize(
   // Reset question.
   hsk_dns_rrs_uninit(&msg->qd);
 
-  hsk_dns_qs_t *qs = hsk_dns_qs_alloc();
+  hsk_dns_qs_t *qs = hsk_dns_rr_alloc_in(msg->arena);
 
   if (!qs) {
     hsk_dns_msg_free(msg);
@@ -251,7 +525,7 @@ hsk_dns_msg_finalize(
   // Truncate.
   size_t max = req->max_size;
 
-  if (key)
+  if (sig0)
     max -= HSK_SIG0_RR_SIZE;
 
   if (!hsk_dns_msg_truncate(data, data_len, max, &data_len)) {
@@ -259,16 +533,30 @@ hsk_dns_msg_finalize(
     return false;
   }
 
-  if (!key) {
-    *wire = data;
-    *wire_len = data_len;
-    return true;
-  }
+  *wire = data;
+  *wire_len = data_len;
+
+  return true;
+}
+
+// Append a SIG(0) record. Takes ownership of `data`.
+bool
+hsk_dns_msg_sign(
+  const hsk_ec_t *ec,
+  const uint8_t *key,
+  uint8_t *data,
+  size_t data_len,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  assert(ec && key && data && wire && wire_len);
 
-  // Sign.
   uint8_t *out = NULL;
   size_t out_len = 0;
 
+  *wire = NULL;
+  *wire_len = 0;
+
   if (!hsk_sig0_sign(ec, key, data, data_len, &out, &out_len)) {
     free(data);
     return false;
@@ -282,3 +570,29 @@ hsk_dns_msg_finalize(
 
   return true;
 }
+
+bool
+hsk_dns_msg_finalize(
+  hsk_dns_msg_t **res,
+  const hsk_dns_req_t *req,
+  const hsk_ec_t *ec,
+  const uint8_t *key,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  assert(res && req && ec && wire && wire_len);
+
+  uint8_t *data = NULL;
+  size_t data_len = 0;
+
+  if (!hsk_dns_msg_finalize_raw(res, req, key != NULL, &data, &data_len))
+    return false;
+
+  if (!key) {
+    *wire = data;
+    *wire_len = data_len;
+    return true;
+  }
+
+  return hsk_dns_msg_sign(ec, key, data, data_len, wire, wire_len);
+}
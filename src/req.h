@@ -13,6 +13,10 @@
 typedef struct {
   // Reference.
   void *ns;
+  // Worker thread which received the query, if any.
+  void *worker;
+  // TCP connection which carried the query, 0 for UDP.
+  int tcp;
 
   // DNS stuff
   uint16_t id;
@@ -27,6 +31,13 @@ typedef struct {
   size_t max_size;
   bool dnssec;
 
+  // Lowercased copy of the name and where each label starts,
+  // kept from parsing so cache keys need no further passes.
+  char lower[HSK_DNS_MAX_NAME + 1];
+  size_t name_len;
+  uint8_t label_offs[HSK_DNS_MAX_LABELS];
+  bool dirty;
+
   // HSK stuff
   char tld[HSK_DNS_MAX_LABEL + 1];
 
@@ -47,6 +58,17 @@ hsk_dns_req_alloc(void);
 void
 hsk_dns_req_free(hsk_dns_req_t *req);
 
+hsk_dns_req_t *
+hsk_dns_req_clone(const hsk_dns_req_t *req);
+
+bool
+hsk_dns_req_parse(
+  hsk_dns_req_t *req,
+  const uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr
+);
+
 hsk_dns_req_t *
 hsk_dns_req_create(
   const uint8_t *data,
@@ -57,6 +79,25 @@ hsk_dns_req_create(
 void
 hsk_dns_req_print(const hsk_dns_req_t *req, const char *prefix);
 
+bool
+hsk_dns_msg_finalize_raw(
+  hsk_dns_msg_t **res,
+  const hsk_dns_req_t *req,
+  bool sig0,
+  uint8_t **wire,
+  size_t *wire_len
+);
+
+bool
+hsk_dns_msg_sign(
+  const hsk_ec_t *ec,
+  const uint8_t *key,
+  uint8_t *data,
+  size_t data_len,
+  uint8_t **wire,
+  size_t *wire_len
+);
+
 bool
 hsk_dns_msg_finalize(
   hsk_dns_msg_t **res,
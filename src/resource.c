@@ -8,6 +8,7 @@
 #include <stdbool.h>
 
 #include "addr.h"
+#include "arena.h"
 #include "base32.h"
 #include "bio.h"
 #include "dns.h"
@@ -475,6 +476,7 @@ hsk_resource_has_ns(const hsk_resource_t *res) {
 
 static bool
 hsk_resource_to_ns(
+  hsk_arena_t *arena,
   const hsk_resource_t *res,
   const char *name,
   hsk_dns_rrs_t *an
@@ -518,7 +520,7 @@ hsk_resource_to_ns(
       strcpy(nsname, c->name);
     }
 
-    hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_NS);
+    hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_NS);
 
     if (!rr)
       return false;
@@ -537,6 +539,7 @@ hsk_resource_to_ns(
 
 static bool
 hsk_resource_to_txt(
+  hsk_arena_t *arena,
   const hsk_resource_t *res,
   const char *name,
   hsk_dns_rrs_t *an
@@ -552,7 +555,7 @@ hsk_resource_to_txt(
     hsk_txt_record_t *rec = (hsk_txt_record_t *)c;
     hsk_dns_txts_t *txts = &rec->txts;
 
-    hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_TXT);
+    hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_TXT);
 
     if (!rr)
       return false;
@@ -564,7 +567,7 @@ hsk_resource_to_txt(
 
     int i;
     for (i = 0; i < txts->size; i++) {
-      hsk_dns_txt_t *txt = hsk_dns_txt_alloc();
+      hsk_dns_txt_t *txt = hsk_dns_txt_alloc_in(arena);
 
       if (!txt) {
         hsk_dns_rr_free(rr);
@@ -587,6 +590,7 @@ hsk_resource_to_txt(
 
 static bool
 hsk_resource_to_ds(
+  hsk_arena_t *arena,
   const hsk_resource_t *res,
   const char *name,
   hsk_dns_rrs_t *an
@@ -601,7 +605,7 @@ hsk_resource_to_ds(
 
     hsk_ds_record_t *rec = (hsk_ds_record_t *)c;
 
-    hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_DS);
+    hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_DS);
 
     if (!rr)
       return false;
@@ -616,7 +620,7 @@ hsk_resource_to_ds(
     rd->digest_type = rec->digest_type;
     rd->digest_len = rec->digest_len;
 
-    rd->digest = malloc(rec->digest_len);
+    rd->digest = hsk_arena_malloc(arena, rec->digest_len);
 
     if (!rd->digest) {
       hsk_dns_rr_free(rr);
@@ -633,6 +637,7 @@ hsk_resource_to_ds(
 
 static bool
 hsk_resource_to_glue(
+  hsk_arena_t *arena,
   const hsk_resource_t *res,
   const char *tld,
   hsk_dns_rrs_t *an
@@ -647,7 +652,7 @@ hsk_resource_to_glue(
         if (!hsk_dns_is_subdomain(tld, c->name))
           break;
 
-        hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_A);
+        hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_A);
         if (!rr)
           return false;
 
@@ -662,7 +667,7 @@ hsk_resource_to_glue(
         break;
       }
       case HSK_SYNTH4: {
-        hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_A);
+        hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_A);
         if (!rr)
           return false;
 
@@ -686,7 +691,7 @@ hsk_resource_to_glue(
         if (!hsk_dns_is_subdomain(tld, c->name))
           break;
 
-        hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_AAAA);
+        hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_AAAA);
         if (!rr)
           return false;
 
@@ -701,7 +706,7 @@ hsk_resource_to_glue(
         break;
       }
       case HSK_SYNTH6: {
-        hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_AAAA);
+        hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_AAAA);
         if (!rr)
           return false;
 
@@ -727,8 +732,8 @@ hsk_resource_to_glue(
 }
 
 bool
-hsk_resource_root_to_soa(hsk_dns_rrs_t *an) {
-  hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_SOA);
+hsk_resource_root_to_soa(hsk_arena_t *arena, hsk_dns_rrs_t *an) {
+  hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_SOA);
 
   if (!rr)
     return false;
@@ -868,12 +873,13 @@ hsk_resource_root_to_ds(hsk_dns_rrs_t *an) {
 
 bool
 hsk_resource_to_empty(
+  hsk_arena_t *arena,
   const char *name,
   const uint8_t *type_map,
   size_t type_map_len,
   hsk_dns_rrs_t *an
 ) {
-  hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_NSEC);
+  hsk_dns_rr_t *rr = hsk_dns_rr_create_in(arena, HSK_DNS_NSEC);
 
   if (!rr)
     return false;
@@ -889,7 +895,7 @@ hsk_resource_to_empty(
   rd->type_map_len = 0;
 
   if (type_map) {
-    uint8_t *buf = malloc(type_map_len);
+    uint8_t *buf = hsk_arena_malloc(arena, type_map_len);
 
     if (!buf) {
       hsk_dns_rr_free(rr);
@@ -938,8 +944,15 @@ hsk_resource_root_to_nsec(hsk_dns_rrs_t *an) {
   return true;
 }
 
+// Every object in the response, including signatures,
+// comes from `arena` (NULL for the heap).
 hsk_dns_msg_t *
-hsk_resource_to_dns(const hsk_resource_t *rs, const char *name, uint16_t type) {
+hsk_resource_to_dns(
+  hsk_arena_t *arena,
+  const hsk_resource_t *rs,
+  const char *name,
+  uint16_t type
+) {
   assert(hsk_dns_name_is_fqdn(name));
 
   int labels = hsk_dns_label_count(name);
@@ -954,7 +967,7 @@ hsk_resource_to_dns(const hsk_resource_t *rs, const char *name, uint16_t type) {
   if (tld_len > HSK_DNS_MAX_LABEL + 1)
     return NULL;
 
-  hsk_dns_msg_t *msg = hsk_dns_msg_alloc();
+  hsk_dns_msg_t *msg = hsk_dns_msg_alloc_in(arena);
 
   if (!msg)
     return NULL;
@@ -966,20 +979,20 @@ hsk_resource_to_dns(const hsk_resource_t *rs, const char *name, uint16_t type) {
   // Referral.
   if (labels > 1) {
     if (hsk_resource_has_ns(rs)) {
-      hsk_resource_to_ns(rs, tld, ns);
-      hsk_resource_to_ds(rs, tld, ns);
-      hsk_resource_to_glue(rs, tld, ar);
+      hsk_resource_to_ns(arena, rs, tld, ns);
+      hsk_resource_to_ds(arena, rs, tld, ns);
+      hsk_resource_to_glue(arena, rs, tld, ar);
       if (!hsk_resource_has(rs, HSK_DS))
-        hsk_dnssec_sign_zsk(ns, HSK_DNS_NS);
+        hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_NS);
       else
-        hsk_dnssec_sign_zsk(ns, HSK_DNS_DS);
+        hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_DS);
     } else {
       // Needs SOA.
       // Empty proof:
-      hsk_resource_to_empty(tld, NULL, 0, ns);
-      hsk_dnssec_sign_zsk(ns, HSK_DNS_NSEC);
-      hsk_resource_root_to_soa(ns);
-      hsk_dnssec_sign_zsk(ns, HSK_DNS_SOA);
+      hsk_resource_to_empty(arena, tld, NULL, 0, ns);
+      hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_NSEC);
+      hsk_resource_root_to_soa(arena, ns);
+      hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_SOA);
     }
 
     return msg;
@@ -988,18 +1001,18 @@ hsk_resource_to_dns(const hsk_resource_t *rs, const char *name, uint16_t type) {
   // Record types actually on-chain for HNS TLDs.
   switch (type) {
     case HSK_DNS_DS:
-      hsk_resource_to_ds(rs, name, an);
-      hsk_dnssec_sign_zsk(an, HSK_DNS_DS);
+      hsk_resource_to_ds(arena, rs, name, an);
+      hsk_dnssec_sign_zsk(arena, an, HSK_DNS_DS);
       break;
     case HSK_DNS_NS:
       // Includes SYNTH and GLUE records.
-      hsk_resource_to_ns(rs, name, ns);
-      hsk_resource_to_glue(rs, name, ar);
-      hsk_dnssec_sign_zsk(ns, HSK_DNS_NS);
+      hsk_resource_to_ns(arena, rs, name, ns);
+      hsk_resource_to_glue(arena, rs, name, ar);
+      hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_NS);
       break;
     case HSK_DNS_TXT:
-      hsk_resource_to_txt(rs, name, an);
-      hsk_dnssec_sign_zsk(an, HSK_DNS_TXT);
+      hsk_resource_to_txt(arena, rs, name, an);
+      hsk_dnssec_sign_zsk(arena, an, HSK_DNS_TXT);
       break;
   }
 
@@ -1009,20 +1022,20 @@ hsk_resource_to_dns(const hsk_resource_t *rs, const char *name, uint16_t type) {
   // Attempt to force a referral if we don't have an answer.
   if (an->size == 0 && ns->size == 0) {
     if (hsk_resource_has_ns(rs)) {
-      hsk_resource_to_ns(rs, name, ns);
-      hsk_resource_to_ds(rs, name, ns);
-      hsk_resource_to_glue(rs, name, ar);
+      hsk_resource_to_ns(arena, rs, name, ns);
+      hsk_resource_to_ds(arena, rs, name, ns);
+      hsk_resource_to_glue(arena, rs, name, ar);
       if (!hsk_resource_has(rs, HSK_DS))
-        hsk_dnssec_sign_zsk(ns, HSK_DNS_NS);
+        hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_NS);
       else
-        hsk_dnssec_sign_zsk(ns, HSK_DNS_DS);
+        hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_DS);
     } else {
       // Needs SOA.
       // Empty proof:
-      hsk_resource_to_empty(name, NULL, 0, ns);
-      hsk_dnssec_sign_zsk(ns, HSK_DNS_NSEC);
-      hsk_resource_root_to_soa(ns);
-      hsk_dnssec_sign_zsk(ns, HSK_DNS_SOA);
+      hsk_resource_to_empty(arena, name, NULL, 0, ns);
+      hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_NSEC);
+      hsk_resource_root_to_soa(arena, ns);
+      hsk_dnssec_sign_zsk(arena, ns, HSK_DNS_SOA);
     }
   }
 
@@ -1046,52 +1059,52 @@ hsk_resource_root(uint16_t type, const hsk_addr_t *addr) {
     case HSK_DNS_ANY:
     case HSK_DNS_NS:
       hsk_resource_root_to_ns(an);
-      hsk_dnssec_sign_zsk(an, HSK_DNS_NS);
+      hsk_dnssec_sign_zsk(NULL, an, HSK_DNS_NS);
 
       if (hsk_addr_is_ip4(addr)) {
         hsk_resource_root_to_a(ar, addr);
-        hsk_dnssec_sign_zsk(ar, HSK_DNS_A);
+        hsk_dnssec_sign_zsk(NULL, ar, HSK_DNS_A);
       }
 
       if (hsk_addr_is_ip6(addr)) {
         hsk_resource_root_to_aaaa(ar, addr);
-        hsk_dnssec_sign_zsk(ar, HSK_DNS_AAAA);
+        hsk_dnssec_sign_zsk(NULL, ar, HSK_DNS_AAAA);
       }
 
       break;
     case HSK_DNS_SOA:
-      hsk_resource_root_to_soa(an);
-      hsk_dnssec_sign_zsk(an, HSK_DNS_SOA);
+      hsk_resource_root_to_soa(NULL, an);
+      hsk_dnssec_sign_zsk(NULL, an, HSK_DNS_SOA);
 
       hsk_resource_root_to_ns(ns);
-      hsk_dnssec_sign_zsk(ns, HSK_DNS_NS);
+      hsk_dnssec_sign_zsk(NULL, ns, HSK_DNS_NS);
 
       if (hsk_addr_is_ip4(addr)) {
         hsk_resource_root_to_a(ar, addr);
-        hsk_dnssec_sign_zsk(ar, HSK_DNS_A);
+        hsk_dnssec_sign_zsk(NULL, ar, HSK_DNS_A);
       }
 
       if (hsk_addr_is_ip6(addr)) {
         hsk_resource_root_to_aaaa(ar, addr);
-        hsk_dnssec_sign_zsk(ar, HSK_DNS_AAAA);
+        hsk_dnssec_sign_zsk(NULL, ar, HSK_DNS_AAAA);
       }
 
       break;
     case HSK_DNS_DNSKEY:
       hsk_resource_root_to_dnskey(an);
-      hsk_dnssec_sign_ksk(an, HSK_DNS_DNSKEY);
+      hsk_dnssec_sign_ksk(NULL, an, HSK_DNS_DNSKEY);
       break;
     case HSK_DNS_DS:
       hsk_resource_root_to_ds(an);
-      hsk_dnssec_sign_zsk(an, HSK_DNS_DS);
+      hsk_dnssec_sign_zsk(NULL, an, HSK_DNS_DS);
       break;
     default:
       // Empty Proof:
       // Show all the types that we signed.
       hsk_resource_root_to_nsec(ns);
-      hsk_dnssec_sign_zsk(ns, HSK_DNS_NSEC);
-      hsk_resource_root_to_soa(ns);
-      hsk_dnssec_sign_zsk(ns, HSK_DNS_SOA);
+      hsk_dnssec_sign_zsk(NULL, ns, HSK_DNS_NSEC);
+      hsk_resource_root_to_soa(NULL, ns);
+      hsk_dnssec_sign_zsk(NULL, ns, HSK_DNS_SOA);
       break;
   }
 
@@ -1117,10 +1130,10 @@ hsk_resource_to_nx(void) {
   // breaking anything.
   hsk_resource_root_to_nsec(ns);
   hsk_resource_root_to_nsec(ns);
-  hsk_dnssec_sign_zsk(ns, HSK_DNS_NSEC);
+  hsk_dnssec_sign_zsk(NULL, ns, HSK_DNS_NSEC);
 
-  hsk_resource_root_to_soa(ns);
-  hsk_dnssec_sign_zsk(ns, HSK_DNS_SOA);
+  hsk_resource_root_to_soa(NULL, ns);
+  hsk_dnssec_sign_zsk(NULL, ns, HSK_DNS_SOA);
 
   return msg;
 }
@@ -1137,6 +1150,20 @@ hsk_resource_to_servfail(void) {
   return msg;
 }
 
+// Empty reply with TC set, telling
+// the client to retry over TCP.
+hsk_dns_msg_t *
+hsk_resource_to_truncated(void) {
+  hsk_dns_msg_t *msg = hsk_dns_msg_alloc();
+
+  if (!msg)
+    return NULL;
+
+  msg->flags |= HSK_DNS_TC;
+
+  return msg;
+}
+
 hsk_dns_msg_t *
 hsk_resource_to_notimp(void) {
   hsk_dns_msg_t *msg = hsk_dns_msg_alloc();
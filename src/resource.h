@@ -14,6 +14,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "addr.h"
+#include "arena.h"
 #include "dns.h"
 
 // Dummy record placeholder
@@ -77,7 +78,12 @@ bool
 hsk_resource_has_ns(const hsk_resource_t *res);
 
 hsk_dns_msg_t *
-hsk_resource_to_dns(const hsk_resource_t *rs, const char *name, uint16_t type);
+hsk_resource_to_dns(
+  hsk_arena_t *arena,
+  const hsk_resource_t *rs,
+  const char *name,
+  uint16_t type
+);
 
 hsk_dns_msg_t *
 hsk_resource_root(uint16_t type, const hsk_addr_t *addr);
@@ -91,11 +97,15 @@ hsk_resource_to_servfail(void);
 hsk_dns_msg_t *
 hsk_resource_to_notimp(void);
 
+hsk_dns_msg_t *
+hsk_resource_to_truncated(void);
+
 bool
 hsk_resource_is_ptr(const char *name);
 
 bool
 hsk_resource_to_empty(
+  hsk_arena_t *arena,
   const char *name,
   const uint8_t *type_map,
   size_t type_map_len,
@@ -103,7 +113,7 @@ hsk_resource_to_empty(
 );
 
 bool
-hsk_resource_root_to_soa(hsk_dns_rrs_t *an);
+hsk_resource_root_to_soa(hsk_arena_t *arena, hsk_dns_rrs_t *an);
 
 void
 ip_to_b32(const uint8_t *ip, char *dst, uint8_t family);
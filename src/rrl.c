@@ -0,0 +1,229 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "addr.h"
+#include "random.h"
+#include "rrl.h"
+#include "siphash.h"
+#include "uv.h"
+
+#define HSK_RRL_SETS (HSK_RRL_SIZE / HSK_RRL_WAYS)
+#define HSK_RRL_COST 1000
+
+/*
+ * Helpers
+ */
+
+static void
+hsk_rrl_refill(
+  const hsk_rrl_t *rrl,
+  hsk_rrl_entry_t *entry,
+  int64_t now,
+  bool fresh
+) {
+  int64_t cap = (int64_t)rrl->rate * HSK_RRL_BURST * HSK_RRL_COST;
+  int64_t proof_cap = (int64_t)rrl->proof_rate * HSK_RRL_BURST * HSK_RRL_COST;
+
+  if (fresh) {
+    entry->tokens = cap;
+    entry->proof_tokens = proof_cap;
+    entry->time = now;
+    entry->limited = 0;
+    return;
+  }
+
+  int64_t elapsed = now - entry->time;
+
+  if (elapsed <= 0)
+    return;
+
+  // One token per second is one thousandth per millisecond.
+  entry->tokens += elapsed * rrl->rate;
+  entry->proof_tokens += elapsed * rrl->proof_rate;
+
+  if (entry->tokens > cap)
+    entry->tokens = cap;
+
+  if (entry->proof_tokens > proof_cap)
+    entry->proof_tokens = proof_cap;
+
+  entry->time = now;
+}
+
+// Bucket for the source's prefix, or NULL if it is exempt.
+static hsk_rrl_entry_t *
+hsk_rrl_get(
+  hsk_rrl_t *rrl,
+  const struct sockaddr *sa,
+  int64_t now,
+  bool exempt_local
+) {
+  hsk_addr_t addr;
+
+  if (!hsk_addr_from_sa(&addr, sa))
+    return NULL;
+
+  if (exempt_local && hsk_addr_is_local(&addr))
+    return NULL;
+
+  uint8_t prefix[8];
+  size_t prefix_len;
+
+  if (hsk_addr_is_ip4(&addr)) {
+    prefix[0] = 4;
+    memcpy(&prefix[1], &addr.ip[12], HSK_RRL_IPV4_PREFIX / 8);
+    prefix_len = 1 + HSK_RRL_IPV4_PREFIX / 8;
+  } else {
+    prefix[0] = 6;
+    memcpy(&prefix[1], &addr.ip[0], HSK_RRL_IPV6_PREFIX / 8);
+    prefix_len = 1 + HSK_RRL_IPV6_PREFIX / 8;
+  }
+
+  uint64_t key = hsk_siphash(prefix, prefix_len, rrl->key);
+
+  // Zero marks an empty slot.
+  if (key == 0)
+    key = 1;
+
+  hsk_rrl_entry_t *set = &rrl->entries[(key % HSK_RRL_SETS) * HSK_RRL_WAYS];
+  hsk_rrl_entry_t *victim = &set[0];
+
+  for (int i = 0; i < HSK_RRL_WAYS; i++) {
+    hsk_rrl_entry_t *entry = &set[i];
+
+    if (entry->key == key) {
+      hsk_rrl_refill(rrl, entry, now, false);
+      return entry;
+    }
+
+    // Prefer an empty slot, then the least recently seen.
+    if (victim->key != 0 && (entry->key == 0 || entry->time < victim->time))
+      victim = entry;
+  }
+
+  victim->key = key;
+  hsk_rrl_refill(rrl, victim, now, true);
+
+  return victim;
+}
+
+/*
+ * Response Rate Limiting
+ */
+
+void
+hsk_rrl_init(hsk_rrl_t *rrl) {
+  assert(rrl);
+
+  // The salt keeps spoofed sources from
+  // aiming at one set; zero still works.
+  if (!hsk_randombytes(rrl->key, sizeof(rrl->key)))
+    memset(rrl->key, 0x00, sizeof(rrl->key));
+
+  rrl->rate = HSK_RRL_RATE;
+  rrl->proof_rate = HSK_RRL_PROOF_RATE;
+  rrl->passed = 0;
+  rrl->dropped = 0;
+  rrl->truncated = 0;
+  rrl->proofs_limited = 0;
+
+  memset(rrl->entries, 0x00, sizeof(rrl->entries));
+}
+
+void
+hsk_rrl_uninit(hsk_rrl_t *rrl) {
+  assert(rrl);
+  memset(rrl->entries, 0x00, sizeof(rrl->entries));
+}
+
+hsk_rrl_t *
+hsk_rrl_alloc(void) {
+  hsk_rrl_t *rrl = malloc(sizeof(hsk_rrl_t));
+
+  if (!rrl)
+    return NULL;
+
+  hsk_rrl_init(rrl);
+
+  return rrl;
+}
+
+void
+hsk_rrl_free(hsk_rrl_t *rrl) {
+  if (rrl) {
+    hsk_rrl_uninit(rrl);
+    free(rrl);
+  }
+}
+
+void
+hsk_rrl_set_rate(hsk_rrl_t *rrl, uint32_t rate, uint32_t proof_rate) {
+  assert(rrl);
+
+  rrl->rate = rate;
+  rrl->proof_rate = proof_rate;
+
+  // Balances were filled to the old caps.
+  memset(rrl->entries, 0x00, sizeof(rrl->entries));
+}
+
+// Charge a response to the source.
+int
+hsk_rrl_check(hsk_rrl_t *rrl, const struct sockaddr *addr, int64_t now) {
+  assert(rrl && addr);
+
+  if (rrl->rate == 0)
+    return HSK_RRL_PASS;
+
+  hsk_rrl_entry_t *entry = hsk_rrl_get(rrl, addr, now, true);
+
+  if (!entry)
+    return HSK_RRL_PASS;
+
+  if (entry->tokens >= HSK_RRL_COST) {
+    entry->tokens -= HSK_RRL_COST;
+    rrl->passed += 1;
+    return HSK_RRL_PASS;
+  }
+
+  entry->limited += 1;
+
+  if (HSK_RRL_SLIP > 0 && entry->limited % HSK_RRL_SLIP == 0) {
+    rrl->truncated += 1;
+    return HSK_RRL_TRUNCATE;
+  }
+
+  rrl->dropped += 1;
+
+  return HSK_RRL_DROP;
+}
+
+// Charge a new proof request to the source.  Loopback
+// is charged too: the recursive server's misses arrive
+// from there, and would otherwise reach the pool unbounded.
+bool
+hsk_rrl_proof(hsk_rrl_t *rrl, const struct sockaddr *addr, int64_t now) {
+  assert(rrl && addr);
+
+  if (rrl->proof_rate == 0)
+    return true;
+
+  hsk_rrl_entry_t *entry = hsk_rrl_get(rrl, addr, now, false);
+
+  if (!entry)
+    return true;
+
+  if (entry->proof_tokens >= HSK_RRL_COST) {
+    entry->proof_tokens -= HSK_RRL_COST;
+    return true;
+  }
+
+  rrl->proofs_limited += 1;
+
+  return false;
+}
@@ -0,0 +1,96 @@
+#ifndef _HSK_RRL_H
+#define _HSK_RRL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uv.h"
+
+/*
+ * Defs
+ */
+
+// Table entries, grouped into sets of HSK_RRL_WAYS.
+#define HSK_RRL_SIZE 4096
+#define HSK_RRL_WAYS 4
+
+// Responses per second per source prefix.
+#define HSK_RRL_RATE 200
+// New proof requests per second per source prefix.
+#define HSK_RRL_PROOF_RATE 20
+// Seconds of traffic a quiet prefix may send at once.
+#define HSK_RRL_BURST 2
+// Every Nth limited response is truncated rather than dropped.
+#define HSK_RRL_SLIP 2
+
+// Sources are grouped by network, as clients are.
+#define HSK_RRL_IPV4_PREFIX 24
+#define HSK_RRL_IPV6_PREFIX 56
+
+#define HSK_RRL_PASS 0
+#define HSK_RRL_DROP 1
+#define HSK_RRL_TRUNCATE 2
+
+/*
+ * Types
+ */
+
+typedef struct hsk_rrl_entry_s {
+  uint64_t key;
+  // Last refill (ms).
+  int64_t time;
+  // Balances in thousandths of a token.
+  int64_t tokens;
+  int64_t proof_tokens;
+  uint32_t limited;
+} hsk_rrl_entry_t;
+
+typedef struct hsk_rrl_s {
+  uint8_t key[16];
+  uint32_t rate;
+  uint32_t proof_rate;
+  uint64_t passed;
+  uint64_t dropped;
+  uint64_t truncated;
+  uint64_t proofs_limited;
+  hsk_rrl_entry_t entries[HSK_RRL_SIZE];
+} hsk_rrl_t;
+
+/*
+ * Response Rate Limiting
+ *
+ * Token buckets per source prefix: one for responses and one for queries
+ * which start a new proof request.  Buckets live in a fixed set-associative
+ * table keyed by a salted hash of the prefix, so a flood of spoofed sources
+ * only evicts other entries, never grows memory.
+ *
+ * Over its response budget a source gets every HSK_RRL_SLIP-th reply
+ * truncated, so a real client behind a spoofed address can still retry over
+ * TCP, and the rest dropped.  Loopback responses are never limited, but
+ * loopback proof requests are: the recursive server resolves through the
+ * root server over loopback, so every client of it shares that one proof
+ * budget.  A rate of zero disables the bucket.
+ */
+
+void
+hsk_rrl_init(hsk_rrl_t *rrl);
+
+void
+hsk_rrl_uninit(hsk_rrl_t *rrl);
+
+hsk_rrl_t *
+hsk_rrl_alloc(void);
+
+void
+hsk_rrl_free(hsk_rrl_t *rrl);
+
+void
+hsk_rrl_set_rate(hsk_rrl_t *rrl, uint32_t rate, uint32_t proof_rate);
+
+int
+hsk_rrl_check(hsk_rrl_t *rrl, const struct sockaddr *addr, int64_t now);
+
+bool
+hsk_rrl_proof(hsk_rrl_t *rrl, const struct sockaddr *addr, int64_t now);
+
+#endif
@@ -20,19 +20,12 @@
 #include "resource.h"
 #include "req.h"
 #include "rs.h"
+#include "sendpool.h"
+#include "tcp.h"
+#include "udp_batch.h"
 #include "utils.h"
 #include "uv.h"
 
-/*
- * Types
- */
-
-typedef struct {
-  hsk_rs_t *ns;
-  void *data;
-  bool should_free;
-} hsk_send_data_t;
-
 /*
  * Prototypes
  */
@@ -40,6 +33,14 @@ typedef struct {
 static void
 hsk_rs_log(hsk_rs_t *ns, const char *fmt, ...);
 
+static void
+hsk_rs_reply(
+  hsk_rs_t *ns,
+  const hsk_dns_req_t *req,
+  uint8_t *wire,
+  size_t wire_len
+);
+
 static int
 hsk_rs_send(
   hsk_rs_t *ns,
@@ -55,9 +56,6 @@ alloc_buffer(uv_handle_t *handle, size_t size, uv_buf_t *buf);
 static void
 after_worker_stop(void *data);
 
-static void
-after_send(uv_udp_send_t *req, int status);
-
 static void
 after_recv(
   uv_udp_t *socket,
@@ -67,6 +65,23 @@ after_recv(
   unsigned flags
 );
 
+static void
+after_batch_recv(
+  void *data,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+);
+
+static void
+after_tcp_recv(
+  void *data,
+  int conn,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+);
+
 static void
 after_resolve(void *data, int status, struct ub_result *result);
 
@@ -99,8 +114,15 @@ hsk_rs_init(hsk_rs_t *ns, const uv_loop_t *loop, const struct sockaddr *stub) {
   ns->loop = (uv_loop_t *)loop;
   ns->ub = ub;
   ns->socket = NULL;
+  ns->batch = NULL;
+  ns->sends = NULL;
+  ns->tcp = NULL;
   ns->rs_worker = NULL;
   ns->ec = ec;
+  hsk_rrl_init(&ns->rrl);
+  // Proofs are charged by the root server, where
+  // this server's loopback source has one budget.
+  hsk_rrl_set_rate(&ns->rrl, HSK_RRL_RATE, 0);
   ns->config = NULL;
   ns->stub = (struct sockaddr *)&ns->stub_;
   assert(hsk_sa_from_string(ns->stub, "127.0.0.1", HSK_NS_PORT));
@@ -152,6 +174,8 @@ hsk_rs_uninit(hsk_rs_t *ns) {
     free(ns->config);
     ns->config = NULL;
   }
+
+  hsk_rrl_uninit(&ns->rrl);
 }
 
 bool
@@ -220,7 +244,7 @@ hsk_rs_inject_options(hsk_rs_t *ns) {
   if (ub_ctx_set_option(ns->ub, "root-hints:", "") != 0)
     return false;
 
-  if (ub_ctx_set_option(ns->ub, "do-tcp:", "no") != 0)
+  if (ub_ctx_set_option(ns->ub, "do-tcp:", "yes") != 0)
     return false;
 
   char stub[HSK_MAX_HOST];
@@ -256,31 +280,57 @@ hsk_rs_open(hsk_rs_t *ns, const struct sockaddr *addr) {
   if (!hsk_rs_inject_options(ns))
     return HSK_EFAILURE;
 
-  ns->socket = malloc(sizeof(uv_udp_t));
-  if (!ns->socket)
-    return HSK_ENOMEM;
+  if (hsk_udp_batch_supported()) {
+    ns->batch = hsk_udp_batch_alloc(ns->loop, after_batch_recv, (void *)ns);
 
-  if (uv_udp_init(ns->loop, ns->socket) != 0)
-    return HSK_EFAILURE;
+    if (!ns->batch)
+      return HSK_ENOMEM;
 
-  ns->socket->data = (void *)ns;
+    if (hsk_udp_batch_open(ns->batch, addr, false) != HSK_SUCCESS)
+      return HSK_EFAILURE;
+  } else {
+    ns->socket = malloc(sizeof(uv_udp_t));
+    if (!ns->socket)
+      return HSK_ENOMEM;
 
-  if (uv_udp_bind(ns->socket, addr, 0) != 0)
-    return HSK_EFAILURE;
+    if (uv_udp_init(ns->loop, ns->socket) != 0)
+      return HSK_EFAILURE;
 
-  int value = sizeof(ns->read_buffer);
+    ns->socket->data = (void *)ns;
 
-  if (uv_send_buffer_size((uv_handle_t *)ns->socket, &value) != 0)
-    return HSK_EFAILURE;
+    ns->sends = hsk_sendpool_alloc();
 
-  if (uv_recv_buffer_size((uv_handle_t *)ns->socket, &value) != 0)
-    return HSK_EFAILURE;
+    if (!ns->sends)
+      return HSK_ENOMEM;
 
-  if (uv_udp_recv_start(ns->socket, alloc_buffer, after_recv) != 0)
-    return HSK_EFAILURE;
+    if (uv_udp_bind(ns->socket, addr, 0) != 0)
+      return HSK_EFAILURE;
+
+    int value = sizeof(ns->read_buffer);
+
+    if (uv_send_buffer_size((uv_handle_t *)ns->socket, &value) != 0)
+      return HSK_EFAILURE;
+
+    if (uv_recv_buffer_size((uv_handle_t *)ns->socket, &value) != 0)
+      return HSK_EFAILURE;
+
+    if (uv_udp_recv_start(ns->socket, alloc_buffer, after_recv) != 0)
+      return HSK_EFAILURE;
+  }
 
   ns->receiving = true;
 
+  ns->tcp = hsk_tcp_alloc(ns->loop, after_tcp_recv, (void *)ns);
+
+  if (!ns->tcp)
+    return HSK_ENOMEM;
+
+  if (hsk_tcp_open(ns->tcp, addr) != HSK_SUCCESS) {
+    hsk_rs_log(ns, "failed opening tcp listener\n");
+    hsk_tcp_free(ns->tcp);
+    ns->tcp = NULL;
+  }
+
   ns->rs_worker = hsk_rs_worker_alloc(ns->loop, (void *)ns, after_worker_stop);
   if (!ns->rs_worker)
     return HSK_EFAILURE;
@@ -354,7 +404,8 @@ hsk_rs_onrecv(
   const uint8_t *data,
   size_t data_len,
   const struct sockaddr *addr,
-  uint32_t flags
+  uint32_t flags,
+  int tcp
 ) {
   hsk_dns_req_t *req = hsk_dns_req_create(data, data_len, addr);
 
@@ -371,6 +422,28 @@ hsk_rs_onrecv(
   hsk_dns_req_print(req, "rs: ");
 
   req->ns = (void *)ns;
+  req->tcp = tcp;
+
+  // No size limit beyond the length prefix.
+  if (tcp)
+    req->max_size = HSK_DNS_MAX_TCP;
+
+  if (!tcp) {
+    switch (hsk_rrl_check(&ns->rrl, addr, uv_now(ns->loop))) {
+      case HSK_RRL_DROP:
+        goto done;
+      case HSK_RRL_TRUNCATE:
+        // Left unsigned, as on the root server.
+        msg = hsk_resource_to_truncated();
+
+        if (msg && hsk_dns_msg_finalize_raw(&msg, req, false,
+                                            &wire, &wire_len)) {
+          hsk_rs_reply(ns, req, wire, wire_len);
+        }
+
+        goto done;
+    }
+  }
 
   if (req->type == HSK_DNS_ANY) {
     msg = hsk_resource_to_notimp();
@@ -404,7 +477,7 @@ fail:
     goto done;
   }
 
-  hsk_rs_send(ns, wire, wire_len, addr, true);
+  hsk_rs_reply(ns, req, wire, wire_len);
 
 done:
   hsk_dns_req_free(req);
@@ -498,7 +571,29 @@ fail:
   }
 
 done:
-  hsk_rs_send(ns, wire, wire_len, req->addr, true);
+  hsk_rs_reply(ns, req, wire, wire_len);
+}
+
+// Answer a query on whichever transport it arrived on.
+static void
+hsk_rs_reply(
+  hsk_rs_t *ns,
+  const hsk_dns_req_t *req,
+  uint8_t *wire,
+  size_t wire_len
+) {
+  if (!req->tcp) {
+    hsk_rs_send(ns, wire, wire_len, req->addr, true);
+    return;
+  }
+
+  if (!ns->tcp) {
+    free(wire);
+    return;
+  }
+
+  if (hsk_tcp_send(ns->tcp, req->tcp, wire, wire_len) != HSK_SUCCESS)
+    hsk_rs_log(ns, "tcp connection gone for reply (%u)\n", req->id);
 }
 
 static int
@@ -509,58 +604,20 @@ hsk_rs_send(
   const struct sockaddr *addr,
   bool should_free
 ) {
-  int rc = HSK_SUCCESS;
-  hsk_send_data_t *sd = NULL;
-  uv_udp_send_t *req = NULL;
-
-  if (!ns->socket) {
-    rc = HSK_EFAILURE;
-    goto fail;
-  }
-
-  sd = (hsk_send_data_t *)malloc(sizeof(hsk_send_data_t));
-
-  if (!sd) {
-    rc = HSK_ENOMEM;
-    goto fail;
-  }
-
-  req = (uv_udp_send_t *)malloc(sizeof(uv_udp_send_t));
-
-  if (!req) {
-    rc = HSK_ENOMEM;
-    goto fail;
-  }
-
-  sd->ns = ns;
-  sd->data = (void *)data;
-  sd->should_free = should_free;
-
-  req->data = (void *)sd;
+  if (ns->batch)
+    return hsk_udp_batch_send(ns->batch, data, data_len, addr, should_free);
 
-  uv_buf_t bufs[] = {
-    { .base = (char *)data, .len = data_len }
-  };
-
-  int status = uv_udp_send(req, ns->socket, bufs, 1, addr, after_send);
-
-  if (status != 0) {
-    hsk_rs_log(ns, "failed sending: %s\n", uv_strerror(status));
-    rc = HSK_EFAILURE;
-    goto fail;
+  if (!ns->socket || !ns->sends) {
+    if (data && should_free)
+      free(data);
+    return HSK_EFAILURE;
   }
 
-  return rc;
-
-fail:
-  if (sd)
-    free(sd);
-
-  if (req)
-    free(req);
+  int rc = hsk_sendpool_send(ns->sends, ns->socket, data, data_len, addr,
+                             should_free);
 
-  if (data && should_free)
-    free(data);
+  if (rc != HSK_SUCCESS)
+    hsk_rs_log(ns, "failed sending: %s\n", hsk_strerror(rc));
 
   return rc;
 }
@@ -592,6 +649,19 @@ after_worker_stop(void *data) {
     ns->rs_worker = NULL;
   }
 
+  if (ns->tcp) {
+    hsk_tcp_close(ns->tcp);
+    hsk_tcp_free(ns->tcp);
+    ns->tcp = NULL;
+  }
+
+  if (ns->batch) {
+    hsk_udp_batch_close(ns->batch);
+    hsk_udp_batch_free(ns->batch);
+    ns->batch = NULL;
+    ns->receiving = false;
+  }
+
   if (ns->receiving) {
     uv_udp_recv_stop(ns->socket);
     ns->receiving = false;
@@ -603,6 +673,12 @@ after_worker_stop(void *data) {
     ns->socket = NULL;
   }
 
+  // Outstanding sends are cancelled by the close and free it.
+  if (ns->sends) {
+    hsk_sendpool_release(ns->sends);
+    ns->sends = NULL;
+  }
+
   if (ns->ub) {
     ub_ctx_delete(ns->ub);
     ns->ub = NULL;
@@ -616,26 +692,6 @@ after_worker_stop(void *data) {
   stop_callback(stop_data);
 }
 
-static void
-after_send(uv_udp_send_t *req, int status) {
-  hsk_send_data_t *sd = (hsk_send_data_t *)req->data;
-  hsk_rs_t *ns = sd->ns;
-
-  if (sd->data && sd->should_free)
-    free(sd->data);
-
-  free(sd);
-  free(req);
-
-  if (!ns)
-    return;
-
-  if (status != 0) {
-    hsk_rs_log(ns, "send error: %s\n", uv_strerror(status));
-    return;
-  }
-}
-
 static void
 after_recv(
   uv_udp_t *socket,
@@ -668,10 +724,32 @@ after_recv(
     (uint8_t *)buf->base,
     (size_t)nread,
     (struct sockaddr *)addr,
-    (uint32_t)flags
+    (uint32_t)flags,
+    0
   );
 }
 
+static void
+after_batch_recv(
+  void *data,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+) {
+  hsk_rs_onrecv((hsk_rs_t *)data, buf, len, addr, 0, 0);
+}
+
+static void
+after_tcp_recv(
+  void *data,
+  int conn,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+) {
+  hsk_rs_onrecv((hsk_rs_t *)data, buf, len, addr, 0, conn);
+}
+
 static void
 after_resolve(void *data, int status, struct ub_result *result) {
   hsk_dns_req_t *req = (hsk_dns_req_t *)data;
@@ -8,7 +8,11 @@
 #include <unbound.h>
 
 #include "ec.h"
+#include "rrl.h"
 #include "rs_worker.h"
+#include "sendpool.h"
+#include "tcp.h"
+#include "udp_batch.h"
 #include "uv.h"
 
 /*
@@ -19,8 +23,12 @@ typedef struct {
   uv_loop_t *loop;
   struct ub_ctx *ub;
   uv_udp_t *socket;
+  hsk_udp_batch_t *batch;
+  hsk_sendpool_t *sends;
+  hsk_tcp_t *tcp;
   hsk_rs_worker_t *rs_worker;
   hsk_ec_t *ec;
+  hsk_rrl_t rrl;
   char *config;
   struct sockaddr_storage stub_;
   struct sockaddr *stub;
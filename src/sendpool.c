@@ -0,0 +1,208 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "error.h"
+#include "sendpool.h"
+#include "uv.h"
+
+/*
+ * Prototypes
+ */
+
+static void
+after_send(uv_udp_send_t *req, int status);
+
+/*
+ * Send Pool
+ */
+
+void
+hsk_sendpool_init(hsk_sendpool_t *pool) {
+  assert(pool);
+  pool->head = NULL;
+  pool->size = 0;
+  pool->max = HSK_SENDPOOL_MAX;
+  pool->pending = 0;
+  pool->closed = false;
+  pool->allocs = 0;
+  pool->try_sends = 0;
+  pool->queued = 0;
+  pool->errors = 0;
+}
+
+void
+hsk_sendpool_uninit(hsk_sendpool_t *pool) {
+  assert(pool);
+
+  hsk_send_t *send, *next;
+
+  for (send = pool->head; send; send = next) {
+    next = send->next;
+    free(send);
+  }
+
+  pool->head = NULL;
+  pool->size = 0;
+}
+
+hsk_sendpool_t *
+hsk_sendpool_alloc(void) {
+  hsk_sendpool_t *pool = malloc(sizeof(hsk_sendpool_t));
+
+  if (!pool)
+    return NULL;
+
+  hsk_sendpool_init(pool);
+
+  return pool;
+}
+
+// Drop the listener's reference.  Frees now, or once the
+// last pending send hands its context back.
+void
+hsk_sendpool_release(hsk_sendpool_t *pool) {
+  if (!pool)
+    return;
+
+  pool->closed = true;
+
+  if (pool->pending > 0)
+    return;
+
+  hsk_sendpool_uninit(pool);
+  free(pool);
+}
+
+hsk_send_t *
+hsk_sendpool_get(hsk_sendpool_t *pool) {
+  hsk_send_t *send = pool->head;
+
+  if (send) {
+    pool->head = send->next;
+    pool->size -= 1;
+  } else {
+    send = malloc(sizeof(hsk_send_t));
+
+    if (!send)
+      return NULL;
+
+    pool->allocs += 1;
+  }
+
+  send->pool = pool;
+  send->data = NULL;
+  send->should_free = false;
+  send->next = NULL;
+
+  pool->pending += 1;
+
+  return send;
+}
+
+void
+hsk_sendpool_put(hsk_sendpool_t *pool, hsk_send_t *send) {
+  assert(pool->pending > 0);
+
+  pool->pending -= 1;
+
+  if (pool->closed || pool->size >= pool->max) {
+    free(send);
+  } else {
+    send->next = pool->head;
+    pool->head = send;
+    pool->size += 1;
+  }
+
+  if (pool->closed && pool->pending == 0)
+    hsk_sendpool_release(pool);
+}
+
+// Send a datagram, taking ownership of `data` when `should_free` is set.
+int
+hsk_sendpool_send(
+  hsk_sendpool_t *pool,
+  uv_udp_t *socket,
+  uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr,
+  bool should_free
+) {
+  uv_buf_t bufs[] = {
+    { .base = (char *)data, .len = data_len }
+  };
+
+  // Fast path: straight onto the wire, nothing to keep around.
+  int status = uv_udp_try_send(socket, bufs, 1, addr);
+
+  if (status >= 0) {
+    pool->try_sends += 1;
+
+    if (data && should_free)
+      free(data);
+
+    return HSK_SUCCESS;
+  }
+
+  if (status != UV_EAGAIN) {
+    pool->errors += 1;
+
+    if (data && should_free)
+      free(data);
+
+    return HSK_EFAILURE;
+  }
+
+  // Would block: queue it behind whatever libuv already holds.
+  hsk_send_t *send = hsk_sendpool_get(pool);
+
+  if (!send) {
+    if (data && should_free)
+      free(data);
+
+    return HSK_ENOMEM;
+  }
+
+  send->data = data;
+  send->should_free = should_free;
+  send->req.data = (void *)send;
+
+  status = uv_udp_send(&send->req, socket, bufs, 1, addr, after_send);
+
+  if (status != 0) {
+    pool->errors += 1;
+
+    if (data && should_free)
+      free(data);
+
+    hsk_sendpool_put(pool, send);
+
+    return HSK_EFAILURE;
+  }
+
+  pool->queued += 1;
+
+  return HSK_SUCCESS;
+}
+
+/*
+ * UV behavior
+ */
+
+static void
+after_send(uv_udp_send_t *req, int status) {
+  hsk_send_t *send = (hsk_send_t *)req->data;
+  hsk_sendpool_t *pool = send->pool;
+
+  if (send->data && send->should_free)
+    free(send->data);
+
+  // Includes sends cancelled by closing the socket.
+  if (status != 0)
+    pool->errors += 1;
+
+  hsk_sendpool_put(pool, send);
+}
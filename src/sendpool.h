@@ -0,0 +1,82 @@
+#ifndef _HSK_SENDPOOL_H
+#define _HSK_SENDPOOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uv.h"
+
+/*
+ * Defs
+ */
+
+// Send contexts kept around for reuse.
+#define HSK_SENDPOOL_MAX 256
+
+/*
+ * Types
+ */
+
+struct hsk_sendpool_s;
+
+typedef struct hsk_send_s {
+  uv_udp_send_t req;
+  struct hsk_sendpool_s *pool;
+  uint8_t *data;
+  bool should_free;
+  struct hsk_send_s *next;
+} hsk_send_t;
+
+typedef struct hsk_sendpool_s {
+  hsk_send_t *head;
+  size_t size;
+  size_t max;
+  size_t pending;
+  bool closed;
+  uint64_t allocs;
+  uint64_t try_sends;
+  uint64_t queued;
+  uint64_t errors;
+} hsk_sendpool_t;
+
+/*
+ * Send Pool
+ *
+ * Per-listener UDP send path.  Replies first go out with a synchronous
+ * uv_udp_try_send(); only when the socket would block does a send context
+ * get queued, taken from a freelist rather than malloc'd each time.
+ *
+ * Queued sends can complete after their listener is gone, so the pool is
+ * released rather than freed: it lives on until the last pending send
+ * returns its context.
+ */
+
+void
+hsk_sendpool_init(hsk_sendpool_t *pool);
+
+void
+hsk_sendpool_uninit(hsk_sendpool_t *pool);
+
+hsk_sendpool_t *
+hsk_sendpool_alloc(void);
+
+void
+hsk_sendpool_release(hsk_sendpool_t *pool);
+
+hsk_send_t *
+hsk_sendpool_get(hsk_sendpool_t *pool);
+
+void
+hsk_sendpool_put(hsk_sendpool_t *pool, hsk_send_t *send);
+
+int
+hsk_sendpool_send(
+  hsk_sendpool_t *pool,
+  uv_udp_t *socket,
+  uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr,
+  bool should_free
+);
+
+#endif
@@ -0,0 +1,161 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "sigcache.h"
+#include "uv.h"
+
+static hsk_sigcache_t *global_cache = NULL;
+static uv_once_t global_once = UV_ONCE_INIT;
+
+/*
+ * Helpers
+ */
+
+static size_t
+hsk_sigcache_index(const hsk_sigcache_t *c, const uint8_t *hash) {
+  uint32_t n = ((uint32_t)hash[0] << 24)
+             | ((uint32_t)hash[1] << 16)
+             | ((uint32_t)hash[2] << 8)
+             | ((uint32_t)hash[3]);
+
+  return n % c->size;
+}
+
+static void
+hsk_sigcache_global_init(void) {
+  global_cache = hsk_sigcache_alloc(HSK_SIGCACHE_SIZE);
+}
+
+/*
+ * Signature Cache
+ */
+
+bool
+hsk_sigcache_init(hsk_sigcache_t *c, size_t size) {
+  assert(c && size > 0);
+
+  c->entries = calloc(size, sizeof(hsk_sigcache_entry_t));
+
+  if (!c->entries)
+    return false;
+
+  if (uv_mutex_init(&c->mutex) != 0) {
+    free(c->entries);
+    c->entries = NULL;
+    return false;
+  }
+
+  c->size = size;
+  c->hits = 0;
+  c->misses = 0;
+
+  return true;
+}
+
+void
+hsk_sigcache_uninit(hsk_sigcache_t *c) {
+  assert(c);
+
+  // Scrub: entries hold signatures and key digests.
+  memset(c->entries, 0x00, c->size * sizeof(hsk_sigcache_entry_t));
+  free(c->entries);
+  c->entries = NULL;
+  c->size = 0;
+
+  uv_mutex_destroy(&c->mutex);
+}
+
+hsk_sigcache_t *
+hsk_sigcache_alloc(size_t size) {
+  hsk_sigcache_t *c = malloc(sizeof(hsk_sigcache_t));
+
+  if (!c)
+    return NULL;
+
+  if (!hsk_sigcache_init(c, size)) {
+    free(c);
+    return NULL;
+  }
+
+  return c;
+}
+
+void
+hsk_sigcache_free(hsk_sigcache_t *c) {
+  if (!c)
+    return;
+
+  hsk_sigcache_uninit(c);
+  free(c);
+}
+
+bool
+hsk_sigcache_get(
+  hsk_sigcache_t *c,
+  const uint8_t *hash,
+  const uint8_t *priv,
+  uint8_t *sig
+) {
+  assert(c && hash && priv && sig);
+
+  uint8_t key[32];
+  hsk_hash_sha256(priv, 32, key);
+
+  uv_mutex_lock(&c->mutex);
+
+  size_t i = hsk_sigcache_index(c, hash);
+  const hsk_sigcache_entry_t *entry = &c->entries[i];
+  bool hit = entry->used
+          && memcmp(entry->hash, hash, 32) == 0
+          && memcmp(entry->key, key, 32) == 0;
+
+  if (hit) {
+    memcpy(sig, entry->sig, 64);
+    c->hits += 1;
+  } else {
+    c->misses += 1;
+  }
+
+  uv_mutex_unlock(&c->mutex);
+
+  return hit;
+}
+
+void
+hsk_sigcache_put(
+  hsk_sigcache_t *c,
+  const uint8_t *hash,
+  const uint8_t *priv,
+  const uint8_t *sig
+) {
+  assert(c && hash && priv && sig);
+
+  uint8_t key[32];
+  hsk_hash_sha256(priv, 32, key);
+
+  uv_mutex_lock(&c->mutex);
+
+  size_t i = hsk_sigcache_index(c, hash);
+  hsk_sigcache_entry_t *entry = &c->entries[i];
+
+  memcpy(entry->hash, hash, 32);
+  memcpy(entry->key, key, 32);
+  memcpy(entry->sig, sig, 64);
+  entry->used = true;
+
+  uv_mutex_unlock(&c->mutex);
+}
+
+// Shared by every signer in the process. NULL if it
+// could not be allocated, in which case nothing is cached.
+hsk_sigcache_t *
+hsk_sigcache_global(void) {
+  uv_once(&global_once, hsk_sigcache_global_init);
+  return global_cache;
+}
@@ -0,0 +1,77 @@
+#ifndef _HSK_SIGCACHE_H
+#define _HSK_SIGCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "uv.h"
+
+/*
+ * Defs
+ */
+
+#define HSK_SIGCACHE_SIZE 4096
+
+/*
+ * Types
+ */
+
+typedef struct hsk_sigcache_entry_s {
+  // Digest of the RRset and RRSIG fields being signed.
+  uint8_t hash[32];
+  // Digest of the private key which signed it.
+  uint8_t key[32];
+  uint8_t sig[64];
+  bool used;
+} hsk_sigcache_entry_t;
+
+typedef struct hsk_sigcache_s {
+  uv_mutex_t mutex;
+  hsk_sigcache_entry_t *entries;
+  size_t size;
+  uint64_t hits;
+  uint64_t misses;
+} hsk_sigcache_t;
+
+/*
+ * Signature Cache
+ *
+ * RRSIGs keyed by their signing hash.  Inception and expiration are part of
+ * that hash, so signatures are only shared while they are bucketed into the
+ * same window (see hsk_dns_sign_rrset()).  Direct mapped: a new signature
+ * simply replaces whatever held its slot.
+ */
+
+bool
+hsk_sigcache_init(hsk_sigcache_t *c, size_t size);
+
+void
+hsk_sigcache_uninit(hsk_sigcache_t *c);
+
+hsk_sigcache_t *
+hsk_sigcache_alloc(size_t size);
+
+void
+hsk_sigcache_free(hsk_sigcache_t *c);
+
+bool
+hsk_sigcache_get(
+  hsk_sigcache_t *c,
+  const uint8_t *hash,
+  const uint8_t *priv,
+  uint8_t *sig
+);
+
+void
+hsk_sigcache_put(
+  hsk_sigcache_t *c,
+  const uint8_t *hash,
+  const uint8_t *priv,
+  const uint8_t *sig
+);
+
+hsk_sigcache_t *
+hsk_sigcache_global(void);
+
+#endif
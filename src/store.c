@@ -17,7 +17,10 @@
 #  include <windows.h>
 #  define HSK_PATH_SEP '\\'
 #else
+#  include <fcntl.h>
+#  include <sys/mman.h>
 #  include <sys/stat.h>
+#  include <unistd.h>
 #  define HSK_PATH_SEP '/'
 #endif
 
@@ -43,13 +46,18 @@ hsk_store_exists(char *path) {
 }
 
 static void
-hsk_store_filename(char *prefix, char *path, uint32_t height) {
+hsk_store_filename(
+  char *prefix,
+  char *path,
+  const char *name,
+  uint32_t height
+) {
   sprintf(
     path,
     "%s%c%s_%s%s",
     prefix,
     HSK_PATH_SEP,
-    HSK_STORE_FILENAME,
+    name,
     HSK_NETWORK_NAME,
     HSK_STORE_EXTENSION
   );
@@ -90,8 +98,8 @@ hsk_store_write(const hsk_chain_t *chain) {
   // Prepare
   char path[HSK_STORE_PATH_MAX];
   char tmp[HSK_STORE_PATH_MAX];
-  hsk_store_filename(chain->prefix, tmp, height);
-  hsk_store_filename(chain->prefix, path, 0);
+  hsk_store_filename(chain->prefix, tmp, HSK_STORE_FILENAME, height);
+  hsk_store_filename(chain->prefix, path, HSK_STORE_FILENAME, 0);
 
   // Open file
   FILE *file = fopen(tmp, "w");
@@ -203,7 +211,7 @@ hsk_store_read(
   hsk_chain_t *chain
 ) {
   char path[HSK_STORE_PATH_MAX];
-  hsk_store_filename(chain->prefix, path, 0);
+  hsk_store_filename(chain->prefix, path, HSK_STORE_FILENAME, 0);
 
   hsk_store_log("loading checkpoint from file: %s\n", path);
 
@@ -247,3 +255,146 @@ hsk_store_read(
 
   return true;
 }
+
+bool
+hsk_store_cache_write(char *prefix, const uint8_t *data, size_t data_len) {
+  uint8_t hdr[HSK_STORE_CACHE_HEADER_SIZE];
+  uint8_t *hdr_ptr = (uint8_t *)&hdr;
+
+  write_u32be(&hdr_ptr, HSK_MAGIC);
+  write_u8(&hdr_ptr, HSK_STORE_CACHE_VERSION);
+
+  // Prepare
+  char path[HSK_STORE_PATH_MAX];
+  char tmp[HSK_STORE_PATH_MAX];
+  hsk_store_filename(prefix, tmp, HSK_STORE_CACHE_FILENAME, 1);
+  hsk_store_filename(prefix, path, HSK_STORE_CACHE_FILENAME, 0);
+
+  // Open file
+  FILE *file = fopen(tmp, "wb");
+  if (!file) {
+    hsk_store_log("could not open temp file to write cache: %s\n", tmp);
+    return false;
+  }
+
+  // Write temp
+  size_t written = fwrite(&hdr, 1, HSK_STORE_CACHE_HEADER_SIZE, file);
+  written += fwrite(data, 1, data_len, file);
+  fclose(file);
+
+  if (written != HSK_STORE_CACHE_HEADER_SIZE + data_len) {
+    hsk_store_log("could not write cache to temp file: %s\n", tmp);
+    remove(tmp);
+    return false;
+  }
+
+  // Rename
+#if defined(_WIN32)
+  remove(path);
+#endif
+
+  if (rename(tmp, path) != 0) {
+    hsk_store_log("failed to write cache file: %s\n", path);
+    return false;
+  }
+
+  hsk_store_log("wrote cache file: %s (%u bytes)\n", path, (uint32_t)written);
+
+  return true;
+}
+
+// Map the cache file into memory and check its header.
+// On success the caller must hand `data` and `data_len`
+// back to hsk_store_cache_release when done reading.
+bool
+hsk_store_cache_read(char *prefix, uint8_t **data, size_t *data_len) {
+  char path[HSK_STORE_PATH_MAX];
+  hsk_store_filename(prefix, path, HSK_STORE_CACHE_FILENAME, 0);
+
+  if (!hsk_store_exists(path))
+    return false;
+
+  hsk_store_log("loading cache from file: %s\n", path);
+
+  uint8_t *map = NULL;
+  size_t map_len = 0;
+
+#if defined(_WIN32)
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    hsk_store_log("could not open cache file: %s\n", path);
+    return false;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long end = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  if (end > 0) {
+    map_len = (size_t)end;
+    map = malloc(map_len);
+  }
+
+  if (!map || fread(map, 1, map_len, file) != map_len) {
+    hsk_store_log("could not read cache file: %s\n", path);
+    fclose(file);
+    free(map);
+    return false;
+  }
+
+  fclose(file);
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    hsk_store_log("could not open cache file: %s\n", path);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    hsk_store_log("could not read cache file: %s\n", path);
+    close(fd);
+    return false;
+  }
+
+  map_len = (size_t)st.st_size;
+  map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED) {
+    hsk_store_log("could not map cache file: %s\n", path);
+    return false;
+  }
+#endif
+
+  uint8_t *ptr = map;
+  size_t len = map_len;
+  uint32_t magic;
+  uint8_t version;
+
+  if (!read_u32be(&ptr, &len, &magic) || magic != HSK_MAGIC) {
+    hsk_store_log("invalid magic bytes in cache file: %s\n", path);
+    hsk_store_cache_release(map, map_len);
+    return false;
+  }
+
+  if (!read_u8(&ptr, &len, &version) || version != HSK_STORE_CACHE_VERSION) {
+    hsk_store_log("invalid version in cache file: %s\n", path);
+    hsk_store_cache_release(map, map_len);
+    return false;
+  }
+
+  *data = map;
+  *data_len = map_len;
+
+  return true;
+}
+
+void
+hsk_store_cache_release(uint8_t *data, size_t data_len) {
+#if defined(_WIN32)
+  free(data);
+#else
+  munmap(data, data_len);
+#endif
+}
@@ -23,6 +23,18 @@
 #define HSK_STORE_PATH_RESERVED 32
 #define HSK_STORE_PATH_MAX 1024
 
+// Version 0 cache store file serialization:
+// Size    Data
+//  4       network magic
+//  1       version (0)
+//  ...     name cache results (see namecache.c)
+//  ...     root nameserver cache entries (see cache.c)
+
+#define HSK_STORE_CACHE_VERSION 0
+#define HSK_STORE_CACHE_HEADER_SIZE 5
+#define HSK_STORE_CACHE_FILENAME "cache"
+#define HSK_STORE_CACHE_INTERVAL (5 * 60)
+
 /*
  * Store
  */
@@ -47,4 +59,13 @@ hsk_store_read(
   hsk_chain_t *chain
 );
 
+bool
+hsk_store_cache_write(char *prefix, const uint8_t *data, size_t data_len);
+
+bool
+hsk_store_cache_read(char *prefix, uint8_t **data, size_t *data_len);
+
+void
+hsk_store_cache_release(uint8_t *data, size_t data_len);
+
 #endif
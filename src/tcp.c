@@ -0,0 +1,464 @@
+#include "config.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error.h"
+#include "map.h"
+#include "platform-net.h"
+#include "tcp.h"
+#include "utils.h"
+#include "uv.h"
+
+/*
+ * Types
+ */
+
+typedef struct {
+  uv_write_t req;
+  uint8_t size[2];
+  uint8_t *data;
+} hsk_tcp_write_t;
+
+/*
+ * Prototypes
+ */
+
+static void
+hsk_tcp_conn_close(hsk_tcp_conn_t *conn);
+
+static void
+after_connection(uv_stream_t *server, int status);
+
+static void
+alloc_buffer(uv_handle_t *handle, size_t size, uv_buf_t *buf);
+
+static void
+after_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf);
+
+static void
+after_write(uv_write_t *req, int status);
+
+static void
+after_timer(uv_timer_t *timer);
+
+static void
+after_conn_close(uv_handle_t *handle);
+
+/*
+ * DNS over TCP
+ */
+
+int
+hsk_tcp_init(hsk_tcp_t *tcp, const uv_loop_t *loop, hsk_tcp_cb cb, void *data) {
+  if (!tcp || !loop || !cb)
+    return HSK_EBADARGS;
+
+  tcp->loop = (uv_loop_t *)loop;
+  tcp->socket = NULL;
+  hsk_map_init_int_map(&tcp->conns, NULL);
+  tcp->next_id = 0;
+  tcp->max_conns = HSK_TCP_MAX_CONNS;
+  tcp->cb = cb;
+  tcp->data = data;
+  tcp->accepted = 0;
+  tcp->rejected = 0;
+  tcp->queries = 0;
+  tcp->timeouts = 0;
+
+  return HSK_SUCCESS;
+}
+
+void
+hsk_tcp_uninit(hsk_tcp_t *tcp) {
+  if (!tcp)
+    return;
+
+  // Connections are owned by their handles; close first.
+  assert(tcp->conns.size == 0);
+
+  hsk_map_uninit(&tcp->conns);
+}
+
+hsk_tcp_t *
+hsk_tcp_alloc(const uv_loop_t *loop, hsk_tcp_cb cb, void *data) {
+  hsk_tcp_t *tcp = malloc(sizeof(hsk_tcp_t));
+
+  if (!tcp)
+    return NULL;
+
+  if (hsk_tcp_init(tcp, loop, cb, data) != HSK_SUCCESS) {
+    free(tcp);
+    return NULL;
+  }
+
+  return tcp;
+}
+
+void
+hsk_tcp_free(hsk_tcp_t *tcp) {
+  if (tcp) {
+    hsk_tcp_uninit(tcp);
+    free(tcp);
+  }
+}
+
+int
+hsk_tcp_open(hsk_tcp_t *tcp, const struct sockaddr *addr) {
+  if (!tcp || !addr)
+    return HSK_EBADARGS;
+
+  tcp->socket = malloc(sizeof(uv_tcp_t));
+
+  if (!tcp->socket)
+    return HSK_ENOMEM;
+
+  if (uv_tcp_init(tcp->loop, tcp->socket) != 0) {
+    free(tcp->socket);
+    tcp->socket = NULL;
+    return HSK_EFAILURE;
+  }
+
+  tcp->socket->data = (void *)tcp;
+
+  if (uv_tcp_bind(tcp->socket, addr, 0) != 0
+      || uv_listen((uv_stream_t *)tcp->socket, HSK_TCP_BACKLOG,
+                   after_connection) != 0) {
+    tcp->socket->data = NULL;
+    hsk_uv_close_free((uv_handle_t *)tcp->socket);
+    tcp->socket = NULL;
+    return HSK_EFAILURE;
+  }
+
+  return HSK_SUCCESS;
+}
+
+void
+hsk_tcp_close(hsk_tcp_t *tcp) {
+  if (!tcp)
+    return;
+
+  if (tcp->socket) {
+    tcp->socket->data = NULL;
+    hsk_uv_close_free((uv_handle_t *)tcp->socket);
+    tcp->socket = NULL;
+  }
+
+  hsk_map_t *map = &tcp->conns;
+  hsk_map_iter_t i;
+
+  for (i = hsk_map_begin(map); i != hsk_map_end(map); i++) {
+    if (!hsk_map_exists(map, i))
+      continue;
+
+    hsk_tcp_conn_close((hsk_tcp_conn_t *)hsk_map_value(map, i));
+  }
+}
+
+// Write a reply to a connection, taking ownership of `data`.  Fails if the
+// connection has gone away in the meantime.
+int
+hsk_tcp_send(hsk_tcp_t *tcp, int id, uint8_t *data, size_t data_len) {
+  hsk_tcp_conn_t *conn = hsk_map_get(&tcp->conns, &id);
+
+  if (!conn || conn->closing || data_len > HSK_DNS_MAX_TCP) {
+    free(data);
+    return HSK_EFAILURE;
+  }
+
+  if (conn->pending > 0)
+    conn->pending -= 1;
+
+  hsk_tcp_write_t *wr = malloc(sizeof(hsk_tcp_write_t));
+
+  if (!wr) {
+    free(data);
+    return HSK_ENOMEM;
+  }
+
+  wr->size[0] = (data_len >> 8) & 0xff;
+  wr->size[1] = data_len & 0xff;
+  wr->data = data;
+  wr->req.data = (void *)wr;
+
+  uv_buf_t bufs[] = {
+    { .base = (char *)wr->size, .len = 2 },
+    { .base = (char *)data, .len = data_len }
+  };
+
+  if (uv_write(&wr->req, (uv_stream_t *)&conn->socket, bufs, 2,
+               after_write) != 0) {
+    free(wr->data);
+    free(wr);
+    hsk_tcp_conn_close(conn);
+    return HSK_EFAILURE;
+  }
+
+  conn->active = uv_now(tcp->loop);
+
+  // Room for more queries again.
+  if (!conn->reading && conn->pending < HSK_TCP_MAX_PENDING) {
+    if (uv_read_start((uv_stream_t *)&conn->socket,
+                      alloc_buffer, after_read) == 0) {
+      conn->reading = true;
+    }
+  }
+
+  return HSK_SUCCESS;
+}
+
+/*
+ * Connections
+ */
+
+static void
+hsk_tcp_conn_close(hsk_tcp_conn_t *conn) {
+  if (conn->closing)
+    return;
+
+  conn->closing = true;
+
+  hsk_map_del(&conn->tcp->conns, &conn->id);
+
+  uv_timer_stop(&conn->timer);
+  uv_close((uv_handle_t *)&conn->timer, after_conn_close);
+  uv_close((uv_handle_t *)&conn->socket, after_conn_close);
+}
+
+// Hand every complete message in `data` to the callback.
+// Returns the number of bytes consumed.
+static size_t
+hsk_tcp_conn_parse(hsk_tcp_conn_t *conn, const uint8_t *data, size_t len) {
+  hsk_tcp_t *tcp = conn->tcp;
+  size_t pos = 0;
+
+  while (len - pos >= 2 && !conn->closing) {
+    size_t size = ((size_t)data[pos] << 8) | data[pos + 1];
+
+    if (size == 0) {
+      hsk_tcp_conn_close(conn);
+      break;
+    }
+
+    if (len - pos - 2 < size)
+      break;
+
+    tcp->queries += 1;
+
+    // The reply may be sent before the callback returns.
+    conn->pending += 1;
+
+    tcp->cb(tcp->data, conn->id, &data[pos + 2], size,
+            (struct sockaddr *)&conn->ss);
+
+    pos += 2 + size;
+  }
+
+  return pos;
+}
+
+static bool
+hsk_tcp_conn_stash(hsk_tcp_conn_t *conn, const uint8_t *data, size_t len) {
+  if (conn->buf_len + len > conn->buf_size) {
+    size_t size = conn->buf_len + len;
+    uint8_t *buf = realloc(conn->buf, size);
+
+    if (!buf)
+      return false;
+
+    conn->buf = buf;
+    conn->buf_size = size;
+  }
+
+  memcpy(&conn->buf[conn->buf_len], data, len);
+  conn->buf_len += len;
+
+  return true;
+}
+
+static void
+hsk_tcp_conn_recv(hsk_tcp_conn_t *conn, const uint8_t *data, size_t len) {
+  // Common case: whole messages straight from the read buffer.
+  if (conn->buf_len == 0) {
+    size_t used = hsk_tcp_conn_parse(conn, data, len);
+
+    if (!conn->closing && used < len) {
+      if (!hsk_tcp_conn_stash(conn, &data[used], len - used))
+        hsk_tcp_conn_close(conn);
+    }
+
+    return;
+  }
+
+  if (!hsk_tcp_conn_stash(conn, data, len)) {
+    hsk_tcp_conn_close(conn);
+    return;
+  }
+
+  size_t used = hsk_tcp_conn_parse(conn, conn->buf, conn->buf_len);
+
+  if (conn->closing)
+    return;
+
+  conn->buf_len -= used;
+  memmove(conn->buf, &conn->buf[used], conn->buf_len);
+}
+
+/*
+ * UV behavior
+ */
+
+static void
+after_connection(uv_stream_t *server, int status) {
+  hsk_tcp_t *tcp = (hsk_tcp_t *)server->data;
+
+  if (!tcp || status < 0)
+    return;
+
+  hsk_tcp_conn_t *conn = calloc(1, sizeof(hsk_tcp_conn_t));
+
+  if (!conn)
+    return;
+
+  conn->tcp = tcp;
+
+  if (uv_tcp_init(tcp->loop, &conn->socket) != 0) {
+    free(conn);
+    return;
+  }
+
+  conn->socket.data = (void *)conn;
+  conn->handles = 1;
+
+  if (uv_accept(server, (uv_stream_t *)&conn->socket) != 0
+      || (int)tcp->conns.size >= tcp->max_conns) {
+    tcp->rejected += 1;
+    conn->closing = true;
+    uv_close((uv_handle_t *)&conn->socket, after_conn_close);
+    return;
+  }
+
+  uv_timer_init(tcp->loop, &conn->timer);
+  conn->timer.data = (void *)conn;
+  conn->handles = 2;
+
+  int namelen = sizeof(conn->ss);
+
+  uv_tcp_getpeername(&conn->socket, (struct sockaddr *)&conn->ss, &namelen);
+
+  do {
+    tcp->next_id = tcp->next_id == INT_MAX ? 1 : tcp->next_id + 1;
+  } while (hsk_map_has(&tcp->conns, &tcp->next_id));
+
+  conn->id = tcp->next_id;
+  conn->active = uv_now(tcp->loop);
+
+  if (!hsk_map_set(&tcp->conns, &conn->id, (void *)conn)) {
+    tcp->rejected += 1;
+    conn->closing = true;
+    uv_close((uv_handle_t *)&conn->timer, after_conn_close);
+    uv_close((uv_handle_t *)&conn->socket, after_conn_close);
+    return;
+  }
+
+  tcp->accepted += 1;
+
+  uv_tcp_nodelay(&conn->socket, 1);
+  uv_timer_start(&conn->timer, after_timer, HSK_TCP_IDLE_TIMEOUT, 0);
+
+  if (uv_read_start((uv_stream_t *)&conn->socket,
+                    alloc_buffer, after_read) != 0) {
+    hsk_tcp_conn_close(conn);
+    return;
+  }
+
+  conn->reading = true;
+}
+
+static void
+alloc_buffer(uv_handle_t *handle, size_t size, uv_buf_t *buf) {
+  hsk_tcp_conn_t *conn = (hsk_tcp_conn_t *)handle->data;
+
+  // Single threaded, and every read is consumed (or
+  // stashed) before the next one, so one buffer will do.
+  buf->base = (char *)conn->tcp->read_buffer;
+  buf->len = sizeof(conn->tcp->read_buffer);
+}
+
+static void
+after_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
+  hsk_tcp_conn_t *conn = (hsk_tcp_conn_t *)stream->data;
+
+  if (conn->closing)
+    return;
+
+  if (nread < 0) {
+    hsk_tcp_conn_close(conn);
+    return;
+  }
+
+  if (nread == 0)
+    return;
+
+  conn->active = uv_now(conn->tcp->loop);
+
+  hsk_tcp_conn_recv(conn, (uint8_t *)buf->base, (size_t)nread);
+
+  // Too many queries in flight: wait for replies.
+  if (!conn->closing && conn->pending >= HSK_TCP_MAX_PENDING) {
+    uv_read_stop(stream);
+    conn->reading = false;
+  }
+}
+
+static void
+after_write(uv_write_t *req, int status) {
+  hsk_tcp_write_t *wr = (hsk_tcp_write_t *)req->data;
+  hsk_tcp_conn_t *conn = (hsk_tcp_conn_t *)req->handle->data;
+
+  free(wr->data);
+  free(wr);
+
+  if (conn->closing)
+    return;
+
+  if (status != 0)
+    hsk_tcp_conn_close(conn);
+}
+
+static void
+after_timer(uv_timer_t *timer) {
+  hsk_tcp_conn_t *conn = (hsk_tcp_conn_t *)timer->data;
+  uint64_t now = uv_now(conn->tcp->loop);
+  uint64_t timeout = conn->pending > 0
+    ? HSK_TCP_QUERY_TIMEOUT
+    : HSK_TCP_IDLE_TIMEOUT;
+
+  if (now - conn->active < timeout) {
+    uv_timer_start(timer, after_timer, timeout - (now - conn->active), 0);
+    return;
+  }
+
+  conn->tcp->timeouts += 1;
+
+  hsk_tcp_conn_close(conn);
+}
+
+static void
+after_conn_close(uv_handle_t *handle) {
+  hsk_tcp_conn_t *conn = (hsk_tcp_conn_t *)handle->data;
+
+  conn->handles -= 1;
+
+  if (conn->handles > 0)
+    return;
+
+  if (conn->buf)
+    free(conn->buf);
+
+  free(conn);
+}
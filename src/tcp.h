@@ -0,0 +1,103 @@
+#ifndef _HSK_TCP_H
+#define _HSK_TCP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dns.h"
+#include "map.h"
+#include "uv.h"
+
+/*
+ * Defs
+ */
+
+#define HSK_TCP_MAX_CONNS 256
+// Queries per connection without a reply before reading pauses.
+#define HSK_TCP_MAX_PENDING 64
+// Idle connections are closed after this long (ms)...
+#define HSK_TCP_IDLE_TIMEOUT 10000
+// ...or after this long with queries still unanswered.
+#define HSK_TCP_QUERY_TIMEOUT 30000
+#define HSK_TCP_BACKLOG 128
+
+/*
+ * Types
+ */
+
+typedef void (*hsk_tcp_cb)(
+  void *data,
+  int conn,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+);
+
+struct hsk_tcp_s;
+
+typedef struct hsk_tcp_conn_s {
+  struct hsk_tcp_s *tcp;
+  int id;
+  uv_tcp_t socket;
+  uv_timer_t timer;
+  int handles;
+  struct sockaddr_storage ss;
+  // Partial message carried over between reads.
+  uint8_t *buf;
+  size_t buf_len;
+  size_t buf_size;
+  int pending;
+  uint64_t active;
+  bool reading;
+  bool closing;
+} hsk_tcp_conn_t;
+
+typedef struct hsk_tcp_s {
+  uv_loop_t *loop;
+  uv_tcp_t *socket;
+  hsk_map_t conns;
+  int next_id;
+  int max_conns;
+  hsk_tcp_cb cb;
+  void *data;
+  uint8_t read_buffer[2 + HSK_DNS_MAX_TCP];
+  uint64_t accepted;
+  uint64_t rejected;
+  uint64_t queries;
+  uint64_t timeouts;
+} hsk_tcp_t;
+
+/*
+ * DNS over TCP
+ *
+ * Listener for the root and recursive servers.  Messages are framed with a
+ * two byte length (RFC 1035 4.2.2).  A connection may carry many queries at
+ * once, and each reply is written as soon as it is ready, in whatever order
+ * they complete (RFC 7766 6.2.1.1).
+ *
+ * Replies are addressed by connection id rather than pointer, so a query
+ * which outlives its connection simply has its reply dropped.
+ */
+
+int
+hsk_tcp_init(hsk_tcp_t *tcp, const uv_loop_t *loop, hsk_tcp_cb cb, void *data);
+
+void
+hsk_tcp_uninit(hsk_tcp_t *tcp);
+
+hsk_tcp_t *
+hsk_tcp_alloc(const uv_loop_t *loop, hsk_tcp_cb cb, void *data);
+
+void
+hsk_tcp_free(hsk_tcp_t *tcp);
+
+int
+hsk_tcp_open(hsk_tcp_t *tcp, const struct sockaddr *addr);
+
+void
+hsk_tcp_close(hsk_tcp_t *tcp);
+
+int
+hsk_tcp_send(hsk_tcp_t *tcp, int conn, uint8_t *data, size_t data_len);
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef _HSK_TLD_HASH_H
+#define _HSK_TLD_HASH_H
+
+/* Autogenerated by scripts/tld-hash.js, do not edit. */
+
+#include <stdint.h>
+
+#define HSK_TLD_BUCKETS 371
+
+static const uint16_t HSK_TLD_DISP[HSK_TLD_BUCKETS] = {
+  1, 0, 116, 8, 10, 2, 0, 20, 19, 0, 0, 3,
+  37, 0, 382, 50, 26, 0, 55, 101, 0, 0, 50, 24,
+  61, 12, 14, 0, 0, 4, 111, 2, 3, 64, 127, 47,
+  10, 25, 1, 1, 15, 1, 0, 0, 0, 0, 128, 0,
+  10, 28, 2, 5, 1, 1, 148, 104, 24, 1, 10, 14,
+  40, 122, 70, 76, 12, 76, 27, 2, 9, 6, 51, 2,
+  59, 9, 105, 9, 22, 1, 4, 90, 127, 21, 136, 91,
+  78, 0, 22, 2, 141, 3, 100, 25, 961, 2, 6, 0,
+  55, 0, 132, 12, 64, 1, 17, 202, 0, 23, 4, 2,
+  44, 446, 88, 2, 29, 0, 514, 0, 19, 164, 30, 130,
+  2, 63, 366, 0, 2, 7, 169, 122, 117, 133, 1, 26,
+  59, 11, 399, 4, 218, 6, 27, 97, 13, 0, 5, 17,
+  17, 13, 26, 128, 3, 194, 57, 308, 18, 0, 8, 0,
+  2, 25, 16, 227, 79, 38, 4, 208, 46, 93, 49, 3,
+  12, 322, 8, 11, 106, 278, 105, 46, 3, 714, 37, 0,
+  229, 121, 1, 0, 188, 0, 287, 3, 128, 0, 3, 31,
+  25, 102, 131, 11, 52, 107, 187, 9, 12, 8, 136, 93,
+  3, 33, 0, 24, 7, 99, 128, 56, 62, 265, 312, 223,
+  49, 55, 0, 137, 113, 645, 0, 184, 0, 17, 8, 5,
+  129, 180, 146, 470, 56, 5, 98, 3, 2022, 0, 7, 28,
+  106, 744, 73, 9, 102, 56, 17, 12, 253, 1, 206, 90,
+  255, 12, 28, 110, 0, 1462, 1, 0, 0, 351, 131, 762,
+  172, 330, 419, 1, 28, 496, 32, 0, 3, 648, 36, 746,
+  2, 10, 14, 10, 4, 573, 5, 66, 1390, 0, 18, 82,
+  140, 1, 295, 66, 0, 2476, 88, 3, 41, 1, 1145, 167,
+  7, 19, 194, 64, 581, 448, 4, 145, 617, 59, 4, 361,
+  1068, 0, 4, 365, 47, 147, 17, 0, 648, 1405, 914, 63,
+  1819, 69, 2, 1088, 652, 72, 6, 310, 43, 315, 19, 1784,
+  230, 21, 3335, 964, 2146, 13, 27, 410, 79, 531, 991, 127,
+  16, 233, 159, 1060, 198, 6, 721, 2, 762, 426, 66, 232,
+  35, 913, 326, 799, 3676, 85, 0, 253, 1141, 6678, 6446
+};
+
+static const uint16_t HSK_TLD_SLOTS[HSK_TLD_SIZE] = {
+  1438, 405, 447, 273, 794, 1218, 1278, 486, 752, 1396, 41, 932,
+  1135, 745, 1074, 984, 936, 786, 401, 835, 1183, 265, 1295, 902,
+  673, 1448, 889, 858, 707, 122, 396, 522, 347, 509, 195, 160,
+  595, 748, 162, 674, 815, 457, 585, 1363, 970, 1134, 1385, 503,
+  75, 843, 1235, 531, 1463, 1432, 528, 1141, 838, 1237, 124, 679,
+  388, 1156, 719, 884, 59, 1315, 1318, 319, 725, 1041, 742, 928,
+  228, 824, 1145, 580, 1173, 116, 519, 706, 58, 119, 1472, 1288,
+  1051, 713, 1151, 1262, 279, 1312, 923, 130, 860, 151, 1143, 1461,
+  955, 1377, 437, 11, 109, 1451, 868, 738, 619, 438, 1374, 711,
+  138, 1294, 1280, 933, 534, 451, 1443, 431, 610, 1140, 174, 121,
+  1212, 1064, 1001, 506, 890, 526, 291, 481, 342, 943, 789, 224,
+  1128, 411, 385, 101, 1204, 1026, 1273, 111, 1421, 140, 607, 814,
+  854, 1042, 292, 14, 996, 1116, 1057, 25, 1401, 1221, 822, 1270,
+  345, 864, 832, 1327, 988, 1332, 787, 879, 1106, 1437, 905, 830,
+  1367, 951, 423, 680, 1357, 1358, 70, 200, 1011, 256, 249, 1410,
+  605, 1081, 352, 993, 496, 760, 185, 1209, 672, 668, 113, 208,
+  1469, 141, 652, 840, 583, 378, 839, 135, 705, 1405, 350, 473,
+  1292, 684, 649, 66, 50, 45, 1429, 1325, 373, 56, 1147, 1264,
+  425, 32, 191, 278, 99, 274, 549, 2, 1454, 999, 904, 3,
+  687, 222, 178, 831, 415, 961, 974, 553, 90, 1256, 324, 488,
+  375, 661, 895, 1413, 755, 521, 1445, 934, 520, 1211, 629, 1224,
+  618, 62, 308, 903, 1471, 1353, 36, 1012, 205, 167, 1420, 262,
+  1460, 334, 69, 535, 1120, 1434, 429, 460, 1061, 562, 445, 402,
+  682, 1202, 637, 34, 916, 367, 181, 688, 544, 930, 477, 1300,
+  230, 188, 638, 192, 1017, 1241, 825, 1271, 316, 1112, 1361, 907,
+  744, 1056, 1054, 1314, 9, 1289, 1150, 358, 311, 967, 1398, 330,
+  172, 539, 654, 866, 76, 1355, 560, 511, 80, 978, 297, 1477,
+  1285, 1125, 551, 1465, 611, 1217, 1182, 586, 1400, 434, 1274, 57,
+  176, 454, 695, 966, 1427, 318, 19, 1305, 186, 4, 919, 24,
+  52, 1031, 404, 756, 133, 931, 874, 929, 235, 10, 632, 878,
+  940, 1201, 1231, 321, 1137, 689, 472, 64, 478, 449, 103, 1326,
+  1096, 818, 622, 542, 1269, 368, 517, 1462, 1340, 715, 1069, 1253,
+  987, 1470, 1452, 272, 505, 463, 621, 298, 514, 154, 1313, 639,
+  780, 323, 441, 1091, 612, 1181, 1148, 1282, 920, 769, 1097, 731,
+  1184, 1167, 723, 131, 1036, 1195, 387, 1139, 37, 604, 343, 548,
+  95, 306, 1004, 533, 1005, 91, 1102, 1025, 1302, 1018, 1132, 1381,
+  958, 448, 500, 724, 1215, 8, 1441, 995, 317, 194, 397, 1003,
+  1379, 541, 149, 1476, 1007, 61, 658, 751, 1343, 968, 875, 857,
+  1076, 1094, 1199, 54, 1378, 312, 400, 1466, 476, 13, 366, 1090,
+  1095, 335, 1303, 458, 1099, 104, 1021, 718, 1079, 726, 241, 55,
+  685, 1293, 414, 1283, 947, 1298, 78, 614, 1223, 1333, 125, 821,
+  567, 1350, 600, 277, 870, 1016, 767, 446, 812, 158, 1409, 1196,
+  981, 1067, 1365, 1179, 1336, 912, 1309, 849, 1164, 530, 698, 1428,
+  648, 774, 665, 636, 1014, 148, 216, 547, 1430, 569, 871, 859,
+  1276, 359, 231, 647, 543, 389, 1023, 153, 5, 276, 564, 1478,
+  941, 948, 428, 110, 213, 283, 1163, 1015, 1299, 1013, 703, 896,
+  805, 260, 515, 165, 592, 1154, 749, 33, 93, 490, 710, 644,
+  550, 1113, 964, 128, 322, 1395, 1166, 1415, 1176, 443, 370, 598,
+  1371, 198, 43, 1457, 376, 788, 1364, 38, 510, 408, 354, 1088,
+  417, 570, 491, 1473, 1160, 1101, 1210, 1110, 681, 232, 743, 653,
+  296, 399, 508, 883, 81, 625, 426, 1259, 792, 49, 237, 627,
+  1068, 642, 1189, 561, 979, 800, 1158, 115, 937, 1009, 563, 26,
+  630, 1133, 867, 189, 1045, 935, 1408, 1186, 1267, 593, 157, 328,
+  1362, 1070, 1028, 764, 299, 861, 1246, 1266, 1103, 1372, 416, 1117,
+  484, 1389, 962, 1121, 513, 1475, 1397, 1447, 846, 177, 227, 1384,
+  1050, 6, 1417, 1203, 1059, 7, 436, 963, 671, 255, 1119, 696,
+  225, 538, 1100, 304, 471, 862, 694, 1392, 439, 179, 850, 1053,
+  175, 1027, 795, 1149, 1108, 1063, 733, 245, 1226, 1093, 238, 313,
+  1104, 248, 353, 1290, 1138, 287, 712, 635, 18, 357, 63, 1175,
+  1002, 499, 1324, 459, 337, 1044, 791, 1423, 834, 1087, 855, 664,
+  161, 690, 1345, 746, 42, 571, 772, 552, 631, 1168, 1360, 502,
+  886, 1373, 983, 143, 971, 85, 1307, 516, 234, 1020, 1260, 72,
+  976, 493, 1047, 487, 155, 209, 226, 773, 527, 735, 1172, 1188,
+  1404, 856, 365, 833, 946, 92, 1214, 374, 349, 597, 881, 118,
+  1341, 247, 1286, 1431, 360, 965, 203, 613, 532, 887, 1136, 1403,
+  1071, 699, 545, 199, 811, 914, 244, 21, 909, 1200, 114, 646,
+  1035, 48, 1115, 1399, 461, 778, 1402, 1304, 683, 852, 1406, 891,
+  20, 973, 880, 250, 1040, 1107, 617, 844, 556, 829, 667, 806,
+  1243, 1407, 1034, 714, 737, 1279, 393, 127, 1386, 30, 98, 410,
+  1205, 817, 1039, 282, 1416, 369, 331, 233, 280, 1479, 1, 1456,
+  960, 129, 1083, 845, 568, 1380, 953, 1144, 1198, 927, 616, 1439,
+  1436, 1046, 1348, 1240, 372, 1062, 469, 847, 420, 512, 1251, 529,
+  524, 442, 123, 1369, 1467, 183, 998, 1122, 379, 254, 576, 663,
+  395, 1170, 73, 68, 1072, 1239, 594, 251, 1178, 220, 485, 826,
+  954, 1284, 666, 741, 1426, 827, 288, 97, 1319, 212, 246, 1297,
+  659, 596, 708, 1098, 1425, 578, 1194, 623, 465, 1329, 1219, 1037,
+  721, 1244, 132, 1030, 146, 455, 252, 1376, 986, 1022, 609, 758,
+  470, 851, 1213, 853, 1335, 16, 808, 96, 581, 269, 603, 985,
+  494, 94, 1169, 453, 1085, 573, 559, 1342, 676, 975, 762, 294,
+  424, 799, 626, 972, 555, 1412, 686, 371, 1328, 1077, 1418, 1124,
+  892, 727, 918, 474, 1006, 691, 407, 766, 1440, 537, 444, 1247,
+  750, 108, 657, 1152, 1233, 809, 159, 991, 351, 992, 804, 285,
+  336, 501, 837, 1222, 483, 1354, 977, 346, 1255, 798, 989, 1310,
+  956, 1351, 1442, 1263, 1155, 263, 480, 302, 1177, 427, 747, 776,
+  634, 1078, 924, 82, 952, 271, 950, 949, 207, 615, 218, 327,
+  1346, 1308, 1114, 1197, 339, 1275, 381, 910, 945, 79, 184, 753,
+  720, 253, 303, 525, 214, 921, 1073, 1306, 1368, 1390, 1311, 1249,
+  105, 314, 1281, 678, 418, 740, 783, 990, 1142, 1236, 1118, 29,
+  267, 1157, 310, 739, 1024, 894, 136, 601, 820, 922, 819, 390,
+  591, 1220, 1268, 413, 201, 1393, 1321, 1029, 197, 1033, 869, 1019,
+  419, 518, 196, 793, 1127, 1435, 286, 338, 757, 495, 1322, 677,
+  1060, 47, 587, 944, 261, 779, 628, 1424, 1257, 163, 588, 173,
+  204, 88, 692, 1190, 572, 1344, 1446, 1058, 142, 117, 732, 640,
+  873, 348, 1301, 810, 589, 582, 229, 1187, 150, 1126, 466, 722,
+  702, 1414, 182, 765, 1375, 1331, 489, 599, 44, 669, 641, 893,
+  333, 100, 1180, 1291, 293, 215, 785, 1232, 497, 885, 112, 452,
+  558, 574, 888, 239, 206, 797, 813, 300, 1316, 969, 391, 1330,
+  1449, 1092, 913, 645, 1193, 768, 236, 361, 403, 1459, 959, 305,
+  270, 1008, 701, 46, 900, 926, 169, 734, 289, 492, 1131, 754,
+  1065, 842, 1038, 152, 1080, 1171, 1366, 363, 1089, 107, 782, 1207,
+  624, 102, 1010, 301, 421, 980, 1352, 1082, 507, 882, 1383, 901,
+  1084, 925, 193, 223, 915, 211, 823, 1111, 83, 716, 341, 1453,
+  392, 332, 450, 1272, 320, 170, 156, 1245, 168, 240, 675, 590,
+  579, 540, 1287, 848, 1234, 386, 863, 730, 816, 917, 139, 1230,
+  120, 565, 906, 1474, 1162, 1359, 1159, 577, 1370, 1129, 482, 27,
+  1468, 1339, 0, 242, 938, 656, 464, 364, 1411, 693, 340, 1055,
+  1394, 608, 23, 1252, 1450, 243, 264, 475, 1356, 356, 432, 939,
+  77, 1229, 670, 761, 377, 1254, 71, 383, 1320, 1387, 362, 697,
+  295, 137, 344, 1052, 1075, 498, 1130, 1153, 763, 807, 1349, 1086,
+  660, 997, 394, 380, 219, 1192, 67, 22, 89, 759, 1048, 422,
+  28, 1296, 60, 828, 355, 1317, 290, 1066, 504, 325, 39, 584,
+  1049, 145, 620, 709, 1191, 1458, 1225, 650, 643, 841, 134, 398,
+  147, 1347, 771, 1382, 1422, 704, 409, 1258, 31, 12, 221, 876,
+  268, 40, 1032, 729, 836, 897, 1444, 781, 17, 430, 468, 717,
+  942, 957, 210, 1105, 994, 557, 908, 1161, 126, 736, 899, 877,
+  164, 412, 1216, 655, 796, 651, 777, 275, 86, 144, 307, 217,
+  1334, 384, 575, 467, 382, 1455, 406, 1323, 1208, 803, 1261, 1265,
+  1388, 1419, 865, 329, 462, 1123, 536, 1338, 1391, 546, 1248, 1228,
+  259, 1000, 982, 326, 87, 315, 456, 554, 166, 1165, 1464, 258,
+  802, 74, 266, 284, 479, 784, 309, 1277, 106, 15, 1185, 1043,
+  1227, 566, 440, 728, 187, 65, 1238, 435, 53, 1242, 1206, 1109,
+  523, 775, 770, 790, 801, 1433, 633, 700, 35, 171, 872, 433,
+  911, 1480, 202, 1174, 1337, 51, 898, 1250, 257, 180, 190, 662,
+  602, 606, 281, 84, 1146
+};
+
+#endif
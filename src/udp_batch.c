@@ -0,0 +1,485 @@
+#include "config.h"
+
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG) && !defined(_WIN32)
+#define HSK_USE_MMSG
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HSK_USE_MMSG
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "error.h"
+#include "udp_batch.h"
+#include "utils.h"
+#include "uv.h"
+
+#ifdef HSK_USE_MMSG
+
+/*
+ * Types
+ */
+
+// Receive side buffers - only exist where struct mmsghdr does.
+typedef struct hsk_udp_batch_ctx_s {
+  struct mmsghdr rmsgs[HSK_UDP_BATCH];
+  struct iovec riov[HSK_UDP_BATCH];
+  struct sockaddr_storage raddrs[HSK_UDP_BATCH];
+  uint8_t rbufs[HSK_UDP_BATCH][HSK_UDP_BATCH_BUFFER];
+  struct mmsghdr smsgs[HSK_UDP_BATCH];
+  struct iovec siov[HSK_UDP_BATCH];
+} hsk_udp_batch_ctx_t;
+
+/*
+ * Prototypes
+ */
+
+static void
+after_poll(uv_poll_t *poll, int status, int events);
+
+static void
+after_prepare(uv_prepare_t *prepare);
+
+static void
+after_check(uv_check_t *check);
+
+#endif
+
+/*
+ * UDP Batching
+ */
+
+bool
+hsk_udp_batch_supported(void) {
+#ifdef HSK_USE_MMSG
+  return true;
+#else
+  return false;
+#endif
+}
+
+int
+hsk_udp_batch_init(
+  hsk_udp_batch_t *b,
+  const uv_loop_t *loop,
+  hsk_udp_batch_cb cb,
+  void *data
+) {
+  if (!b || !loop || !cb)
+    return HSK_EBADARGS;
+
+  b->loop = (uv_loop_t *)loop;
+  b->fd = -1;
+  b->poll = NULL;
+  b->prepare = NULL;
+  b->check = NULL;
+  b->events = 0;
+  b->cb = cb;
+  b->data = data;
+  b->ctx = NULL;
+  memset(b->queue, 0x00, sizeof(b->queue));
+  b->queued = 0;
+  b->recv_calls = 0;
+  b->recv_msgs = 0;
+  b->send_calls = 0;
+  b->send_msgs = 0;
+  b->send_drops = 0;
+
+#ifdef HSK_USE_MMSG
+  b->ctx = malloc(sizeof(hsk_udp_batch_ctx_t));
+
+  if (!b->ctx)
+    return HSK_ENOMEM;
+
+  return HSK_SUCCESS;
+#else
+  return HSK_EFAILURE;
+#endif
+}
+
+void
+hsk_udp_batch_uninit(hsk_udp_batch_t *b) {
+  if (!b)
+    return;
+
+  for (int i = 0; i < b->queued; i++)
+    free(b->queue[i].data);
+
+  b->queued = 0;
+
+  if (b->ctx) {
+    free(b->ctx);
+    b->ctx = NULL;
+  }
+}
+
+hsk_udp_batch_t *
+hsk_udp_batch_alloc(const uv_loop_t *loop, hsk_udp_batch_cb cb, void *data) {
+  hsk_udp_batch_t *b = malloc(sizeof(hsk_udp_batch_t));
+
+  if (!b)
+    return NULL;
+
+  if (hsk_udp_batch_init(b, loop, cb, data) != HSK_SUCCESS) {
+    hsk_udp_batch_uninit(b);
+    free(b);
+    return NULL;
+  }
+
+  return b;
+}
+
+void
+hsk_udp_batch_free(hsk_udp_batch_t *b) {
+  if (b) {
+    hsk_udp_batch_uninit(b);
+    free(b);
+  }
+}
+
+#ifdef HSK_USE_MMSG
+
+static int
+hsk_udp_batch_watch(hsk_udp_batch_t *b, int events) {
+  if (!b->poll || b->events == events)
+    return HSK_SUCCESS;
+
+  if (uv_poll_start(b->poll, events, after_poll) != 0)
+    return HSK_EFAILURE;
+
+  b->events = events;
+
+  return HSK_SUCCESS;
+}
+
+static void
+hsk_udp_batch_shift(hsk_udp_batch_t *b, int count) {
+  for (int i = 0; i < count; i++)
+    free(b->queue[i].data);
+
+  b->queued -= count;
+
+  memmove(&b->queue[0], &b->queue[count],
+          b->queued * sizeof(hsk_udp_batch_slot_t));
+}
+
+static void
+hsk_udp_batch_recv(hsk_udp_batch_t *b) {
+  hsk_udp_batch_ctx_t *ctx = b->ctx;
+
+  for (int i = 0; i < HSK_UDP_BATCH; i++) {
+    struct msghdr *hdr = &ctx->rmsgs[i].msg_hdr;
+
+    ctx->riov[i].iov_base = ctx->rbufs[i];
+    ctx->riov[i].iov_len = HSK_UDP_BATCH_BUFFER;
+
+    memset(hdr, 0x00, sizeof(struct msghdr));
+    hdr->msg_name = &ctx->raddrs[i];
+    hdr->msg_namelen = sizeof(struct sockaddr_storage);
+    hdr->msg_iov = &ctx->riov[i];
+    hdr->msg_iovlen = 1;
+  }
+
+  int n = recvmmsg(b->fd, ctx->rmsgs, HSK_UDP_BATCH, MSG_DONTWAIT, NULL);
+
+  if (n <= 0)
+    return;
+
+  b->recv_calls += 1;
+  b->recv_msgs += n;
+
+  for (int i = 0; i < n; i++) {
+    struct msghdr *hdr = &ctx->rmsgs[i].msg_hdr;
+
+    if (hdr->msg_flags & MSG_TRUNC)
+      continue;
+
+    b->cb(b->data,
+          ctx->rbufs[i],
+          ctx->rmsgs[i].msg_len,
+          (struct sockaddr *)&ctx->raddrs[i]);
+
+    // Closed from within the callback.
+    if (b->fd == -1)
+      break;
+  }
+}
+
+#endif
+
+int
+hsk_udp_batch_open(
+  hsk_udp_batch_t *b,
+  const struct sockaddr *addr,
+  bool reuseport
+) {
+#ifdef HSK_USE_MMSG
+  if (!b || !addr)
+    return HSK_EBADARGS;
+
+  int type = SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC;
+  int fd = socket(addr->sa_family, type, 0);
+
+  if (fd == -1)
+    return HSK_EFAILURE;
+
+  int on = 1;
+
+  if (reuseport) {
+#ifdef SO_REUSEPORT
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0) {
+      close(fd);
+      return HSK_EFAILURE;
+    }
+#else
+    close(fd);
+    return HSK_EFAILURE;
+#endif
+  }
+
+  // Room for a full batch in each direction.
+  int size = HSK_UDP_BATCH * HSK_UDP_BATCH_BUFFER;
+
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+  socklen_t len = addr->sa_family == AF_INET6
+    ? sizeof(struct sockaddr_in6)
+    : sizeof(struct sockaddr_in);
+
+  if (bind(fd, addr, len) != 0) {
+    close(fd);
+    return HSK_EFAILURE;
+  }
+
+  b->poll = malloc(sizeof(uv_poll_t));
+  b->prepare = malloc(sizeof(uv_prepare_t));
+  b->check = malloc(sizeof(uv_check_t));
+
+  if (!b->poll || !b->prepare || !b->check
+      || uv_poll_init(b->loop, b->poll, fd) != 0) {
+    free(b->poll);
+    free(b->prepare);
+    free(b->check);
+    b->poll = NULL;
+    b->prepare = NULL;
+    b->check = NULL;
+    close(fd);
+    return HSK_EFAILURE;
+  }
+
+  b->fd = fd;
+
+  uv_prepare_init(b->loop, b->prepare);
+  uv_check_init(b->loop, b->check);
+
+  b->poll->data = (void *)b;
+  b->prepare->data = (void *)b;
+  b->check->data = (void *)b;
+
+  if (hsk_udp_batch_watch(b, UV_READABLE) != HSK_SUCCESS
+      || uv_prepare_start(b->prepare, after_prepare) != 0
+      || uv_check_start(b->check, after_check) != 0) {
+    hsk_udp_batch_close(b);
+    return HSK_EFAILURE;
+  }
+
+  return HSK_SUCCESS;
+#else
+  return HSK_EFAILURE;
+#endif
+}
+
+void
+hsk_udp_batch_close(hsk_udp_batch_t *b) {
+  if (!b || b->fd == -1)
+    return;
+
+  // Best effort: whatever is still queued goes out now.
+  hsk_udp_batch_flush(b);
+
+  if (b->poll) {
+    b->poll->data = NULL;
+    hsk_uv_close_free((uv_handle_t *)b->poll);
+    b->poll = NULL;
+  }
+
+  if (b->prepare) {
+    b->prepare->data = NULL;
+    hsk_uv_close_free((uv_handle_t *)b->prepare);
+    b->prepare = NULL;
+  }
+
+  if (b->check) {
+    b->check->data = NULL;
+    hsk_uv_close_free((uv_handle_t *)b->check);
+    b->check = NULL;
+  }
+
+#ifdef HSK_USE_MMSG
+  close(b->fd);
+#endif
+
+  b->fd = -1;
+  b->events = 0;
+}
+
+// Queue a datagram for the next flush.  Takes ownership of `data` when
+// `should_free` is set, otherwise copies it.
+int
+hsk_udp_batch_send(
+  hsk_udp_batch_t *b,
+  uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr,
+  bool should_free
+) {
+  int rc = HSK_SUCCESS;
+
+  if (!b || b->fd == -1 || !addr) {
+    rc = HSK_EFAILURE;
+    goto fail;
+  }
+
+  if (b->queued == HSK_UDP_BATCH)
+    hsk_udp_batch_flush(b);
+
+  // Socket buffer is still full.
+  if (b->queued == HSK_UDP_BATCH) {
+    b->send_drops += 1;
+    rc = HSK_EFAILURE;
+    goto fail;
+  }
+
+  uint8_t *buf = data;
+
+  if (!should_free) {
+    buf = malloc(data_len);
+
+    if (!buf)
+      return HSK_ENOMEM;
+
+    memcpy(buf, data, data_len);
+  }
+
+  hsk_udp_batch_slot_t *slot = &b->queue[b->queued];
+
+  if (addr->sa_family == AF_INET6)
+    memcpy(&slot->ss, addr, sizeof(struct sockaddr_in6));
+  else
+    memcpy(&slot->ss, addr, sizeof(struct sockaddr_in));
+
+  slot->data = buf;
+  slot->data_len = data_len;
+
+  b->queued += 1;
+
+  return rc;
+
+fail:
+  if (data && should_free)
+    free(data);
+
+  return rc;
+}
+
+// Send everything queued with as few sendmmsg() calls as possible.
+int
+hsk_udp_batch_flush(hsk_udp_batch_t *b) {
+#ifdef HSK_USE_MMSG
+  if (!b || b->fd == -1)
+    return HSK_EFAILURE;
+
+  hsk_udp_batch_ctx_t *ctx = b->ctx;
+
+  while (b->queued > 0) {
+    for (int i = 0; i < b->queued; i++) {
+      hsk_udp_batch_slot_t *slot = &b->queue[i];
+      struct msghdr *hdr = &ctx->smsgs[i].msg_hdr;
+
+      ctx->siov[i].iov_base = slot->data;
+      ctx->siov[i].iov_len = slot->data_len;
+
+      memset(hdr, 0x00, sizeof(struct msghdr));
+      hdr->msg_name = &slot->ss;
+      hdr->msg_namelen = slot->ss.ss_family == AF_INET6
+        ? sizeof(struct sockaddr_in6)
+        : sizeof(struct sockaddr_in);
+      hdr->msg_iov = &ctx->siov[i];
+      hdr->msg_iovlen = 1;
+    }
+
+    int n = sendmmsg(b->fd, ctx->smsgs, b->queued, 0);
+
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+
+      // Wait for the socket to drain.
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return hsk_udp_batch_watch(b, UV_READABLE | UV_WRITABLE);
+
+      // Only the first datagram failed: drop it and carry on.
+      b->send_drops += 1;
+      hsk_udp_batch_shift(b, 1);
+      continue;
+    }
+
+    b->send_calls += 1;
+    b->send_msgs += n;
+
+    hsk_udp_batch_shift(b, n);
+  }
+
+  return hsk_udp_batch_watch(b, UV_READABLE);
+#else
+  return HSK_EFAILURE;
+#endif
+}
+
+/*
+ * UV behavior
+ */
+
+#ifdef HSK_USE_MMSG
+
+static void
+after_poll(uv_poll_t *poll, int status, int events) {
+  hsk_udp_batch_t *b = (hsk_udp_batch_t *)poll->data;
+
+  if (!b || status < 0)
+    return;
+
+  if (events & UV_WRITABLE)
+    hsk_udp_batch_flush(b);
+
+  if (events & UV_READABLE)
+    hsk_udp_batch_recv(b);
+}
+
+static void
+after_prepare(uv_prepare_t *prepare) {
+  hsk_udp_batch_t *b = (hsk_udp_batch_t *)prepare->data;
+
+  if (b && b->queued > 0)
+    hsk_udp_batch_flush(b);
+}
+
+static void
+after_check(uv_check_t *check) {
+  hsk_udp_batch_t *b = (hsk_udp_batch_t *)check->data;
+
+  if (b && b->queued > 0)
+    hsk_udp_batch_flush(b);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef _HSK_UDP_BATCH_
+#define _HSK_UDP_BATCH_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uv.h"
+
+/*
+ * Defs
+ */
+
+// Datagrams drained (or flushed) per system call.
+#define HSK_UDP_BATCH 32
+#define HSK_UDP_BATCH_BUFFER 4096
+
+/*
+ * Types
+ */
+
+typedef void (*hsk_udp_batch_cb)(
+  void *data,
+  const uint8_t *buf,
+  size_t len,
+  const struct sockaddr *addr
+);
+
+typedef struct {
+  struct sockaddr_storage ss;
+  uint8_t *data;
+  size_t data_len;
+} hsk_udp_batch_slot_t;
+
+struct hsk_udp_batch_ctx_s;
+
+typedef struct {
+  uv_loop_t *loop;
+  int fd;
+  uv_poll_t *poll;
+  uv_prepare_t *prepare;
+  uv_check_t *check;
+  int events;
+  hsk_udp_batch_cb cb;
+  void *data;
+  struct hsk_udp_batch_ctx_s *ctx;
+  hsk_udp_batch_slot_t queue[HSK_UDP_BATCH];
+  int queued;
+  uint64_t recv_calls;
+  uint64_t recv_msgs;
+  uint64_t send_calls;
+  uint64_t send_msgs;
+  uint64_t send_drops;
+} hsk_udp_batch_t;
+
+/*
+ * UDP Batching
+ *
+ * Linux fast path for the UDP servers: each wakeup drains up to
+ * HSK_UDP_BATCH datagrams with one recvmmsg(2), and every response queued
+ * during a loop iteration goes out with one sendmmsg(2), either right after
+ * polling (check) or right before blocking again (prepare).  Elsewhere
+ * hsk_udp_batch_supported() is false and callers keep using uv_udp_t.
+ */
+
+bool
+hsk_udp_batch_supported(void);
+
+int
+hsk_udp_batch_init(
+  hsk_udp_batch_t *b,
+  const uv_loop_t *loop,
+  hsk_udp_batch_cb cb,
+  void *data
+);
+
+void
+hsk_udp_batch_uninit(hsk_udp_batch_t *b);
+
+hsk_udp_batch_t *
+hsk_udp_batch_alloc(const uv_loop_t *loop, hsk_udp_batch_cb cb, void *data);
+
+void
+hsk_udp_batch_free(hsk_udp_batch_t *b);
+
+int
+hsk_udp_batch_open(
+  hsk_udp_batch_t *b,
+  const struct sockaddr *addr,
+  bool reuseport
+);
+
+void
+hsk_udp_batch_close(hsk_udp_batch_t *b);
+
+int
+hsk_udp_batch_send(
+  hsk_udp_batch_t *b,
+  uint8_t *data,
+  size_t data_len,
+  const struct sockaddr *addr,
+  bool should_free
+);
+
+int
+hsk_udp_batch_flush(hsk_udp_batch_t *b);
+
+#endif
@@ -0,0 +1,194 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wheel.h"
+
+/*
+ * Helpers
+ */
+
+static void
+hsk_wheel_link(hsk_wheel_entry_t **head, hsk_wheel_entry_t *entry) {
+  entry->next = *head;
+
+  if (entry->next)
+    entry->next->pprev = &entry->next;
+
+  entry->pprev = head;
+  *head = entry;
+}
+
+static void
+hsk_wheel_unlink(hsk_wheel_entry_t *entry) {
+  *entry->pprev = entry->next;
+
+  if (entry->next)
+    entry->next->pprev = entry->pprev;
+
+  entry->next = NULL;
+  entry->pprev = NULL;
+}
+
+// Slot for a deadline, relative to the current tick.
+static hsk_wheel_entry_t **
+hsk_wheel_slot(hsk_wheel_t *wheel, uint64_t expires) {
+  uint64_t delta = expires - wheel->now;
+  int level = 0;
+
+  while (level < HSK_WHEEL_LEVELS - 1
+         && delta >= (uint64_t)1 << (HSK_WHEEL_BITS * (level + 1))) {
+    level += 1;
+  }
+
+  // Past the top level: park in the furthest slot and
+  // let it cascade down again until it is in range.
+  if (level == HSK_WHEEL_LEVELS - 1
+      && delta >= (uint64_t)1 << (HSK_WHEEL_BITS * HSK_WHEEL_LEVELS)) {
+    expires = wheel->now
+            + ((uint64_t)1 << (HSK_WHEEL_BITS * HSK_WHEEL_LEVELS)) - 1;
+  }
+
+  size_t index = (expires >> (HSK_WHEEL_BITS * level)) & (HSK_WHEEL_SLOTS - 1);
+
+  return &wheel->slots[level][index];
+}
+
+// Push every entry in a slot back down a level.
+static void
+hsk_wheel_cascade(hsk_wheel_t *wheel, int level, size_t index) {
+  hsk_wheel_entry_t *entry = wheel->slots[level][index];
+
+  wheel->slots[level][index] = NULL;
+
+  while (entry) {
+    hsk_wheel_entry_t *next = entry->next;
+    hsk_wheel_link(hsk_wheel_slot(wheel, entry->expires), entry);
+    entry = next;
+  }
+}
+
+static void
+hsk_wheel_tick(hsk_wheel_t *wheel) {
+  wheel->now += 1;
+
+  for (int level = 1; level < HSK_WHEEL_LEVELS; level++) {
+    uint64_t mask = ((uint64_t)1 << (HSK_WHEEL_BITS * level)) - 1;
+
+    if ((wheel->now & mask) != 0)
+      break;
+
+    size_t index = (wheel->now >> (HSK_WHEEL_BITS * level))
+                 & (HSK_WHEEL_SLOTS - 1);
+
+    hsk_wheel_cascade(wheel, level, index);
+  }
+
+  size_t index = wheel->now & (HSK_WHEEL_SLOTS - 1);
+  hsk_wheel_entry_t *entry = wheel->slots[0][index];
+
+  if (!entry)
+    return;
+
+  // Only ticked with nothing due.
+  assert(!wheel->due);
+
+  wheel->slots[0][index] = NULL;
+  wheel->due = entry;
+  entry->pprev = &wheel->due;
+}
+
+/*
+ * Timer Wheel
+ */
+
+void
+hsk_wheel_init(hsk_wheel_t *wheel, uint64_t now) {
+  assert(wheel);
+  wheel->now = now;
+  wheel->size = 0;
+  wheel->due = NULL;
+  memset(wheel->slots, 0, sizeof(wheel->slots));
+}
+
+void
+hsk_wheel_entry_init(hsk_wheel_entry_t *entry) {
+  assert(entry);
+  entry->expires = 0;
+  entry->next = NULL;
+  entry->pprev = NULL;
+}
+
+bool
+hsk_wheel_entry_active(const hsk_wheel_entry_t *entry) {
+  assert(entry);
+  return entry->pprev != NULL;
+}
+
+// Deadlines already past expire on the next tick.
+void
+hsk_wheel_add(hsk_wheel_t *wheel, hsk_wheel_entry_t *entry, uint64_t expires) {
+  assert(wheel && entry);
+
+  if (hsk_wheel_entry_active(entry))
+    hsk_wheel_remove(wheel, entry);
+
+  if (expires <= wheel->now)
+    expires = wheel->now + 1;
+
+  entry->expires = expires;
+
+  hsk_wheel_link(hsk_wheel_slot(wheel, expires), entry);
+
+  wheel->size += 1;
+}
+
+void
+hsk_wheel_remove(hsk_wheel_t *wheel, hsk_wheel_entry_t *entry) {
+  assert(wheel && entry);
+
+  if (!hsk_wheel_entry_active(entry))
+    return;
+
+  hsk_wheel_unlink(entry);
+
+  assert(wheel->size > 0);
+  wheel->size -= 1;
+}
+
+// Bring an empty wheel's clock up to `now` at once,
+// rather than ticking through the time it sat idle.
+void
+hsk_wheel_catch_up(hsk_wheel_t *wheel, uint64_t now) {
+  assert(wheel);
+
+  if (wheel->size == 0 && wheel->now < now)
+    wheel->now = now;
+}
+
+// Take one entry which expired by `now`, or NULL once
+// there are none. Call until NULL after every advance.
+hsk_wheel_entry_t *
+hsk_wheel_expire(hsk_wheel_t *wheel, uint64_t now) {
+  assert(wheel);
+
+  hsk_wheel_catch_up(wheel, now);
+
+  while (!wheel->due && wheel->now < now)
+    hsk_wheel_tick(wheel);
+
+  hsk_wheel_entry_t *entry = wheel->due;
+
+  if (!entry)
+    return NULL;
+
+  hsk_wheel_unlink(entry);
+
+  wheel->size -= 1;
+
+  return entry;
+}
@@ -0,0 +1,66 @@
+#ifndef _HSK_WHEEL_H
+#define _HSK_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Defs
+ */
+
+#define HSK_WHEEL_BITS 6
+#define HSK_WHEEL_SLOTS (1 << HSK_WHEEL_BITS)
+#define HSK_WHEEL_LEVELS 4
+
+/*
+ * Types
+ */
+
+// Embedded in whatever carries a deadline.
+typedef struct hsk_wheel_entry_s {
+  uint64_t expires;
+  struct hsk_wheel_entry_s *next;
+  struct hsk_wheel_entry_s **pprev;
+} hsk_wheel_entry_t;
+
+typedef struct hsk_wheel_s {
+  uint64_t now;
+  size_t size;
+  // Expired, waiting to be taken.
+  hsk_wheel_entry_t *due;
+  hsk_wheel_entry_t *slots[HSK_WHEEL_LEVELS][HSK_WHEEL_SLOTS];
+} hsk_wheel_t;
+
+/*
+ * Timer Wheel
+ *
+ * Hierarchical timer wheel: adding and removing a deadline is O(1), and
+ * so is finding what expired, amortized over the ticks.  Time is counted
+ * in ticks of whatever length the caller likes.  Each level has 64 slots
+ * covering 64 times the span of the level below it; entries move down a
+ * level as their deadline comes into range.
+ */
+
+void
+hsk_wheel_init(hsk_wheel_t *wheel, uint64_t now);
+
+void
+hsk_wheel_entry_init(hsk_wheel_entry_t *entry);
+
+bool
+hsk_wheel_entry_active(const hsk_wheel_entry_t *entry);
+
+void
+hsk_wheel_add(hsk_wheel_t *wheel, hsk_wheel_entry_t *entry, uint64_t expires);
+
+void
+hsk_wheel_remove(hsk_wheel_t *wheel, hsk_wheel_entry_t *entry);
+
+void
+hsk_wheel_catch_up(hsk_wheel_t *wheel, uint64_t now);
+
+hsk_wheel_entry_t *
+hsk_wheel_expire(hsk_wheel_t *wheel, uint64_t now);
+
+#endif
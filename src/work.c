@@ -0,0 +1,165 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "uv.h"
+#include "work.h"
+
+/*
+ * Types
+ */
+
+typedef struct hsk_work_job_s {
+  uv_work_t req;
+  hsk_work_t *work;
+  hsk_work_cb cb;
+  hsk_work_after_cb after_cb;
+  void *arg;
+  uint64_t queued_at;
+  uint64_t started_at;
+} hsk_work_job_t;
+
+/*
+ * Prototypes
+ */
+
+static void
+on_work(uv_work_t *req);
+
+static void
+after_work(uv_work_t *req, int status);
+
+/*
+ * Work Queue
+ */
+
+void
+hsk_work_init(hsk_work_t *work, const uv_loop_t *loop) {
+  assert(work && loop);
+  work->loop = (uv_loop_t *)loop;
+  work->max_pending = HSK_WORK_MAX_PENDING;
+  work->pending = 0;
+  work->closed = false;
+  work->queued = 0;
+  work->inlined = 0;
+  work->completed = 0;
+  work->wait_total = 0;
+  work->wait_max = 0;
+}
+
+hsk_work_t *
+hsk_work_alloc(const uv_loop_t *loop) {
+  hsk_work_t *work = malloc(sizeof(hsk_work_t));
+
+  if (!work)
+    return NULL;
+
+  hsk_work_init(work, loop);
+
+  return work;
+}
+
+// Drop the owner's reference.  Frees now, or once
+// the last pending job has been cancelled.
+void
+hsk_work_release(hsk_work_t *work) {
+  if (!work)
+    return;
+
+  work->closed = true;
+
+  if (work->pending > 0)
+    return;
+
+  free(work);
+}
+
+// Hand `cb` to the threadpool.  Returns false if the queue
+// is full or closed, in which case nothing has been queued
+// and the caller still owns `arg`.
+bool
+hsk_work_queue(
+  hsk_work_t *work,
+  hsk_work_cb cb,
+  hsk_work_after_cb after_cb,
+  void *arg
+) {
+  assert(work && cb && after_cb);
+
+  if (work->closed || work->pending >= work->max_pending)
+    return false;
+
+  hsk_work_job_t *job = malloc(sizeof(hsk_work_job_t));
+
+  if (!job)
+    return false;
+
+  job->req.data = (void *)job;
+  job->work = work;
+  job->cb = cb;
+  job->after_cb = after_cb;
+  job->arg = arg;
+  job->queued_at = uv_hrtime();
+  job->started_at = 0;
+
+  if (uv_queue_work(work->loop, &job->req, on_work, after_work) != 0) {
+    free(job);
+    return false;
+  }
+
+  work->pending += 1;
+  work->queued += 1;
+
+  return true;
+}
+
+uint64_t
+hsk_work_wait_avg(const hsk_work_t *work) {
+  assert(work);
+
+  if (work->completed == 0)
+    return 0;
+
+  return work->wait_total / work->completed;
+}
+
+/*
+ * UV behavior
+ */
+
+static void
+on_work(uv_work_t *req) {
+  hsk_work_job_t *job = (hsk_work_job_t *)req->data;
+  job->started_at = uv_hrtime();
+  job->cb(job->arg);
+}
+
+static void
+after_work(uv_work_t *req, int status) {
+  hsk_work_job_t *job = (hsk_work_job_t *)req->data;
+  hsk_work_t *work = job->work;
+
+  assert(work->pending > 0);
+
+  work->pending -= 1;
+
+  if (status == 0) {
+    uint64_t wait = (job->started_at - job->queued_at) / 1000;
+
+    work->completed += 1;
+    work->wait_total += wait;
+
+    if (wait > work->wait_max)
+      work->wait_max = wait;
+  }
+
+  job->after_cb(job->arg, work->closed || status != 0);
+
+  free(job);
+
+  if (work->closed && work->pending == 0)
+    free(work);
+}
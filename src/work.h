@@ -0,0 +1,73 @@
+#ifndef _HSK_WORK_H
+#define _HSK_WORK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uv.h"
+
+/*
+ * Defs
+ */
+
+// Jobs allowed in flight per queue before callers run them inline.
+#define HSK_WORK_MAX_PENDING 64
+
+/*
+ * Types
+ */
+
+// Runs on a threadpool thread.
+typedef void (*hsk_work_cb)(void *arg);
+
+// Runs back on the loop. `cancelled` means the owner has released
+// the queue: the job must only free itself.
+typedef void (*hsk_work_after_cb)(void *arg, bool cancelled);
+
+typedef struct hsk_work_s {
+  uv_loop_t *loop;
+  int max_pending;
+  int pending;
+  bool closed;
+  uint64_t queued;
+  uint64_t inlined;
+  uint64_t completed;
+  // Time jobs spent waiting for a thread (us).
+  uint64_t wait_total;
+  uint64_t wait_max;
+} hsk_work_t;
+
+/*
+ * Work Queue
+ *
+ * Bounded front for the libuv threadpool, used for CPU-bound stages such as
+ * proof verification and signing.  Callers decide what is cheap enough to
+ * run inline; anything queued past `max_pending` is refused and also runs
+ * inline, so a backlog degrades to the old behaviour instead of growing.
+ *
+ * Results are resumed on the loop.  Like the send pool, the queue is
+ * released rather than freed, and outlives its owner until every job
+ * has come back.
+ */
+
+void
+hsk_work_init(hsk_work_t *work, const uv_loop_t *loop);
+
+hsk_work_t *
+hsk_work_alloc(const uv_loop_t *loop);
+
+void
+hsk_work_release(hsk_work_t *work);
+
+bool
+hsk_work_queue(
+  hsk_work_t *work,
+  hsk_work_cb cb,
+  hsk_work_after_cb after_cb,
+  void *arg
+);
+
+uint64_t
+hsk_work_wait_avg(const hsk_work_t *work);
+
+#endif
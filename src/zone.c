@@ -0,0 +1,333 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "addr.h"
+#include "bio.h"
+#include "dns.h"
+#include "req.h"
+#include "resource.h"
+#include "sig0.h"
+#include "utils.h"
+#include "zone.h"
+
+// Header plus a root question.
+#define HSK_ZONE_BODY (12 + 1 + 4)
+
+// Query type each response is finalized for.
+static const uint16_t hsk_zone_types[HSK_ZONE_MAX] = {
+  HSK_DNS_NS,
+  HSK_DNS_SOA,
+  HSK_DNS_DNSKEY,
+  HSK_DNS_DS,
+  HSK_DNS_A,
+  HSK_DNS_A,
+  HSK_DNS_A
+};
+
+/*
+ * Helpers
+ */
+
+static void
+hsk_zone_item_init(hsk_zone_item_t *item) {
+  item->type = 0;
+  item->msg = NULL;
+  item->msg_len = 0;
+
+  for (int v = 0; v < HSK_ZONE_VARIANTS; v++) {
+    item->wires[v] = NULL;
+    item->wire_lens[v] = 0;
+  }
+}
+
+static void
+hsk_zone_item_uninit(hsk_zone_item_t *item) {
+  if (item->msg)
+    free(item->msg);
+
+  for (int v = 0; v < HSK_ZONE_VARIANTS; v++) {
+    if (item->wires[v])
+      free(item->wires[v]);
+  }
+
+  hsk_zone_item_init(item);
+}
+
+static hsk_dns_msg_t *
+hsk_zone_build(int slot, const hsk_addr_t *addr) {
+  switch (slot) {
+    case HSK_ZONE_NS:
+      return hsk_resource_root(HSK_DNS_NS, addr);
+    case HSK_ZONE_SOA:
+      return hsk_resource_root(HSK_DNS_SOA, addr);
+    case HSK_ZONE_DNSKEY:
+      return hsk_resource_root(HSK_DNS_DNSKEY, addr);
+    case HSK_ZONE_DS:
+      return hsk_resource_root(HSK_DNS_DS, addr);
+    case HSK_ZONE_EMPTY:
+      return hsk_resource_root(HSK_DNS_A, addr);
+    case HSK_ZONE_NX:
+      return hsk_resource_to_nx();
+    case HSK_ZONE_SERVFAIL:
+      return hsk_resource_to_servfail();
+  }
+
+  return NULL;
+}
+
+static bool
+hsk_zone_item_build(hsk_zone_item_t *item, int slot, const hsk_addr_t *addr) {
+  hsk_dns_msg_t *msg = hsk_zone_build(slot, addr);
+
+  if (!msg)
+    return false;
+
+  item->type = hsk_zone_types[slot];
+
+  bool ok = hsk_dns_msg_encode(msg, &item->msg, &item->msg_len);
+
+  hsk_dns_msg_free(msg);
+
+  if (!ok)
+    return false;
+
+  for (int v = 0; v < HSK_ZONE_VARIANTS; v++) {
+    hsk_dns_req_t req;
+    hsk_dns_req_init(&req);
+
+    strcpy(req.name, ".");
+    req.type = item->type;
+    req.class = HSK_DNS_IN;
+    req.edns = v > 0;
+    req.dnssec = v == 2;
+    req.max_size = HSK_DNS_MAX_TCP;
+
+    hsk_dns_msg_t *copy = NULL;
+
+    if (!hsk_dns_msg_decode(item->msg, item->msg_len, &copy))
+      return false;
+
+    if (!hsk_dns_msg_finalize_raw(&copy, &req, false,
+                                  &item->wires[v], &item->wire_lens[v])) {
+      return false;
+    }
+
+    assert(item->wire_lens[v] >= HSK_ZONE_BODY);
+  }
+
+  return true;
+}
+
+// Types which survive cleaning only when queried for.
+static bool
+hsk_zone_is_dnssec(uint16_t type) {
+  switch (type) {
+    case HSK_DNS_DS:
+    case HSK_DNS_DLV:
+    case HSK_DNS_DNSKEY:
+    case HSK_DNS_RRSIG:
+    case HSK_DNS_NXT:
+    case HSK_DNS_NSEC:
+    case HSK_DNS_NSEC3:
+    case HSK_DNS_NSEC3PARAM:
+      return true;
+  }
+
+  return false;
+}
+
+/*
+ * Zone
+ */
+
+void
+hsk_zone_init(hsk_zone_t *zone) {
+  assert(zone);
+
+  for (int i = 0; i < HSK_ZONE_MAX; i++)
+    hsk_zone_item_init(&zone->items[i]);
+
+  zone->ready = false;
+  zone->signed_time = 0;
+  zone->hits = 0;
+  zone->misses = 0;
+}
+
+void
+hsk_zone_uninit(hsk_zone_t *zone) {
+  assert(zone);
+
+  for (int i = 0; i < HSK_ZONE_MAX; i++)
+    hsk_zone_item_uninit(&zone->items[i]);
+
+  zone->ready = false;
+}
+
+// Build and sign every response. On failure
+// the previous set is kept.
+bool
+hsk_zone_sign(hsk_zone_t *zone, const hsk_addr_t *addr) {
+  assert(zone && addr);
+
+  hsk_zone_item_t items[HSK_ZONE_MAX];
+  int i;
+
+  for (i = 0; i < HSK_ZONE_MAX; i++)
+    hsk_zone_item_init(&items[i]);
+
+  for (i = 0; i < HSK_ZONE_MAX; i++) {
+    if (!hsk_zone_item_build(&items[i], i, addr))
+      break;
+  }
+
+  if (i < HSK_ZONE_MAX) {
+    for (i = 0; i < HSK_ZONE_MAX; i++)
+      hsk_zone_item_uninit(&items[i]);
+    return false;
+  }
+
+  for (i = 0; i < HSK_ZONE_MAX; i++) {
+    hsk_zone_item_uninit(&zone->items[i]);
+    zone->items[i] = items[i];
+  }
+
+  zone->ready = true;
+  zone->signed_time = hsk_now();
+
+  return true;
+}
+
+int
+hsk_zone_root_slot(uint16_t type) {
+  switch (type) {
+    case HSK_DNS_ANY:
+    case HSK_DNS_NS:
+      return HSK_ZONE_NS;
+    case HSK_DNS_SOA:
+      return HSK_ZONE_SOA;
+    case HSK_DNS_DNSKEY:
+      return HSK_ZONE_DNSKEY;
+    case HSK_DNS_DS:
+      return HSK_ZONE_DS;
+  }
+
+  return HSK_ZONE_EMPTY;
+}
+
+// Copy of the signed message, for callers
+// which need to cache or finalize it themselves.
+hsk_dns_msg_t *
+hsk_zone_msg(const hsk_zone_t *zone, int slot) {
+  assert(zone);
+
+  if (!zone->ready || slot < 0 || slot >= HSK_ZONE_MAX)
+    return NULL;
+
+  const hsk_zone_item_t *item = &zone->items[slot];
+  hsk_dns_msg_t *msg;
+
+  if (!hsk_dns_msg_decode(item->msg, item->msg_len, &msg))
+    return NULL;
+
+  return msg;
+}
+
+// Finalized reply for `req`, matching what finalizing a copy
+// of the message would produce. When `sig0` is set, room is
+// left for a SIG(0) record as with hsk_dns_msg_finalize_raw().
+bool
+hsk_zone_wire(
+  hsk_zone_t *zone,
+  int slot,
+  const hsk_dns_req_t *req,
+  bool sig0,
+  uint8_t **wire,
+  size_t *wire_len
+) {
+  assert(zone && req && wire && wire_len);
+
+  *wire = NULL;
+  *wire_len = 0;
+
+  if (!zone->ready || slot < 0 || slot >= HSK_ZONE_MAX)
+    goto miss;
+
+  const hsk_zone_item_t *item = &zone->items[slot];
+  int v = 0;
+
+  if (req->edns)
+    v = req->dnssec ? 2 : 1;
+  else if (req->dnssec)
+    goto miss;
+
+  // Cleaning keeps DNSSEC records of the queried type.
+  if (!req->dnssec
+      && req->type != item->type
+      && hsk_zone_is_dnssec(req->type)) {
+    goto miss;
+  }
+
+  const uint8_t *tmpl = item->wires[v];
+  size_t body_len = item->wire_lens[v] - HSK_ZONE_BODY;
+  int qname_len = hsk_dns_name_write(req->name, NULL, NULL);
+  size_t size = 12 + qname_len + 4 + body_len;
+  size_t max = req->max_size;
+
+  if (sig0)
+    max -= HSK_SIG0_RR_SIZE;
+
+  // Leave truncation to the slow path.
+  if (size > max)
+    goto miss;
+
+  uint8_t *data = malloc(size);
+
+  if (!data)
+    goto miss;
+
+  uint8_t *buf = data;
+
+  memcpy(buf, tmpl, 12);
+
+  // ID.
+  set_u16be(&buf[0], req->id);
+
+  // Flags.
+  uint16_t flags = get_u16be(&buf[2]);
+
+  if (req->rd)
+    flags |= HSK_DNS_RD;
+
+  if (req->cd)
+    flags |= HSK_DNS_CD;
+
+  set_u16be(&buf[2], flags);
+
+  buf += 12;
+
+  // Question.
+  hsk_dns_name_write(req->name, &buf, NULL);
+  write_u16be(&buf, req->type);
+  write_u16be(&buf, req->class);
+
+  memcpy(buf, &tmpl[HSK_ZONE_BODY], body_len);
+  buf += body_len;
+
+  assert((size_t)(buf - data) == size);
+
+  zone->hits += 1;
+
+  *wire = data;
+  *wire_len = size;
+
+  return true;
+
+miss:
+  zone->misses += 1;
+  return false;
+}
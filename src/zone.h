@@ -0,0 +1,92 @@
+#ifndef _HSK_ZONE_H
+#define _HSK_ZONE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "addr.h"
+#include "dns.h"
+#include "req.h"
+
+/*
+ * Defs
+ */
+
+// Well inside the two week RRSIG validity, and
+// often enough to keep the hourly SOA serial current.
+#define HSK_ZONE_RESIGN_INTERVAL (60 * 60 * 1000)
+
+// Fixed responses.
+#define HSK_ZONE_NS 0
+#define HSK_ZONE_SOA 1
+#define HSK_ZONE_DNSKEY 2
+#define HSK_ZONE_DS 3
+#define HSK_ZONE_EMPTY 4
+#define HSK_ZONE_NX 5
+#define HSK_ZONE_SERVFAIL 6
+#define HSK_ZONE_MAX 7
+
+// Finalized forms: no EDNS, EDNS, EDNS with DO.
+#define HSK_ZONE_VARIANTS 3
+
+/*
+ * Types
+ */
+
+typedef struct hsk_zone_item_s {
+  uint16_t type;
+  // Signed message, before finalizing.
+  uint8_t *msg;
+  size_t msg_len;
+  // Finalized for a root question, per variant.
+  uint8_t *wires[HSK_ZONE_VARIANTS];
+  size_t wire_lens[HSK_ZONE_VARIANTS];
+} hsk_zone_item_t;
+
+typedef struct hsk_zone_s {
+  hsk_zone_item_t items[HSK_ZONE_MAX];
+  bool ready;
+  int64_t signed_time;
+  uint64_t hits;
+  uint64_t misses;
+} hsk_zone_t;
+
+/*
+ * Zone
+ *
+ * Root zone answers which never change between queries: the apex records,
+ * the empty proof, the phony NXDOMAIN and SERVFAIL.  Each is built and
+ * signed once, then kept both as a message and as finalized wire.
+ *
+ * Every name in these answers is the root, which is never compressed, so
+ * a reply is just the header, the query's own question, and the stored
+ * sections after it.  Anything that would need truncating, or cleaning
+ * for a DNSSEC query type, falls back to finalizing a copy of the message.
+ */
+
+void
+hsk_zone_init(hsk_zone_t *zone);
+
+void
+hsk_zone_uninit(hsk_zone_t *zone);
+
+bool
+hsk_zone_sign(hsk_zone_t *zone, const hsk_addr_t *addr);
+
+int
+hsk_zone_root_slot(uint16_t type);
+
+hsk_dns_msg_t *
+hsk_zone_msg(const hsk_zone_t *zone, int slot);
+
+bool
+hsk_zone_wire(
+  hsk_zone_t *zone,
+  int slot,
+  const hsk_dns_req_t *req,
+  bool sig0,
+  uint8_t **wire,
+  size_t *wire_len
+);
+
+#endif
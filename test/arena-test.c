@@ -0,0 +1,194 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "dns.h"
+#include "dnssec.h"
+#include "req.h"
+#include "resource.h"
+
+static void
+test_arena_alloc() {
+  hsk_arena_t *arena = hsk_arena_alloc();
+  assert(arena);
+
+  uint8_t *a = hsk_arena_malloc(arena, 3);
+  uint8_t *b = hsk_arena_malloc(arena, 5);
+
+  assert(a && b);
+  assert(((uintptr_t)a & (HSK_ARENA_ALIGN - 1)) == 0);
+  assert(((uintptr_t)b & (HSK_ARENA_ALIGN - 1)) == 0);
+  assert(b >= a + 3);
+  assert(arena->grows == 0);
+
+  // Only the latest allocation can be given back.
+  hsk_arena_release(arena, a);
+  assert(hsk_arena_malloc(arena, 5) != b);
+
+  uint8_t *c = hsk_arena_malloc(arena, 7);
+  hsk_arena_release(arena, c);
+  assert(hsk_arena_malloc(arena, 7) == c);
+
+  uint8_t *z = hsk_arena_calloc(arena, 4, 8);
+  assert(z);
+
+  for (int i = 0; i < 32; i++)
+    assert(z[i] == 0);
+
+  assert(hsk_arena_calloc(arena, SIZE_MAX, 2) == NULL);
+
+  // Past the inline space, and past a whole block.
+  uint8_t *big = hsk_arena_malloc(arena, HSK_ARENA_SIZE);
+  assert(big);
+  memset(big, 0xff, HSK_ARENA_SIZE);
+  assert(arena->grows == 1);
+
+  uint8_t *huge = hsk_arena_malloc(arena, HSK_ARENA_BLOCK * 3);
+  assert(huge);
+  memset(huge, 0xff, HSK_ARENA_BLOCK * 3);
+  assert(arena->grows == 2);
+
+  // Reset goes back to the inline space.
+  hsk_arena_reset(arena);
+  assert(hsk_arena_malloc(arena, 3) == a);
+
+  hsk_arena_free(arena);
+
+  // No arena is the heap.
+  void *p = hsk_arena_malloc(NULL, 16);
+  assert(p);
+  hsk_arena_release(NULL, p);
+}
+
+static void
+test_arena_sighash() {
+  const uint8_t *priv = &hsk_dnssec_zsk[0];
+  const hsk_dns_rr_t *key = hsk_dnssec_get_zsk();
+  uint8_t hashes[2][32];
+
+  // Case and TTL are not part of the canonical form.
+  const char *names[2] = { "FoO.", "foo." };
+  const char *targets[2] = { "NS1.Example.", "ns1.example." };
+
+  for (int i = 0; i < 2; i++) {
+    hsk_arena_t arena;
+    hsk_arena_init(&arena);
+
+    hsk_dns_rrs_t rrset;
+    hsk_dns_rrs_init(&rrset);
+
+    hsk_dns_rr_t *rr = hsk_dns_rr_create_in(&arena, HSK_DNS_NS);
+    assert(rr && rr->arena == &arena);
+
+    strcpy(rr->name, names[i]);
+    rr->ttl = 3600 * (i + 1);
+    strcpy(((hsk_dns_ns_rd_t *)rr->rd)->ns, targets[i]);
+
+    hsk_dns_rrs_push(&rrset, rr);
+
+    hsk_dns_rr_t *sig = hsk_dns_sign_rrset(&arena, &rrset, key, priv);
+    assert(sig && sig->arena == &arena);
+
+    hsk_dns_rrsig_rd_t *rrsig = sig->rd;
+    rrsig->orig_ttl = 21600;
+
+    assert(hsk_dns_sighash(&rrset, sig, hashes[i]));
+
+    hsk_dns_rr_free(sig);
+    hsk_dns_rr_free(rr);
+    hsk_arena_uninit(&arena);
+  }
+
+  assert(memcmp(hashes[0], hashes[1], 32) == 0);
+}
+
+static void
+test_arena_resource() {
+  hsk_record_t ns;
+  ns.type = HSK_NS;
+  strcpy(ns.name, "ns1.foo.");
+
+  hsk_record_t glue;
+  glue.type = HSK_GLUE4;
+  strcpy(glue.name, "ns1.foo.");
+  memset(glue.inet4, 0x7f, 4);
+
+  hsk_ds_record_t ds;
+  ds.type = HSK_DS;
+  ds.key_tag = 1234;
+  ds.algorithm = 13;
+  ds.digest_type = 2;
+  ds.digest_len = 32;
+  memset(ds.digest, 0xab, 32);
+
+  hsk_resource_t res;
+  res.version = 0;
+  res.ttl = 21600;
+  res.record_count = 3;
+  res.records[0] = &ns;
+  res.records[1] = &glue;
+  res.records[2] = (hsk_record_t *)&ds;
+
+  const char *names[3] = { "www.foo.", "foo.", "foo." };
+  const uint16_t types[3] = { HSK_DNS_A, HSK_DNS_NS, HSK_DNS_DS };
+
+  for (int i = 0; i < 3; i++) {
+    hsk_dns_msg_t *heap = hsk_resource_to_dns(NULL, &res, names[i], types[i]);
+    assert(heap && !heap->arena);
+
+    hsk_arena_t arena;
+    hsk_arena_init(&arena);
+
+    hsk_dns_msg_t *msg = hsk_resource_to_dns(&arena, &res, names[i], types[i]);
+    assert(msg && msg->arena == &arena);
+    assert(arena.grows == 0);
+
+    // Same response, signatures shared through the cache.
+    uint8_t *a, *b;
+    size_t a_len, b_len;
+
+    assert(hsk_dns_msg_encode(heap, &a, &a_len));
+    assert(hsk_dns_msg_encode(msg, &b, &b_len));
+    assert(a_len == b_len);
+    assert(memcmp(a, b, a_len) == 0);
+
+    free(a);
+    free(b);
+
+    // Finalizing cleans records and adds a question.
+    hsk_dns_req_t req;
+    hsk_dns_req_init(&req);
+
+    strcpy(req.name, names[i]);
+    req.type = types[i];
+    req.class = HSK_DNS_IN;
+    req.max_size = HSK_DNS_MAX_UDP;
+
+    uint8_t *wire;
+    size_t wire_len;
+
+    assert(hsk_dns_msg_finalize_raw(&msg, &req, false, &wire, &wire_len));
+    assert(!msg);
+    assert(wire_len > 12);
+
+    free(wire);
+
+    hsk_dns_msg_free(heap);
+    hsk_arena_uninit(&arena);
+  }
+}
+
+void
+test_arena() {
+  printf(" test_arena_alloc\n");
+  test_arena_alloc();
+
+  printf(" test_arena_sighash\n");
+  test_arena_sighash();
+
+  printf(" test_arena_resource\n");
+  test_arena_resource();
+}
@@ -0,0 +1,324 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "utils.h"
+
+static bool
+insert_wire_ttl(hsk_cache_t *c, const char *name, size_t len, uint32_t ttl) {
+  uint8_t *wire = malloc(len);
+  assert(wire);
+  memset(wire, 0, len);
+
+  if (!hsk_cache_insert_data(c, name, HSK_DNS_A, wire, len, ttl)) {
+    free(wire);
+    return false;
+  }
+
+  return true;
+}
+
+static bool
+insert_wire(hsk_cache_t *c, const char *name, size_t len) {
+  return insert_wire_ttl(c, name, len, 3600);
+}
+
+static bool
+has_wire(hsk_cache_t *c, const char *name) {
+  uint8_t *wire;
+  size_t wire_len;
+  return hsk_cache_get_data(c, name, HSK_DNS_A, &wire, &wire_len);
+}
+
+static void
+test_cache_evict_lru() {
+  hsk_cache_t c;
+  hsk_cache_init(&c);
+  assert(hsk_cache_set_limit(&c, 2, HSK_CACHE_SIZE));
+
+  assert(insert_wire(&c, "a.", 100));
+  assert(insert_wire(&c, "b.", 100));
+
+  // Touch "a." so "b." becomes least recently used.
+  assert(has_wire(&c, "a."));
+
+  assert(insert_wire(&c, "c.", 100));
+
+  assert(c.map.size == 2);
+  assert(c.size == 200);
+  assert(c.evictions == 1);
+  assert(has_wire(&c, "a."));
+  assert(!has_wire(&c, "b."));
+  assert(has_wire(&c, "c."));
+
+  hsk_cache_uninit(&c);
+}
+
+static void
+test_cache_evict_size() {
+  hsk_cache_t c;
+  hsk_cache_init(&c);
+  assert(hsk_cache_set_limit(&c, HSK_CACHE_LIMIT, 250));
+
+  assert(insert_wire(&c, "a.", 100));
+  assert(insert_wire(&c, "b.", 100));
+  assert(insert_wire(&c, "c.", 100));
+
+  assert(c.map.size == 2);
+  assert(c.size == 200);
+  assert(!has_wire(&c, "a."));
+
+  // Larger than the whole cache.
+  assert(!insert_wire(&c, "d.", 300));
+  assert(c.map.size == 2);
+
+  hsk_cache_uninit(&c);
+}
+
+static void
+test_cache_expire_ttl() {
+  hsk_cache_t c;
+  hsk_cache_init(&c);
+  assert(hsk_cache_set_ttl(&c, 60, 7200));
+  hsk_cache_set_stale(&c, 0);
+
+  int64_t now = hsk_now();
+
+  assert(insert_wire_ttl(&c, "a.", 100, 1));
+  assert(insert_wire_ttl(&c, "b.", 100, 300));
+  assert(insert_wire_ttl(&c, "c.", 100, 86400));
+
+  // Clamped up to the floor.
+  hsk_cache_expire(&c, now + 30);
+  assert(c.map.size == 3);
+
+  hsk_cache_expire(&c, now + 120);
+  assert(c.map.size == 2);
+  assert(c.expirations == 1);
+
+  hsk_cache_expire(&c, now + 600);
+  assert(c.map.size == 1);
+  assert(c.size == 100);
+
+  // Clamped down to the ceiling.
+  hsk_cache_expire(&c, now + 7201);
+  assert(c.map.size == 0);
+  assert(c.size == 0);
+  assert(c.expirations == 3);
+
+  hsk_cache_uninit(&c);
+}
+
+static void
+test_cache_wire() {
+  hsk_cache_t c;
+  hsk_cache_init(&c);
+  hsk_cache_set_stale(&c, 0);
+
+  const uint8_t query[] = {
+    0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x03, 'F', 'o', 'O',
+    0x00, 0x00, 0x01, 0x00, 0x01
+  };
+
+  const uint8_t reply[] = {
+    0x00, 0x01, 0x84, 0x10, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x03, 'f', 'o', 'o',
+    0x00, 0x00, 0x01, 0x00, 0x01
+  };
+
+  hsk_dns_req_t req;
+  hsk_dns_req_init(&req);
+  strcpy(req.name, "FoO.");
+  req.id = 0x1234;
+  req.type = HSK_DNS_A;
+  req.class = HSK_DNS_IN;
+  req.rd = true;
+  req.max_size = HSK_DNS_MAX_UDP;
+
+  uint8_t *wire;
+  size_t wire_len;
+
+  // Needs a cached message to hang off.
+  assert(!hsk_cache_insert_wire(&c, &req, reply, sizeof(reply)));
+  assert(insert_wire(&c, "foo.", 100));
+  assert(hsk_cache_insert_wire(&c, &req, reply, sizeof(reply)));
+  assert(c.size == 100 + sizeof(reply));
+
+  assert(hsk_cache_get_wire(&c, &req, query, sizeof(query), &wire, &wire_len));
+  assert(wire_len == sizeof(reply));
+  assert(wire[0] == 0x12 && wire[1] == 0x34);
+  assert(wire[2] == 0x85 && wire[3] == 0x00);
+  assert(memcmp(&wire[12], &query[12], 5) == 0);
+  assert(memcmp(&wire[17], &reply[17], 4) == 0);
+  assert(c.wire_hits == 1);
+  free(wire);
+
+  // Different size class.
+  req.edns = true;
+  req.max_size = HSK_DNS_MAX_EDNS;
+  assert(!hsk_cache_get_wire(&c, &req, query, sizeof(query), &wire, &wire_len));
+
+  // Expires with its message.
+  hsk_cache_expire(&c, hsk_now() + 3601);
+  assert(c.map.size == 0);
+  assert(c.wires.size == 0);
+  assert(c.size == 0);
+
+  hsk_cache_uninit(&c);
+}
+
+static void
+test_cache_wire_full() {
+  hsk_cache_t c;
+  hsk_cache_init(&c);
+  assert(hsk_cache_set_limit(&c, 2, HSK_CACHE_SIZE));
+
+  const uint8_t reply[] = {
+    0x00, 0x01, 0x84, 0x10, 0x00, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x03, 'f', 'o', 'o',
+    0x00, 0x00, 0x01, 0x00, 0x01
+  };
+
+  hsk_dns_req_t req;
+  hsk_dns_req_init(&req);
+  strcpy(req.name, "foo.");
+  req.type = HSK_DNS_A;
+  req.class = HSK_DNS_IN;
+  req.max_size = HSK_DNS_MAX_UDP;
+
+  assert(insert_wire(&c, "a.", 100));
+  assert(insert_wire(&c, "foo.", 100));
+  assert(c.map.size == 2);
+
+  // A wire copy is not another entry.
+  assert(hsk_cache_insert_wire(&c, &req, reply, sizeof(reply)));
+  assert(c.map.size == 2);
+  assert(c.evictions == 0);
+  assert(has_wire(&c, "a."));
+
+  hsk_cache_uninit(&c);
+}
+
+static void
+test_cache_stale() {
+  hsk_cache_t c;
+  hsk_cache_init(&c);
+  assert(hsk_cache_set_ttl(&c, 0, 7200));
+  hsk_cache_set_stale(&c, 600);
+
+  hsk_dns_req_t req;
+  hsk_dns_req_init(&req);
+  strcpy(req.name, "foo.");
+  req.type = HSK_DNS_A;
+  req.class = HSK_DNS_IN;
+
+  hsk_dns_msg_t *msg = hsk_dns_msg_alloc();
+  assert(msg);
+
+  hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_A);
+  assert(rr);
+  hsk_dns_rr_set_name(rr, "foo.");
+  rr->ttl = 0;
+  hsk_dns_rrs_push(&msg->an, rr);
+
+  // Expires as soon as it is inserted.
+  assert(hsk_cache_insert(&c, &req, msg));
+  hsk_dns_msg_free(msg);
+
+  assert(!hsk_cache_get(&c, &req));
+
+  bool refresh;
+  msg = hsk_cache_get_stale(&c, &req, &refresh);
+  assert(msg);
+  assert(refresh);
+  assert(msg->an.size == 1);
+  hsk_dns_msg_free(msg);
+
+  // Only one refresh at a time.
+  msg = hsk_cache_get_stale(&c, &req, &refresh);
+  assert(msg);
+  assert(!refresh);
+  hsk_dns_msg_free(msg);
+
+  assert(c.stale_hits == 2);
+
+  hsk_cache_expire(&c, hsk_now() + 601);
+  assert(c.map.size == 0);
+  assert(!hsk_cache_get_stale(&c, &req, &refresh));
+
+  hsk_cache_uninit(&c);
+}
+
+static void
+test_cache_persist() {
+  hsk_cache_t c;
+  hsk_cache_init(&c);
+
+  assert(insert_wire(&c, "a.", 100));
+  assert(insert_wire(&c, "b.", 50));
+
+  size_t size = hsk_cache_write(&c, NULL);
+  uint8_t *data = malloc(size);
+  assert(data);
+
+  uint8_t *buf = data;
+  assert(hsk_cache_write(&c, &buf) == size);
+
+  hsk_cache_t r;
+  hsk_cache_init(&r);
+
+  buf = data;
+  size_t len = size;
+
+  assert(hsk_cache_read(&r, &buf, &len));
+  assert(len == 0);
+  assert(r.map.size == 2);
+  assert(r.size == 150);
+  assert(has_wire(&r, "a."));
+  assert(has_wire(&r, "b."));
+
+  // LRU order survives the round trip.
+  assert(r.head->msg_len == c.head->msg_len);
+  assert(r.head->expires == c.head->expires);
+
+  // Truncated input is rejected.
+  hsk_cache_t t;
+  hsk_cache_init(&t);
+
+  buf = data;
+  len = size - 1;
+
+  assert(!hsk_cache_read(&t, &buf, &len));
+
+  hsk_cache_uninit(&t);
+  hsk_cache_uninit(&r);
+  hsk_cache_uninit(&c);
+  free(data);
+}
+
+void
+test_cache() {
+  printf(" test_cache_evict_lru\n");
+  test_cache_evict_lru();
+
+  printf(" test_cache_evict_size\n");
+  test_cache_evict_size();
+
+  printf(" test_cache_expire_ttl\n");
+  test_cache_expire_ttl();
+
+  printf(" test_cache_wire\n");
+  test_cache_wire();
+
+  printf(" test_cache_wire_full\n");
+  test_cache_wire_full();
+
+  printf(" test_cache_stale\n");
+  test_cache_stale();
+
+  printf(" test_cache_persist\n");
+  test_cache_persist();
+}
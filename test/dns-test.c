@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "dns.h"
 
@@ -25,8 +27,51 @@ test_hsk_dns_is_subdomain() {
     "ddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd.ddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd."));
 }
 
+static void
+test_hsk_dns_msg_truncate() {
+  hsk_dns_msg_t *msg = hsk_dns_msg_alloc();
+  assert(msg);
+
+  for (int i = 0; i < 64; i++) {
+    hsk_dns_rr_t *rr = hsk_dns_rr_create(HSK_DNS_A);
+    assert(rr);
+    rr->ttl = 3600;
+    hsk_dns_rr_set_name(rr, "handshake.");
+    hsk_dns_a_rd_t *rd = rr->rd;
+    memset(rd->addr, i, 4);
+    hsk_dns_rrs_push(&msg->an, rr);
+  }
+
+  uint8_t *data = NULL;
+  size_t data_len = 0;
+  size_t len = 0;
+
+  assert(hsk_dns_msg_encode(msg, &data, &data_len));
+  hsk_dns_msg_free(msg);
+
+  // Fits: left alone.
+  assert(hsk_dns_msg_truncate(data, data_len, HSK_DNS_MAX_TCP, &len));
+  assert(len == data_len);
+  assert((data[2] << 8 | data[3]) == 0);
+
+  // Doesn't fit: cut at a record boundary and flagged.
+  assert(hsk_dns_msg_truncate(data, data_len, HSK_DNS_MAX_UDP, &len));
+  assert(len <= HSK_DNS_MAX_UDP);
+
+  msg = NULL;
+  assert(hsk_dns_msg_decode(data, len, &msg));
+  assert(msg->flags & HSK_DNS_TC);
+  assert(msg->an.size > 0 && msg->an.size < 64);
+
+  hsk_dns_msg_free(msg);
+  free(data);
+}
+
 void
 test_dns() {
   printf(" test_hsk_dns_name_cmp\n");
   test_hsk_dns_is_subdomain();
+
+  printf(" test_hsk_dns_msg_truncate\n");
+  test_hsk_dns_msg_truncate();
 }
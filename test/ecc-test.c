@@ -0,0 +1,88 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ecc.h"
+
+static void
+test_ecc_keypair(uint8_t *priv, uint8_t *pub) {
+  for (int i = 0; i < HSK_ECC_BYTES; i++)
+    priv[i] = i + 1;
+
+  assert(hsk_ecc_make_pubkey_compressed(priv, pub));
+}
+
+static void
+test_ecc_sign_verify() {
+  uint8_t priv[HSK_ECC_BYTES];
+  uint8_t pub[HSK_ECC_BYTES + 1];
+  uint8_t hash[HSK_ECC_BYTES];
+  uint8_t sig[HSK_ECC_BYTES * 2];
+  uint8_t sig2[HSK_ECC_BYTES * 2];
+
+  test_ecc_keypair(priv, pub);
+
+  for (int i = 0; i < 32; i++) {
+    memset(hash, i, sizeof(hash));
+
+    // Table, with an empty pool.
+    assert(hsk_ecc_sign(priv, hash, sig));
+    assert(hsk_ecc_verify(pub, hash, sig));
+
+    // Ladder.
+    assert(hsk_ecc_sign_generic(priv, hash, sig2));
+    assert(hsk_ecc_verify(pub, hash, sig2));
+
+    // Fresh nonces every time.
+    assert(memcmp(sig, sig2, HSK_ECC_BYTES) != 0);
+
+    sig[HSK_ECC_BYTES * 2 - 1] ^= 1;
+    assert(!hsk_ecc_verify(pub, hash, sig));
+  }
+}
+
+static void
+test_ecc_nonces() {
+  uint8_t priv[HSK_ECC_BYTES];
+  uint8_t pub[HSK_ECC_BYTES + 1];
+  uint8_t hash[HSK_ECC_BYTES];
+  uint8_t sig[HSK_ECC_BYTES * 2];
+  uint8_t prev[HSK_ECC_BYTES * 2];
+
+  test_ecc_keypair(priv, pub);
+  memset(hash, 0xaa, sizeof(hash));
+  memset(prev, 0, sizeof(prev));
+
+  size_t before = hsk_ecc_nonces();
+
+  assert(hsk_ecc_nonces_fill(8) == 8);
+  assert(hsk_ecc_nonces() == before + 8);
+
+  // Each pooled nonce is used exactly once.
+  for (int i = 0; i < 8; i++) {
+    assert(hsk_ecc_sign(priv, hash, sig));
+    assert(hsk_ecc_verify(pub, hash, sig));
+    assert(memcmp(sig, prev, HSK_ECC_BYTES) != 0);
+    memcpy(prev, sig, sizeof(sig));
+  }
+
+  assert(hsk_ecc_nonces() == before);
+
+  // Filling stops at the limit.
+  hsk_ecc_nonces_fill(HSK_ECC_NONCES * 2);
+  assert(hsk_ecc_nonces() == HSK_ECC_NONCES);
+  assert(hsk_ecc_nonces_fill(1) == 0);
+
+  while (hsk_ecc_nonces() > 0)
+    assert(hsk_ecc_sign(priv, hash, sig));
+}
+
+void
+test_ecc() {
+  printf(" test_ecc_sign_verify\n");
+  test_ecc_sign_verify();
+
+  printf(" test_ecc_nonces\n");
+  test_ecc_nonces();
+}
@@ -15,15 +15,60 @@ int
 main() {
   printf("Testing hnsd...\n");
 
+  printf("test_arena\n");
+  test_arena();
+
   printf("test_base32\n");
   test_base32();
 
   printf("test_dns\n");
   test_dns();
 
+  printf("test_req\n");
+  test_req();
+
   printf("test_resource\n");
   test_resource();
 
+  printf("test_cache\n");
+  test_cache();
+
+  printf("test_ecc\n");
+  test_ecc();
+
+  printf("test_icann\n");
+  test_icann();
+
+  printf("test_latency\n");
+  test_latency();
+
+  printf("test_namecache\n");
+  test_namecache();
+
+  printf("test_ns\n");
+  test_ns();
+
+  printf("test_pool\n");
+  test_pool();
+
+  printf("test_rrl\n");
+  test_rrl();
+
+  printf("test_sendpool\n");
+  test_sendpool();
+
+  printf("test_sigcache\n");
+  test_sigcache();
+
+  printf("test_wheel\n");
+  test_wheel();
+
+  printf("test_work\n");
+  test_work();
+
+  printf("test_zone\n");
+  test_zone();
+
   printf("ok\n");
 
   return 0;
@@ -1,13 +1,58 @@
 #ifndef _HSK_HNSD_TEST_H
 #define _HSK_HNSD_TEST_H
 
+void
+test_arena();
+
 void
 test_base32();
 
 void
 test_dns();
 
+void
+test_req();
+
 void
 test_resource();
 
+void
+test_cache();
+
+void
+test_ecc();
+
+void
+test_icann();
+
+void
+test_latency();
+
+void
+test_namecache();
+
+void
+test_ns();
+
+void
+test_pool();
+
+void
+test_rrl();
+
+void
+test_sendpool();
+
+void
+test_sigcache();
+
+void
+test_wheel();
+
+void
+test_work();
+
+void
+test_zone();
+
 #endif
@@ -0,0 +1,57 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns.h"
+#include "icann.h"
+#include "resource.h"
+
+static void
+test_icann_index() {
+  // First, last, and somewhere in between.
+  assert(hsk_icann_index("aaa") == 0);
+  assert(hsk_icann_index("zw") == 1480);
+  assert(hsk_icann_index("xn--11b4c3d") == 1306);
+
+  assert(hsk_icann_index("com") >= 0);
+  assert(hsk_icann_index("COM") == hsk_icann_index("com"));
+  assert(hsk_icann_index("Net") == hsk_icann_index("net"));
+  assert(hsk_icann_index("com") != hsk_icann_index("net"));
+
+  // Hashes to some slot, but is not that name.
+  assert(hsk_icann_index("") == -1);
+  assert(hsk_icann_index("comx") == -1);
+  assert(hsk_icann_index("comm") == -1);
+  assert(hsk_icann_index("hnsd-not-a-tld") == -1);
+}
+
+static void
+test_icann_resource() {
+  hsk_icann_init();
+
+  const hsk_resource_t *com = hsk_icann_resource("com");
+  assert(com);
+  assert(com->record_count > 0);
+
+  // Shared, not decoded per lookup.
+  assert(hsk_icann_resource("COM") == com);
+  assert(hsk_icann_resource("hnsd-not-a-tld") == NULL);
+
+  hsk_dns_msg_t *msg = hsk_resource_to_dns(NULL, com, "www.com.", HSK_DNS_A);
+  assert(msg);
+
+  // Referral to the ICANN servers.
+  assert(msg->ns.size > 0);
+
+  hsk_dns_msg_free(msg);
+}
+
+void
+test_icann() {
+  printf(" test_icann_index\n");
+  test_icann_index();
+
+  printf(" test_icann_resource\n");
+  test_icann_resource();
+}
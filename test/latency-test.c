@@ -0,0 +1,58 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency.h"
+
+static void
+test_latency_quantile() {
+  hsk_latency_t lat;
+  hsk_latency_init(&lat);
+
+  assert(hsk_latency_quantile(&lat, 0.9) == -1);
+
+  // 1..10, out of order.
+  const int64_t ms[10] = { 7, 3, 10, 1, 9, 2, 8, 4, 6, 5 };
+
+  for (int i = 0; i < 10; i++)
+    hsk_latency_add(&lat, ms[i]);
+
+  assert(lat.count == 10);
+  assert(hsk_latency_quantile(&lat, 0.9) == 9);
+  assert(hsk_latency_quantile(&lat, 0.5) == 5);
+  assert(hsk_latency_quantile(&lat, 1) == 10);
+  assert(hsk_latency_quantile(&lat, 0) == 1);
+
+  // Clock skew is not a negative latency.
+  hsk_latency_add(&lat, -5);
+  assert(hsk_latency_quantile(&lat, 0) == 0);
+}
+
+static void
+test_latency_window() {
+  hsk_latency_t lat;
+  hsk_latency_init(&lat);
+
+  for (int i = 0; i < HSK_LATENCY_SAMPLES; i++)
+    hsk_latency_add(&lat, 5000);
+
+  assert(hsk_latency_quantile(&lat, 0.9) == 5000);
+
+  // A slow spell ages out of the window.
+  for (int i = 0; i < HSK_LATENCY_SAMPLES; i++)
+    hsk_latency_add(&lat, 50);
+
+  assert(lat.count == HSK_LATENCY_SAMPLES);
+  assert(lat.total == 2 * HSK_LATENCY_SAMPLES);
+  assert(hsk_latency_quantile(&lat, 0.9) == 50);
+}
+
+void
+test_latency() {
+  printf(" test_latency_quantile\n");
+  test_latency_quantile();
+
+  printf(" test_latency_window\n");
+  test_latency_window();
+}
@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "namecache.h"
+
+static void
+fill(uint8_t *out, uint8_t ch) {
+  memset(out, ch, 32);
+}
+
+static void
+insert(
+  hsk_namecache_t *nc,
+  const char *name,
+  uint8_t id,
+  const uint8_t *root
+) {
+  uint8_t hash[32];
+  uint8_t data[4] = { 1, 2, 3, 4 };
+
+  fill(hash, id);
+
+  assert(hsk_namecache_insert(nc, name, hash, root, true, data, 4));
+}
+
+static bool
+lookup(hsk_namecache_t *nc, uint8_t id, const uint8_t *root) {
+  uint8_t hash[32];
+  fill(hash, id);
+  return hsk_namecache_get(nc, hash, root) != NULL;
+}
+
+static void
+test_namecache_root() {
+  hsk_namecache_t nc;
+  hsk_namecache_init(&nc);
+
+  uint8_t root1[32];
+  uint8_t root2[32];
+  fill(root1, 0xaa);
+  fill(root2, 0xbb);
+
+  insert(&nc, "foo", 1, root1);
+
+  assert(lookup(&nc, 1, root1));
+  assert(!lookup(&nc, 1, root2));
+  assert(nc.hits == 1);
+  assert(nc.misses == 1);
+
+  // Re-proving keeps the popularity earned so far.
+  insert(&nc, "foo", 1, root2);
+
+  assert(nc.map.size == 1);
+  assert(nc.head->score == 3);
+  assert(lookup(&nc, 1, root2));
+
+  hsk_namecache_uninit(&nc);
+}
+
+static void
+test_namecache_hottest() {
+  hsk_namecache_t nc;
+  hsk_namecache_init(&nc);
+
+  uint8_t root1[32];
+  uint8_t root2[32];
+  fill(root1, 0xaa);
+  fill(root2, 0xbb);
+
+  insert(&nc, "cold", 1, root1);
+  insert(&nc, "warm", 2, root1);
+  insert(&nc, "hot", 3, root1);
+  insert(&nc, "done", 4, root2);
+
+  for (int i = 0; i < 10; i++)
+    assert(lookup(&nc, 3, root1));
+
+  for (int i = 0; i < 5; i++)
+    assert(lookup(&nc, 2, root1));
+
+  for (int i = 0; i < 20; i++)
+    assert(lookup(&nc, 4, root2));
+
+  hsk_namecache_item_t *items[2];
+
+  // Names already proven against root2 are skipped.
+  size_t count = hsk_namecache_hottest(&nc, root2, items, 2);
+
+  assert(count == 2);
+  assert(strcmp(items[0]->name, "hot") == 0);
+  assert(strcmp(items[1]->name, "warm") == 0);
+
+  // A single decay leaves "cold" with nothing.
+  hsk_namecache_decay(&nc);
+
+  assert(items[0]->score == 5);
+  assert(items[1]->score == 3);
+
+  count = hsk_namecache_hottest(&nc, root2, items, 2);
+
+  assert(count == 2);
+  assert(strcmp(items[0]->name, "hot") == 0);
+
+  hsk_namecache_decay(&nc);
+  hsk_namecache_decay(&nc);
+  hsk_namecache_decay(&nc);
+
+  count = hsk_namecache_hottest(&nc, root2, items, 2);
+
+  assert(count == 0);
+
+  hsk_namecache_uninit(&nc);
+}
+
+static void
+test_namecache_persist() {
+  hsk_namecache_t nc;
+  hsk_namecache_init(&nc);
+
+  uint8_t root[32];
+  fill(root, 0xaa);
+
+  insert(&nc, "foo", 1, root);
+  insert(&nc, "bar", 2, root);
+
+  assert(lookup(&nc, 1, root));
+
+  size_t size = hsk_namecache_write(&nc, NULL);
+  uint8_t *data = malloc(size);
+  assert(data);
+
+  uint8_t *buf = data;
+  assert(hsk_namecache_write(&nc, &buf) == size);
+
+  hsk_namecache_t r;
+  hsk_namecache_init(&r);
+
+  buf = data;
+  size_t len = size;
+
+  assert(hsk_namecache_read(&r, &buf, &len));
+  assert(len == 0);
+  assert(r.map.size == 2);
+  assert(strcmp(r.head->name, "foo") == 0);
+  assert(r.head->score == 2);
+  assert(r.head->data_len == 4);
+  assert(lookup(&r, 2, root));
+
+  hsk_namecache_uninit(&r);
+  hsk_namecache_uninit(&nc);
+  free(data);
+}
+
+void
+test_namecache() {
+  printf(" test_namecache_root\n");
+  test_namecache_root();
+
+  printf(" test_namecache_hottest\n");
+  test_namecache_hottest();
+
+  printf(" test_namecache_persist\n");
+  test_namecache_persist();
+}
@@ -0,0 +1,262 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uv.h"
+#include "bio.h"
+#include "dns.h"
+#include "error.h"
+#include "ns.h"
+#include "pool.h"
+#include "sigcache.h"
+
+#define TEST_NS_QUERIES 3
+
+typedef struct test_client_s {
+  uv_udp_t socket;
+  uint8_t read[4096];
+  uint8_t replies[TEST_NS_QUERIES][4096];
+  size_t sizes[TEST_NS_QUERIES];
+  int count;
+} test_client_t;
+
+static void
+test_client_alloc(uv_handle_t *handle, size_t size, uv_buf_t *buf) {
+  test_client_t *client = (test_client_t *)handle->data;
+  buf->base = (char *)client->read;
+  buf->len = sizeof(client->read);
+}
+
+static void
+test_client_recv(
+  uv_udp_t *socket,
+  ssize_t nread,
+  const uv_buf_t *buf,
+  const struct sockaddr *addr,
+  unsigned flags
+) {
+  test_client_t *client = (test_client_t *)socket->data;
+
+  if (nread <= 0 || !addr)
+    return;
+
+  assert(client->count < TEST_NS_QUERIES);
+  assert((size_t)nread <= sizeof(client->replies[0]));
+
+  memcpy(client->replies[client->count], buf->base, nread);
+  client->sizes[client->count] = nread;
+  client->count += 1;
+}
+
+// A query with EDNS and the DO bit, so the answer is signed.
+// Returns the length; the question starts at byte 12.
+static size_t
+test_query(uint8_t *out, uint16_t id, const char *name, size_t *qlen) {
+  uint8_t *p = out;
+  size_t size = 0;
+
+  size += write_u16be(&p, id);
+  size += write_u16be(&p, 0);
+  size += write_u16be(&p, 1);
+  size += write_u16be(&p, 0);
+  size += write_u16be(&p, 0);
+  size += write_u16be(&p, 1);
+
+  const char *label = name;
+
+  while (*label) {
+    const char *dot = strchr(label, '.');
+    size_t len = dot ? (size_t)(dot - label) : strlen(label);
+
+    size += write_u8(&p, (uint8_t)len);
+    size += write_bytes(&p, (const uint8_t *)label, len);
+
+    label += len;
+
+    if (*label == '.')
+      label += 1;
+  }
+
+  size += write_u8(&p, 0);
+  size += write_u16be(&p, HSK_DNS_A);
+  size += write_u16be(&p, HSK_DNS_IN);
+
+  *qlen = size - 12;
+
+  // OPT: 4096 byte payload, DO.
+  size += write_u8(&p, 0);
+  size += write_u16be(&p, HSK_DNS_OPT);
+  size += write_u16be(&p, 4096);
+  size += write_u32be(&p, 0x8000);
+  size += write_u16be(&p, 0);
+
+  return size;
+}
+
+static uint64_t
+test_count_rrsigs(const hsk_dns_rrs_t *rrs) {
+  uint64_t count = 0;
+
+  for (size_t i = 0; i < rrs->size; i++) {
+    if (rrs->items[i]->type == HSK_DNS_RRSIG)
+      count += 1;
+  }
+
+  return count;
+}
+
+static void
+test_tick(uv_timer_t *timer) {
+  return;
+}
+
+static void
+test_ns_coalesce() {
+  uv_loop_t loop;
+  uv_timer_t tick;
+  uv_udp_t probe;
+  hsk_pool_t pool;
+  hsk_ns_t ns;
+  test_client_t client;
+  struct sockaddr_storage ss;
+  int len = sizeof(ss);
+
+  // Identical misses, differing only in ID and case.
+  const char *names[TEST_NS_QUERIES] = { "www.com", "WWW.Com", "www.cOM" };
+  const uint16_t ids[TEST_NS_QUERIES] = { 0x1001, 0x2002, 0x3003 };
+
+  uint8_t queries[TEST_NS_QUERIES][512];
+  size_t sizes[TEST_NS_QUERIES];
+  size_t qlens[TEST_NS_QUERIES];
+
+  memset(&client, 0, sizeof(client));
+
+  assert(uv_loop_init(&loop) == 0);
+  assert(uv_timer_init(&loop, &tick) == 0);
+  assert(uv_timer_start(&tick, test_tick, 10, 10) == 0);
+
+  // A free port for the nameserver.
+  assert(uv_ip4_addr("127.0.0.1", 0, (struct sockaddr_in *)&ss) == 0);
+  assert(uv_udp_init(&loop, &probe) == 0);
+  assert(uv_udp_bind(&probe, (struct sockaddr *)&ss, 0) == 0);
+  assert(uv_udp_getsockname(&probe, (struct sockaddr *)&ss, &len) == 0);
+  uv_close((uv_handle_t *)&probe, NULL);
+  uv_run(&loop, UV_RUN_NOWAIT);
+
+  // A synced pool without peers: requests wait in its queue.
+  assert(hsk_pool_init(&pool, &loop) == HSK_SUCCESS);
+  hsk_map_reset(&pool.am.map);
+  pool.am.size = 0;
+  pool.chain.synced = true;
+
+  uint8_t key[32];
+  memset(key, 0x01, sizeof(key));
+
+  assert(hsk_ns_init(&ns, &loop, &pool) == HSK_SUCCESS);
+  assert(hsk_ns_set_key(&ns, key));
+  assert(hsk_ns_open(&ns, (struct sockaddr *)&ss) == HSK_SUCCESS);
+
+  struct sockaddr_storage local;
+  assert(uv_ip4_addr("127.0.0.1", 0, (struct sockaddr_in *)&local) == 0);
+  assert(uv_udp_init(&loop, &client.socket) == 0);
+  client.socket.data = (void *)&client;
+  assert(uv_udp_bind(&client.socket, (struct sockaddr *)&local, 0) == 0);
+  assert(uv_udp_recv_start(&client.socket, test_client_alloc,
+                           test_client_recv) == 0);
+
+  for (int i = 0; i < TEST_NS_QUERIES; i++) {
+    sizes[i] = test_query(queries[i], ids[i], names[i], &qlens[i]);
+
+    uv_buf_t buf = uv_buf_init((char *)queries[i], sizes[i]);
+    assert(uv_udp_try_send(&client.socket, &buf, 1,
+                           (struct sockaddr *)&ss) == (int)sizes[i]);
+  }
+
+  uint64_t end = uv_now(&loop) + 2000;
+
+  while (ns.coalesced < TEST_NS_QUERIES - 1) {
+    assert(uv_now(&loop) < end);
+    uv_run(&loop, UV_RUN_ONCE);
+  }
+
+  // One proof request for all of them.
+  assert(pool.pending.count == 1);
+  assert(ns.inflight.size == 1);
+  assert(client.count == 0);
+
+  hsk_sigcache_t *sigcache = hsk_sigcache_global();
+  uint64_t hits = sigcache->hits;
+  uint64_t misses = sigcache->misses;
+  uint64_t builds = ns.sign->inlined + ns.sign->queued;
+
+  // Answered as the pool would: the name is unclaimed,
+  // so the ICANN root zone's referral is served.
+  hsk_name_req_t *req = pool.pending.head;
+  assert(req->next == NULL);
+
+  pool.pending.head = NULL;
+  pool.pending.tail = NULL;
+  pool.pending.count = 0;
+
+  req->callback(req->name, HSK_SUCCESS, false, NULL, 0, req->arg);
+  free(req);
+
+  end = uv_now(&loop) + 2000;
+
+  while (client.count < TEST_NS_QUERIES) {
+    assert(uv_now(&loop) < end);
+    uv_run(&loop, UV_RUN_ONCE);
+  }
+
+  // Built once, so every signature in it was
+  // looked up once however many replies went out.
+  assert(ns.sign->inlined + ns.sign->queued == builds + 1);
+  assert(ns.inflight.size == 0);
+
+  hsk_dns_msg_t *msg = NULL;
+  assert(hsk_dns_msg_decode(client.replies[0], client.sizes[0], &msg));
+
+  uint64_t sigs = test_count_rrsigs(&msg->an)
+                + test_count_rrsigs(&msg->ns)
+                + test_count_rrsigs(&msg->ar);
+
+  hsk_dns_msg_free(msg);
+
+  assert(sigs > 0);
+  assert(sigcache->hits + sigcache->misses == hits + misses + sigs);
+
+  // Each reply carries its own ID and question.
+  for (int i = 0; i < TEST_NS_QUERIES; i++) {
+    const uint8_t *reply = NULL;
+
+    for (int j = 0; j < client.count; j++) {
+      if (client.replies[j][0] == (ids[i] >> 8)
+          && client.replies[j][1] == (ids[i] & 0xff)) {
+        assert(!reply);
+        reply = client.replies[j];
+      }
+    }
+
+    assert(reply);
+    assert(reply[2] & 0x80);
+    assert((reply[3] & 0x0f) == HSK_DNS_NOERROR);
+    assert(memcmp(&reply[12], &queries[i][12], qlens[i]) == 0);
+  }
+
+  assert(hsk_ns_close(&ns) == HSK_SUCCESS);
+  hsk_ns_uninit(&ns);
+  hsk_pool_uninit(&pool);
+
+  uv_close((uv_handle_t *)&client.socket, NULL);
+  uv_close((uv_handle_t *)&tick, NULL);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+void
+test_ns() {
+  printf(" test_ns_coalesce\n");
+  test_ns_coalesce();
+}
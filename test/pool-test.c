@@ -0,0 +1,662 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uv.h"
+#include "addrmgr.h"
+#include "bio.h"
+#include "constants.h"
+#include "error.h"
+#include "hash.h"
+#include "msg.h"
+#include "namecache.h"
+#include "pool.h"
+#include "utils.h"
+
+/*
+ * Test peer: plain TCP, records the proof requests
+ * it gets and answers them when told to.
+ */
+
+#define TEST_PEER_REQS 64
+
+typedef struct test_peer_s {
+  uv_tcp_t server;
+  uv_tcp_t conn;
+  uint16_t port;
+  bool connected;
+  bool closed;
+  uint8_t read[4096];
+  uint8_t buf[8192];
+  size_t len;
+  uint8_t keys[TEST_PEER_REQS][32];
+  uint8_t roots[TEST_PEER_REQS][32];
+  int requests;
+  int answered;
+} test_peer_t;
+
+typedef struct test_lookup_s {
+  int calls;
+  int status;
+  bool exists;
+} test_lookup_t;
+
+static void
+test_peer_write(test_peer_t *tp, const uint8_t *data, size_t len) {
+  uv_buf_t buf = uv_buf_init((char *)data, len);
+  assert(uv_try_write((uv_stream_t *)&tp->conn, &buf, 1) == (int)len);
+}
+
+static size_t
+test_peer_msg(uint8_t *out, uint8_t cmd, const uint8_t *body, size_t len) {
+  uint8_t *p = out;
+  size_t size = 0;
+  size += write_u32(&p, HSK_MAGIC);
+  size += write_u8(&p, cmd);
+  size += write_u32(&p, (uint32_t)len);
+  if (len > 0)
+    size += write_bytes(&p, body, len);
+  return size;
+}
+
+// A dead end proof: the name does not exist
+// (and verifies against an empty tree).
+static size_t
+test_peer_proof(uint8_t *out, const uint8_t *root, const uint8_t *key) {
+  uint8_t body[68];
+  uint8_t *p = body;
+  write_bytes(&p, root, 32);
+  write_bytes(&p, key, 32);
+  write_u16(&p, 0);
+  write_u16(&p, 0);
+  return test_peer_msg(out, HSK_MSG_PROOF, body, sizeof(body));
+}
+
+// Answer request `i`.
+static void
+test_peer_answer(test_peer_t *tp, int i) {
+  uint8_t msg[128];
+  assert(i < tp->requests);
+  test_peer_write(tp, msg, test_peer_proof(msg, tp->roots[i], tp->keys[i]));
+  tp->answered += 1;
+}
+
+// Answer everything outstanding in one write, so
+// the pool reads every proof at the same time.
+static void
+test_peer_answer_all(test_peer_t *tp) {
+  uint8_t msg[TEST_PEER_REQS * 80];
+  size_t len = 0;
+
+  for (; tp->answered < tp->requests; tp->answered++) {
+    len += test_peer_proof(msg + len,
+                           tp->roots[tp->answered],
+                           tp->keys[tp->answered]);
+  }
+
+  if (len > 0)
+    test_peer_write(tp, msg, len);
+}
+
+static void
+test_peer_parse(test_peer_t *tp) {
+  while (tp->len >= 9) {
+    uint8_t cmd = tp->buf[4];
+    uint8_t *p = &tp->buf[5];
+    size_t n = 4;
+    uint32_t size;
+
+    assert(read_u32(&p, &n, &size));
+
+    if (tp->len < 9 + size)
+      break;
+
+    if (cmd == HSK_MSG_VERSION) {
+      uint8_t msg[9];
+      test_peer_write(tp, msg, test_peer_msg(msg, HSK_MSG_VERACK, NULL, 0));
+    }
+
+    if (cmd == HSK_MSG_GETPROOF) {
+      assert(size == 64);
+      assert(tp->requests < TEST_PEER_REQS);
+      memcpy(tp->roots[tp->requests], &tp->buf[9], 32);
+      memcpy(tp->keys[tp->requests], &tp->buf[41], 32);
+      tp->requests += 1;
+    }
+
+    memmove(tp->buf, &tp->buf[9 + size], tp->len - 9 - size);
+    tp->len -= 9 + size;
+  }
+}
+
+static void
+test_peer_alloc(uv_handle_t *handle, size_t size, uv_buf_t *buf) {
+  test_peer_t *tp = (test_peer_t *)handle->data;
+  buf->base = (char *)tp->read;
+  buf->len = sizeof(tp->read);
+}
+
+static void
+test_peer_after_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
+  test_peer_t *tp = (test_peer_t *)stream->data;
+
+  if (nread < 0) {
+    tp->closed = true;
+    uv_read_stop(stream);
+    return;
+  }
+
+  assert(tp->len + nread <= sizeof(tp->buf));
+  memcpy(&tp->buf[tp->len], buf->base, nread);
+  tp->len += nread;
+
+  test_peer_parse(tp);
+}
+
+static void
+test_peer_on_connection(uv_stream_t *server, int status) {
+  test_peer_t *tp = (test_peer_t *)server->data;
+
+  assert(status == 0);
+  assert(!tp->connected);
+
+  assert(uv_tcp_init(server->loop, &tp->conn) == 0);
+  tp->conn.data = (void *)tp;
+
+  assert(uv_accept(server, (uv_stream_t *)&tp->conn) == 0);
+  assert(uv_read_start((uv_stream_t *)&tp->conn,
+                       test_peer_alloc,
+                       test_peer_after_read) == 0);
+
+  tp->connected = true;
+}
+
+static void
+test_peer_listen(test_peer_t *tp, uv_loop_t *loop) {
+  struct sockaddr_storage ss;
+  int len = sizeof(ss);
+
+  memset(tp, 0, sizeof(*tp));
+
+  assert(uv_ip4_addr("127.0.0.1", 0, (struct sockaddr_in *)&ss) == 0);
+  assert(uv_tcp_init(loop, &tp->server) == 0);
+  tp->server.data = (void *)tp;
+
+  assert(uv_tcp_bind(&tp->server, (struct sockaddr *)&ss, 0) == 0);
+  assert(uv_listen((uv_stream_t *)&tp->server, 8,
+                   test_peer_on_connection) == 0);
+
+  assert(uv_tcp_getsockname(&tp->server, (struct sockaddr *)&ss, &len) == 0);
+  tp->port = ntohs(((struct sockaddr_in *)&ss)->sin_port);
+}
+
+static void
+test_peer_close(test_peer_t *tp) {
+  uv_close((uv_handle_t *)&tp->server, NULL);
+
+  if (tp->connected)
+    uv_close((uv_handle_t *)&tp->conn, NULL);
+}
+
+/*
+ * Helpers
+ */
+
+// Run the loop until `cond` holds, failing after `ms`.
+#define run_until(loop, cond, ms) do {        \
+  uint64_t end_ = uv_now(loop) + (ms);        \
+  while (!(cond)) {                           \
+    assert(uv_now(loop) < end_);              \
+    uv_run((loop), UV_RUN_ONCE);              \
+  }                                           \
+} while (0)
+
+static void
+test_tick(uv_timer_t *timer) {
+  return;
+}
+
+static void
+test_resolve_cb(
+  const char *name,
+  int status,
+  bool exists,
+  const uint8_t *data,
+  size_t data_len,
+  const void *arg
+) {
+  test_lookup_t *lookup = (test_lookup_t *)arg;
+  lookup->calls += 1;
+  lookup->status = status;
+  lookup->exists = exists;
+}
+
+// A synced pool which only knows about the test peers.
+static void
+test_pool_open(
+  hsk_pool_t *pool,
+  uv_loop_t *loop,
+  test_peer_t *peers,
+  int count
+) {
+  assert(hsk_pool_init(pool, loop) == HSK_SUCCESS);
+
+  // Forget the seeds.
+  hsk_map_reset(&pool->am.map);
+  pool->am.size = 0;
+
+  for (int i = 0; i < count; i++) {
+    struct sockaddr_in sa;
+    assert(uv_ip4_addr("127.0.0.1", peers[i].port, &sa) == 0);
+    assert(hsk_addrman_add_sa(&pool->am, (struct sockaddr *)&sa));
+  }
+
+  assert(hsk_pool_set_size(pool, count > 0 ? count : 1));
+
+  pool->chain.synced = true;
+
+  // Dead end proofs verify against an empty tree.
+  memset((uint8_t *)hsk_chain_safe_root(&pool->chain), 0, 32);
+
+  assert(hsk_pool_open(pool) == HSK_SUCCESS);
+
+  for (int i = 0; i < count; i++)
+    run_until(loop, peers[i].connected, 2000);
+}
+
+static void
+test_pool_close(
+  hsk_pool_t *pool,
+  uv_loop_t *loop,
+  test_peer_t *peers,
+  int count
+) {
+  assert(hsk_pool_close(pool) == HSK_SUCCESS);
+  hsk_pool_uninit(pool);
+
+  for (int i = 0; i < count; i++)
+    test_peer_close(&peers[i]);
+}
+
+static hsk_peer_t *
+test_pool_peer(hsk_pool_t *pool, const test_peer_t *tp) {
+  for (hsk_peer_t *peer = pool->head; peer; peer = peer->next) {
+    if (peer->addr.port == tp->port)
+      return peer;
+  }
+
+  return NULL;
+}
+
+/*
+ * Tests
+ */
+
+static void
+test_pool_hedge_loser() {
+  uv_loop_t loop;
+  uv_timer_t tick;
+  hsk_pool_t pool;
+  test_peer_t peers[2];
+  test_lookup_t lookup;
+
+  memset(&lookup, 0, sizeof(lookup));
+
+  assert(uv_loop_init(&loop) == 0);
+  assert(uv_timer_init(&loop, &tick) == 0);
+  assert(uv_timer_start(&tick, test_tick, 10, 10) == 0);
+
+  test_peer_listen(&peers[0], &loop);
+  test_peer_listen(&peers[1], &loop);
+  test_pool_open(&pool, &loop, peers, 2);
+
+  pool.hedge_delay = HSK_POOL_HEDGE_MIN;
+
+  assert(hsk_pool_resolve(&pool, "hedge", test_resolve_cb, &lookup) == 0);
+
+  run_until(&loop, peers[0].requests + peers[1].requests == 2, 2000);
+  assert(pool.hedges == 1);
+
+  test_peer_t *winner = peers[0].requests ? &peers[0] : &peers[1];
+  test_peer_t *loser = winner == &peers[0] ? &peers[1] : &peers[0];
+
+  assert(winner->requests == 1 && loser->requests == 1);
+
+  test_peer_answer(winner, 0);
+  run_until(&loop, lookup.calls == 1, 2000);
+
+  assert(lookup.status == HSK_SUCCESS);
+  assert(!lookup.exists);
+
+  // The loser's proof is still expected
+  // once the answer has been evicted.
+  hsk_namecache_uninit(&pool.namecache);
+  hsk_namecache_init(&pool.namecache);
+
+  test_peer_answer(loser, 0);
+  run_until(&loop, pool.verify->inlined == 2, 2000);
+
+  assert(lookup.calls == 1);
+  assert(pool.size == 2);
+  assert(test_pool_peer(&pool, loser));
+  assert(!loser->closed);
+
+  test_pool_close(&pool, &loop, peers, 2);
+  uv_close((uv_handle_t *)&tick, NULL);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+static void
+test_pool_late_proof() {
+  uv_loop_t loop;
+  uv_timer_t tick;
+  hsk_pool_t pool;
+  test_peer_t peers[2];
+  test_lookup_t lookup;
+
+  memset(&lookup, 0, sizeof(lookup));
+
+  assert(uv_loop_init(&loop) == 0);
+  assert(uv_timer_init(&loop, &tick) == 0);
+  assert(uv_timer_start(&tick, test_tick, 10, 10) == 0);
+
+  test_peer_listen(&peers[0], &loop);
+  test_peer_listen(&peers[1], &loop);
+  test_pool_open(&pool, &loop, peers, 2);
+
+  // Not hedged: only the retry reaches the second peer.
+  assert(hsk_pool_resolve_background(&pool, "late",
+                                     test_resolve_cb, &lookup) == 0);
+
+  run_until(&loop, peers[0].requests + peers[1].requests == 1, 2000);
+
+  test_peer_t *slow = peers[0].requests ? &peers[0] : &peers[1];
+  test_peer_t *retry = slow == &peers[0] ? &peers[1] : &peers[0];
+
+  run_until(&loop, retry->requests == 1, HSK_POOL_PROOF_TIMEOUT + 1000);
+
+  assert(pool.timeouts == 1);
+  assert(pool.retries == 1);
+  assert(lookup.calls == 0);
+
+  // Timing out halves the window too.
+  assert(test_pool_peer(&pool, slow)->window == HSK_POOL_WINDOW_INIT / 2);
+
+  // Answered after its deadline, but before the retry.
+  test_peer_answer(slow, 0);
+  run_until(&loop, lookup.calls == 1, 2000);
+
+  assert(lookup.status == HSK_SUCCESS);
+  assert(!lookup.exists);
+  assert(test_pool_peer(&pool, slow));
+  assert(hsk_namecache_get(&pool.namecache, retry->keys[0], retry->roots[0]));
+
+  // The retry is answered too, after the cache lost it.
+  hsk_namecache_uninit(&pool.namecache);
+  hsk_namecache_init(&pool.namecache);
+
+  test_peer_answer(retry, 0);
+  run_until(&loop, pool.verify->inlined == 2, 2000);
+
+  assert(lookup.calls == 1);
+  assert(pool.size == 2);
+  assert(test_pool_peer(&pool, retry));
+  assert(!slow->closed && !retry->closed);
+
+  test_pool_close(&pool, &loop, peers, 2);
+  uv_close((uv_handle_t *)&tick, NULL);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+static void
+test_pool_window() {
+  uv_loop_t loop;
+  uv_timer_t tick;
+  hsk_pool_t pool;
+  test_peer_t tp;
+  test_lookup_t lookups[HSK_POOL_WINDOW_INIT + 1];
+
+  memset(lookups, 0, sizeof(lookups));
+
+  assert(uv_loop_init(&loop) == 0);
+  assert(uv_timer_init(&loop, &tick) == 0);
+  assert(uv_timer_start(&tick, test_tick, 10, 10) == 0);
+
+  test_peer_listen(&tp, &loop);
+  test_pool_open(&pool, &loop, &tp, 1);
+
+  hsk_peer_t *peer = test_pool_peer(&pool, &tp);
+  assert(peer);
+  assert(peer->window == HSK_POOL_WINDOW_INIT);
+
+  // A full window of on-time proofs opens it by one.
+  for (int i = 0; i < HSK_POOL_WINDOW_INIT; i++) {
+    char name[16];
+    sprintf(name, "window%d", i);
+    assert(hsk_pool_resolve(&pool, name, test_resolve_cb, &lookups[i]) == 0);
+  }
+
+  run_until(&loop, tp.requests == HSK_POOL_WINDOW_INIT, 2000);
+
+  test_peer_answer_all(&tp);
+  run_until(&loop, pool.verify->inlined == HSK_POOL_WINDOW_INIT, 2000);
+
+  assert(peer->window == HSK_POOL_WINDOW_INIT + 1);
+
+  // One slow proof halves it.
+  assert(hsk_pool_resolve(&pool, "slow", test_resolve_cb,
+                          &lookups[HSK_POOL_WINDOW_INIT]) == 0);
+
+  run_until(&loop, tp.requests == HSK_POOL_WINDOW_INIT + 1, 2000);
+
+  uint64_t slow = uv_now(&loop) + 200;
+  run_until(&loop, uv_now(&loop) >= slow, 1000);
+
+  test_peer_answer_all(&tp);
+  run_until(&loop, lookups[HSK_POOL_WINDOW_INIT].calls == 1, 2000);
+
+  assert(peer->window == (HSK_POOL_WINDOW_INIT + 1) / 2);
+
+  test_pool_close(&pool, &loop, &tp, 1);
+  uv_close((uv_handle_t *)&tick, NULL);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+static void
+test_pool_drain_order() {
+  uv_loop_t loop;
+  uv_timer_t tick;
+  hsk_pool_t pool;
+  test_peer_t tp;
+  test_lookup_t lookups[4];
+  const char *names[4] = { "first", "refresh", "live1", "live2" };
+
+  memset(lookups, 0, sizeof(lookups));
+
+  assert(uv_loop_init(&loop) == 0);
+  assert(uv_timer_init(&loop, &tick) == 0);
+  assert(uv_timer_start(&tick, test_tick, 10, 10) == 0);
+
+  test_peer_listen(&tp, &loop);
+  test_pool_open(&pool, &loop, &tp, 1);
+
+  hsk_peer_t *peer = test_pool_peer(&pool, &tp);
+  assert(peer);
+
+  peer->window = 1;
+
+  assert(hsk_pool_resolve(&pool, names[0], test_resolve_cb, &lookups[0]) == 0);
+
+  // The refresh was queued first, but waits for client lookups.
+  assert(hsk_pool_resolve_background(&pool, names[1],
+                                     test_resolve_cb, &lookups[1]) == 0);
+  assert(hsk_pool_resolve(&pool, names[2], test_resolve_cb, &lookups[2]) == 0);
+  assert(hsk_pool_resolve(&pool, names[3], test_resolve_cb, &lookups[3]) == 0);
+
+  assert(pool.pending.count == 2);
+  assert(pool.background.count == 1);
+
+  run_until(&loop, tp.requests == 1, 2000);
+
+  while (tp.requests < 4) {
+    int sent = tp.requests;
+    test_peer_answer_all(&tp);
+    run_until(&loop, tp.requests > sent, 2000);
+  }
+
+  test_peer_answer_all(&tp);
+  run_until(&loop, lookups[1].calls == 1, 2000);
+
+  const int order[4] = { 0, 2, 3, 1 };
+
+  for (int i = 0; i < 4; i++) {
+    uint8_t hash[32];
+    hsk_hash_name(names[order[i]], hash);
+    assert(memcmp(tp.keys[i], hash, 32) == 0);
+    assert(lookups[i].calls == 1);
+    assert(lookups[i].status == HSK_SUCCESS);
+  }
+
+  assert(pool.pending.count == 0);
+  assert(pool.background.count == 0);
+
+  test_pool_close(&pool, &loop, &tp, 1);
+  uv_close((uv_handle_t *)&tick, NULL);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+static void
+test_pool_queue_timeout() {
+  uv_loop_t loop;
+  uv_timer_t tick;
+  hsk_pool_t pool;
+  test_lookup_t lookups[2];
+
+  memset(lookups, 0, sizeof(lookups));
+
+  assert(uv_loop_init(&loop) == 0);
+  assert(uv_timer_init(&loop, &tick) == 0);
+  assert(uv_timer_start(&tick, test_tick, 10, 10) == 0);
+
+  // No peers: everything waits in the queue.
+  test_pool_open(&pool, &loop, NULL, 0);
+
+  assert(hsk_pool_resolve(&pool, "old", test_resolve_cb, &lookups[0]) == 0);
+  assert(pool.pending.count == 1);
+
+  pool.pending.head->time = hsk_now() - HSK_POOL_QUEUE_TIMEOUT - 1;
+
+  assert(hsk_pool_resolve(&pool, "new", test_resolve_cb, &lookups[1]) == 0);
+  assert(pool.pending.count == 2);
+
+  // Only the request which has waited too long goes.
+  run_until(&loop, lookups[0].calls == 1, 4000);
+
+  assert(lookups[0].status == HSK_ETIMEOUT);
+  assert(lookups[1].calls == 0);
+  assert(pool.pending.count == 1);
+  assert(pool.queue_expired == 1);
+
+  test_pool_close(&pool, &loop, NULL, 0);
+  uv_close((uv_handle_t *)&tick, NULL);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+static void
+test_pool_scale() {
+  uv_loop_t loop;
+  uv_timer_t tick;
+  hsk_pool_t pool;
+  test_peer_t tp;
+  test_lookup_t lookups[HSK_POOL_WINDOW_INIT * 4];
+  int count = 0;
+
+  memset(lookups, 0, sizeof(lookups));
+
+  assert(uv_loop_init(&loop) == 0);
+  assert(uv_timer_init(&loop, &tick) == 0);
+  assert(uv_timer_start(&tick, test_tick, 10, 10) == 0);
+
+  test_peer_listen(&tp, &loop);
+  test_pool_open(&pool, &loop, &tp, 1);
+
+  assert(hsk_pool_set_max_size(&pool, 4));
+  assert(pool.target == 1);
+
+  // Fill the one window, then queue: one more peer
+  // is wanted for each window's worth of requests.
+  struct {
+    int queued;
+    int target;
+  } steps[3] = {
+    { HSK_POOL_WINDOW_INIT + 1, 3 },
+    { HSK_POOL_WINDOW_INIT * 2 + 1, 4 },
+    { HSK_POOL_WINDOW_INIT * 3, 4 }
+  };
+
+  for (int i = 0; i < 3; i++) {
+    while (count < HSK_POOL_WINDOW_INIT + steps[i].queued) {
+      char name[16];
+      sprintf(name, "scale%d", count);
+      assert(hsk_pool_resolve(&pool, name, test_resolve_cb,
+                              &lookups[count]) == 0);
+      count += 1;
+    }
+
+    assert(pool.pending.count == steps[i].queued);
+    assert(pool.target == steps[i].target);
+  }
+
+  // No other peers to connect to.
+  assert(pool.size == 1);
+
+  while (tp.answered < count) {
+    run_until(&loop, tp.requests > tp.answered, 2000);
+    test_peer_answer_all(&tp);
+  }
+
+  run_until(&loop, lookups[count - 1].calls == 1, 2000);
+  assert(pool.pending.count == 0);
+
+  // Idle: back down by one peer a tick.
+  run_until(&loop, pool.target < 4, 4000);
+  assert(pool.target == 3);
+
+  test_pool_close(&pool, &loop, &tp, 1);
+  uv_close((uv_handle_t *)&tick, NULL);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+void
+test_pool() {
+  printf(" test_pool_hedge_loser\n");
+  test_pool_hedge_loser();
+
+  printf(" test_pool_late_proof\n");
+  test_pool_late_proof();
+
+  printf(" test_pool_window\n");
+  test_pool_window();
+
+  printf(" test_pool_drain_order\n");
+  test_pool_drain_order();
+
+  printf(" test_pool_queue_timeout\n");
+  test_pool_queue_timeout();
+
+  printf(" test_pool_scale\n");
+  test_pool_scale();
+}
@@ -0,0 +1,227 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "dns.h"
+#include "req.h"
+
+// Header for a query with one question and `arcount` additionals.
+static size_t
+test_req_header(uint8_t *buf, uint16_t flags, uint16_t arcount) {
+  uint8_t hdr[12] = {
+    0x12, 0x34,
+    flags >> 8, flags & 0xff,
+    0x00, 0x01,
+    0x00, 0x00,
+    0x00, 0x00,
+    arcount >> 8, arcount & 0xff
+  };
+
+  memcpy(buf, hdr, 12);
+
+  return 12;
+}
+
+static size_t
+test_req_query(
+  uint8_t *buf,
+  const char *name,
+  uint16_t type,
+  bool edns,
+  uint32_t edns_ttl
+) {
+  size_t len = test_req_header(buf, HSK_DNS_RD, edns ? 1 : 0);
+  uint8_t *p = &buf[len];
+
+  len += hsk_dns_name_write(name, &p, NULL);
+
+  buf[len++] = type >> 8;
+  buf[len++] = type & 0xff;
+  buf[len++] = 0x00;
+  buf[len++] = HSK_DNS_IN;
+
+  if (edns) {
+    uint8_t opt[11] = {
+      0x00,
+      0x00, HSK_DNS_OPT,
+      0x10, 0x00,
+      edns_ttl >> 24, (edns_ttl >> 16) & 0xff,
+      (edns_ttl >> 8) & 0xff, edns_ttl & 0xff,
+      0x00, 0x00
+    };
+
+    memcpy(&buf[len], opt, sizeof(opt));
+    len += sizeof(opt);
+  }
+
+  return len;
+}
+
+static void
+test_req_fast() {
+  uint8_t buf[512];
+  size_t len = test_req_query(buf, "WwW.Example.ORG.", HSK_DNS_A, false, 0);
+  hsk_dns_req_t req;
+
+  assert(hsk_dns_req_parse(&req, buf, len, NULL));
+
+  assert(req.id == 0x1234);
+  assert(req.rd && !req.cd && !req.ad);
+  assert(strcmp(req.name, "WwW.Example.ORG.") == 0);
+  assert(strcmp(req.lower, "www.example.org.") == 0);
+  assert(req.name_len == 16);
+  assert(req.labels == 3);
+  assert(req.label_offs[0] == 0);
+  assert(req.label_offs[1] == 4);
+  assert(req.label_offs[2] == 12);
+  assert(!req.dirty);
+  assert(strcmp(req.tld, "org") == 0);
+  assert(req.type == HSK_DNS_A);
+  assert(req.class == HSK_DNS_IN);
+  assert(!req.edns && !req.dnssec);
+  assert(req.max_size == HSK_DNS_MAX_UDP);
+
+  len = test_req_query(buf, "foo.", HSK_DNS_NS, true, HSK_DNS_DO);
+
+  assert(hsk_dns_req_parse(&req, buf, len, NULL));
+  assert(req.edns && req.dnssec);
+  assert(req.max_size == 4096);
+  assert(strcmp(req.tld, "foo") == 0);
+
+  len = test_req_query(buf, ".", HSK_DNS_NS, false, 0);
+
+  assert(hsk_dns_req_parse(&req, buf, len, NULL));
+  assert(strcmp(req.name, ".") == 0);
+  assert(req.labels == 0);
+  assert(req.tld[0] == '\0');
+}
+
+static void
+test_req_fallback() {
+  uint8_t buf[512];
+  hsk_dns_req_t req;
+
+  // Question compressed against a name after it.
+  size_t len = test_req_header(buf, 0, 0);
+  uint8_t tail[] = {
+    0x03, 'F', 'o', 'o', 0xc0, 12 + 10,
+    0x00, HSK_DNS_TXT, 0x00, HSK_DNS_IN,
+    0x03, 'b', 'a', 'r', 0x00
+  };
+
+  memcpy(&buf[len], tail, sizeof(tail));
+  len += sizeof(tail);
+
+  assert(hsk_dns_req_parse(&req, buf, len, NULL));
+  assert(strcmp(req.name, "Foo.bar.") == 0);
+  assert(strcmp(req.lower, "foo.bar.") == 0);
+  assert(req.labels == 2);
+  assert(req.label_offs[1] == 4);
+  assert(strcmp(req.tld, "bar") == 0);
+  assert(req.type == HSK_DNS_TXT);
+
+  // An additional record which isn't OPT.
+  len = test_req_query(buf, "foo.", HSK_DNS_A, false, 0);
+  buf[11] = 1;
+
+  uint8_t a[] = {
+    0x00, 0x00, HSK_DNS_A, 0x00, HSK_DNS_IN,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 127, 0, 0, 1
+  };
+
+  memcpy(&buf[len], a, sizeof(a));
+  len += sizeof(a);
+
+  assert(hsk_dns_req_parse(&req, buf, len, NULL));
+  assert(strcmp(req.lower, "foo.") == 0);
+  assert(!req.edns);
+}
+
+static void
+test_req_invalid() {
+  uint8_t buf[512];
+  hsk_dns_req_t req;
+  size_t len = test_req_query(buf, "foo.", HSK_DNS_A, true, 0);
+
+  // Truncated.
+  assert(!hsk_dns_req_parse(&req, buf, 11, NULL));
+  assert(!hsk_dns_req_parse(&req, buf, 12 + 5, NULL));
+  assert(!hsk_dns_req_parse(&req, buf, len - 1, NULL));
+
+  // Extended RCODE.
+  len = test_req_query(buf, "foo.", HSK_DNS_A, true, 1 << 24);
+  assert(!hsk_dns_req_parse(&req, buf, len, NULL));
+
+  // Not a query.
+  len = test_req_query(buf, "foo.", HSK_DNS_A, false, 0);
+  buf[2] |= HSK_DNS_NOTIFY << 3;
+  assert(!hsk_dns_req_parse(&req, buf, len, NULL));
+
+  // Dirty TLDs, but not dirty subdomains.
+  len = test_req_query(buf, "foo.b@r.", HSK_DNS_A, false, 0);
+  assert(!hsk_dns_req_parse(&req, buf, len, NULL));
+
+  len = test_req_query(buf, "f@o.bar.", HSK_DNS_A, false, 0);
+  assert(hsk_dns_req_parse(&req, buf, len, NULL));
+  assert(req.dirty);
+}
+
+static void
+test_req_cache_key() {
+  const struct {
+    const char *name;
+    uint16_t type;
+  } vectors[] = {
+    { ".", HSK_DNS_NS },
+    { "Foo.", HSK_DNS_A },
+    { "www.FOO.", HSK_DNS_A },
+    { "_synth.", HSK_DNS_A },
+    { "_443._tcp.foo.", HSK_DNS_TLSA },
+    { "_443._tcp.foo.", HSK_DNS_A },
+    { "a.b.c.d.", HSK_DNS_AAAA },
+    { "f@o.bar.", HSK_DNS_A }
+  };
+
+  for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+    uint8_t buf[512];
+    size_t len = test_req_query(buf, vectors[i].name, vectors[i].type,
+                                false, 0);
+    hsk_dns_req_t req;
+
+    assert(hsk_dns_req_parse(&req, buf, len, NULL));
+
+    hsk_cache_key_t a, b;
+    hsk_cache_key_init(&a);
+    hsk_cache_key_init(&b);
+
+    bool ok = hsk_cache_key_set(&a, vectors[i].name, vectors[i].type);
+
+    assert(hsk_cache_key_set_req(&b, &req) == ok);
+
+    if (!ok)
+      continue;
+
+    assert(a.name_len == b.name_len);
+    assert(memcmp(a.name, b.name, a.name_len) == 0);
+    assert(a.ref == b.ref);
+    assert(a.type == b.type);
+    assert(hsk_cache_key_equal(&a, &b));
+  }
+}
+
+void
+test_req() {
+  printf(" test_req_fast\n");
+  test_req_fast();
+
+  printf(" test_req_fallback\n");
+  test_req_fallback();
+
+  printf(" test_req_invalid\n");
+  test_req_invalid();
+
+  printf(" test_req_cache_key\n");
+  test_req_cache_key();
+}
@@ -54,7 +54,7 @@ test_resource_to_dns() {
   hsk_dns_msg_t *msg1;
   printf(" 62 char TLD\n");
   char *name1 = "dddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd.";
-  msg1 = hsk_resource_to_dns(&res, name1, HSK_DNS_NS);
+  msg1 = hsk_resource_to_dns(NULL, &res, name1, HSK_DNS_NS);
   hsk_dns_rrs_t ns1 = msg1->ns;
   hsk_dns_rr_t *rr1 = ns1.items[0];
   hsk_dns_ns_rd_t *rd1 = rr1->rd;
@@ -65,7 +65,7 @@ test_resource_to_dns() {
   hsk_dns_msg_t *msg2;
   printf(" 63 char TLD\n");
   char *name2 = "ddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd.";
-  msg2 = hsk_resource_to_dns(&res, name2, HSK_DNS_NS);
+  msg2 = hsk_resource_to_dns(NULL, &res, name2, HSK_DNS_NS);
   hsk_dns_rrs_t ns2 = msg2->ns;
   hsk_dns_rr_t *rr2 = ns2.items[0];
   hsk_dns_ns_rd_t *rd2 = rr2->rd;
@@ -76,7 +76,7 @@ test_resource_to_dns() {
   hsk_dns_msg_t *msg3;
   printf(" 64 char TLD (invalid)\n");
   char *name3 = "dddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd.";
-  msg3 = hsk_resource_to_dns(&res, name3, HSK_DNS_NS);
+  msg3 = hsk_resource_to_dns(NULL, &res, name3, HSK_DNS_NS);
   assert(msg3 == NULL);
 }
 
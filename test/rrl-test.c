@@ -0,0 +1,144 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "addr.h"
+#include "rrl.h"
+
+static void
+test_rrl_sa(struct sockaddr_storage *ss, const char *ip) {
+  assert(hsk_sa_from_string((struct sockaddr *)ss, ip, 53));
+}
+
+static void
+test_rrl_slip() {
+  hsk_rrl_t *rrl = hsk_rrl_alloc();
+  assert(rrl);
+
+  hsk_rrl_set_rate(rrl, 10, 0);
+
+  struct sockaddr_storage ss;
+  struct sockaddr *addr = (struct sockaddr *)&ss;
+  test_rrl_sa(&ss, "203.0.113.7");
+
+  // A full burst passes...
+  for (int i = 0; i < 10 * HSK_RRL_BURST; i++)
+    assert(hsk_rrl_check(rrl, addr, 1000) == HSK_RRL_PASS);
+
+  // ...then every other reply is truncated.
+  assert(hsk_rrl_check(rrl, addr, 1000) == HSK_RRL_DROP);
+  assert(hsk_rrl_check(rrl, addr, 1000) == HSK_RRL_TRUNCATE);
+  assert(hsk_rrl_check(rrl, addr, 1000) == HSK_RRL_DROP);
+  assert(hsk_rrl_check(rrl, addr, 1000) == HSK_RRL_TRUNCATE);
+
+  assert(rrl->passed == 10 * HSK_RRL_BURST);
+  assert(rrl->dropped == 2);
+  assert(rrl->truncated == 2);
+
+  // The same /24 shares the bucket.
+  test_rrl_sa(&ss, "203.0.113.200");
+  assert(hsk_rrl_check(rrl, addr, 1000) != HSK_RRL_PASS);
+
+  // Other networks and loopback are unaffected.
+  test_rrl_sa(&ss, "198.51.100.1");
+  assert(hsk_rrl_check(rrl, addr, 1000) == HSK_RRL_PASS);
+
+  test_rrl_sa(&ss, "127.0.0.1");
+
+  for (int i = 0; i < 100; i++)
+    assert(hsk_rrl_check(rrl, addr, 1000) == HSK_RRL_PASS);
+
+  // A tenth of a second refills one token.
+  test_rrl_sa(&ss, "203.0.113.7");
+  assert(hsk_rrl_check(rrl, addr, 1100) == HSK_RRL_PASS);
+  assert(hsk_rrl_check(rrl, addr, 1100) != HSK_RRL_PASS);
+
+  // Disabled.
+  hsk_rrl_set_rate(rrl, 0, 0);
+
+  for (int i = 0; i < 100; i++)
+    assert(hsk_rrl_check(rrl, addr, 1100) == HSK_RRL_PASS);
+
+  hsk_rrl_free(rrl);
+}
+
+static void
+test_rrl_proof() {
+  hsk_rrl_t *rrl = hsk_rrl_alloc();
+  assert(rrl);
+
+  hsk_rrl_set_rate(rrl, 0, 5);
+
+  struct sockaddr_storage ss;
+  struct sockaddr *addr = (struct sockaddr *)&ss;
+  test_rrl_sa(&ss, "2001:db8:1:2::1");
+
+  for (int i = 0; i < 5 * HSK_RRL_BURST; i++)
+    assert(hsk_rrl_proof(rrl, addr, 0));
+
+  assert(!hsk_rrl_proof(rrl, addr, 0));
+  assert(rrl->proofs_limited == 1);
+
+  // The same /56 shares the bucket, another doesn't.
+  test_rrl_sa(&ss, "2001:db8:1:ff::1");
+  assert(!hsk_rrl_proof(rrl, addr, 0));
+
+  test_rrl_sa(&ss, "2001:db8:1:100::1");
+  assert(hsk_rrl_proof(rrl, addr, 0));
+
+  // Refilled, but only up to the burst.
+  test_rrl_sa(&ss, "2001:db8:1:2::1");
+
+  for (int i = 0; i < 5 * HSK_RRL_BURST; i++)
+    assert(hsk_rrl_proof(rrl, addr, 60000));
+
+  assert(!hsk_rrl_proof(rrl, addr, 60000));
+
+  // Loopback, where the recursive server's misses
+  // come from, has a proof budget like any network.
+  test_rrl_sa(&ss, "127.0.0.1");
+
+  for (int i = 0; i < 5 * HSK_RRL_BURST; i++)
+    assert(hsk_rrl_proof(rrl, addr, 60000));
+
+  assert(!hsk_rrl_proof(rrl, addr, 60000));
+
+  hsk_rrl_free(rrl);
+}
+
+static void
+test_rrl_evict() {
+  hsk_rrl_t *rrl = hsk_rrl_alloc();
+  assert(rrl);
+
+  hsk_rrl_set_rate(rrl, 1, 0);
+
+  struct sockaddr_storage ss;
+  struct sockaddr *addr = (struct sockaddr *)&ss;
+  char ip[32];
+
+  // Many more networks than entries: each is
+  // charged at most once, and the table stays put.
+  for (int i = 0; i < HSK_RRL_SIZE * 4; i++) {
+    sprintf(ip, "10.%d.%d.1", (i >> 8) & 0xff, i & 0xff);
+    test_rrl_sa(&ss, ip);
+    assert(hsk_rrl_check(rrl, addr, i) == HSK_RRL_PASS);
+  }
+
+  assert(rrl->passed == HSK_RRL_SIZE * 4);
+
+  hsk_rrl_free(rrl);
+}
+
+void
+test_rrl() {
+  printf(" test_rrl_slip\n");
+  test_rrl_slip();
+
+  printf(" test_rrl_proof\n");
+  test_rrl_proof();
+
+  printf(" test_rrl_evict\n");
+  test_rrl_evict();
+}
@@ -0,0 +1,95 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sendpool.h"
+
+static void
+test_sendpool_reuse() {
+  hsk_sendpool_t pool;
+  hsk_sendpool_init(&pool);
+
+  hsk_send_t *sends[8];
+
+  // Warm up: the first round has to allocate.
+  for (int i = 0; i < 8; i++) {
+    sends[i] = hsk_sendpool_get(&pool);
+    assert(sends[i]);
+  }
+
+  assert(pool.allocs == 8);
+  assert(pool.pending == 8);
+
+  for (int i = 0; i < 8; i++)
+    hsk_sendpool_put(&pool, sends[i]);
+
+  assert(pool.pending == 0);
+  assert(pool.size == 8);
+
+  // Steady state: no further allocations.
+  for (int round = 0; round < 100; round++) {
+    for (int i = 0; i < 8; i++)
+      sends[i] = hsk_sendpool_get(&pool);
+
+    for (int i = 0; i < 8; i++)
+      hsk_sendpool_put(&pool, sends[i]);
+  }
+
+  assert(pool.allocs == 8);
+  assert(pool.size == 8);
+
+  hsk_sendpool_uninit(&pool);
+}
+
+static void
+test_sendpool_max() {
+  hsk_sendpool_t pool;
+  hsk_sendpool_init(&pool);
+  pool.max = 2;
+
+  hsk_send_t *sends[4];
+
+  for (int i = 0; i < 4; i++)
+    sends[i] = hsk_sendpool_get(&pool);
+
+  for (int i = 0; i < 4; i++)
+    hsk_sendpool_put(&pool, sends[i]);
+
+  // Anything past the limit is freed.
+  assert(pool.size == 2);
+
+  hsk_sendpool_uninit(&pool);
+}
+
+static void
+test_sendpool_release() {
+  hsk_sendpool_t *pool = hsk_sendpool_alloc();
+  assert(pool);
+
+  hsk_send_t *a = hsk_sendpool_get(pool);
+  hsk_send_t *b = hsk_sendpool_get(pool);
+
+  // Still in flight: the pool outlives its owner.
+  hsk_sendpool_release(pool);
+  assert(pool->closed);
+  assert(pool->pending == 2);
+
+  hsk_sendpool_put(pool, a);
+  assert(pool->size == 0);
+
+  // Last one frees the pool (checked under ASan).
+  hsk_sendpool_put(pool, b);
+}
+
+void
+test_sendpool() {
+  printf(" test_sendpool_reuse\n");
+  test_sendpool_reuse();
+
+  printf(" test_sendpool_max\n");
+  test_sendpool_max();
+
+  printf(" test_sendpool_release\n");
+  test_sendpool_release();
+}
@@ -0,0 +1,103 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns.h"
+#include "resource.h"
+#include "sigcache.h"
+
+static void
+test_sigcache_get_put() {
+  hsk_sigcache_t c;
+  assert(hsk_sigcache_init(&c, 4));
+
+  uint8_t hash[32];
+  uint8_t priv[32];
+  uint8_t other[32];
+  uint8_t sig[64];
+  uint8_t out[64];
+
+  memset(hash, 0x01, sizeof(hash));
+  memset(priv, 0x02, sizeof(priv));
+  memset(other, 0x03, sizeof(other));
+  memset(sig, 0x04, sizeof(sig));
+
+  assert(!hsk_sigcache_get(&c, hash, priv, out));
+
+  hsk_sigcache_put(&c, hash, priv, sig);
+
+  assert(hsk_sigcache_get(&c, hash, priv, out));
+  assert(memcmp(out, sig, 64) == 0);
+
+  // Signed by a different key.
+  assert(!hsk_sigcache_get(&c, hash, other, out));
+
+  // Same slot, different hash: replaced.
+  uint8_t hash2[32];
+  memcpy(hash2, hash, 32);
+  hash2[31] ^= 0xff;
+
+  hsk_sigcache_put(&c, hash2, priv, sig);
+
+  assert(!hsk_sigcache_get(&c, hash, priv, out));
+  assert(hsk_sigcache_get(&c, hash2, priv, out));
+
+  assert(c.hits == 2);
+  assert(c.misses == 3);
+
+  hsk_sigcache_uninit(&c);
+}
+
+static const hsk_dns_rrsig_rd_t *
+first_rrsig(const hsk_dns_msg_t *msg) {
+  for (int i = 0; i < msg->ns.size; i++) {
+    const hsk_dns_rr_t *rr = msg->ns.items[i];
+
+    if (rr->type == HSK_DNS_RRSIG)
+      return (const hsk_dns_rrsig_rd_t *)rr->rd;
+  }
+
+  return NULL;
+}
+
+static void
+test_sigcache_rrsig_reuse() {
+  hsk_sigcache_t *c = hsk_sigcache_global();
+  assert(c);
+
+  hsk_dns_msg_t *a = hsk_resource_to_nx();
+  uint64_t hits = c->hits;
+  hsk_dns_msg_t *b = hsk_resource_to_nx();
+
+  assert(a && b);
+
+  const hsk_dns_rrsig_rd_t *sa = first_rrsig(a);
+  const hsk_dns_rrsig_rd_t *sb = first_rrsig(b);
+
+  assert(sa && sb);
+
+  // Window is bucketed: both ends land on its boundary.
+  assert(sa->inception % HSK_DNS_SIG_WINDOW == 0);
+  assert(sa->expiration - sa->inception == 2 * HSK_DNS_SIG_VALIDITY);
+
+  // Unless a window boundary fell in between,
+  // the second proof reused the first's signatures.
+  if (sa->inception == sb->inception) {
+    assert(c->hits >= hits + 2);
+    assert(sa->signature_len == sb->signature_len);
+    assert(memcmp(sa->signature, sb->signature, sa->signature_len) == 0);
+  }
+
+  hsk_dns_msg_free(a);
+  hsk_dns_msg_free(b);
+}
+
+void
+test_sigcache() {
+  printf(" test_sigcache_get_put\n");
+  test_sigcache_get_put();
+
+  printf(" test_sigcache_rrsig_reuse\n");
+  test_sigcache_rrsig_reuse();
+}
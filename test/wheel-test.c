@@ -0,0 +1,116 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wheel.h"
+
+#define WHEEL_ENTRIES 2000
+
+static void
+test_wheel_levels() {
+  hsk_wheel_t wheel;
+  hsk_wheel_init(&wheel, 1000);
+
+  // One per level, plus one already due.
+  const uint64_t deadlines[5] = { 1003, 1000 + 100, 1000 + 5000,
+                                  1000 + 300000, 900 };
+  hsk_wheel_entry_t entries[5];
+
+  for (int i = 0; i < 5; i++) {
+    hsk_wheel_entry_init(&entries[i]);
+    hsk_wheel_add(&wheel, &entries[i], deadlines[i]);
+    assert(hsk_wheel_entry_active(&entries[i]));
+  }
+
+  assert(wheel.size == 5);
+
+  assert(hsk_wheel_expire(&wheel, 1000) == NULL);
+  assert(hsk_wheel_expire(&wheel, 1001) == &entries[4]);
+  assert(!hsk_wheel_entry_active(&entries[4]));
+  assert(hsk_wheel_expire(&wheel, 1001) == NULL);
+
+  assert(hsk_wheel_expire(&wheel, 1002) == NULL);
+  assert(hsk_wheel_expire(&wheel, 1003) == &entries[0]);
+
+  assert(hsk_wheel_expire(&wheel, 1099) == NULL);
+  assert(hsk_wheel_expire(&wheel, 1100) == &entries[1]);
+
+  // Removed before it is due.
+  hsk_wheel_remove(&wheel, &entries[2]);
+  assert(!hsk_wheel_entry_active(&entries[2]));
+  assert(hsk_wheel_expire(&wheel, 1000 + 10000) == NULL);
+
+  assert(hsk_wheel_expire(&wheel, 1000 + 299999) == NULL);
+  assert(hsk_wheel_expire(&wheel, 1000 + 300000) == &entries[3]);
+
+  assert(wheel.size == 0);
+
+  // Idle wheels skip ahead instead of ticking.
+  hsk_wheel_catch_up(&wheel, 1000 + 900000);
+  assert(wheel.now == 1000 + 900000);
+
+  hsk_wheel_add(&wheel, &entries[0], 1000 + 900002);
+  hsk_wheel_catch_up(&wheel, 1000 + 900005);
+  assert(wheel.now == 1000 + 900000);
+  assert(hsk_wheel_expire(&wheel, 1000 + 900001) == NULL);
+  assert(hsk_wheel_expire(&wheel, 1000 + 900002) == &entries[0]);
+}
+
+static void
+test_wheel_random() {
+  static hsk_wheel_entry_t entries[WHEEL_ENTRIES];
+  static bool fired[WHEEL_ENTRIES];
+
+  hsk_wheel_t wheel;
+  hsk_wheel_init(&wheel, 12345);
+
+  srand(1);
+
+  for (int i = 0; i < WHEEL_ENTRIES; i++) {
+    hsk_wheel_entry_init(&entries[i]);
+    hsk_wheel_add(&wheel, &entries[i], 12345 + 1 + rand() % 20000);
+    fired[i] = false;
+  }
+
+  // Drop every tenth.
+  for (int i = 0; i < WHEEL_ENTRIES; i += 10)
+    hsk_wheel_remove(&wheel, &entries[i]);
+
+  // Uneven steps, expiring on time and in order.
+  uint64_t now = 12345;
+  uint64_t last = 0;
+  int count = 0;
+
+  while (now < 12345 + 20001) {
+    now += 1 + rand() % 7;
+
+    hsk_wheel_entry_t *entry;
+
+    while ((entry = hsk_wheel_expire(&wheel, now))) {
+      int i = entry - entries;
+
+      assert(i % 10 != 0);
+      assert(!fired[i]);
+      assert(entry->expires <= now);
+      assert(entry->expires >= last);
+      assert(entry->expires == wheel.now);
+
+      fired[i] = true;
+      last = entry->expires;
+      count += 1;
+    }
+  }
+
+  assert(count == WHEEL_ENTRIES - WHEEL_ENTRIES / 10);
+  assert(wheel.size == 0);
+}
+
+void
+test_wheel() {
+  printf(" test_wheel_levels\n");
+  test_wheel_levels();
+
+  printf(" test_wheel_random\n");
+  test_wheel_random();
+}
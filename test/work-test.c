@@ -0,0 +1,126 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uv.h"
+#include "work.h"
+
+typedef struct test_job_s {
+  int input;
+  int output;
+  bool done;
+  bool cancelled;
+} test_job_t;
+
+static void
+test_work_cb(void *arg) {
+  test_job_t *job = (test_job_t *)arg;
+  job->output = job->input * 2;
+}
+
+static void
+test_after_cb(void *arg, bool cancelled) {
+  test_job_t *job = (test_job_t *)arg;
+  job->done = true;
+  job->cancelled = cancelled;
+}
+
+static void
+test_work_queue() {
+  uv_loop_t loop;
+  assert(uv_loop_init(&loop) == 0);
+
+  hsk_work_t *work = hsk_work_alloc(&loop);
+  assert(work);
+
+  test_job_t jobs[8];
+  memset(jobs, 0, sizeof(jobs));
+
+  for (int i = 0; i < 8; i++) {
+    jobs[i].input = i;
+    assert(hsk_work_queue(work, test_work_cb, test_after_cb, &jobs[i]));
+  }
+
+  assert(work->pending == 8);
+  assert(work->queued == 8);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  for (int i = 0; i < 8; i++) {
+    assert(jobs[i].done);
+    assert(!jobs[i].cancelled);
+    assert(jobs[i].output == i * 2);
+  }
+
+  assert(work->pending == 0);
+  assert(work->completed == 8);
+  assert(hsk_work_wait_avg(work) <= work->wait_max);
+
+  hsk_work_release(work);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+static void
+test_work_bounded() {
+  uv_loop_t loop;
+  assert(uv_loop_init(&loop) == 0);
+
+  hsk_work_t *work = hsk_work_alloc(&loop);
+  assert(work);
+  work->max_pending = 2;
+
+  test_job_t jobs[3];
+  memset(jobs, 0, sizeof(jobs));
+
+  assert(hsk_work_queue(work, test_work_cb, test_after_cb, &jobs[0]));
+  assert(hsk_work_queue(work, test_work_cb, test_after_cb, &jobs[1]));
+
+  // Full: the caller keeps the job.
+  assert(!hsk_work_queue(work, test_work_cb, test_after_cb, &jobs[2]));
+  assert(work->queued == 2);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  assert(jobs[0].done && jobs[1].done && !jobs[2].done);
+
+  hsk_work_release(work);
+  assert(uv_loop_close(&loop) == 0);
+}
+
+static void
+test_work_release() {
+  uv_loop_t loop;
+  assert(uv_loop_init(&loop) == 0);
+
+  hsk_work_t *work = hsk_work_alloc(&loop);
+  assert(work);
+
+  test_job_t job;
+  memset(&job, 0, sizeof(job));
+
+  assert(hsk_work_queue(work, test_work_cb, test_after_cb, &job));
+
+  // Owner goes away first: the job comes back cancelled,
+  // and the queue frees itself (checked under ASan).
+  hsk_work_release(work);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  assert(job.done);
+  assert(job.cancelled);
+
+  assert(uv_loop_close(&loop) == 0);
+}
+
+void
+test_work() {
+  printf(" test_work_queue\n");
+  test_work_queue();
+
+  printf(" test_work_bounded\n");
+  test_work_bounded();
+
+  printf(" test_work_release\n");
+  test_work_release();
+}
@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "addr.h"
+#include "dns.h"
+#include "req.h"
+#include "sig0.h"
+#include "zone.h"
+
+static void
+make_addr(hsk_addr_t *addr) {
+  assert(hsk_addr_from_string(addr, "127.0.0.1", 53));
+}
+
+static void
+make_req(
+  hsk_dns_req_t *req,
+  const char *name,
+  uint16_t type,
+  int variant,
+  size_t max_size
+) {
+  hsk_dns_req_init(req);
+  strcpy(req->name, name);
+  req->id = 0x1234;
+  req->type = type;
+  req->class = HSK_DNS_IN;
+  req->rd = true;
+  req->edns = variant > 0;
+  req->dnssec = variant == 2;
+  req->max_size = max_size;
+}
+
+// The template must match finalizing a copy byte for byte.
+static void
+check_wire(hsk_zone_t *zone, int slot, const hsk_dns_req_t *req, bool sig0) {
+  uint8_t *fast = NULL;
+  size_t fast_len = 0;
+
+  if (!hsk_zone_wire(zone, slot, req, sig0, &fast, &fast_len))
+    return;
+
+  hsk_dns_msg_t *msg = hsk_zone_msg(zone, slot);
+  assert(msg);
+
+  uint8_t *slow = NULL;
+  size_t slow_len = 0;
+
+  assert(hsk_dns_msg_finalize_raw(&msg, req, sig0, &slow, &slow_len));
+
+  assert(fast_len == slow_len);
+  assert(memcmp(fast, slow, fast_len) == 0);
+
+  free(fast);
+  free(slow);
+}
+
+static void
+test_zone_wire() {
+  hsk_zone_t zone;
+  hsk_addr_t addr;
+
+  hsk_zone_init(&zone);
+  make_addr(&addr);
+
+  assert(hsk_zone_sign(&zone, &addr));
+  assert(zone.ready);
+
+  const char *names[] = { ".", "bit.", "Some.Name.example." };
+  const uint16_t types[] = {
+    HSK_DNS_A,
+    HSK_DNS_NS,
+    HSK_DNS_SOA,
+    HSK_DNS_DNSKEY,
+    HSK_DNS_DS,
+    HSK_DNS_ANY,
+    HSK_DNS_NSEC,
+    HSK_DNS_RRSIG
+  };
+  const size_t sizes[] = { HSK_DNS_MAX_UDP, HSK_DNS_MAX_EDNS };
+
+  for (int n = 0; n < 3; n++) {
+    for (int t = 0; t < 8; t++) {
+      for (int v = 0; v < HSK_ZONE_VARIANTS; v++) {
+        for (int s = 0; s < 2; s++) {
+          hsk_dns_req_t req;
+          make_req(&req, names[n], types[t], v, sizes[s]);
+
+          int slot = n == 0 ? hsk_zone_root_slot(types[t]) : HSK_ZONE_NX;
+
+          check_wire(&zone, slot, &req, false);
+          check_wire(&zone, slot, &req, true);
+          check_wire(&zone, HSK_ZONE_SERVFAIL, &req, false);
+        }
+      }
+    }
+  }
+
+  assert(zone.hits > 0);
+
+  hsk_zone_uninit(&zone);
+}
+
+static void
+test_zone_fallback() {
+  hsk_zone_t zone;
+  hsk_addr_t addr;
+
+  hsk_zone_init(&zone);
+  make_addr(&addr);
+
+  hsk_dns_req_t req;
+  uint8_t *wire;
+  size_t wire_len;
+
+  make_req(&req, ".", HSK_DNS_NS, 2, HSK_DNS_MAX_EDNS);
+
+  // Nothing signed yet.
+  assert(!hsk_zone_wire(&zone, HSK_ZONE_NS, &req, false, &wire, &wire_len));
+  assert(!hsk_zone_msg(&zone, HSK_ZONE_NS));
+
+  assert(hsk_zone_sign(&zone, &addr));
+  assert(hsk_zone_wire(&zone, HSK_ZONE_NS, &req, false, &wire, &wire_len));
+  free(wire);
+
+  // Cleaning depends on the query type.
+  make_req(&req, "foo.", HSK_DNS_NSEC, 1, HSK_DNS_MAX_EDNS);
+  assert(!hsk_zone_wire(&zone, HSK_ZONE_NX, &req, false, &wire, &wire_len));
+
+  // Too big for the client.
+  make_req(&req, ".", HSK_DNS_DNSKEY, 2, 100);
+  assert(!hsk_zone_wire(&zone, HSK_ZONE_DNSKEY, &req, true, &wire, &wire_len));
+
+  assert(zone.misses == 3);
+
+  hsk_zone_uninit(&zone);
+}
+
+void
+test_zone() {
+  printf(" test_zone_wire\n");
+  test_zone_wire();
+
+  printf(" test_zone_fallback\n");
+  test_zone_fallback();
+}